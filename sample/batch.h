@@ -0,0 +1,243 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include "sbm.h"
+
+#include <cstring>
+#include <vector>
+
+// Merges static instances of SBM models into a single model at load time.
+//
+// Every instance is a frame of a model placed by a transform. Instances using
+// the same material, a texture and an array layer, are pre-transformed into
+// one contiguous vertex range, a batch, which is one frame of the merged
+// model and is drawn with a single call. Each instance keeps its sub-range of
+// the batch and its world space bounding box, so culling can skip instances
+// by drawing only runs of visible sub-ranges.
+//
+// The merged model has position, normal and texture coordinate attributes,
+// the first three attributes of the instances' models. Transforms may rotate
+// and translate but not scale, since normals only get the rotation.
+class StaticBatcher
+{
+public:
+    enum { MAX_RANGES = 256, MAX_BATCHES = 16 };
+
+    // Vertices and world space bounding box of one instance.
+    struct Range
+    {
+        GLuint      first;
+        GLuint      count;
+        GLfloat     boxMin[3];
+        GLfloat     boxMax[3];
+    };
+
+    // Instances sharing a material; their ranges follow each other.
+    struct Batch
+    {
+        GLuint          texture;
+        GLint           layer;
+        GLuint          first;
+        GLuint          count;
+        unsigned int    firstRange;
+        unsigned int    numRanges;
+    };
+
+    StaticBatcher() : m_numInstances(0), m_numBatches(0)
+    {}
+
+    // Queue a frame of a model, placed by a column-major transform. The
+    // model has to stay loaded until Build().
+    bool Add(const SBObject* object, unsigned int frame, const GLfloat transform[16], GLuint texture, GLint layer)
+    {
+        if(m_numInstances >= MAX_RANGES || object->GetAttributeCount() < 3 ||
+           object->GetAttribComponents(0) < 3 || object->GetAttribComponents(1) < 3 ||
+           object->GetAttribComponents(2) < 2)
+        {
+            return false;
+        }
+        Instance& inst = m_instances[m_numInstances++];
+        inst.object = object;
+        inst.frame = frame;
+        memcpy(inst.transform, transform, sizeof(inst.transform));
+        inst.texture = texture;
+        inst.layer = layer;
+        return true;
+    }
+
+    // Merge the queued instances, grouped by material in the order their
+    // materials were first added, and upload the result.
+    bool Build()
+    {
+        std::vector<GLfloat> positions;
+        std::vector<GLfloat> normals;
+        std::vector<GLfloat> texcoords;
+        m_numBatches = 0;
+        unsigned int numRanges = 0;
+        std::vector<bool> merged(m_numInstances, false);
+        for(unsigned int i = 0; i < m_numInstances; i++)
+        {
+            if(merged[i])
+            {
+                continue;
+            }
+            if(m_numBatches >= MAX_BATCHES)
+            {
+                return false;
+            }
+            Batch& batch = m_batches[m_numBatches++];
+            batch.texture = m_instances[i].texture;
+            batch.layer = m_instances[i].layer;
+            batch.first = (GLuint) positions.size() / 3;
+            batch.firstRange = numRanges;
+            for(unsigned int j = i; j < m_numInstances; j++)
+            {
+                const Instance& inst = m_instances[j];
+                if(merged[j] || inst.texture != batch.texture || inst.layer != batch.layer)
+                {
+                    continue;
+                }
+                merged[j] = true;
+                Range& range = m_ranges[numRanges++];
+                range.first = (GLuint) positions.size() / 3;
+                Append(inst, range, positions, normals, texcoords);
+                range.count = (GLuint) positions.size() / 3 - range.first;
+            }
+            batch.count = (GLuint) positions.size() / 3 - batch.first;
+            batch.numRanges = numRanges - batch.firstRange;
+        }
+        return CreateModel(positions, normals, texcoords);
+    }
+
+    void Destroy()
+    {
+        m_model.DeleteBuffers();
+        m_model.Free();
+        m_numInstances = 0;
+        m_numBatches = 0;
+    }
+
+    // Merged model; batch i is its frame i.
+    const SBObject& GetModel() const
+    {
+        return m_model;
+    }
+
+    unsigned int GetBatchCount() const
+    {
+        return m_numBatches;
+    }
+
+    const Batch& GetBatch(unsigned int i) const
+    {
+        return m_batches[i];
+    }
+
+    const Range& GetRange(unsigned int i) const
+    {
+        return m_ranges[i];
+    }
+
+private:
+    struct Instance
+    {
+        const SBObject* object;
+        unsigned int    frame;
+        GLfloat         transform[16];
+        GLuint          texture;
+        GLint           layer;
+    };
+
+    static void Append(const Instance& inst, Range& range, std::vector<GLfloat>& positions,
+                       std::vector<GLfloat>& normals, std::vector<GLfloat>& texcoords)
+    {
+        const SBObject* obj = inst.object;
+        const GLfloat* m = inst.transform;
+        const unsigned char* data = obj->GetVertexData();
+        const GLfloat* pos = (const GLfloat*) (data + obj->GetAttribOffset(0));
+        const GLfloat* norm = (const GLfloat*) (data + obj->GetAttribOffset(1));
+        const GLfloat* uv = (const GLfloat*) (data + obj->GetAttribOffset(2));
+        unsigned int posSize = obj->GetAttribComponents(0);
+        unsigned int normSize = obj->GetAttribComponents(1);
+        unsigned int uvSize = obj->GetAttribComponents(2);
+        unsigned int first = obj->GetFirstFrameVertex(inst.frame);
+        unsigned int count = obj->GetFrameVertexCount(inst.frame);
+        for(unsigned int v = first; v < first + count; v++)
+        {
+            const GLfloat* p = &pos[v * posSize];
+            const GLfloat* n = &norm[v * normSize];
+            for(int k = 0; k < 3; k++)
+            {
+                GLfloat world = m[k] * p[0] + m[4 + k] * p[1] + m[8 + k] * p[2] + m[12 + k];
+                bool firstVertex = v == first;
+                range.boxMin[k] = (firstVertex || world < range.boxMin[k]) ? world : range.boxMin[k];
+                range.boxMax[k] = (firstVertex || world > range.boxMax[k]) ? world : range.boxMax[k];
+                positions.push_back(world);
+            }
+            for(int k = 0; k < 3; k++)
+            {
+                normals.push_back(m[k] * n[0] + m[4 + k] * n[1] + m[8 + k] * n[2]);
+            }
+            texcoords.push_back(uv[v * uvSize]);
+            texcoords.push_back(uv[v * uvSize + 1]);
+        }
+    }
+
+    // Assemble the merged arrays as an SBM image, one frame per batch.
+    bool CreateModel(const std::vector<GLfloat>& positions, const std::vector<GLfloat>& normals,
+                     const std::vector<GLfloat>& texcoords)
+    {
+        if(positions.empty())
+        {
+            return false;
+        }
+        SBM_HEADER header;
+        memset(&header, 0, sizeof(header));
+        header.size = sizeof(SBM_HEADER);
+        strncpy(header.name, "static batch", sizeof(header.name) - 1);
+        header.num_attribs = 3;
+        header.num_frames = m_numBatches;
+        header.num_vertices = (unsigned int) positions.size() / 3;
+
+        SBM_ATTRIB_HEADER attribs[3];
+        const unsigned int components[3] = { 3, 3, 2 };
+        for(int a = 0; a < 3; a++)
+        {
+            memcpy(&attribs[a], m_instances[0].object->GetAttributeHeader(a), sizeof(SBM_ATTRIB_HEADER));
+            attribs[a].type = GL_FLOAT;
+            attribs[a].components = components[a];
+        }
+
+        std::vector<unsigned char> image(sizeof(header) + sizeof(attribs) + m_numBatches * sizeof(SBM_FRAME_HEADER));
+        unsigned char* out = &image[0];
+        memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        memcpy(out, attribs, sizeof(attribs));
+        out += sizeof(attribs);
+        for(unsigned int b = 0; b < m_numBatches; b++)
+        {
+            SBM_FRAME_HEADER frame;
+            frame.first = m_batches[b].first;
+            frame.count = m_batches[b].count;
+            frame.flags = 0;
+            memcpy(out, &frame, sizeof(frame));
+            out += sizeof(frame);
+        }
+        const std::vector<GLfloat>* arrays[3] = { &positions, &normals, &texcoords };
+        for(int a = 0; a < 3; a++)
+        {
+            const unsigned char* bytes = (const unsigned char*) &(*arrays[a])[0];
+            image.insert(image.end(), bytes, bytes + arrays[a]->size() * sizeof(GLfloat));
+        }
+        return m_model.LoadFromMemory(&image[0], image.size()) && m_model.CreateBuffers();
+    }
+
+    Instance        m_instances[MAX_RANGES];
+    unsigned int    m_numInstances;
+    Range           m_ranges[MAX_RANGES];
+    Batch           m_batches[MAX_BATCHES];
+    unsigned int    m_numBatches;
+    SBObject        m_model;
+};
+
+#endif // __BATCH_H__
@@ -0,0 +1,380 @@
+#ifndef __BLOBCACHE_H__
+#define __BLOBCACHE_H__
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "nativefile.h"
+#include "nativethread.h"
+#include "eglutil.h"
+#include "hashutil.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// On-disk store behind EGL_ANDROID_blob_cache, shared by every process using
+// the same directory, so compiled shader binaries the driver hands out in
+// one run are handed back on later runs and to other processes.
+//
+// Each value lives in a file of its own, named after a hash of its key and
+// holding the key, the value and a checksum of both. Files are replaced in
+// one step (ReplaceNativeFile), so they are whole or absent. An index file
+// mapped by every process records the size and last use of each entry; it is
+// only touched under a lock of that file, and by one thread of the process
+// at a time. When the values outgrow the size limit the least recently used
+// ones are deleted.
+//
+// A process dying mid-update can leave an index entry without a file, or
+// with a file from another key, but no value file the index does not track:
+// entries are taken before their file is written and cleared after it is
+// deleted. Every read checks the file against the key and the checksum, so
+// such leftovers are misses, dropped from the index.
+//
+// The driver calls back without a context argument, so there is one cache
+// per process, installed with Install().
+class BlobCache
+{
+public:
+    enum { MAX_ENTRIES = 1024, DEFAULT_MAX_BYTES = 32 * 1024 * 1024 };
+
+    BlobCache() :
+        m_index(NULL), m_indexFile(NULL), m_mutex(NULL), m_maxBytes(0),
+        m_hits(0), m_misses(0), m_stores(0)
+    {
+        m_dir[0] = '\0';
+    }
+
+    // Open or create the cache in a directory, holding up to maxBytes of
+    // values.
+    bool Open(const char* dir, size_t maxBytes)
+    {
+        if(strlen(dir) + 32 > sizeof(m_dir) || !CreateNativeDirectory(dir))
+        {
+            return false;
+        }
+        strcpy(m_dir, dir);
+        m_maxBytes = maxBytes;
+        char path[sizeof(m_dir) + 32];
+        sprintf(path, "%s/index", m_dir);
+        void* data = NULL;
+        if(!OpenNativeSharedFile(path, sizeof(Index), &m_indexFile, &data))
+        {
+            return false;
+        }
+        if(!CreateNativeSemaphore(1, &m_mutex))
+        {
+            CloseNativeSharedFile(m_indexFile);
+            m_indexFile = NULL;
+            return false;
+        }
+        m_index = (Index*) data;
+
+        // a new file is all zeros; one of another layout starts over, and
+        // the total is recounted in case a process died while updating it
+        Lock();
+        if(m_index->magic != INDEX_MAGIC || m_index->numEntries != MAX_ENTRIES)
+        {
+            memset(m_index, 0, sizeof(Index));
+            m_index->magic = INDEX_MAGIC;
+            m_index->numEntries = MAX_ENTRIES;
+        }
+        m_index->totalBytes = 0;
+        for(unsigned int i = 0; i < MAX_ENTRIES; i++)
+        {
+            m_index->entries[i].size = m_index->entries[i].used ? m_index->entries[i].size : 0;
+            m_index->totalBytes += m_index->entries[i].size;
+        }
+        Unlock();
+        return true;
+    }
+
+    void Close()
+    {
+        if(m_indexFile != NULL)
+        {
+            CloseNativeSharedFile(m_indexFile);
+            DestroyNativeSemaphore(m_mutex);
+        }
+        m_indexFile = NULL;
+        m_index = NULL;
+        m_mutex = NULL;
+    }
+
+    bool IsOpen() const
+    {
+        return m_index != NULL;
+    }
+
+    // Hand the callbacks of this cache to the driver. Must be called before
+    // any context of the display is created.
+    bool Install(EGLDisplay display)
+    {
+        PFNEGLSETBLOBCACHEFUNCSANDROIDPROC setBlobCacheFuncs =
+            (PFNEGLSETBLOBCACHEFUNCSANDROIDPROC) eglGetProcAddress("eglSetBlobCacheFuncsANDROID");
+        if(!IsOpen() || !HasEGLExtension(display, "EGL_ANDROID_blob_cache") || setBlobCacheFuncs == NULL)
+        {
+            return false;
+        }
+        Instance() = this;
+        setBlobCacheFuncs(display, SetBlob, GetBlob);
+        return true;
+    }
+
+    // Store a value, replacing the one of the same key, and evict values
+    // over the size limit.
+    void Set(const void* key, size_t keySize, const void* value, size_t valueSize)
+    {
+        size_t size = sizeof(BlobHeader) + keySize + valueSize;
+        if(!IsOpen() || size > m_maxBytes)
+        {
+            return;
+        }
+        BlobHeader header;
+        header.magic = BLOB_MAGIC;
+        header.keySize = (khronos_uint32_t) keySize;
+        header.valueSize = (khronos_uint32_t) valueSize;
+        header.checksum = HashFNV1a(value, valueSize, HashFNV1a(key, keySize));
+        std::vector<unsigned char> blob(size);
+        memcpy(&blob[0], &header, sizeof(header));
+        memcpy(&blob[sizeof(header)], key, keySize);
+        memcpy(&blob[sizeof(header) + keySize], value, valueSize);
+
+        khronos_uint64_t hash = KeyHash(key, keySize);
+        char path[sizeof(m_dir) + 32];
+        GetBlobPath(hash, path);
+        Lock();
+        // the index takes the entry before the file is written, so a crash
+        // in between leaves an entry without a file, which reads drop, and
+        // never a file the index does not know of and would not evict
+        Entry* entry = Find(hash);
+        entry = (entry != NULL) ? entry : Find(0);
+        if(entry == NULL)
+        {
+            entry = FindOldest(NULL);
+            Remove(entry);
+        }
+        m_index->totalBytes -= entry->size;
+        entry->hash = hash;
+        entry->size = size;
+        entry->lastUse = ++m_index->clock;
+        entry->used = 1;
+        m_index->totalBytes += size;
+        Entry* oldest = FindOldest(entry);
+        while(m_index->totalBytes > m_maxBytes && oldest != NULL)
+        {
+            Remove(oldest);
+            oldest = FindOldest(entry);
+        }
+        if(ReplaceNativeFile(path, &blob[0], size))
+        {
+            m_stores++;
+        }
+        else
+        {
+            Remove(entry);
+        }
+        Unlock();
+    }
+
+    // Copy the value of a key if it fits. Returns the size of the value, or 0
+    // if the key is not stored.
+    size_t Get(const void* key, size_t keySize, void* value, size_t valueSize)
+    {
+        if(!IsOpen())
+        {
+            return 0;
+        }
+        khronos_uint64_t hash = KeyHash(key, keySize);
+        char path[sizeof(m_dir) + 32];
+        GetBlobPath(hash, path);
+        size_t found = 0;
+        Lock();
+        Entry* entry = Find(hash);
+        if(entry != NULL)
+        {
+            found = Read(path, key, keySize, value, valueSize);
+            if(found != 0)
+            {
+                entry->lastUse = ++m_index->clock;
+            }
+            else
+            {
+                Remove(entry);
+            }
+        }
+        if(found != 0)
+        {
+            m_hits++;
+        }
+        else
+        {
+            m_misses++;
+        }
+        Unlock();
+        return found;
+    }
+
+    void PrintStats() const
+    {
+        printf("Blob cache: %u hits, %u misses, %u stored\n", m_hits, m_misses, m_stores);
+    }
+
+private:
+    enum { INDEX_MAGIC = 0x58444942, BLOB_MAGIC = 0x424f4c42 };
+
+    struct Entry
+    {
+        khronos_uint64_t    hash;
+        khronos_uint64_t    size;
+        khronos_uint64_t    lastUse;
+        khronos_uint64_t    used;
+    };
+
+    struct Index
+    {
+        khronos_uint32_t    magic;
+        khronos_uint32_t    numEntries;
+        khronos_uint64_t    totalBytes;
+        khronos_uint64_t    clock;
+        Entry               entries[MAX_ENTRIES];
+    };
+
+    struct BlobHeader
+    {
+        khronos_uint32_t    magic;
+        khronos_uint32_t    keySize;
+        khronos_uint32_t    valueSize;
+        khronos_uint32_t    pad;
+        khronos_uint64_t    checksum;
+    };
+
+    static BlobCache*& Instance()
+    {
+        static BlobCache* instance = NULL;
+        return instance;
+    }
+
+    static void SetBlob(const void* key, EGLsizeiANDROID keySize, const void* value, EGLsizeiANDROID valueSize)
+    {
+        Instance()->Set(key, (size_t) keySize, value, (size_t) valueSize);
+    }
+
+    static EGLsizeiANDROID GetBlob(const void* key, EGLsizeiANDROID keySize, void* value, EGLsizeiANDROID valueSize)
+    {
+        return (EGLsizeiANDROID) Instance()->Get(key, (size_t) keySize, value, (size_t) valueSize);
+    }
+
+    // never 0, which marks free entries
+    static khronos_uint64_t KeyHash(const void* key, size_t keySize)
+    {
+        khronos_uint64_t hash = HashFNV1a(key, keySize);
+        return (hash != 0) ? hash : 1;
+    }
+
+    void GetBlobPath(khronos_uint64_t hash, char* path) const
+    {
+        sprintf(path, "%s/%08x%08x.blob", m_dir, (unsigned int) (hash >> 32), (unsigned int) hash);
+    }
+
+    void Lock()
+    {
+        WaitNativeSemaphore(m_mutex);
+        LockNativeSharedFile(m_indexFile);
+    }
+
+    void Unlock()
+    {
+        UnlockNativeSharedFile(m_indexFile);
+        PostNativeSemaphore(m_mutex);
+    }
+
+    // The used entry of a hash, or with hash 0 a free one. The index is
+    // small enough to scan.
+    Entry* Find(khronos_uint64_t hash)
+    {
+        for(unsigned int i = 0; i < MAX_ENTRIES; i++)
+        {
+            Entry& entry = m_index->entries[i];
+            if(hash != 0 ? (entry.used && entry.hash == hash) : !entry.used)
+            {
+                return &entry;
+            }
+        }
+        return NULL;
+    }
+
+    // The least recently used entry other than keep, NULL if there is none.
+    Entry* FindOldest(const Entry* keep)
+    {
+        Entry* oldest = NULL;
+        for(unsigned int i = 0; i < MAX_ENTRIES; i++)
+        {
+            Entry& entry = m_index->entries[i];
+            if(entry.used && &entry != keep && (oldest == NULL || entry.lastUse < oldest->lastUse))
+            {
+                oldest = &entry;
+            }
+        }
+        return oldest;
+    }
+
+    void Remove(Entry* entry)
+    {
+        if(entry->used)
+        {
+            char path[sizeof(m_dir) + 32];
+            GetBlobPath(entry->hash, path);
+            DeleteNativeFile(path);
+        }
+        m_index->totalBytes -= entry->size;
+        memset(entry, 0, sizeof(Entry));
+    }
+
+    // Read a value file, checking that it is whole and of this key.
+    static size_t Read(const char* path, const void* key, size_t keySize, void* value, size_t valueSize)
+    {
+        NativeFile file;
+        const void* data = NULL;
+        size_t size = 0;
+        if(!MapNativeFile(path, &file, &data, &size))
+        {
+            return 0;
+        }
+        const unsigned char* bytes = (const unsigned char*) data;
+        BlobHeader header;
+        size_t found = 0;
+        if(size >= sizeof(header) + keySize)
+        {
+            memcpy(&header, bytes, sizeof(header));
+            const unsigned char* storedKey = bytes + sizeof(header);
+            const unsigned char* storedValue = storedKey + keySize;
+            if(header.magic == BLOB_MAGIC && header.keySize == keySize &&
+               header.valueSize == size - sizeof(header) - keySize &&
+               memcmp(storedKey, key, keySize) == 0 &&
+               HashFNV1a(storedValue, header.valueSize, HashFNV1a(storedKey, keySize)) == header.checksum)
+            {
+                found = header.valueSize;
+                if(valueSize >= found)
+                {
+                    memcpy(value, storedValue, found);
+                }
+            }
+        }
+        UnmapNativeFile(file);
+        return found;
+    }
+
+    char            m_dir[512];
+    Index*          m_index;
+    NativeSharedFile m_indexFile;
+    NativeSemaphore m_mutex;
+    size_t          m_maxBytes;
+
+    // counted for this process only
+    unsigned int    m_hits;
+    unsigned int    m_misses;
+    unsigned int    m_stores;
+};
+
+#endif // __BLOBCACHE_H__
@@ -0,0 +1,154 @@
+#ifndef __BMP_H__
+#define __BMP_H__
+
+#include <GLES2/gl2.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#pragma pack(1)
+struct RGB {
+  GLbyte blue;
+  GLbyte green;
+  GLbyte red;
+  GLbyte alpha;
+};
+
+struct BMPInfoHeader {
+  GLuint	size;
+  GLuint	width;
+  GLuint	height;
+  GLushort  planes;
+  GLushort  bits;
+  GLuint	compression;
+  GLuint	imageSize;
+  GLuint	xScale;
+  GLuint	yScale;
+  GLuint	colors;
+  GLuint	importantColors;
+};
+
+struct BMPHeader {
+  GLushort	type;
+  GLuint	size;
+  GLushort	unused;
+  GLushort	unused2;
+  GLuint	offset;
+};
+
+struct BMPInfo {
+  BMPInfoHeader		header;
+  RGB				colors[1];
+};
+
+#pragma pack(8)
+
+// Bytes per row of a 24 bit image; BMP pads rows to four bytes, which also
+// matches the default GL_UNPACK_ALIGNMENT.
+inline GLuint GetBMPRowSize(GLint width)
+{
+    return (width * 3 + 3) & ~3;
+}
+
+// Read an uncompressed 24 bit BMP. Returns the rows bottom-up as stored in
+// the file, allocated with malloc, or NULL on failure.
+inline GLbyte* LoadBMP(const char* filename, GLint* width, GLint* height)
+{
+    FILE*	pFile;
+	BMPInfo *pBitmapInfo = NULL;
+	unsigned long lInfoSize = 0;
+	unsigned long lBitSize = 0;
+	GLbyte *pBits = NULL;
+	BMPHeader	bitmapHeader;
+
+    pFile = fopen(filename, "rb");
+    if(pFile == NULL)
+        return NULL;
+
+    if(fread(&bitmapHeader, 1, sizeof(BMPHeader), pFile) != sizeof(BMPHeader))
+    {
+        fclose(pFile);
+        printf("Failed to load texture.\n");
+		return NULL;
+    }
+
+	lInfoSize = bitmapHeader.offset - sizeof(BMPHeader);
+	pBitmapInfo = (BMPInfo *) malloc(sizeof(GLbyte)*lInfoSize);
+	if(fread(pBitmapInfo, 1, lInfoSize, pFile) != lInfoSize)
+	{
+		free(pBitmapInfo);
+		fclose(pFile);
+        printf("Failed to load texture.\n");
+		return NULL;
+	}
+
+	GLint nWidth = pBitmapInfo->header.width;
+	GLint nHeight = pBitmapInfo->header.height;
+	lBitSize = pBitmapInfo->header.imageSize;
+
+	if(pBitmapInfo->header.bits != 24)
+	{
+        printf("Failed to load texture.\n");
+		free(pBitmapInfo);
+		fclose(pFile);
+		return NULL;
+	}
+
+	if(lBitSize == 0)
+		lBitSize = (nWidth *
+           pBitmapInfo->header.bits + 7) / 8 *
+  		  abs(nHeight);
+
+	free(pBitmapInfo);
+	pBits = (GLbyte*)malloc(sizeof(GLbyte)*lBitSize);
+
+	if(fread(pBits, 1, lBitSize, pFile) != lBitSize)
+	{
+		free(pBits);
+		pBits = NULL;
+	}
+
+	fclose(pFile);
+
+    *width = nWidth;
+    *height = nHeight;
+    return pBits;
+}
+
+// Write rows laid out as LoadBMP() returns them as a 24 bit BMP.
+inline bool SaveBMP(const char* filename, GLint width, GLint height, const GLbyte* bits)
+{
+    FILE* pFile = fopen(filename, "wb");
+    if(pFile == NULL)
+    {
+        printf("Could not open %s for writing.\n", filename);
+        return false;
+    }
+
+    GLuint imageSize = GetBMPRowSize(width) * height;
+    BMPHeader bitmapHeader;
+    memset(&bitmapHeader, 0, sizeof(bitmapHeader));
+    bitmapHeader.type = 0x4d42;     // "BM"
+    bitmapHeader.offset = sizeof(BMPHeader) + sizeof(BMPInfoHeader);
+    bitmapHeader.size = bitmapHeader.offset + imageSize;
+
+    BMPInfoHeader infoHeader;
+    memset(&infoHeader, 0, sizeof(infoHeader));
+    infoHeader.size = sizeof(BMPInfoHeader);
+    infoHeader.width = width;
+    infoHeader.height = height;
+    infoHeader.planes = 1;
+    infoHeader.bits = 24;
+    infoHeader.imageSize = imageSize;
+
+    fwrite(&bitmapHeader, sizeof(bitmapHeader), 1, pFile);
+    fwrite(&infoHeader, sizeof(infoHeader), 1, pFile);
+    fwrite(bits, 1, imageSize, pFile);
+
+    bool ok = ferror(pFile) == 0;
+    fclose(pFile);
+    return ok;
+}
+
+#endif // __BMP_H__
@@ -0,0 +1,127 @@
+#ifndef __COMMANDLIST_H__
+#define __COMMANDLIST_H__
+
+#include <GLES2/gl2.h>
+
+#include "sbm.h"
+
+class SurfaceView;
+
+enum RenderCommandType
+{
+    CMD_BIND_VIEW,      // direct the following commands at another surface
+    CMD_VIEWPORT,       // window was resized
+    CMD_BEGIN_FRAME,    // scissor to the repaint region and clear
+    CMD_CULL_GROUP,     // occlusion test a group of the following meshes
+    CMD_DRAW_MESH,      // draw one frame of an SBObject
+    CMD_END_FRAME,      // present the frame
+    CMD_QUIT            // leave the render loop
+};
+
+struct BindViewCommand
+{
+    SurfaceView* view;
+};
+
+struct ViewportCommand
+{
+    GLint   width;
+    GLint   height;
+};
+
+struct FrameCommand
+{
+    // damage of this frame relative to the previous one
+    GLint   damage[4];
+    GLfloat clearColor[4];
+    // time of the oldest input this frame reflects, 0 if none
+    double  inputTime;
+};
+
+// Bounds of a mesh or group for occlusion culling, in the space the mvp
+// matrix transforms from. A negative node disables culling.
+struct CullBounds
+{
+    GLint   node;
+    GLfloat boxMin[3];
+    GLfloat boxMax[3];
+};
+
+struct CullGroupCommand
+{
+    CullBounds  bounds;
+    // number of CMD_DRAW_MESH commands in the group, following this one
+    GLuint      children;
+    GLfloat     mvp[16];
+};
+
+struct MeshCommand
+{
+    const SBObject* object;
+    GLuint  texture;
+    // layer of an array texture, -1 for a 2D texture
+    GLint   layer;
+    GLuint  first;
+    GLuint  count;
+    GLfloat mvp[16];
+    GLfloat light[4];
+    CullBounds bounds;
+};
+
+// Plain data, so a command list can be recorded on one thread and executed
+// on another without allocations or locks.
+struct RenderCommand
+{
+    unsigned int type;
+    union
+    {
+        BindViewCommand bind;
+        ViewportCommand viewport;
+        FrameCommand    frame;
+        CullGroupCommand group;
+        MeshCommand     mesh;
+    };
+};
+
+// Fixed capacity list of the commands of one frame.
+class CommandList
+{
+public:
+    enum { MAX_COMMANDS = 512 };
+
+    CommandList() : m_count(0)
+    {}
+
+    void Reset()
+    {
+        m_count = 0;
+    }
+
+    // Returns NULL once the list is full.
+    RenderCommand* Add(unsigned int type)
+    {
+        if(m_count >= MAX_COMMANDS)
+        {
+            return 0;
+        }
+        RenderCommand* cmd = &m_commands[m_count++];
+        cmd->type = type;
+        return cmd;
+    }
+
+    unsigned int GetCount() const
+    {
+        return m_count;
+    }
+
+    const RenderCommand& Get(unsigned int index) const
+    {
+        return m_commands[index];
+    }
+
+private:
+    unsigned int    m_count;
+    RenderCommand   m_commands[MAX_COMMANDS];
+};
+
+#endif // __COMMANDLIST_H__
@@ -0,0 +1,180 @@
+#ifndef __COMPILERPOOL_H__
+#define __COMPILERPOOL_H__
+
+#include <GLSLANG/ShaderLang.h>
+
+#include "hashutil.h"
+#include "nativethread.h"
+
+#include <map>
+#include <vector>
+
+// Constructed translator compilers kept for reuse.
+//
+// ShConstructCompiler builds the compiler's built-in symbol tables for its
+// shader type, spec and resources, which costs more than compiling most
+// shaders. A compiler resets itself at the start of every ShCompile, so one
+// handle can compile any number of shaders of its kind, one at a time.
+//
+// Acquire() hands out an idle compiler constructed for the same type, spec,
+// output and resources, or constructs one; Release() makes it idle again.
+// Resources are compared and hashed field by field, so padding bytes the
+// caller left uninitialized never tell equal resources apart; the hash is
+// kept so most keys are told apart without comparing. Any thread may
+// acquire and release; a compiler is only used by the thread holding it.
+class ShaderCompilerPool
+{
+public:
+    ShaderCompilerPool() : m_mutex(NULL), m_constructed(0), m_reused(0)
+    {
+        CreateNativeSemaphore(1, &m_mutex);
+    }
+
+    ~ShaderCompilerPool()
+    {
+        Clear();
+        DestroyNativeSemaphore(m_mutex);
+    }
+
+    // An idle compiler of the kind, or a new one; NULL if it cannot be
+    // constructed.
+    ShHandle Acquire(sh::GLenum type, ShShaderSpec spec, ShShaderOutput output, const ShBuiltInResources& resources)
+    {
+        khronos_uint64_t hash = HashResources(resources);
+        WaitNativeSemaphore(m_mutex);
+        unsigned int kind = 0;
+        while(kind < m_kinds.size() && !m_kinds[kind].Matches(type, spec, output, resources, hash))
+        {
+            kind++;
+        }
+        if(kind == m_kinds.size())
+        {
+            Kind k;
+            k.type = type;
+            k.spec = spec;
+            k.output = output;
+            k.resources = resources;
+            k.hash = hash;
+            m_kinds.push_back(k);
+        }
+        ShHandle handle = NULL;
+        if(!m_kinds[kind].idle.empty())
+        {
+            handle = m_kinds[kind].idle.back();
+            m_kinds[kind].idle.pop_back();
+            m_reused++;
+        }
+        PostNativeSemaphore(m_mutex);
+
+        // constructing takes long; other threads go on meanwhile
+        bool constructed = handle == NULL;
+        if(constructed)
+        {
+            handle = ShConstructCompiler(type, spec, output, &resources);
+            if(handle == NULL)
+            {
+                return NULL;
+            }
+        }
+        WaitNativeSemaphore(m_mutex);
+        m_constructed += constructed ? 1 : 0;
+        m_owners[handle] = kind;
+        PostNativeSemaphore(m_mutex);
+        return handle;
+    }
+
+    // Return a compiler from Acquire() for reuse.
+    void Release(ShHandle handle)
+    {
+        WaitNativeSemaphore(m_mutex);
+        std::map<ShHandle, unsigned int>::iterator owner = m_owners.find(handle);
+        if(owner != m_owners.end())
+        {
+            m_kinds[owner->second].idle.push_back(handle);
+            m_owners.erase(owner);
+        }
+        PostNativeSemaphore(m_mutex);
+    }
+
+    // Destruct the idle compilers, before ShFinalize. Compilers in use are
+    // forgotten; their holders destruct them with ShDestruct.
+    void Clear()
+    {
+        WaitNativeSemaphore(m_mutex);
+        for(unsigned int i = 0; i < m_kinds.size(); i++)
+        {
+            for(unsigned int j = 0; j < m_kinds[i].idle.size(); j++)
+            {
+                ShDestruct(m_kinds[i].idle[j]);
+            }
+            m_kinds[i].idle.clear();
+        }
+        m_owners.clear();
+        PostNativeSemaphore(m_mutex);
+    }
+
+    unsigned int GetConstructedCount() const
+    {
+        return m_constructed;
+    }
+
+    unsigned int GetReusedCount() const
+    {
+        return m_reused;
+    }
+
+private:
+    struct Kind
+    {
+        sh::GLenum              type;
+        ShShaderSpec            spec;
+        ShShaderOutput          output;
+        ShBuiltInResources      resources;
+        khronos_uint64_t        hash;
+        std::vector<ShHandle>   idle;
+
+        bool Matches(sh::GLenum t, ShShaderSpec s, ShShaderOutput o, const ShBuiltInResources& r,
+                     khronos_uint64_t h) const
+        {
+            return type == t && spec == s && output == o && hash == h && SameResources(resources, r);
+        }
+    };
+
+    // every field of ShBuiltInResources
+    #define COMPILERPOOL_RESOURCES(X) \
+        X(MaxVertexAttribs) X(MaxVertexUniformVectors) X(MaxVaryingVectors) \
+        X(MaxVertexTextureImageUnits) X(MaxCombinedTextureImageUnits) X(MaxTextureImageUnits) \
+        X(MaxFragmentUniformVectors) X(MaxDrawBuffers) X(OES_standard_derivatives) \
+        X(OES_EGL_image_external) X(ARB_texture_rectangle) X(EXT_draw_buffers) X(EXT_frag_depth) \
+        X(EXT_shader_texture_lod) X(NV_draw_buffers) X(FragmentPrecisionHigh) \
+        X(MaxVertexOutputVectors) X(MaxFragmentInputVectors) X(MinProgramTexelOffset) \
+        X(MaxProgramTexelOffset) X(HashFunction) X(ArrayIndexClampingStrategy) \
+        X(MaxExpressionComplexity) X(MaxCallStackDepth)
+
+    static bool SameResources(const ShBuiltInResources& a, const ShBuiltInResources& b)
+    {
+        #define X(field) && a.field == b.field
+        return true COMPILERPOOL_RESOURCES(X);
+        #undef X
+    }
+
+    static khronos_uint64_t HashResources(const ShBuiltInResources& r)
+    {
+        khronos_uint64_t hash = FNV1A_OFFSET;
+        #define X(field) hash = HashFNV1a(&r.field, sizeof(r.field), hash);
+        COMPILERPOOL_RESOURCES(X)
+        #undef X
+        return hash;
+    }
+
+    #undef COMPILERPOOL_RESOURCES
+
+    NativeSemaphore                     m_mutex;
+    std::vector<Kind>                   m_kinds;
+    // kind of every compiler handed out
+    std::map<ShHandle, unsigned int>    m_owners;
+    unsigned int                        m_constructed;
+    unsigned int                        m_reused;
+};
+
+#endif // __COMPILERPOOL_H__
@@ -0,0 +1,208 @@
+#ifndef __DAMAGE_H__
+#define __DAMAGE_H__
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#include "eglutil.h"
+#include "vecmath.h"
+
+// Window rectangle in GL window coordinates (origin at the bottom left).
+struct DamageRect
+{
+    int x, y, w, h;
+
+    DamageRect() : x(0), y(0), w(0), h(0)
+    {}
+
+    DamageRect(int x, int y, int w, int h) : x(x), y(y), w(w), h(h)
+    {}
+
+    bool IsEmpty() const
+    {
+        return w <= 0 || h <= 0;
+    }
+
+    DamageRect Union(const DamageRect& r) const
+    {
+        if(IsEmpty())
+            return r;
+        if(r.IsEmpty())
+            return *this;
+        int x0 = (x < r.x) ? x : r.x;
+        int y0 = (y < r.y) ? y : r.y;
+        int x1 = (x + w > r.x + r.w) ? x + w : r.x + r.w;
+        int y1 = (y + h > r.y + r.h) ? y + h : r.y + r.h;
+        return DamageRect(x0, y0, x1 - x0, y1 - y0);
+    }
+
+    DamageRect Clip(int width, int height) const
+    {
+        int x0 = (x > 0) ? x : 0;
+        int y0 = (y > 0) ? y : 0;
+        int x1 = (x + w < width) ? x + w : width;
+        int y1 = (y + h < height) ? y + h : height;
+        return DamageRect(x0, y0, x1 - x0, y1 - y0);
+    }
+
+    // Window rectangle covered by a bounding sphere, padded by a pixel on
+    // each side for rasterization rounding. Returns the full window if the
+    // sphere reaches behind the eye.
+    static DamageRect FromSphere(const mat4& mvp, const float center[3], float radius, int width, int height)
+    {
+        float minx = 1.0f, miny = 1.0f, maxx = -1.0f, maxy = -1.0f;
+        for(int i = 0; i < 8; i++)
+        {
+            vec4 corner(center[0] + ((i & 1) ? radius : -radius),
+                        center[1] + ((i & 2) ? radius : -radius),
+                        center[2] + ((i & 4) ? radius : -radius),
+                        1.0f);
+            vec4 clip = mvp * corner;
+            if(clip.w <= 0.0f)
+            {
+                return DamageRect(0, 0, width, height);
+            }
+            float nx = clip.x / clip.w;
+            float ny = clip.y / clip.w;
+            minx = (nx < minx) ? nx : minx;
+            miny = (ny < miny) ? ny : miny;
+            maxx = (nx > maxx) ? nx : maxx;
+            maxy = (ny > maxy) ? ny : maxy;
+        }
+        int x0 = (int) ((minx * 0.5f + 0.5f) * width) - 1;
+        int y0 = (int) ((miny * 0.5f + 0.5f) * height) - 1;
+        int x1 = (int) ((maxx * 0.5f + 0.5f) * width) + 2;
+        int y1 = (int) ((maxy * 0.5f + 0.5f) * height) + 2;
+        return DamageRect(x0, y0, x1 - x0, y1 - y0).Clip(width, height);
+    }
+};
+
+// Remembers the damage of recent frames so a frame can repaint only what
+// changed since the back buffer it renders into was last presented.
+class DamageTracker
+{
+public:
+    enum { MAX_AGE = 4 };
+
+    DamageTracker() : m_count(0)
+    {}
+
+    // Forget all history, e.g. after a resize invalidated every buffer.
+    void Reset()
+    {
+        m_count = 0;
+    }
+
+    // Region to repaint this frame given the age of the back buffer as
+    // reported by EGL_EXT_buffer_age. An age of 0 means the contents are
+    // undefined, and ages older than the history force a full repaint.
+    DamageRect GetRepaintRegion(int bufferAge, const DamageRect& frameDamage, int width, int height) const
+    {
+        DamageRect full(0, 0, width, height);
+        if(bufferAge <= 0 || bufferAge - 1 > m_count)
+        {
+            return full;
+        }
+        DamageRect region = frameDamage;
+        // the buffer misses the damage of the age-1 frames presented after it
+        for(int i = 0; i < bufferAge - 1; i++)
+        {
+            region = region.Union(m_history[i]);
+        }
+        return region.Clip(width, height);
+    }
+
+    // Record the damage of the frame just presented.
+    void Push(const DamageRect& frameDamage)
+    {
+        for(int i = MAX_AGE - 1; i > 0; i--)
+        {
+            m_history[i] = m_history[i-1];
+        }
+        m_history[0] = frameDamage;
+        m_count = (m_count < MAX_AGE) ? m_count + 1 : MAX_AGE;
+    }
+
+private:
+    DamageRect  m_history[MAX_AGE];
+    int         m_count;
+};
+
+// Damage aware presentation through EGL_EXT_buffer_age,
+// EGL_EXT_swap_buffers_with_damage and EGL_NV_post_sub_buffer, falling back
+// to eglSwapBuffers when none are exposed.
+class DamagePresenter
+{
+public:
+    DamagePresenter() :
+        m_bufferAge(false), m_postSubBuffer(false),
+        m_swapWithDamage(NULL), m_postSubBufferFn(NULL)
+    {}
+
+    // Attributes to create the window surface with, so eglPostSubBufferNV
+    // can be used on it.
+    static const EGLint* GetSurfaceAttribs(EGLDisplay display)
+    {
+        static const EGLint attribs[] = { EGL_POST_SUB_BUFFER_SUPPORTED_NV, EGL_TRUE, EGL_NONE };
+        return HasEGLExtension(display, "EGL_NV_post_sub_buffer") ? attribs : NULL;
+    }
+
+    void Init(EGLDisplay display, EGLSurface surface)
+    {
+        m_bufferAge = HasEGLExtension(display, "EGL_EXT_buffer_age");
+        if(HasEGLExtension(display, "EGL_EXT_swap_buffers_with_damage"))
+        {
+            m_swapWithDamage = (PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC) eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+        }
+        if(HasEGLExtension(display, "EGL_NV_post_sub_buffer"))
+        {
+            EGLint supported = EGL_FALSE;
+            eglQuerySurface(display, surface, EGL_POST_SUB_BUFFER_SUPPORTED_NV, &supported);
+            m_postSubBufferFn = (PFNEGLPOSTSUBBUFFERNVPROC) eglGetProcAddress("eglPostSubBufferNV");
+            m_postSubBuffer = supported == EGL_TRUE && m_postSubBufferFn != NULL;
+        }
+    }
+
+    // Age of the current back buffer, 0 if unknown.
+    int QueryBufferAge(EGLDisplay display, EGLSurface surface) const
+    {
+        EGLint age = 0;
+        if(m_bufferAge && !eglQuerySurface(display, surface, EGL_BUFFER_AGE_EXT, &age))
+        {
+            age = 0;
+        }
+        return age;
+    }
+
+    // Present the back buffer, telling the window system which part changed
+    // since the previous frame.
+    EGLBoolean Swap(EGLDisplay display, EGLSurface surface, const DamageRect& damage, int width, int height) const
+    {
+        bool full = damage.x <= 0 && damage.y <= 0 && damage.w >= width && damage.h >= height;
+        // an empty rectangle list would mean the whole surface is damaged
+        if(!full && !damage.IsEmpty() && m_swapWithDamage != NULL)
+        {
+            EGLint rect[4] = { damage.x, damage.y, damage.w, damage.h };
+            return m_swapWithDamage(display, surface, rect, 1);
+        }
+        if(!full && !damage.IsEmpty() && m_postSubBuffer)
+        {
+            return m_postSubBufferFn(display, surface, damage.x, damage.y, damage.w, damage.h);
+        }
+        return eglSwapBuffers(display, surface);
+    }
+
+    bool SupportsBufferAge() const
+    {
+        return m_bufferAge;
+    }
+
+private:
+    bool                                m_bufferAge;
+    bool                                m_postSubBuffer;
+    PFNEGLSWAPBUFFERSWITHDAMAGEEXTPROC  m_swapWithDamage;
+    PFNEGLPOSTSUBBUFFERNVPROC           m_postSubBufferFn;
+};
+
+#endif // __DAMAGE_H__
@@ -0,0 +1,27 @@
+#ifndef __EGLUTIL_H__
+#define __EGLUTIL_H__
+
+#include <EGL/egl.h>
+
+#include <cstring>
+
+// Whether a display exposes an EGL extension. EGL_NO_DISPLAY asks for the
+// client extensions.
+inline bool HasEGLExtension(EGLDisplay display, const char* name)
+{
+    const char* exts = eglQueryString(display, EGL_EXTENSIONS);
+    size_t len = strlen(name);
+    while(exts != NULL && *exts != '\0')
+    {
+        const char* end = strchr(exts, ' ');
+        size_t extlen = (end != NULL) ? (size_t) (end - exts) : strlen(exts);
+        if(extlen == len && strncmp(exts, name, len) == 0)
+        {
+            return true;
+        }
+        exts = (end != NULL) ? end + 1 : NULL;
+    }
+    return false;
+}
+
+#endif // __EGLUTIL_H__
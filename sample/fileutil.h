@@ -0,0 +1,26 @@
+#ifndef __FILEUTIL_H__
+#define __FILEUTIL_H__
+
+#include <cstdio>
+#include <string>
+
+// Append the whole contents of a file to text.
+inline bool ReadText(const char* filename, std::string& text)
+{
+    FILE* f = fopen(filename, "rb");
+    if(f == NULL)
+    {
+        printf("Could not open %s.\n", filename);
+        return false;
+    }
+    char buffer[4096];
+    size_t read = 0;
+    while((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    {
+        text.append(buffer, read);
+    }
+    fclose(f);
+    return true;
+}
+
+#endif // __FILEUTIL_H__
@@ -0,0 +1,242 @@
+#ifndef __FRAMEPACER_H__
+#define __FRAMEPACER_H__
+
+#include "nativewin.h"
+
+#include <cstdio>
+
+// When a frame reached the screen, and the time of the oldest input event it
+// reflects (0 if none).
+struct FrameTiming
+{
+    double inputTime;
+    double presentTime;
+};
+
+// Drives the main loop with a fixed simulation timestep and a paced frame
+// rate.
+//
+// Each iteration calls BeginFrame(), runs the simulation while Step() returns
+// true, renders with GetAlpha() as the interpolation factor between the last
+// two simulation states, and finally calls EndFrame(). EndFrame() sleeps until
+// the next frame deadline, so the loop no longer spins a core when the target
+// frame rate is below what the GPU could deliver, or when the simulation has
+// no new state to show yet.
+//
+// The scheduler also measures the latency from the first input event that
+// changed the view to the swap that presented it.
+class FrameScheduler
+{
+public:
+    FrameScheduler() :
+        m_timestep(1.0 / 60.0), m_framePeriod(0.0),
+        m_maxSteps(8), m_reportInterval(0.0),
+        m_lastTime(0.0), m_accumulator(0.0), m_nextFrame(0.0), m_lastReport(0.0),
+        m_inputTime(0.0), m_inputPending(false)
+    {
+        ResetStats();
+    }
+
+    // Simulation rate in steps per second.
+    void SetSimulationRate(double hz)
+    {
+        m_timestep = (hz > 0.0) ? 1.0 / hz : 1.0 / 60.0;
+    }
+
+    // Target presentation rate. Zero leaves pacing to the swap interval.
+    void SetTargetFrameRate(double fps)
+    {
+        m_framePeriod = (fps > 0.0) ? 1.0 / fps : 0.0;
+    }
+
+    // Interval between statistics reports in seconds. Zero disables them.
+    void SetReportInterval(double seconds)
+    {
+        m_reportInterval = seconds;
+    }
+
+    double GetTimestep() const
+    {
+        return m_timestep;
+    }
+
+    void Start()
+    {
+        m_lastTime = GetNativeTime();
+        m_nextFrame = m_lastTime;
+        m_lastReport = m_lastTime;
+        m_accumulator = 0.0;
+    }
+
+    void BeginFrame()
+    {
+        double now = GetNativeTime();
+        double elapsed = now - m_lastTime;
+        m_lastTime = now;
+        m_accumulator += elapsed;
+        // drop time the simulation could never catch up on, e.g. after the
+        // process was suspended
+        if(m_accumulator > m_maxSteps * m_timestep)
+        {
+            m_accumulator = m_maxSteps * m_timestep;
+        }
+    }
+
+    bool Step()
+    {
+        if(m_accumulator < m_timestep)
+        {
+            return false;
+        }
+        m_accumulator -= m_timestep;
+        m_stats.steps++;
+        return true;
+    }
+
+    // Fraction of a timestep between the previous and the current state.
+    float GetAlpha() const
+    {
+        return (float) (m_accumulator / m_timestep);
+    }
+
+    // Record an input event that will change the next presented frame.
+    void NoteInput()
+    {
+        if(!m_inputPending)
+        {
+            m_inputTime = GetNativeTime();
+            m_inputPending = true;
+        }
+    }
+
+    // Called when a frame is recorded: hands the pending input time over to
+    // that frame and returns it, or 0 if no input is pending.
+    double TakeInputTime()
+    {
+        double time = m_inputPending ? m_inputTime : 0.0;
+        m_inputPending = false;
+        return time;
+    }
+
+    // Account for a frame after its swap, which may have happened on
+    // another thread.
+    void NotePresented(const FrameTiming& timing)
+    {
+        m_stats.frames++;
+        if(timing.inputTime > 0.0)
+        {
+            double latency = timing.presentTime - timing.inputTime;
+            m_stats.latencySum += latency;
+            m_stats.latencyMax = (latency > m_stats.latencyMax) ? latency : m_stats.latencyMax;
+            m_stats.latencySamples++;
+        }
+    }
+
+    // Sleep until the next frame is due. 'rendered' is false when the frame
+    // was skipped because the simulation had no new state yet, in which case
+    // the loop waits at least until the next simulation step.
+    void EndFrame(bool rendered)
+    {
+        double now = GetNativeTime();
+        double period = m_framePeriod;
+        if(!rendered)
+        {
+            double untilStep = m_timestep - m_accumulator;
+            m_stats.idleFrames++;
+            period = (period > untilStep) ? period : untilStep;
+        }
+        if(period > 0.0)
+        {
+            m_nextFrame += period;
+            // resynchronize when more than a frame behind instead of
+            // rendering a burst of frames to catch up
+            if(m_nextFrame < now - period)
+            {
+                m_nextFrame = now;
+            }
+            SleepNative(m_nextFrame - now);
+        }
+        else
+        {
+            m_nextFrame = now;
+        }
+        Report();
+    }
+
+    // Restart timing after the loop blocked waiting for events, so the time
+    // spent asleep is neither simulated nor counted as a late frame. Time
+    // left over before the wait, and the time since an input event that
+    // woke the loop, are kept for the next steps.
+    void Resume()
+    {
+        double now = GetNativeTime();
+        m_lastTime = (m_inputPending && m_inputTime < now) ? m_inputTime : now;
+        m_nextFrame = now;
+        m_accumulator = m_inputPending ? m_accumulator : 0.0;
+        m_stats.waits++;
+    }
+
+private:
+    struct Stats
+    {
+        unsigned int frames;
+        unsigned int idleFrames;
+        unsigned int waits;
+        unsigned int steps;
+        unsigned int latencySamples;
+        double latencySum;
+        double latencyMax;
+    };
+
+    void ResetStats()
+    {
+        m_stats.frames = 0;
+        m_stats.idleFrames = 0;
+        m_stats.waits = 0;
+        m_stats.steps = 0;
+        m_stats.latencySamples = 0;
+        m_stats.latencySum = 0.0;
+        m_stats.latencyMax = 0.0;
+    }
+
+    void Report()
+    {
+        if(m_reportInterval <= 0.0)
+        {
+            return;
+        }
+        double now = GetNativeTime();
+        double elapsed = now - m_lastReport;
+        if(elapsed < m_reportInterval)
+        {
+            return;
+        }
+        printf("%.1f fps, %u idle, %u waits, %.1f steps/s",
+               m_stats.frames / elapsed, m_stats.idleFrames, m_stats.waits, m_stats.steps / elapsed);
+        if(m_stats.latencySamples > 0)
+        {
+            printf(", input latency avg %.1f ms max %.1f ms",
+                   m_stats.latencySum / m_stats.latencySamples * 1000.0, m_stats.latencyMax * 1000.0);
+        }
+        printf("\n");
+        m_lastReport = now;
+        ResetStats();
+    }
+
+    double          m_timestep;
+    double          m_framePeriod;
+    unsigned int    m_maxSteps;
+    double          m_reportInterval;
+
+    double          m_lastTime;
+    double          m_accumulator;
+    double          m_nextFrame;
+    double          m_lastReport;
+
+    double          m_inputTime;
+    bool            m_inputPending;
+
+    Stats           m_stats;
+};
+
+#endif // __FRAMEPACER_H__
@@ -0,0 +1,366 @@
+#ifndef __GLDEBUG_H__
+#define __GLDEBUG_H__
+
+// Debug layer reporting what the driver has to say about the sample's GL
+// calls, through GL_KHR_debug.
+//
+// Contexts are created with EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR where the display
+// has EGL_KHR_create_context, and each gets a message callback the first time
+// it is made current. Output is synchronous, so the callback runs inside the
+// GL call that raised the message, on the thread that made it: errors and
+// warnings, performance warnings such as shader recompiles and stalls on
+// buffers in use among them, are printed with the innermost GL_DEBUG_SITE()
+// the thread is in. Each message is printed once per site; Report() counts
+// the repeats. Notifications are not enabled.
+//
+// Objects are named for the messages and for debuggers with GL_DEBUG_LABEL(),
+// through GL_EXT_debug_label or, without it, glObjectLabelKHR. On contexts
+// without GL_KHR_debug, GL_DEBUG_CHECK() reports the errors glGetError has
+// collected since the previous check.
+//
+// All of it is used through the macros at the end, which are only defined to
+// do something with GL_DEBUG_LAYER defined at build time. Otherwise they are
+// empty and the header declares nothing else.
+
+#if defined(GL_DEBUG_LAYER)
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "eglutil.h"
+#include "nativethread.h"
+#include "renderpass.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+
+#if defined(_MSC_VER)
+#define GL_DEBUG_THREAD_LOCAL __declspec(thread)
+#else
+#define GL_DEBUG_THREAD_LOCAL __thread
+#endif
+
+// A place in the source making GL calls, and the one it was reached from.
+struct GLDebugSite
+{
+    const char*         file;
+    int                 line;
+    const char*         function;
+    const GLDebugSite*  outer;
+};
+
+class GLDebug
+{
+public:
+    static GLDebug& Instance()
+    {
+        static GLDebug debug;
+        return debug;
+    }
+
+    // Ask for a debug context: append the flag to attributes ending in
+    // EGL_NONE, which need room for two more entries.
+    static void AddContextAttribs(EGLDisplay display, EGLint* attribs)
+    {
+        if(!HasEGLExtension(display, "EGL_KHR_create_context"))
+        {
+            return;
+        }
+        int end = 0;
+        while(attribs[end] != EGL_NONE)
+        {
+            end += 2;
+        }
+        attribs[end] = EGL_CONTEXT_FLAGS_KHR;
+        attribs[end + 1] = EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR;
+        attribs[end + 2] = EGL_NONE;
+    }
+
+    // Install the callback on the current context unless it has been.
+    // Returns whether the context has GL_KHR_debug.
+    bool Install()
+    {
+        EGLContext context = eglGetCurrentContext();
+        if(context == EGL_NO_CONTEXT)
+        {
+            return false;
+        }
+        WaitNativeSemaphore(m_mutex);
+        std::map<EGLContext, bool>::const_iterator found = m_contexts.find(context);
+        bool installed = found != m_contexts.end();
+        bool debug = installed && found->second;
+        bool first = m_contexts.empty();
+        if(!installed)
+        {
+            debug = HasGLExtension("GL_KHR_debug") && Load();
+            m_contexts[context] = debug;
+        }
+        PostNativeSemaphore(m_mutex);
+        if(installed)
+        {
+            return debug;
+        }
+
+        // outside the lock, the callback takes it
+        if(debug)
+        {
+            glEnable(GL_DEBUG_OUTPUT);
+            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            m_debugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+            m_debugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+            m_debugMessageCallback(Callback, this);
+        }
+        if(first)
+        {
+            printf(debug ? "GL debug layer: driver messages through GL_KHR_debug.\n" :
+                           "GL debug layer: no GL_KHR_debug, checking glGetError only.\n");
+        }
+        return debug;
+    }
+
+    // Name an object of the current share group. type is one of the
+    // GL_EXT_debug_label types, or GL_TEXTURE, GL_FRAMEBUFFER or
+    // GL_RENDERBUFFER.
+    void Label(GLenum type, GLuint object, const char* label)
+    {
+        if(object == 0)
+        {
+            return;
+        }
+        if(m_labelObject != NULL)
+        {
+            m_labelObject(type, object, 0, label);
+        }
+        else if(m_objectLabel != NULL)
+        {
+            GLenum identifier = (type == GL_BUFFER_OBJECT_EXT) ? GL_BUFFER :
+                                (type == GL_SHADER_OBJECT_EXT) ? GL_SHADER :
+                                (type == GL_PROGRAM_OBJECT_EXT) ? GL_PROGRAM : type;
+            m_objectLabel(identifier, object, -1, label);
+        }
+    }
+
+    // Report the errors glGetError holds, as raised before the given site,
+    // unless the callback has already reported them.
+    void CheckErrors(const char* file, int line, const char* function)
+    {
+        EGLContext context = eglGetCurrentContext();
+        WaitNativeSemaphore(m_mutex);
+        std::map<EGLContext, bool>::const_iterator found = m_contexts.find(context);
+        bool reported = found != m_contexts.end() && found->second;
+        PostNativeSemaphore(m_mutex);
+        for(GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError())
+        {
+            if(!reported)
+            {
+                printf("GL error %s before %s:%d in %s\n", GetErrorName(error), file, line, function);
+                AtomicAdd(&m_messages, 1);
+            }
+        }
+    }
+
+    // Print how many messages there were, if any.
+    void Report()
+    {
+        unsigned int messages = AtomicLoadAcquire(&m_messages);
+        unsigned int repeats = AtomicLoadAcquire(&m_repeats);
+        if(messages > 0)
+        {
+            printf("GL debug layer: %u messages, %u of them repeats not shown.\n", messages, repeats);
+        }
+    }
+
+    // Innermost site of the calling thread.
+    static const GLDebugSite*& CurrentSite()
+    {
+        static GL_DEBUG_THREAD_LOCAL const GLDebugSite* site = NULL;
+        return site;
+    }
+
+private:
+    // Messages already printed, by what raised them and where.
+    struct Key
+    {
+        GLenum          source;
+        GLuint          id;
+        const char*     file;
+        int             line;
+
+        bool operator<(const Key& other) const
+        {
+            if(source != other.source)
+            {
+                return source < other.source;
+            }
+            if(id != other.id)
+            {
+                return id < other.id;
+            }
+            return (line != other.line) ? line < other.line : strcmp(file, other.file) < 0;
+        }
+    };
+
+    GLDebug() :
+        m_debugMessageCallback(NULL), m_debugMessageControl(NULL), m_labelObject(NULL), m_objectLabel(NULL),
+        m_messages(0), m_repeats(0)
+    {
+        CreateNativeSemaphore(1, &m_mutex);
+    }
+
+    ~GLDebug()
+    {
+        DestroyNativeSemaphore(m_mutex);
+    }
+
+    // Entry points are the same for every context; labels use the
+    // extensions of the first context that has them.
+    bool Load()
+    {
+        if(m_debugMessageCallback == NULL)
+        {
+            m_debugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKPROC) eglGetProcAddress("glDebugMessageCallbackKHR");
+            m_debugMessageControl = (PFNGLDEBUGMESSAGECONTROLPROC) eglGetProcAddress("glDebugMessageControlKHR");
+        }
+        if(m_labelObject == NULL && HasGLExtension("GL_EXT_debug_label"))
+        {
+            m_labelObject = (PFNGLLABELOBJECTEXTPROC) eglGetProcAddress("glLabelObjectEXT");
+        }
+        if(m_objectLabel == NULL)
+        {
+            m_objectLabel = (PFNGLOBJECTLABELPROC) eglGetProcAddress("glObjectLabelKHR");
+        }
+        return m_debugMessageCallback != NULL && m_debugMessageControl != NULL;
+    }
+
+    static void GL_APIENTRY Callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                     const GLchar* message, GLvoid* userParam)
+    {
+        GLDebug& debug = *(GLDebug*) userParam;
+        const GLDebugSite* site = CurrentSite();
+        Key key = { source, id, (site != NULL) ? site->file : "", (site != NULL) ? site->line : 0 };
+        AtomicAdd(&debug.m_messages, 1);
+        WaitNativeSemaphore(debug.m_mutex);
+        bool seen = !debug.m_seen.insert(key).second;
+        PostNativeSemaphore(debug.m_mutex);
+        if(seen)
+        {
+            AtomicAdd(&debug.m_repeats, 1);
+            return;
+        }
+        printf("GL %s (%s, %s) %u: %.*s\n", GetTypeName(type), GetSourceName(source), GetSeverityName(severity), id,
+               (int) length, message);
+        for(; site != NULL; site = site->outer)
+        {
+            printf("    at %s:%d in %s\n", site->file, site->line, site->function);
+        }
+    }
+
+    static const char* GetTypeName(GLenum type)
+    {
+        switch(type)
+        {
+        case GL_DEBUG_TYPE_ERROR:               return "error";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated behavior";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "undefined behavior";
+        case GL_DEBUG_TYPE_PORTABILITY:         return "portability warning";
+        case GL_DEBUG_TYPE_PERFORMANCE:         return "performance warning";
+        case GL_DEBUG_TYPE_MARKER:              return "marker";
+        default:                                return "message";
+        }
+    }
+
+    static const char* GetSourceName(GLenum source)
+    {
+        switch(source)
+        {
+        case GL_DEBUG_SOURCE_API:               return "api";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:     return "window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER:   return "shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY:       return "third party";
+        case GL_DEBUG_SOURCE_APPLICATION:       return "application";
+        default:                                return "other";
+        }
+    }
+
+    static const char* GetSeverityName(GLenum severity)
+    {
+        switch(severity)
+        {
+        case GL_DEBUG_SEVERITY_HIGH:            return "high";
+        case GL_DEBUG_SEVERITY_MEDIUM:          return "medium";
+        case GL_DEBUG_SEVERITY_LOW:             return "low";
+        default:                                return "notification";
+        }
+    }
+
+    static const char* GetErrorName(GLenum error)
+    {
+        switch(error)
+        {
+        case GL_INVALID_ENUM:                   return "GL_INVALID_ENUM";
+        case GL_INVALID_VALUE:                  return "GL_INVALID_VALUE";
+        case GL_INVALID_OPERATION:              return "GL_INVALID_OPERATION";
+        case GL_INVALID_FRAMEBUFFER_OPERATION:  return "GL_INVALID_FRAMEBUFFER_OPERATION";
+        case GL_OUT_OF_MEMORY:                  return "GL_OUT_OF_MEMORY";
+        default:                                return "unknown";
+        }
+    }
+
+    PFNGLDEBUGMESSAGECALLBACKPROC   m_debugMessageCallback;
+    PFNGLDEBUGMESSAGECONTROLPROC    m_debugMessageControl;
+    PFNGLLABELOBJECTEXTPROC         m_labelObject;
+    PFNGLOBJECTLABELPROC            m_objectLabel;
+    // guards the contexts and the messages seen
+    NativeSemaphore                 m_mutex;
+    // whether each context seen has the callback
+    std::map<EGLContext, bool>      m_contexts;
+    std::set<Key>                   m_seen;
+    volatile unsigned int           m_messages;
+    volatile unsigned int           m_repeats;
+};
+
+// Makes its site the calling thread's innermost while it exists.
+class GLDebugScope
+{
+public:
+    GLDebugScope(const char* file, int line, const char* function)
+    {
+        m_site.file = file;
+        m_site.line = line;
+        m_site.function = function;
+        m_site.outer = GLDebug::CurrentSite();
+        GLDebug::CurrentSite() = &m_site;
+    }
+
+    ~GLDebugScope()
+    {
+        GLDebug::CurrentSite() = m_site.outer;
+    }
+
+private:
+    GLDebugSite m_site;
+};
+
+#define GL_DEBUG_CONTEXT_ATTRIBS(display, attribs) GLDebug::AddContextAttribs(display, attribs)
+#define GL_DEBUG_INSTALL() GLDebug::Instance().Install()
+#define GL_DEBUG_SITE() GLDebugScope glDebugScope(__FILE__, __LINE__, __FUNCTION__)
+#define GL_DEBUG_LABEL(type, object, label) GLDebug::Instance().Label(type, object, label)
+#define GL_DEBUG_CHECK() GLDebug::Instance().CheckErrors(__FILE__, __LINE__, __FUNCTION__)
+#define GL_DEBUG_REPORT() GLDebug::Instance().Report()
+
+#else
+
+#define GL_DEBUG_CONTEXT_ATTRIBS(display, attribs) ((void) 0)
+#define GL_DEBUG_INSTALL() ((void) 0)
+#define GL_DEBUG_SITE() ((void) 0)
+#define GL_DEBUG_LABEL(type, object, label) ((void) 0)
+#define GL_DEBUG_CHECK() ((void) 0)
+#define GL_DEBUG_REPORT() ((void) 0)
+
+#endif // GL_DEBUG_LAYER
+
+#endif // __GLDEBUG_H__
@@ -0,0 +1,812 @@
+#ifndef __GLINTERCEPT_H__
+#define __GLINTERCEPT_H__
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "gltrace.h"
+#include "nativethread.h"
+#include "nativewin.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Interception of the OpenGL ES 2.0 and EGL 1.4 entry points, counting what
+// every frame asks of the driver.
+//
+// Built with GL_INTERCEPT defined, this header replaces each core entry point
+// in the files including it after it with a wrapper, by a macro of the same
+// name. The wrapper counts the call and goes through a table of entry points,
+// which Load() fills from eglGetProcAddress when the implementation hands out
+// core functions that way (EGL 1.5 or EGL_KHR_get_all_proc_addresses), and
+// which otherwise holds the functions the sample links against. For the
+// extension and OpenGL ES 3.0 functions the sample loads itself,
+// eglGetProcAddress keeps what the implementation returns in the table and
+// hands out the wrapper instead. Debug output and the blob cache, which hand
+// the driver callbacks, are called directly and not seen.
+//
+// Calls are counted per function, and as draws, state changes (binding,
+// enabling and setting fixed function state), uniform updates and uploads,
+// with the bytes of buffer and texture data handed over. Any thread may make
+// calls. EndFrame() closes a frame; with a report interval set it also
+// prints the averages per frame since the last report, with the functions
+// called most. Calls made by a render thread are counted in the frame the
+// main loop closes next.
+//
+// StartTrace() has the wrappers also record every call, with the data it
+// hands in, into a trace (gltrace.h) that glreplay plays back.
+//
+// Without GL_INTERCEPT no macro is defined, GL calls are direct and the class
+// counts nothing.
+
+// Each entry point as X(return type, name, parameters, arguments, kind,
+// bytes uploaded, roles, capture). Roles tell the replay which of the result
+// and the parameters, in that order, name objects that differ between runs:
+// o a program or shader, u a uniform location, d an EGL display, c a
+// config, s a surface, x a context, y a sync object. Capture describes what
+// the pointer parameters hand in, to a GLTraceCall.
+#define GL_INTERCEPT_GL_FUNCTIONS(X) \
+    X(void, glActiveTexture, (GLenum texture), (texture), GLI_STATE, 0, "..", NoData()) \
+    X(void, glAttachShader, (GLuint program, GLuint shader), (program, shader), GLI_CALL, 0, ".oo", NoData()) \
+    X(void, glBindAttribLocation, (GLuint program, GLuint index, const GLchar* name), (program, index, name), GLI_CALL, 0, ".o..", String(name)) \
+    X(void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer), GLI_STATE, 0, "...", BindBuffer(target, buffer)) \
+    X(void, glBindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer), GLI_STATE, 0, "...", NoData()) \
+    X(void, glBindRenderbuffer, (GLenum target, GLuint renderbuffer), (target, renderbuffer), GLI_STATE, 0, "...", NoData()) \
+    X(void, glBindTexture, (GLenum target, GLuint texture), (target, texture), GLI_STATE, 0, "...", NoData()) \
+    X(void, glBlendColor, (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha), (red, green, blue, alpha), GLI_STATE, 0, ".....", NoData()) \
+    X(void, glBlendEquation, (GLenum mode), (mode), GLI_STATE, 0, "..", NoData()) \
+    X(void, glBlendEquationSeparate, (GLenum modeRGB, GLenum modeAlpha), (modeRGB, modeAlpha), GLI_STATE, 0, "...", NoData()) \
+    X(void, glBlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor), GLI_STATE, 0, "...", NoData()) \
+    X(void, glBlendFuncSeparate, (GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha), (srcRGB, dstRGB, srcAlpha, dstAlpha), GLI_STATE, 0, ".....", NoData()) \
+    X(void, glBufferData, (GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage), (target, size, data, usage), GLI_UPLOAD, (data != NULL) ? size : 0, ".....", Blob(data, size)) \
+    X(void, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data), (target, offset, size, data), GLI_UPLOAD, size, ".....", Blob(data, size)) \
+    X(GLenum, glCheckFramebufferStatus, (GLenum target), (target), GLI_CALL, 0, "..", NoData()) \
+    X(void, glClear, (GLbitfield mask), (mask), GLI_CALL, 0, "..", NoData()) \
+    X(void, glClearColor, (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha), (red, green, blue, alpha), GLI_STATE, 0, ".....", NoData()) \
+    X(void, glClearDepthf, (GLclampf depth), (depth), GLI_STATE, 0, "..", NoData()) \
+    X(void, glClearStencil, (GLint s), (s), GLI_STATE, 0, "..", NoData()) \
+    X(void, glColorMask, (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha), (red, green, blue, alpha), GLI_STATE, 0, ".....", NoData()) \
+    X(void, glCompileShader, (GLuint shader), (shader), GLI_CALL, 0, ".o", NoData()) \
+    X(void, glCompressedTexImage2D, (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid* data), (target, level, internalformat, width, height, border, imageSize, data), GLI_UPLOAD, (data != NULL) ? imageSize : 0, ".........", Blob(data, imageSize)) \
+    X(void, glCompressedTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const GLvoid* data), (target, level, xoffset, yoffset, width, height, format, imageSize, data), GLI_UPLOAD, imageSize, "..........", Blob(data, imageSize)) \
+    X(void, glCopyTexImage2D, (GLenum target, GLint level, GLenum internalformat, GLint x, GLint y, GLsizei width, GLsizei height, GLint border), (target, level, internalformat, x, y, width, height, border), GLI_CALL, 0, ".........", NoData()) \
+    X(void, glCopyTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height), (target, level, xoffset, yoffset, x, y, width, height), GLI_CALL, 0, ".........", NoData()) \
+    X(GLuint, glCreateProgram, (void), (), GLI_CALL, 0, "o", NoData()) \
+    X(GLuint, glCreateShader, (GLenum type), (type), GLI_CALL, 0, "o.", NoData()) \
+    X(void, glCullFace, (GLenum mode), (mode), GLI_STATE, 0, "..", NoData()) \
+    X(void, glDeleteBuffers, (GLsizei n, const GLuint* buffers), (n, buffers), GLI_CALL, 0, "...", Blob(buffers, n * sizeof(GLuint))) \
+    X(void, glDeleteFramebuffers, (GLsizei n, const GLuint* framebuffers), (n, framebuffers), GLI_CALL, 0, "...", Blob(framebuffers, n * sizeof(GLuint))) \
+    X(void, glDeleteProgram, (GLuint program), (program), GLI_CALL, 0, ".o", NoData()) \
+    X(void, glDeleteRenderbuffers, (GLsizei n, const GLuint* renderbuffers), (n, renderbuffers), GLI_CALL, 0, "...", Blob(renderbuffers, n * sizeof(GLuint))) \
+    X(void, glDeleteShader, (GLuint shader), (shader), GLI_CALL, 0, ".o", NoData()) \
+    X(void, glDeleteTextures, (GLsizei n, const GLuint* textures), (n, textures), GLI_CALL, 0, "...", Blob(textures, n * sizeof(GLuint))) \
+    X(void, glDepthFunc, (GLenum func), (func), GLI_STATE, 0, "..", NoData()) \
+    X(void, glDepthMask, (GLboolean flag), (flag), GLI_STATE, 0, "..", NoData()) \
+    X(void, glDepthRangef, (GLclampf zNear, GLclampf zFar), (zNear, zFar), GLI_STATE, 0, "...", NoData()) \
+    X(void, glDetachShader, (GLuint program, GLuint shader), (program, shader), GLI_CALL, 0, ".oo", NoData()) \
+    X(void, glDisable, (GLenum cap), (cap), GLI_STATE, 0, "..", NoData()) \
+    X(void, glDisableVertexAttribArray, (GLuint index), (index), GLI_STATE, 0, "..", NoData()) \
+    X(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count), GLI_DRAW, 0, "....", Arrays(first + count)) \
+    X(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const GLvoid* indices), (mode, count, type, indices), GLI_DRAW, 0, ".....", Elements(count, type, indices)) \
+    X(void, glEnable, (GLenum cap), (cap), GLI_STATE, 0, "..", NoData()) \
+    X(void, glEnableVertexAttribArray, (GLuint index), (index), GLI_STATE, 0, "..", NoData()) \
+    X(void, glFinish, (void), (), GLI_CALL, 0, ".", NoData()) \
+    X(void, glFlush, (void), (), GLI_CALL, 0, ".", NoData()) \
+    X(void, glFramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer), (target, attachment, renderbuffertarget, renderbuffer), GLI_CALL, 0, ".....", NoData()) \
+    X(void, glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level), (target, attachment, textarget, texture, level), GLI_CALL, 0, "......", NoData()) \
+    X(void, glFrontFace, (GLenum mode), (mode), GLI_STATE, 0, "..", NoData()) \
+    X(void, glGenBuffers, (GLsizei n, GLuint* buffers), (n, buffers), GLI_CALL, 0, "...", NoData()) \
+    X(void, glGenerateMipmap, (GLenum target), (target), GLI_CALL, 0, "..", NoData()) \
+    X(void, glGenFramebuffers, (GLsizei n, GLuint* framebuffers), (n, framebuffers), GLI_CALL, 0, "...", NoData()) \
+    X(void, glGenRenderbuffers, (GLsizei n, GLuint* renderbuffers), (n, renderbuffers), GLI_CALL, 0, "...", NoData()) \
+    X(void, glGenTextures, (GLsizei n, GLuint* textures), (n, textures), GLI_CALL, 0, "...", NoData()) \
+    X(void, glGetActiveAttrib, (GLuint program, GLuint index, GLsizei bufsize, GLsizei* length, GLint* size, GLenum* type, GLchar* name), (program, index, bufsize, length, size, type, name), GLI_CALL, 0, ".o......", Output(name, bufsize)) \
+    X(void, glGetActiveUniform, (GLuint program, GLuint index, GLsizei bufsize, GLsizei* length, GLint* size, GLenum* type, GLchar* name), (program, index, bufsize, length, size, type, name), GLI_CALL, 0, ".o......", Output(name, bufsize)) \
+    X(void, glGetAttachedShaders, (GLuint program, GLsizei maxcount, GLsizei* count, GLuint* shaders), (program, maxcount, count, shaders), GLI_CALL, 0, ".o...", NoData()) \
+    X(GLint, glGetAttribLocation, (GLuint program, const GLchar* name), (program, name), GLI_CALL, 0, ".o.", String(name)) \
+    X(void, glGetBooleanv, (GLenum pname, GLboolean* params), (pname, params), GLI_CALL, 0, "...", NoData()) \
+    X(void, glGetBufferParameteriv, (GLenum target, GLenum pname, GLint* params), (target, pname, params), GLI_CALL, 0, "....", NoData()) \
+    X(GLenum, glGetError, (void), (), GLI_CALL, 0, ".", NoData()) \
+    X(void, glGetFloatv, (GLenum pname, GLfloat* params), (pname, params), GLI_CALL, 0, "...", NoData()) \
+    X(void, glGetFramebufferAttachmentParameteriv, (GLenum target, GLenum attachment, GLenum pname, GLint* params), (target, attachment, pname, params), GLI_CALL, 0, ".....", NoData()) \
+    X(void, glGetIntegerv, (GLenum pname, GLint* params), (pname, params), GLI_CALL, 0, "...", NoData()) \
+    X(void, glGetProgramiv, (GLuint program, GLenum pname, GLint* params), (program, pname, params), GLI_CALL, 0, ".o..", NoData()) \
+    X(void, glGetProgramInfoLog, (GLuint program, GLsizei bufsize, GLsizei* length, GLchar* infolog), (program, bufsize, length, infolog), GLI_CALL, 0, ".o...", Output(infolog, bufsize)) \
+    X(void, glGetRenderbufferParameteriv, (GLenum target, GLenum pname, GLint* params), (target, pname, params), GLI_CALL, 0, "....", NoData()) \
+    X(void, glGetShaderiv, (GLuint shader, GLenum pname, GLint* params), (shader, pname, params), GLI_CALL, 0, ".o..", NoData()) \
+    X(void, glGetShaderInfoLog, (GLuint shader, GLsizei bufsize, GLsizei* length, GLchar* infolog), (shader, bufsize, length, infolog), GLI_CALL, 0, ".o...", Output(infolog, bufsize)) \
+    X(void, glGetShaderPrecisionFormat, (GLenum shadertype, GLenum precisiontype, GLint* range, GLint* precision), (shadertype, precisiontype, range, precision), GLI_CALL, 0, ".....", NoData()) \
+    X(void, glGetShaderSource, (GLuint shader, GLsizei bufsize, GLsizei* length, GLchar* source), (shader, bufsize, length, source), GLI_CALL, 0, ".o...", Output(source, bufsize)) \
+    X(const GLubyte*, glGetString, (GLenum name), (name), GLI_CALL, 0, "..", NoData()) \
+    X(void, glGetTexParameterfv, (GLenum target, GLenum pname, GLfloat* params), (target, pname, params), GLI_CALL, 0, "....", NoData()) \
+    X(void, glGetTexParameteriv, (GLenum target, GLenum pname, GLint* params), (target, pname, params), GLI_CALL, 0, "....", NoData()) \
+    X(void, glGetUniformfv, (GLuint program, GLint location, GLfloat* params), (program, location, params), GLI_CALL, 0, ".ou.", NoData()) \
+    X(void, glGetUniformiv, (GLuint program, GLint location, GLint* params), (program, location, params), GLI_CALL, 0, ".ou.", NoData()) \
+    X(GLint, glGetUniformLocation, (GLuint program, const GLchar* name), (program, name), GLI_CALL, 0, "uo.", String(name)) \
+    X(void, glGetVertexAttribfv, (GLuint index, GLenum pname, GLfloat* params), (index, pname, params), GLI_CALL, 0, "....", NoData()) \
+    X(void, glGetVertexAttribiv, (GLuint index, GLenum pname, GLint* params), (index, pname, params), GLI_CALL, 0, "....", NoData()) \
+    X(void, glGetVertexAttribPointerv, (GLuint index, GLenum pname, GLvoid** pointer), (index, pname, pointer), GLI_CALL, 0, "....", NoData()) \
+    X(void, glHint, (GLenum target, GLenum mode), (target, mode), GLI_STATE, 0, "...", NoData()) \
+    X(GLboolean, glIsBuffer, (GLuint buffer), (buffer), GLI_CALL, 0, "..", NoData()) \
+    X(GLboolean, glIsEnabled, (GLenum cap), (cap), GLI_CALL, 0, "..", NoData()) \
+    X(GLboolean, glIsFramebuffer, (GLuint framebuffer), (framebuffer), GLI_CALL, 0, "..", NoData()) \
+    X(GLboolean, glIsProgram, (GLuint program), (program), GLI_CALL, 0, ".o", NoData()) \
+    X(GLboolean, glIsRenderbuffer, (GLuint renderbuffer), (renderbuffer), GLI_CALL, 0, "..", NoData()) \
+    X(GLboolean, glIsShader, (GLuint shader), (shader), GLI_CALL, 0, ".o", NoData()) \
+    X(GLboolean, glIsTexture, (GLuint texture), (texture), GLI_CALL, 0, "..", NoData()) \
+    X(void, glLineWidth, (GLfloat width), (width), GLI_STATE, 0, "..", NoData()) \
+    X(void, glLinkProgram, (GLuint program), (program), GLI_CALL, 0, ".o", NoData()) \
+    X(void, glPixelStorei, (GLenum pname, GLint param), (pname, param), GLI_STATE, 0, "...", PixelStore(pname, param)) \
+    X(void, glPolygonOffset, (GLfloat factor, GLfloat units), (factor, units), GLI_STATE, 0, "...", NoData()) \
+    X(void, glReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid* pixels), (x, y, width, height, format, type, pixels), GLI_CALL, 0, "........", Output(pixels, GLIntercept::GetImageSize(width, height, format, type))) \
+    X(void, glReleaseShaderCompiler, (void), (), GLI_CALL, 0, ".", NoData()) \
+    X(void, glRenderbufferStorage, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height), (target, internalformat, width, height), GLI_CALL, 0, ".....", NoData()) \
+    X(void, glSampleCoverage, (GLclampf value, GLboolean invert), (value, invert), GLI_STATE, 0, "...", NoData()) \
+    X(void, glScissor, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), GLI_STATE, 0, ".....", NoData()) \
+    X(void, glShaderBinary, (GLsizei n, const GLuint* shaders, GLenum binaryformat, const GLvoid* binary, GLsizei length), (n, shaders, binaryformat, binary, length), GLI_CALL, 0, "......", Blob(shaders, n * sizeof(GLuint)).Blob(binary, length)) \
+    X(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar*const* string, const GLint* length), (shader, count, string, length), GLI_CALL, 0, ".o...", Strings(count, string, length)) \
+    X(void, glStencilFunc, (GLenum func, GLint ref, GLuint mask), (func, ref, mask), GLI_STATE, 0, "....", NoData()) \
+    X(void, glStencilFuncSeparate, (GLenum face, GLenum func, GLint ref, GLuint mask), (face, func, ref, mask), GLI_STATE, 0, ".....", NoData()) \
+    X(void, glStencilMask, (GLuint mask), (mask), GLI_STATE, 0, "..", NoData()) \
+    X(void, glStencilMaskSeparate, (GLenum face, GLuint mask), (face, mask), GLI_STATE, 0, "...", NoData()) \
+    X(void, glStencilOp, (GLenum fail, GLenum zfail, GLenum zpass), (fail, zfail, zpass), GLI_STATE, 0, "....", NoData()) \
+    X(void, glStencilOpSeparate, (GLenum face, GLenum fail, GLenum zfail, GLenum zpass), (face, fail, zfail, zpass), GLI_STATE, 0, ".....", NoData()) \
+    X(void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid* pixels), (target, level, internalformat, width, height, border, format, type, pixels), GLI_UPLOAD, (pixels != NULL) ? GLIntercept::GetImageSize(width, height, format, type) : 0, "..........", Image(width, height, format, type, pixels)) \
+    X(void, glTexParameterf, (GLenum target, GLenum pname, GLfloat param), (target, pname, param), GLI_STATE, 0, "....", NoData()) \
+    X(void, glTexParameterfv, (GLenum target, GLenum pname, const GLfloat* params), (target, pname, params), GLI_STATE, 0, "....", Blob(params, sizeof(*params))) \
+    X(void, glTexParameteri, (GLenum target, GLenum pname, GLint param), (target, pname, param), GLI_STATE, 0, "....", NoData()) \
+    X(void, glTexParameteriv, (GLenum target, GLenum pname, const GLint* params), (target, pname, params), GLI_STATE, 0, "....", Blob(params, sizeof(*params))) \
+    X(void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels), (target, level, xoffset, yoffset, width, height, format, type, pixels), GLI_UPLOAD, GLIntercept::GetImageSize(width, height, format, type), "..........", Image(width, height, format, type, pixels)) \
+    X(void, glUniform1f, (GLint location, GLfloat x), (location, x), GLI_UNIFORM, 0, ".u.", NoData()) \
+    X(void, glUniform1fv, (GLint location, GLsizei count, const GLfloat* v), (location, count, v), GLI_UNIFORM, 0, ".u..", Blob(v, count * 1 * 4)) \
+    X(void, glUniform1i, (GLint location, GLint x), (location, x), GLI_UNIFORM, 0, ".u.", NoData()) \
+    X(void, glUniform1iv, (GLint location, GLsizei count, const GLint* v), (location, count, v), GLI_UNIFORM, 0, ".u..", Blob(v, count * 1 * 4)) \
+    X(void, glUniform2f, (GLint location, GLfloat x, GLfloat y), (location, x, y), GLI_UNIFORM, 0, ".u..", NoData()) \
+    X(void, glUniform2fv, (GLint location, GLsizei count, const GLfloat* v), (location, count, v), GLI_UNIFORM, 0, ".u..", Blob(v, count * 2 * 4)) \
+    X(void, glUniform2i, (GLint location, GLint x, GLint y), (location, x, y), GLI_UNIFORM, 0, ".u..", NoData()) \
+    X(void, glUniform2iv, (GLint location, GLsizei count, const GLint* v), (location, count, v), GLI_UNIFORM, 0, ".u..", Blob(v, count * 2 * 4)) \
+    X(void, glUniform3f, (GLint location, GLfloat x, GLfloat y, GLfloat z), (location, x, y, z), GLI_UNIFORM, 0, ".u...", NoData()) \
+    X(void, glUniform3fv, (GLint location, GLsizei count, const GLfloat* v), (location, count, v), GLI_UNIFORM, 0, ".u..", Blob(v, count * 3 * 4)) \
+    X(void, glUniform3i, (GLint location, GLint x, GLint y, GLint z), (location, x, y, z), GLI_UNIFORM, 0, ".u...", NoData()) \
+    X(void, glUniform3iv, (GLint location, GLsizei count, const GLint* v), (location, count, v), GLI_UNIFORM, 0, ".u..", Blob(v, count * 3 * 4)) \
+    X(void, glUniform4f, (GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w), (location, x, y, z, w), GLI_UNIFORM, 0, ".u....", NoData()) \
+    X(void, glUniform4fv, (GLint location, GLsizei count, const GLfloat* v), (location, count, v), GLI_UNIFORM, 0, ".u..", Blob(v, count * 4 * 4)) \
+    X(void, glUniform4i, (GLint location, GLint x, GLint y, GLint z, GLint w), (location, x, y, z, w), GLI_UNIFORM, 0, ".u....", NoData()) \
+    X(void, glUniform4iv, (GLint location, GLsizei count, const GLint* v), (location, count, v), GLI_UNIFORM, 0, ".u..", Blob(v, count * 4 * 4)) \
+    X(void, glUniformMatrix2fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value), GLI_UNIFORM, 0, ".u...", Blob(value, count * 4 * 4)) \
+    X(void, glUniformMatrix3fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value), GLI_UNIFORM, 0, ".u...", Blob(value, count * 9 * 4)) \
+    X(void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value), GLI_UNIFORM, 0, ".u...", Blob(value, count * 16 * 4)) \
+    X(void, glUseProgram, (GLuint program), (program), GLI_STATE, 0, ".o", NoData()) \
+    X(void, glValidateProgram, (GLuint program), (program), GLI_CALL, 0, ".o", NoData()) \
+    X(void, glVertexAttrib1f, (GLuint indx, GLfloat x), (indx, x), GLI_STATE, 0, "...", NoData()) \
+    X(void, glVertexAttrib1fv, (GLuint indx, const GLfloat* values), (indx, values), GLI_STATE, 0, "...", Blob(values, 1 * sizeof(GLfloat))) \
+    X(void, glVertexAttrib2f, (GLuint indx, GLfloat x, GLfloat y), (indx, x, y), GLI_STATE, 0, "....", NoData()) \
+    X(void, glVertexAttrib2fv, (GLuint indx, const GLfloat* values), (indx, values), GLI_STATE, 0, "...", Blob(values, 2 * sizeof(GLfloat))) \
+    X(void, glVertexAttrib3f, (GLuint indx, GLfloat x, GLfloat y, GLfloat z), (indx, x, y, z), GLI_STATE, 0, ".....", NoData()) \
+    X(void, glVertexAttrib3fv, (GLuint indx, const GLfloat* values), (indx, values), GLI_STATE, 0, "...", Blob(values, 3 * sizeof(GLfloat))) \
+    X(void, glVertexAttrib4f, (GLuint indx, GLfloat x, GLfloat y, GLfloat z, GLfloat w), (indx, x, y, z, w), GLI_STATE, 0, "......", NoData()) \
+    X(void, glVertexAttrib4fv, (GLuint indx, const GLfloat* values), (indx, values), GLI_STATE, 0, "...", Blob(values, 4 * sizeof(GLfloat))) \
+    X(void, glVertexAttribPointer, (GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* ptr), (indx, size, type, normalized, stride, ptr), GLI_STATE, 0, ".......", Pointer(ptr)) \
+    X(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), GLI_STATE, 0, ".....", NoData())
+
+#define GL_INTERCEPT_EGL_FUNCTIONS(X) \
+    X(EGLBoolean, eglChooseConfig, (EGLDisplay dpy, const EGLint* attrib_list, EGLConfig* configs, EGLint config_size, EGLint* num_config), (dpy, attrib_list, configs, config_size, num_config), GLI_CALL, 0, ".d....", AttribList(attrib_list).Configs(configs, num_config)) \
+    X(EGLBoolean, eglCopyBuffers, (EGLDisplay dpy, EGLSurface surface, EGLNativePixmapType target), (dpy, surface, target), GLI_CALL, 0, ".ds.", NoData()) \
+    X(EGLContext, eglCreateContext, (EGLDisplay dpy, EGLConfig config, EGLContext share_context, const EGLint* attrib_list), (dpy, config, share_context, attrib_list), GLI_CALL, 0, "xdcx.", AttribList(attrib_list)) \
+    X(EGLSurface, eglCreatePbufferSurface, (EGLDisplay dpy, EGLConfig config, const EGLint* attrib_list), (dpy, config, attrib_list), GLI_CALL, 0, "sdc.", AttribList(attrib_list)) \
+    X(EGLSurface, eglCreatePixmapSurface, (EGLDisplay dpy, EGLConfig config, EGLNativePixmapType pixmap, const EGLint* attrib_list), (dpy, config, pixmap, attrib_list), GLI_CALL, 0, "sdc..", AttribList(attrib_list).Surface(dpy)) \
+    X(EGLSurface, eglCreateWindowSurface, (EGLDisplay dpy, EGLConfig config, EGLNativeWindowType win, const EGLint* attrib_list), (dpy, config, win, attrib_list), GLI_CALL, 0, "sdc..", AttribList(attrib_list).Surface(dpy)) \
+    X(EGLBoolean, eglDestroyContext, (EGLDisplay dpy, EGLContext ctx), (dpy, ctx), GLI_CALL, 0, ".dx", NoData()) \
+    X(EGLBoolean, eglDestroySurface, (EGLDisplay dpy, EGLSurface surface), (dpy, surface), GLI_CALL, 0, ".ds", NoData()) \
+    X(EGLBoolean, eglGetConfigAttrib, (EGLDisplay dpy, EGLConfig config, EGLint attribute, EGLint* value), (dpy, config, attribute, value), GLI_CALL, 0, ".dc..", NoData()) \
+    X(EGLBoolean, eglGetConfigs, (EGLDisplay dpy, EGLConfig* configs, EGLint config_size, EGLint* num_config), (dpy, configs, config_size, num_config), GLI_CALL, 0, ".d...", Configs(configs, num_config)) \
+    X(EGLDisplay, eglGetCurrentDisplay, (void), (), GLI_CALL, 0, "d", NoData()) \
+    X(EGLSurface, eglGetCurrentSurface, (EGLint readdraw), (readdraw), GLI_CALL, 0, "s.", NoData()) \
+    X(EGLDisplay, eglGetDisplay, (EGLNativeDisplayType display_id), (display_id), GLI_CALL, 0, "d.", NoData()) \
+    X(EGLint, eglGetError, (void), (), GLI_CALL, 0, ".", NoData()) \
+    X(__eglMustCastToProperFunctionPointerType, eglGetProcAddress, (const char* procname), (procname), GLI_CALL, 0, "..", NoData()) \
+    X(EGLBoolean, eglInitialize, (EGLDisplay dpy, EGLint* major, EGLint* minor), (dpy, major, minor), GLI_CALL, 0, ".d..", NoData()) \
+    X(EGLBoolean, eglMakeCurrent, (EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLContext ctx), (dpy, draw, read, ctx), GLI_STATE, 0, ".dssx", NoData()) \
+    X(EGLBoolean, eglQueryContext, (EGLDisplay dpy, EGLContext ctx, EGLint attribute, EGLint* value), (dpy, ctx, attribute, value), GLI_CALL, 0, ".dx..", NoData()) \
+    X(const char*, eglQueryString, (EGLDisplay dpy, EGLint name), (dpy, name), GLI_CALL, 0, ".d.", NoData()) \
+    X(EGLBoolean, eglQuerySurface, (EGLDisplay dpy, EGLSurface surface, EGLint attribute, EGLint* value), (dpy, surface, attribute, value), GLI_CALL, 0, ".ds..", NoData()) \
+    X(EGLBoolean, eglSwapBuffers, (EGLDisplay dpy, EGLSurface surface), (dpy, surface), GLI_CALL, 0, ".ds", NoData()) \
+    X(EGLBoolean, eglTerminate, (EGLDisplay dpy), (dpy), GLI_CALL, 0, ".d", NoData()) \
+    X(EGLBoolean, eglWaitGL, (void), (), GLI_CALL, 0, ".", NoData()) \
+    X(EGLBoolean, eglWaitNative, (EGLint engine), (engine), GLI_CALL, 0, "..", NoData()) \
+    X(EGLBoolean, eglBindTexImage, (EGLDisplay dpy, EGLSurface surface, EGLint buffer), (dpy, surface, buffer), GLI_CALL, 0, ".ds.", NoData()) \
+    X(EGLBoolean, eglReleaseTexImage, (EGLDisplay dpy, EGLSurface surface, EGLint buffer), (dpy, surface, buffer), GLI_CALL, 0, ".ds.", NoData()) \
+    X(EGLBoolean, eglSurfaceAttrib, (EGLDisplay dpy, EGLSurface surface, EGLint attribute, EGLint value), (dpy, surface, attribute, value), GLI_CALL, 0, ".ds..", NoData()) \
+    X(EGLBoolean, eglSwapInterval, (EGLDisplay dpy, EGLint interval), (dpy, interval), GLI_CALL, 0, ".d.", NoData()) \
+    X(EGLBoolean, eglBindAPI, (EGLenum api), (api), GLI_CALL, 0, "..", NoData()) \
+    X(EGLenum, eglQueryAPI, (void), (), GLI_CALL, 0, ".", NoData()) \
+    X(EGLSurface, eglCreatePbufferFromClientBuffer, (EGLDisplay dpy, EGLenum buftype, EGLClientBuffer buffer, EGLConfig config, const EGLint* attrib_list), (dpy, buftype, buffer, config, attrib_list), GLI_CALL, 0, "sd..c.", AttribList(attrib_list)) \
+    X(EGLBoolean, eglReleaseThread, (void), (), GLI_CALL, 0, ".", NoData()) \
+    X(EGLBoolean, eglWaitClient, (void), (), GLI_CALL, 0, ".", NoData()) \
+    X(EGLContext, eglGetCurrentContext, (void), (), GLI_CALL, 0, "x", NoData())
+
+// Entry points the sample gets from eglGetProcAddress.
+#define GL_INTERCEPT_EXT_FUNCTIONS(X) \
+    X(void, glRenderbufferStorageMultisampleEXT, (GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height), (target, samples, internalformat, width, height), GLI_CALL, 0, "......", NoData()) \
+    X(void, glFramebufferTexture2DMultisampleEXT, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level, GLsizei samples), (target, attachment, textarget, texture, level, samples), GLI_CALL, 0, ".......", NoData()) \
+    X(void, glRenderbufferStorageMultisampleANGLE, (GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height), (target, samples, internalformat, width, height), GLI_CALL, 0, "......", NoData()) \
+    X(void, glBlitFramebufferANGLE, (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter), (srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter), GLI_CALL, 0, "...........", NoData()) \
+    X(void, glInvalidateFramebuffer, (GLenum target, GLsizei numAttachments, const GLenum* attachments), (target, numAttachments, attachments), GLI_CALL, 0, "....", Blob(attachments, numAttachments * sizeof(GLenum))) \
+    X(void, glDiscardFramebufferEXT, (GLenum target, GLsizei numAttachments, const GLenum* attachments), (target, numAttachments, attachments), GLI_CALL, 0, "....", Blob(attachments, numAttachments * sizeof(GLenum))) \
+    X(void, glGenQueriesEXT, (GLsizei n, GLuint* ids), (n, ids), GLI_CALL, 0, "...", NoData()) \
+    X(void, glDeleteQueriesEXT, (GLsizei n, const GLuint* ids), (n, ids), GLI_CALL, 0, "...", Blob(ids, n * sizeof(GLuint))) \
+    X(void, glBeginQueryEXT, (GLenum target, GLuint id), (target, id), GLI_CALL, 0, "...", NoData()) \
+    X(void, glEndQueryEXT, (GLenum target), (target), GLI_CALL, 0, "..", NoData()) \
+    X(void, glGetQueryObjectuivEXT, (GLuint id, GLenum pname, GLuint* params), (id, pname, params), GLI_CALL, 0, "....", NoData()) \
+    X(void, glTexImage3D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels), (target, level, internalformat, width, height, depth, border, format, type, pixels), GLI_UPLOAD, (pixels != NULL) ? GLIntercept::GetImageSize(width, height * depth, format, type) : 0, "...........", Image(width, height * depth, format, type, pixels)) \
+    X(void, glTexSubImage3D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels), (target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels), GLI_UPLOAD, GLIntercept::GetImageSize(width, height * depth, format, type), "............", Image(width, height * depth, format, type, pixels)) \
+    X(void*, glMapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access), GLI_UPLOAD, (access & GL_MAP_WRITE_BIT_EXT) ? length : 0, ".....", MapRange(target, length, access)) \
+    X(GLboolean, glUnmapBuffer, (GLenum target), (target), GLI_CALL, 0, "..", Unmap(target)) \
+    X(EGLSyncKHR, eglCreateSyncKHR, (EGLDisplay dpy, EGLenum type, const EGLint* attrib_list), (dpy, type, attrib_list), GLI_CALL, 0, "yd..", AttribList(attrib_list)) \
+    X(EGLBoolean, eglDestroySyncKHR, (EGLDisplay dpy, EGLSyncKHR sync), (dpy, sync), GLI_CALL, 0, ".dy", NoData()) \
+    X(EGLint, eglClientWaitSyncKHR, (EGLDisplay dpy, EGLSyncKHR sync, EGLint flags, EGLTimeKHR timeout), (dpy, sync, flags, timeout), GLI_CALL, 0, ".dy..", NoData()) \
+    X(EGLBoolean, eglSwapBuffersWithDamageEXT, (EGLDisplay dpy, EGLSurface surface, EGLint* rects, EGLint n_rects), (dpy, surface, rects, n_rects), GLI_CALL, 0, ".ds..", Blob(rects, n_rects * 4 * sizeof(EGLint))) \
+    X(EGLBoolean, eglPostSubBufferNV, (EGLDisplay dpy, EGLSurface surface, EGLint x, EGLint y, EGLint width, EGLint height), (dpy, surface, x, y, width, height), GLI_CALL, 0, ".ds....", NoData())
+
+// Entry points the sample links against.
+#define GL_INTERCEPT_CORE_FUNCTIONS(X) \
+    GL_INTERCEPT_GL_FUNCTIONS(X) \
+    GL_INTERCEPT_EGL_FUNCTIONS(X)
+
+#define GL_INTERCEPT_FUNCTIONS(X) \
+    GL_INTERCEPT_CORE_FUNCTIONS(X) \
+    GL_INTERCEPT_EXT_FUNCTIONS(X)
+
+class GLIntercept
+{
+public:
+    enum Function
+    {
+#define GL_INTERCEPT_ENUM(ret, name, params, args, kind, bytes, roles, capture) FUNCTION_##name,
+        GL_INTERCEPT_FUNCTIONS(GL_INTERCEPT_ENUM)
+#undef GL_INTERCEPT_ENUM
+        FUNCTION_COUNT
+    };
+
+    enum Kind
+    {
+        GLI_CALL,
+        GLI_DRAW,
+        GLI_STATE,
+        GLI_UNIFORM,
+        GLI_UPLOAD,
+        KIND_COUNT
+    };
+
+    struct Counters
+    {
+        khronos_uint64_t    calls;
+        khronos_uint64_t    draws;
+        khronos_uint64_t    stateChanges;
+        khronos_uint64_t    uniforms;
+        khronos_uint64_t    uploads;
+        khronos_uint64_t    uploadBytes;
+        khronos_uint64_t    functions[FUNCTION_COUNT];
+    };
+
+    static GLIntercept& Instance()
+    {
+        static GLIntercept intercept;
+        return intercept;
+    }
+
+    // Table of the entry points the wrappers call, also used by glreplay.
+    // Those of GL_INTERCEPT_EXT_FUNCTIONS are NULL until loaded.
+    struct Dispatch
+    {
+#define GL_INTERCEPT_MEMBER(ret, name, params, args, kind, bytes, roles, capture) \
+        typedef ret (KHRONOS_APIENTRY* name##Proc) params; \
+        name##Proc name;
+        GL_INTERCEPT_FUNCTIONS(GL_INTERCEPT_MEMBER)
+#undef GL_INTERCEPT_MEMBER
+
+        Dispatch()
+        {
+#define GL_INTERCEPT_LINK(ret, name, params, args, kind, bytes, roles, capture) name = ::name;
+            GL_INTERCEPT_CORE_FUNCTIONS(GL_INTERCEPT_LINK)
+#undef GL_INTERCEPT_LINK
+#define GL_INTERCEPT_NULL(ret, name, params, args, kind, bytes, roles, capture) name = NULL;
+            GL_INTERCEPT_EXT_FUNCTIONS(GL_INTERCEPT_NULL)
+#undef GL_INTERCEPT_NULL
+        }
+    };
+
+#if defined(GL_INTERCEPT)
+    Dispatch        dispatch;
+    GLTraceWriter   trace;
+
+    bool IsEnabled() const
+    {
+        return true;
+    }
+
+    // Fill the table of core functions from eglGetProcAddress, once the
+    // display is initialized. Returns how many entry points were loaded that
+    // way; the rest keep calling the linked functions.
+    int Load(EGLDisplay display)
+    {
+        int major = 0;
+        int minor = 0;
+        const char* version = dispatch.eglQueryString(display, EGL_VERSION);
+        const char* extensions = dispatch.eglQueryString(display, EGL_EXTENSIONS);
+        // client extensions need EGL_EXT_client_extensions; without it the
+        // query fails, leaving an error behind
+        const char* clientExtensions = dispatch.eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        dispatch.eglGetError();
+        bool all = (version != NULL && sscanf(version, "%d.%d", &major, &minor) == 2 &&
+                    (major > 1 || (major == 1 && minor >= 5))) ||
+                   HasToken(extensions, "EGL_KHR_get_all_proc_addresses") ||
+                   HasToken(clientExtensions, "EGL_KHR_client_get_all_proc_addresses");
+        if(!all)
+        {
+            return 0;
+        }
+        int loaded = 0;
+#define GL_INTERCEPT_LOAD(ret, name, params, args, kind, bytes, roles, capture) \
+        { \
+            Dispatch::name##Proc proc = (Dispatch::name##Proc) dispatch.eglGetProcAddress(#name); \
+            dispatch.name = (proc != NULL) ? proc : dispatch.name; \
+            loaded += (proc != NULL) ? 1 : 0; \
+        }
+        GL_INTERCEPT_CORE_FUNCTIONS(GL_INTERCEPT_LOAD)
+#undef GL_INTERCEPT_LOAD
+        return loaded;
+    }
+
+    // Seconds between reports printed by EndFrame(), 0 for none.
+    void SetReportInterval(double seconds)
+    {
+        m_reportInterval = seconds;
+        m_lastReport = GetNativeTime();
+    }
+
+    // Record every call into a trace file (gltrace.h), from the next one on.
+    bool StartTrace(const char* filename)
+    {
+        const char* names[FUNCTION_COUNT];
+        for(int f = 0; f < FUNCTION_COUNT; f++)
+        {
+            names[f] = GetFunctionName((Function) f);
+        }
+        return trace.Open(filename, names, FUNCTION_COUNT);
+    }
+
+    // Once no other thread makes calls.
+    void StopTrace()
+    {
+        trace.Close();
+    }
+
+    // Close the frame: what was counted since the previous call becomes the
+    // last frame and is added to the totals.
+    void EndFrame()
+    {
+        if(trace.IsOpen())
+        {
+            trace.EndFrame();
+        }
+        memset(&m_lastFrame, 0, sizeof(m_lastFrame));
+        khronos_uint64_t* kinds[KIND_COUNT] =
+        {
+            &m_lastFrame.calls, &m_lastFrame.draws, &m_lastFrame.stateChanges, &m_lastFrame.uniforms,
+            &m_lastFrame.uploads
+        };
+        // calls are summed from the functions
+        for(int k = GLI_DRAW; k < KIND_COUNT; k++)
+        {
+            *kinds[k] = Take(&m_live[k]);
+        }
+        m_lastFrame.uploadBytes = Take(&m_liveBytes);
+        for(int f = 0; f < FUNCTION_COUNT; f++)
+        {
+            m_lastFrame.functions[f] = Take(&m_liveFunctions[f]);
+            m_lastFrame.calls += m_lastFrame.functions[f];
+        }
+        Add(m_totals, m_lastFrame);
+        Add(m_interval, m_lastFrame);
+        m_frames++;
+        m_intervalFrames++;
+        Report();
+    }
+
+    // Count a call; used by the wrappers.
+    void Count(Function function, Kind kind, unsigned int bytes)
+    {
+        AtomicAdd(&m_liveFunctions[function], 1);
+        if(kind != GLI_CALL)
+        {
+            AtomicAdd(&m_live[kind], 1);
+        }
+        if(bytes != 0)
+        {
+            AtomicAdd(&m_liveBytes, bytes);
+        }
+    }
+#else
+    bool IsEnabled() const
+    {
+        return false;
+    }
+
+    int Load(EGLDisplay)
+    {
+        return 0;
+    }
+
+    bool StartTrace(const char*)
+    {
+        return false;
+    }
+
+    void StopTrace()
+    {
+    }
+
+    void SetReportInterval(double)
+    {
+    }
+
+    void EndFrame()
+    {
+    }
+#endif
+
+    // What the last closed frame counted.
+    const Counters& GetLastFrame() const
+    {
+        return m_lastFrame;
+    }
+
+    // What all closed frames counted.
+    const Counters& GetTotals() const
+    {
+        return m_totals;
+    }
+
+    unsigned int GetFrameCount() const
+    {
+        return m_frames;
+    }
+
+    static const char* GetFunctionName(Function function)
+    {
+        static const char* names[FUNCTION_COUNT] =
+        {
+#define GL_INTERCEPT_NAME(ret, name, params, args, kind, bytes, roles, capture) #name,
+            GL_INTERCEPT_FUNCTIONS(GL_INTERCEPT_NAME)
+#undef GL_INTERCEPT_NAME
+        };
+        return names[function];
+    }
+
+    // Bytes of pixels of a width by height image, with rows packed tightly.
+    static unsigned int GetImageSize(GLsizei width, GLsizei height, GLenum format, GLenum type)
+    {
+        return (unsigned int) width * (unsigned int) height * GLTraceGetPixelSize(format, type);
+    }
+
+private:
+    GLIntercept() : m_frames(0), m_intervalFrames(0), m_reportInterval(0.0), m_lastReport(0.0)
+    {
+        memset(&m_lastFrame, 0, sizeof(m_lastFrame));
+        memset(&m_totals, 0, sizeof(m_totals));
+        memset(&m_interval, 0, sizeof(m_interval));
+        memset((void*) m_live, 0, sizeof(m_live));
+        memset((void*) m_liveFunctions, 0, sizeof(m_liveFunctions));
+        m_liveBytes = 0;
+    }
+
+    GLIntercept(const GLIntercept&);
+    GLIntercept& operator=(const GLIntercept&);
+
+#if defined(GL_INTERCEPT)
+    // The count so far, leaving what other threads add meanwhile.
+    static unsigned int Take(volatile unsigned int* p)
+    {
+        unsigned int value = AtomicLoadAcquire(p);
+        AtomicAdd(p, 0u - value);
+        return value;
+    }
+
+    static void Add(Counters& sum, const Counters& c)
+    {
+        sum.calls += c.calls;
+        sum.draws += c.draws;
+        sum.stateChanges += c.stateChanges;
+        sum.uniforms += c.uniforms;
+        sum.uploads += c.uploads;
+        sum.uploadBytes += c.uploadBytes;
+        for(int f = 0; f < FUNCTION_COUNT; f++)
+        {
+            sum.functions[f] += c.functions[f];
+        }
+    }
+
+    static bool HasToken(const char* list, const char* token)
+    {
+        size_t length = strlen(token);
+        for(const char* p = list; p != NULL && (p = strstr(p, token)) != NULL; p += length)
+        {
+            if((p == list || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Report()
+    {
+        double now = GetNativeTime();
+        if(m_reportInterval <= 0.0 || now - m_lastReport < m_reportInterval)
+        {
+            return;
+        }
+        double frames = (double) m_intervalFrames;
+        printf("GL per frame: %.1f calls, %.1f draws, %.1f state changes, %.1f uniforms, %.1f uploads of %.1f KB\n",
+               m_interval.calls / frames, m_interval.draws / frames, m_interval.stateChanges / frames,
+               m_interval.uniforms / frames, m_interval.uploads / frames, m_interval.uploadBytes / frames / 1024.0);
+        // the five functions called most
+        bool listed[FUNCTION_COUNT] = { false };
+        printf("  most called:");
+        for(int i = 0; i < 5; i++)
+        {
+            int top = -1;
+            for(int f = 0; f < FUNCTION_COUNT; f++)
+            {
+                if(!listed[f] && m_interval.functions[f] > 0 &&
+                   (top < 0 || m_interval.functions[f] > m_interval.functions[top]))
+                {
+                    top = f;
+                }
+            }
+            if(top < 0)
+            {
+                break;
+            }
+            listed[top] = true;
+            printf(" %s %.1f", GetFunctionName((Function) top), m_interval.functions[top] / frames);
+        }
+        printf("\n");
+        memset(&m_interval, 0, sizeof(m_interval));
+        m_intervalFrames = 0;
+        m_lastReport = now;
+    }
+#endif
+
+    Counters                m_lastFrame;
+    Counters                m_totals;
+    // since the last report
+    Counters                m_interval;
+    unsigned int            m_frames;
+    unsigned int            m_intervalFrames;
+    double                  m_reportInterval;
+    double                  m_lastReport;
+    // counted since the last EndFrame(), by kind and by function
+    volatile unsigned int   m_live[KIND_COUNT];
+    volatile unsigned int   m_liveBytes;
+    volatile unsigned int   m_liveFunctions[FUNCTION_COUNT];
+};
+
+#if defined(GL_INTERCEPT)
+#define GL_INTERCEPT_WRAPPER(ret, name, params, args, kind, bytes, roles, capture) \
+    inline ret KHRONOS_APIENTRY GLI_##name params \
+    { \
+        GLIntercept& intercept = GLIntercept::Instance(); \
+        intercept.Count(GLIntercept::FUNCTION_##name, GLIntercept::kind, (unsigned int) (bytes)); \
+        if(!intercept.trace.IsOpen()) \
+        { \
+            return intercept.dispatch.name args; \
+        } \
+        GLTraceCall call(intercept.trace, GLIntercept::FUNCTION_##name); \
+        call.capture; \
+        call.Arguments args; \
+        return (intercept.dispatch.name args, GLTraceResult(call)).Get((ret*) NULL); \
+    }
+GL_INTERCEPT_FUNCTIONS(GL_INTERCEPT_WRAPPER)
+#undef GL_INTERCEPT_WRAPPER
+
+// eglGetProcAddress, handing out the wrappers of GL_INTERCEPT_EXT_FUNCTIONS
+// once the table holds what the implementation returned.
+inline __eglMustCastToProperFunctionPointerType KHRONOS_APIENTRY GLI_GetProcAddress(const char* procname)
+{
+    __eglMustCastToProperFunctionPointerType proc = GLI_eglGetProcAddress(procname);
+    GLIntercept::Dispatch& dispatch = GLIntercept::Instance().dispatch;
+#define GL_INTERCEPT_PROC(ret, name, params, args, kind, bytes, roles, capture) \
+    if(proc != NULL && procname != NULL && strcmp(procname, #name) == 0) \
+    { \
+        dispatch.name = (GLIntercept::Dispatch::name##Proc) proc; \
+        return (__eglMustCastToProperFunctionPointerType) GLI_##name; \
+    }
+    GL_INTERCEPT_EXT_FUNCTIONS(GL_INTERCEPT_PROC)
+#undef GL_INTERCEPT_PROC
+    return proc;
+}
+
+#define glActiveTexture GLI_glActiveTexture
+#define glAttachShader GLI_glAttachShader
+#define glBindAttribLocation GLI_glBindAttribLocation
+#define glBindBuffer GLI_glBindBuffer
+#define glBindFramebuffer GLI_glBindFramebuffer
+#define glBindRenderbuffer GLI_glBindRenderbuffer
+#define glBindTexture GLI_glBindTexture
+#define glBlendColor GLI_glBlendColor
+#define glBlendEquation GLI_glBlendEquation
+#define glBlendEquationSeparate GLI_glBlendEquationSeparate
+#define glBlendFunc GLI_glBlendFunc
+#define glBlendFuncSeparate GLI_glBlendFuncSeparate
+#define glBufferData GLI_glBufferData
+#define glBufferSubData GLI_glBufferSubData
+#define glCheckFramebufferStatus GLI_glCheckFramebufferStatus
+#define glClear GLI_glClear
+#define glClearColor GLI_glClearColor
+#define glClearDepthf GLI_glClearDepthf
+#define glClearStencil GLI_glClearStencil
+#define glColorMask GLI_glColorMask
+#define glCompileShader GLI_glCompileShader
+#define glCompressedTexImage2D GLI_glCompressedTexImage2D
+#define glCompressedTexSubImage2D GLI_glCompressedTexSubImage2D
+#define glCopyTexImage2D GLI_glCopyTexImage2D
+#define glCopyTexSubImage2D GLI_glCopyTexSubImage2D
+#define glCreateProgram GLI_glCreateProgram
+#define glCreateShader GLI_glCreateShader
+#define glCullFace GLI_glCullFace
+#define glDeleteBuffers GLI_glDeleteBuffers
+#define glDeleteFramebuffers GLI_glDeleteFramebuffers
+#define glDeleteProgram GLI_glDeleteProgram
+#define glDeleteRenderbuffers GLI_glDeleteRenderbuffers
+#define glDeleteShader GLI_glDeleteShader
+#define glDeleteTextures GLI_glDeleteTextures
+#define glDepthFunc GLI_glDepthFunc
+#define glDepthMask GLI_glDepthMask
+#define glDepthRangef GLI_glDepthRangef
+#define glDetachShader GLI_glDetachShader
+#define glDisable GLI_glDisable
+#define glDisableVertexAttribArray GLI_glDisableVertexAttribArray
+#define glDrawArrays GLI_glDrawArrays
+#define glDrawElements GLI_glDrawElements
+#define glEnable GLI_glEnable
+#define glEnableVertexAttribArray GLI_glEnableVertexAttribArray
+#define glFinish GLI_glFinish
+#define glFlush GLI_glFlush
+#define glFramebufferRenderbuffer GLI_glFramebufferRenderbuffer
+#define glFramebufferTexture2D GLI_glFramebufferTexture2D
+#define glFrontFace GLI_glFrontFace
+#define glGenBuffers GLI_glGenBuffers
+#define glGenerateMipmap GLI_glGenerateMipmap
+#define glGenFramebuffers GLI_glGenFramebuffers
+#define glGenRenderbuffers GLI_glGenRenderbuffers
+#define glGenTextures GLI_glGenTextures
+#define glGetActiveAttrib GLI_glGetActiveAttrib
+#define glGetActiveUniform GLI_glGetActiveUniform
+#define glGetAttachedShaders GLI_glGetAttachedShaders
+#define glGetAttribLocation GLI_glGetAttribLocation
+#define glGetBooleanv GLI_glGetBooleanv
+#define glGetBufferParameteriv GLI_glGetBufferParameteriv
+#define glGetError GLI_glGetError
+#define glGetFloatv GLI_glGetFloatv
+#define glGetFramebufferAttachmentParameteriv GLI_glGetFramebufferAttachmentParameteriv
+#define glGetIntegerv GLI_glGetIntegerv
+#define glGetProgramiv GLI_glGetProgramiv
+#define glGetProgramInfoLog GLI_glGetProgramInfoLog
+#define glGetRenderbufferParameteriv GLI_glGetRenderbufferParameteriv
+#define glGetShaderiv GLI_glGetShaderiv
+#define glGetShaderInfoLog GLI_glGetShaderInfoLog
+#define glGetShaderPrecisionFormat GLI_glGetShaderPrecisionFormat
+#define glGetShaderSource GLI_glGetShaderSource
+#define glGetString GLI_glGetString
+#define glGetTexParameterfv GLI_glGetTexParameterfv
+#define glGetTexParameteriv GLI_glGetTexParameteriv
+#define glGetUniformfv GLI_glGetUniformfv
+#define glGetUniformiv GLI_glGetUniformiv
+#define glGetUniformLocation GLI_glGetUniformLocation
+#define glGetVertexAttribfv GLI_glGetVertexAttribfv
+#define glGetVertexAttribiv GLI_glGetVertexAttribiv
+#define glGetVertexAttribPointerv GLI_glGetVertexAttribPointerv
+#define glHint GLI_glHint
+#define glIsBuffer GLI_glIsBuffer
+#define glIsEnabled GLI_glIsEnabled
+#define glIsFramebuffer GLI_glIsFramebuffer
+#define glIsProgram GLI_glIsProgram
+#define glIsRenderbuffer GLI_glIsRenderbuffer
+#define glIsShader GLI_glIsShader
+#define glIsTexture GLI_glIsTexture
+#define glLineWidth GLI_glLineWidth
+#define glLinkProgram GLI_glLinkProgram
+#define glPixelStorei GLI_glPixelStorei
+#define glPolygonOffset GLI_glPolygonOffset
+#define glReadPixels GLI_glReadPixels
+#define glReleaseShaderCompiler GLI_glReleaseShaderCompiler
+#define glRenderbufferStorage GLI_glRenderbufferStorage
+#define glSampleCoverage GLI_glSampleCoverage
+#define glScissor GLI_glScissor
+#define glShaderBinary GLI_glShaderBinary
+#define glShaderSource GLI_glShaderSource
+#define glStencilFunc GLI_glStencilFunc
+#define glStencilFuncSeparate GLI_glStencilFuncSeparate
+#define glStencilMask GLI_glStencilMask
+#define glStencilMaskSeparate GLI_glStencilMaskSeparate
+#define glStencilOp GLI_glStencilOp
+#define glStencilOpSeparate GLI_glStencilOpSeparate
+#define glTexImage2D GLI_glTexImage2D
+#define glTexParameterf GLI_glTexParameterf
+#define glTexParameterfv GLI_glTexParameterfv
+#define glTexParameteri GLI_glTexParameteri
+#define glTexParameteriv GLI_glTexParameteriv
+#define glTexSubImage2D GLI_glTexSubImage2D
+#define glUniform1f GLI_glUniform1f
+#define glUniform1fv GLI_glUniform1fv
+#define glUniform1i GLI_glUniform1i
+#define glUniform1iv GLI_glUniform1iv
+#define glUniform2f GLI_glUniform2f
+#define glUniform2fv GLI_glUniform2fv
+#define glUniform2i GLI_glUniform2i
+#define glUniform2iv GLI_glUniform2iv
+#define glUniform3f GLI_glUniform3f
+#define glUniform3fv GLI_glUniform3fv
+#define glUniform3i GLI_glUniform3i
+#define glUniform3iv GLI_glUniform3iv
+#define glUniform4f GLI_glUniform4f
+#define glUniform4fv GLI_glUniform4fv
+#define glUniform4i GLI_glUniform4i
+#define glUniform4iv GLI_glUniform4iv
+#define glUniformMatrix2fv GLI_glUniformMatrix2fv
+#define glUniformMatrix3fv GLI_glUniformMatrix3fv
+#define glUniformMatrix4fv GLI_glUniformMatrix4fv
+#define glUseProgram GLI_glUseProgram
+#define glValidateProgram GLI_glValidateProgram
+#define glVertexAttrib1f GLI_glVertexAttrib1f
+#define glVertexAttrib1fv GLI_glVertexAttrib1fv
+#define glVertexAttrib2f GLI_glVertexAttrib2f
+#define glVertexAttrib2fv GLI_glVertexAttrib2fv
+#define glVertexAttrib3f GLI_glVertexAttrib3f
+#define glVertexAttrib3fv GLI_glVertexAttrib3fv
+#define glVertexAttrib4f GLI_glVertexAttrib4f
+#define glVertexAttrib4fv GLI_glVertexAttrib4fv
+#define glVertexAttribPointer GLI_glVertexAttribPointer
+#define glViewport GLI_glViewport
+#define eglChooseConfig GLI_eglChooseConfig
+#define eglCopyBuffers GLI_eglCopyBuffers
+#define eglCreateContext GLI_eglCreateContext
+#define eglCreatePbufferSurface GLI_eglCreatePbufferSurface
+#define eglCreatePixmapSurface GLI_eglCreatePixmapSurface
+#define eglCreateWindowSurface GLI_eglCreateWindowSurface
+#define eglDestroyContext GLI_eglDestroyContext
+#define eglDestroySurface GLI_eglDestroySurface
+#define eglGetConfigAttrib GLI_eglGetConfigAttrib
+#define eglGetConfigs GLI_eglGetConfigs
+#define eglGetCurrentDisplay GLI_eglGetCurrentDisplay
+#define eglGetCurrentSurface GLI_eglGetCurrentSurface
+#define eglGetDisplay GLI_eglGetDisplay
+#define eglGetError GLI_eglGetError
+#define eglGetProcAddress GLI_GetProcAddress
+#define eglInitialize GLI_eglInitialize
+#define eglMakeCurrent GLI_eglMakeCurrent
+#define eglQueryContext GLI_eglQueryContext
+#define eglQueryString GLI_eglQueryString
+#define eglQuerySurface GLI_eglQuerySurface
+#define eglSwapBuffers GLI_eglSwapBuffers
+#define eglTerminate GLI_eglTerminate
+#define eglWaitGL GLI_eglWaitGL
+#define eglWaitNative GLI_eglWaitNative
+#define eglBindTexImage GLI_eglBindTexImage
+#define eglReleaseTexImage GLI_eglReleaseTexImage
+#define eglSurfaceAttrib GLI_eglSurfaceAttrib
+#define eglSwapInterval GLI_eglSwapInterval
+#define eglBindAPI GLI_eglBindAPI
+#define eglQueryAPI GLI_eglQueryAPI
+#define eglCreatePbufferFromClientBuffer GLI_eglCreatePbufferFromClientBuffer
+#define eglReleaseThread GLI_eglReleaseThread
+#define eglWaitClient GLI_eglWaitClient
+#define eglGetCurrentContext GLI_eglGetCurrentContext
+#endif
+
+#endif // __GLINTERCEPT_H__
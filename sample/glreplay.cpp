@@ -0,0 +1,824 @@
+// glreplay - plays a trace of GL and EGL calls back and measures each call.
+//
+// usage: glreplay [-top <n>] <trace>
+//
+// Traces are recorded by the sample built with GL_INTERCEPT and run with
+// -trace <file> (gltrace.h). Every call is made again, as fast as the driver
+// takes it, on one thread and without a window system: the display is the
+// surfaceless platform of EGL_MESA_platform_surfaceless where the EGL
+// implementation has it and the default display otherwise, and window
+// surfaces are pbuffers of the size the windows had. Calls of different
+// threads are replayed in the order they were recorded, each thread's
+// context made current for its calls.
+//
+// Programs, shaders, uniform locations and EGL objects are mapped from their
+// recorded to their replayed values. Buffer, texture, framebuffer,
+// renderbuffer and query names are used as recorded, binding them creates
+// them. eglGetProcAddress is not replayed; the extension functions the
+// sample called through the pointers it returned are loaded when first
+// called, and skipped where the implementation lacks them. What the sample
+// wrote into a mapped buffer range is copied into the replayed mapping
+// before it is unmapped.
+//
+// The CPU time of every call is measured around it; a call waiting for the
+// GPU includes the wait. Printed are the frames and calls replayed and the
+// -top functions (default 20) taking the most time, with their calls, total
+// and average time.
+
+#include "glintercept.h"
+#include "gltrace.h"
+#include "nativefile.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static double GetTime()
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static const char* const s_roles[GLIntercept::FUNCTION_COUNT] =
+{
+#define GLREPLAY_ROLES(ret, name, params, args, kind, bytes, roles, capture) roles,
+    GL_INTERCEPT_FUNCTIONS(GLREPLAY_ROLES)
+#undef GLREPLAY_ROLES
+};
+
+// What a replayed call returned. (call(...), Returned()) catches it with the
+// comma operator below; calls returning void leave it invalid.
+struct Returned
+{
+    Returned() : valid(false), value(0)
+    {
+    }
+
+    bool            valid;
+    khronos_int64_t value;
+};
+
+template<class T>
+inline khronos_int64_t ToInteger(T value)
+{
+    return (khronos_int64_t) value;
+}
+
+template<class T>
+inline khronos_int64_t ToInteger(T* value)
+{
+    return (khronos_int64_t) (size_t) value;
+}
+
+template<class T>
+inline Returned operator,(const T& value, Returned r)
+{
+    r.valid = true;
+    r.value = ToInteger(value);
+    return r;
+}
+
+struct FunctionCost
+{
+    int             function;
+    unsigned int    calls;
+    double          seconds;
+
+    bool operator<(const FunctionCost& other) const
+    {
+        return seconds > other.seconds;
+    }
+};
+
+class Replayer
+{
+public:
+    Replayer() : m_display(EGL_NO_DISPLAY), m_roles(""), m_current(0), m_elapsed(0.0)
+    {
+    }
+
+    // Replay the trace, adding the time of each function to costs.
+    bool Play(GLTraceReader& reader, std::vector<FunctionCost>& costs, unsigned int& frames, unsigned int& calls)
+    {
+        const std::vector<std::string>& names = reader.GetFunctionNames();
+        std::vector<int> functions(names.size(), -1);
+        for(unsigned int i = 0; i < names.size(); i++)
+        {
+            for(int f = 0; f < GLIntercept::FUNCTION_COUNT && functions[i] < 0; f++)
+            {
+                functions[i] = (names[i] == GLIntercept::GetFunctionName((GLIntercept::Function) f)) ? f : -1;
+            }
+        }
+        costs.resize(GLIntercept::FUNCTION_COUNT);
+        for(int f = 0; f < GLIntercept::FUNCTION_COUNT; f++)
+        {
+            FunctionCost cost = { f, 0, 0.0 };
+            costs[f] = cost;
+        }
+        frames = 0;
+        calls = 0;
+        unsigned int skipped = 0;
+        while(reader.Next(m_record))
+        {
+            if(m_record.tag == GLTRACE_FRAME)
+            {
+                frames++;
+                continue;
+            }
+            int function = (m_record.function < functions.size()) ? functions[m_record.function] : -1;
+            if(function < 0 || function == GLIntercept::FUNCTION_eglGetProcAddress)
+            {
+                skipped++;
+                continue;
+            }
+            m_roles = s_roles[function];
+            MakeThreadCurrent(function);
+            if(!Replay((GLIntercept::Function) function))
+            {
+                skipped++;
+                continue;
+            }
+            costs[function].calls++;
+            costs[function].seconds += m_elapsed;
+            calls++;
+        }
+        if(skipped > 0)
+        {
+            printf("%u calls skipped.\n", skipped);
+        }
+        return calls > 0;
+    }
+
+private:
+    struct ThreadState
+    {
+        khronos_int64_t display;
+        khronos_int64_t draw;
+        khronos_int64_t read;
+        khronos_int64_t context;
+    };
+
+    typedef std::map<khronos_int64_t, khronos_int64_t> ValueMap;
+    typedef std::map<std::pair<khronos_int64_t, khronos_int64_t>, khronos_int64_t> LocationMap;
+
+    struct Mapping
+    {
+        void*   pointer;
+        size_t  size;
+    };
+
+    typedef std::map<std::pair<khronos_int64_t, khronos_int64_t>, Mapping> MappingMap;
+
+    // False for a function the implementation lacks.
+    bool Replay(GLIntercept::Function function)
+    {
+        m_elapsed = 0.0;
+        Returned result;
+        bool available = true;
+        ThreadState& thread = m_threads[m_record.thread];
+        std::pair<khronos_int64_t, khronos_int64_t> target(thread.context, GetArg(0));
+        if(function == GLIntercept::FUNCTION_eglGetDisplay)
+        {
+            result = GetDisplay();
+        }
+        else if(function == GLIntercept::FUNCTION_eglChooseConfig || function == GLIntercept::FUNCTION_eglGetConfigs)
+        {
+            result = GetConfigs(function);
+        }
+        else if(function == GLIntercept::FUNCTION_eglCreateWindowSurface ||
+                function == GLIntercept::FUNCTION_eglCreatePixmapSurface)
+        {
+            result = CreateSurface();
+        }
+        else
+        {
+            if(function == GLIntercept::FUNCTION_glDrawArrays || function == GLIntercept::FUNCTION_glDrawElements)
+            {
+                SetClientArrays();
+            }
+            else if(function == GLIntercept::FUNCTION_glUnmapBuffer)
+            {
+                WriteMapping(target);
+            }
+            switch(function)
+            {
+#define GLREPLAY_CASE(ret, name, params, args, kind, bytes, roles, capture) \
+            case GLIntercept::FUNCTION_##name: \
+                result = Invoke(m_gl.name); \
+                break;
+            GL_INTERCEPT_CORE_FUNCTIONS(GLREPLAY_CASE)
+#undef GLREPLAY_CASE
+#define GLREPLAY_EXT_CASE(ret, name, params, args, kind, bytes, roles, capture) \
+            case GLIntercept::FUNCTION_##name: \
+                m_gl.name = (m_gl.name != NULL) ? m_gl.name : \
+                            (GLIntercept::Dispatch::name##Proc) m_gl.eglGetProcAddress(#name); \
+                available = m_gl.name != NULL; \
+                result = available ? Invoke(m_gl.name) : result; \
+                break;
+            GL_INTERCEPT_EXT_FUNCTIONS(GLREPLAY_EXT_CASE)
+#undef GLREPLAY_EXT_CASE
+            default:
+                break;
+            }
+        }
+        if(function == GLIntercept::FUNCTION_glMapBufferRange && result.valid && result.value != 0)
+        {
+            Mapping mapping = { (void*) (size_t) result.value, (size_t) GetArg(2) };
+            m_mappings[target] = mapping;
+        }
+
+        // remember what the recorded values became
+        char role = m_roles[0];
+        if(result.valid && m_record.result.tag != GLTRACE_VOID && role == 'u')
+        {
+            m_locations[std::make_pair(GetArg(0), m_record.result.integer)] = result.value;
+        }
+        else if(result.valid && m_record.result.tag != GLTRACE_VOID && role != '.')
+        {
+            m_objects[role][m_record.result.integer] = result.value;
+        }
+        if(function == GLIntercept::FUNCTION_glUseProgram)
+        {
+            m_programs[thread.context] = GetArg(0);
+        }
+        else if(function == GLIntercept::FUNCTION_eglMakeCurrent && result.value)
+        {
+            thread.display = GetArg(0);
+            thread.draw = GetArg(1);
+            thread.read = GetArg(2);
+            thread.context = GetArg(3);
+        }
+        return available;
+    }
+
+    // Copy what the sample wrote into the range mapped on the target of
+    // glUnmapBuffer, outside the time of the call.
+    void WriteMapping(const std::pair<khronos_int64_t, khronos_int64_t>& target)
+    {
+        MappingMap::iterator found = m_mappings.find(target);
+        if(found == m_mappings.end())
+        {
+            return;
+        }
+        if(!m_record.payloads.empty() && m_record.payloads[0].kind == GLTRACE_DATA)
+        {
+            const GLTracePayload& written = m_record.payloads[0];
+            memcpy(found->second.pointer, written.data, std::min(written.size, found->second.size));
+        }
+        m_mappings.erase(found);
+    }
+
+    // Make the context of the thread that made the call current, if another
+    // thread's was.
+    void MakeThreadCurrent(int function)
+    {
+        if(m_record.thread >= m_threads.size())
+        {
+            ThreadState none = { 0, 0, 0, 0 };
+            m_threads.resize(m_record.thread + 1, none);
+        }
+        if(m_record.thread == m_current || function == GLIntercept::FUNCTION_eglMakeCurrent)
+        {
+            return;
+        }
+        const ThreadState& from = m_threads[m_current];
+        const ThreadState& to = m_threads[m_record.thread];
+        m_current = m_record.thread;
+        if(to.context != 0 &&
+           (to.display != from.display || to.draw != from.draw || to.read != from.read || to.context != from.context))
+        {
+            m_gl.eglMakeCurrent((EGLDisplay) (size_t) Lookup('d', to.display), (EGLSurface) (size_t) Lookup('s', to.draw),
+                                (EGLSurface) (size_t) Lookup('s', to.read), (EGLContext) (size_t) Lookup('x', to.context));
+        }
+    }
+
+    khronos_int64_t Lookup(char role, khronos_int64_t value)
+    {
+        ValueMap::const_iterator found = m_objects[role].find(value);
+        return (value != 0 && found != m_objects[role].end()) ? found->second : value;
+    }
+
+    // Recorded value of an argument.
+    khronos_int64_t GetArg(unsigned int i) const
+    {
+        return (i < m_record.args.size()) ? m_record.args[i].integer : 0;
+    }
+
+    // Replayed value of an integer or pointer argument.
+    khronos_int64_t GetValue(unsigned int i)
+    {
+        khronos_int64_t value = GetArg(i);
+        char role = (i + 1 < strlen(m_roles)) ? m_roles[i + 1] : '.';
+        if(role == 'u')
+        {
+            // of the program passed along, or the one in use
+            const char* program = strchr(m_roles + 1, 'o');
+            khronos_int64_t key = (program != NULL) ? GetArg((unsigned int) (program - m_roles - 1)) :
+                                                      m_programs[m_threads[m_record.thread].context];
+            LocationMap::const_iterator found = m_locations.find(std::make_pair(key, value));
+            return (found != m_locations.end()) ? found->second : value;
+        }
+        return (role != '.') ? Lookup(role, value) : value;
+    }
+
+    void* GetPointer(unsigned int i)
+    {
+        if(i >= m_record.args.size())
+        {
+            return NULL;
+        }
+        const GLTraceValue& arg = m_record.args[i];
+        if(arg.tag == GLTRACE_OUTPUT)
+        {
+            if(m_outputs.size() <= i)
+            {
+                m_outputs.resize(i + 1);
+            }
+            // queries of unknown size get room for any GLES2 state
+            size_t size = (arg.integer > 4096) ? (size_t) arg.integer : 4096;
+            m_outputs[i].resize(size);
+            return &m_outputs[i][0];
+        }
+        if(arg.tag != GLTRACE_PAYLOAD)
+        {
+            return (void*) (size_t) GetValue(i);
+        }
+        if(arg.integer < 0 || (size_t) arg.integer >= m_record.payloads.size())
+        {
+            return NULL;
+        }
+        const GLTracePayload& payload = m_record.payloads[(size_t) arg.integer];
+        if(payload.kind == GLTRACE_STRINGS)
+        {
+            m_strings.clear();
+            for(size_t pos = 0; pos < payload.size; pos += strlen((const char*) payload.data + pos) + 1)
+            {
+                m_strings.push_back((const char*) payload.data + pos);
+            }
+            return m_strings.empty() ? NULL : (void*) &m_strings[0];
+        }
+        return (payload.kind == GLTRACE_DATA) ? (void*) payload.data : NULL;
+    }
+
+    template<class T>
+    void Get(unsigned int i, T& value)
+    {
+        value = (T) GetValue(i);
+    }
+
+    void Get(unsigned int i, GLfloat& value)
+    {
+        value = (i < m_record.args.size()) ? m_record.args[i].real : 0.0f;
+    }
+
+    template<class T>
+    void Get(unsigned int i, T*& value)
+    {
+        value = (T*) GetPointer(i);
+    }
+
+    template<class R>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)())
+    {
+        double start = GetTime();
+        Returned r = (f(), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0))
+    {
+        A0 a0;
+        Get(0, a0);
+        double start = GetTime();
+        Returned r = (f(a0), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1))
+    {
+        A0 a0;
+        A1 a1;
+        Get(0, a0);
+        Get(1, a1);
+        double start = GetTime();
+        Returned r = (f(a0, a1), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1, class A2>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1, A2))
+    {
+        A0 a0;
+        A1 a1;
+        A2 a2;
+        Get(0, a0);
+        Get(1, a1);
+        Get(2, a2);
+        double start = GetTime();
+        Returned r = (f(a0, a1, a2), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1, class A2, class A3>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1, A2, A3))
+    {
+        A0 a0;
+        A1 a1;
+        A2 a2;
+        A3 a3;
+        Get(0, a0);
+        Get(1, a1);
+        Get(2, a2);
+        Get(3, a3);
+        double start = GetTime();
+        Returned r = (f(a0, a1, a2, a3), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1, class A2, class A3, class A4>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1, A2, A3, A4))
+    {
+        A0 a0;
+        A1 a1;
+        A2 a2;
+        A3 a3;
+        A4 a4;
+        Get(0, a0);
+        Get(1, a1);
+        Get(2, a2);
+        Get(3, a3);
+        Get(4, a4);
+        double start = GetTime();
+        Returned r = (f(a0, a1, a2, a3, a4), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1, class A2, class A3, class A4, class A5>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1, A2, A3, A4, A5))
+    {
+        A0 a0;
+        A1 a1;
+        A2 a2;
+        A3 a3;
+        A4 a4;
+        A5 a5;
+        Get(0, a0);
+        Get(1, a1);
+        Get(2, a2);
+        Get(3, a3);
+        Get(4, a4);
+        Get(5, a5);
+        double start = GetTime();
+        Returned r = (f(a0, a1, a2, a3, a4, a5), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1, class A2, class A3, class A4, class A5, class A6>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1, A2, A3, A4, A5, A6))
+    {
+        A0 a0;
+        A1 a1;
+        A2 a2;
+        A3 a3;
+        A4 a4;
+        A5 a5;
+        A6 a6;
+        Get(0, a0);
+        Get(1, a1);
+        Get(2, a2);
+        Get(3, a3);
+        Get(4, a4);
+        Get(5, a5);
+        Get(6, a6);
+        double start = GetTime();
+        Returned r = (f(a0, a1, a2, a3, a4, a5, a6), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1, A2, A3, A4, A5, A6, A7))
+    {
+        A0 a0;
+        A1 a1;
+        A2 a2;
+        A3 a3;
+        A4 a4;
+        A5 a5;
+        A6 a6;
+        A7 a7;
+        Get(0, a0);
+        Get(1, a1);
+        Get(2, a2);
+        Get(3, a3);
+        Get(4, a4);
+        Get(5, a5);
+        Get(6, a6);
+        Get(7, a7);
+        double start = GetTime();
+        Returned r = (f(a0, a1, a2, a3, a4, a5, a6, a7), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1, A2, A3, A4, A5, A6, A7, A8))
+    {
+        A0 a0;
+        A1 a1;
+        A2 a2;
+        A3 a3;
+        A4 a4;
+        A5 a5;
+        A6 a6;
+        A7 a7;
+        A8 a8;
+        Get(0, a0);
+        Get(1, a1);
+        Get(2, a2);
+        Get(3, a3);
+        Get(4, a4);
+        Get(5, a5);
+        Get(6, a6);
+        Get(7, a7);
+        Get(8, a8);
+        double start = GetTime();
+        Returned r = (f(a0, a1, a2, a3, a4, a5, a6, a7, a8), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1, A2, A3, A4, A5, A6, A7, A8, A9))
+    {
+        A0 a0;
+        A1 a1;
+        A2 a2;
+        A3 a3;
+        A4 a4;
+        A5 a5;
+        A6 a6;
+        A7 a7;
+        A8 a8;
+        A9 a9;
+        Get(0, a0);
+        Get(1, a1);
+        Get(2, a2);
+        Get(3, a3);
+        Get(4, a4);
+        Get(5, a5);
+        Get(6, a6);
+        Get(7, a7);
+        Get(8, a8);
+        Get(9, a9);
+        double start = GetTime();
+        Returned r = (f(a0, a1, a2, a3, a4, a5, a6, a7, a8, a9), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    template<class R, class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9,
+             class A10>
+    Returned Invoke(R (KHRONOS_APIENTRY* f)(A0, A1, A2, A3, A4, A5, A6, A7, A8, A9, A10))
+    {
+        A0 a0;
+        A1 a1;
+        A2 a2;
+        A3 a3;
+        A4 a4;
+        A5 a5;
+        A6 a6;
+        A7 a7;
+        A8 a8;
+        A9 a9;
+        A10 a10;
+        Get(0, a0);
+        Get(1, a1);
+        Get(2, a2);
+        Get(3, a3);
+        Get(4, a4);
+        Get(5, a5);
+        Get(6, a6);
+        Get(7, a7);
+        Get(8, a8);
+        Get(9, a9);
+        Get(10, a10);
+        double start = GetTime();
+        Returned r = (f(a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10), Returned());
+        m_elapsed = GetTime() - start;
+        return r;
+    }
+
+    // The display of the replay, whatever the sample opened.
+    Returned GetDisplay()
+    {
+        double start = GetTime();
+        if(m_display == EGL_NO_DISPLAY)
+        {
+            const char* extensions = m_gl.eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC) m_gl.eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if(extensions != NULL && strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL &&
+               getPlatformDisplay != NULL)
+            {
+                m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            }
+            m_gl.eglGetError();
+            m_display = (m_display != EGL_NO_DISPLAY) ? m_display : m_gl.eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+        m_elapsed = GetTime() - start;
+        return (m_display, Returned());
+    }
+
+    // eglChooseConfig for pbuffers instead of windows, or eglGetConfigs; the
+    // recorded configs map to the replayed ones in order.
+    Returned GetConfigs(GLIntercept::Function function)
+    {
+        bool choose = function == GLIntercept::FUNCTION_eglChooseConfig;
+        std::vector<EGLint> attribs;
+        const EGLint* list = choose ? (const EGLint*) GetPointer(1) : NULL;
+        for(unsigned int i = 0; list != NULL && list[i] != EGL_NONE; i += 2)
+        {
+            attribs.push_back(list[i]);
+            attribs.push_back((list[i] == EGL_SURFACE_TYPE) ? EGL_PBUFFER_BIT : list[i + 1]);
+        }
+        attribs.push_back(EGL_NONE);
+        EGLint size = (EGLint) GetArg(choose ? 3 : 2);
+        std::vector<EGLConfig> configs((size > 0) ? size : 1);
+        EGLint count = 0;
+        EGLDisplay display = (EGLDisplay) (size_t) GetValue(0);
+        double start = GetTime();
+        EGLBoolean ok = choose ? m_gl.eglChooseConfig(display, &attribs[0], &configs[0], size, &count) :
+                                 m_gl.eglGetConfigs(display, &configs[0], size, &count);
+        m_elapsed = GetTime() - start;
+        for(unsigned int i = 0; ok && count > 0 && i < m_record.configs.size(); i++)
+        {
+            EGLConfig config = configs[((EGLint) i < count) ? i : 0];
+            m_objects['c'][(khronos_int64_t) m_record.configs[i]] = (khronos_int64_t) (size_t) config;
+        }
+        return (ok, Returned());
+    }
+
+    // A pbuffer as large as the window was.
+    Returned CreateSurface()
+    {
+        EGLint attribs[] = { EGL_WIDTH, m_record.width, EGL_HEIGHT, m_record.height, EGL_NONE };
+        double start = GetTime();
+        EGLSurface surface = m_gl.eglCreatePbufferSurface((EGLDisplay) (size_t) GetValue(0),
+                                                          (EGLConfig) (size_t) GetValue(1), attribs);
+        m_elapsed = GetTime() - start;
+        return (surface, Returned());
+    }
+
+    // Point the attributes the sample drew from client memory at the
+    // recorded vertices.
+    void SetClientArrays()
+    {
+        if(m_record.arrays.empty())
+        {
+            return;
+        }
+        GLint buffer = 0;
+        m_gl.glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &buffer);
+        m_gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for(unsigned int i = 0; i < m_record.arrays.size(); i++)
+        {
+            const GLTraceClientArray& a = m_record.arrays[i];
+            m_gl.glVertexAttribPointer(a.index, a.size, a.type, a.normalized, a.stride,
+                                       m_record.payloads[a.payload].data);
+        }
+        m_gl.glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    }
+
+    GLIntercept::Dispatch               m_gl;
+    EGLDisplay                          m_display;
+    GLTraceRecord                       m_record;
+    const char*                         m_roles;
+    // recorded values to replayed ones, by role
+    std::map<char, ValueMap>            m_objects;
+    // uniform locations by recorded program and location
+    LocationMap                         m_locations;
+    // program in use by recorded context
+    ValueMap                            m_programs;
+    std::vector<ThreadState>            m_threads;
+    unsigned int                        m_current;
+    // ranges mapped by recorded context and target
+    MappingMap                          m_mappings;
+    std::vector<std::vector<unsigned char> > m_outputs;
+    std::vector<const char*>            m_strings;
+    double                              m_elapsed;
+};
+
+int main(int argc, char** argv)
+{
+    const char* filename = NULL;
+    unsigned int top = 20;
+    bool valid = true;
+    for(int i = 1; i < argc && valid; i++)
+    {
+        if(strcmp(argv[i], "-top") == 0 && i + 1 < argc)
+        {
+            top = (unsigned int) atoi(argv[++i]);
+        }
+        else if(argv[i][0] != '-' && filename == NULL)
+        {
+            filename = argv[i];
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+    if(!valid || filename == NULL)
+    {
+        printf("usage: %s [-top <n>] <trace>\n", argv[0]);
+        return 1;
+    }
+
+    NativeFile file = NULL;
+    const void* data = NULL;
+    size_t size = 0;
+    GLTraceReader reader;
+    if(!MapNativeFile(filename, &file, &data, &size))
+    {
+        printf("Could not open %s.\n", filename);
+        return 1;
+    }
+    if(!reader.Open(data, size))
+    {
+        printf("%s is not a trace.\n", filename);
+        UnmapNativeFile(file);
+        return 1;
+    }
+
+    Replayer replayer;
+    std::vector<FunctionCost> costs;
+    unsigned int frames = 0;
+    unsigned int calls = 0;
+    double start = GetTime();
+    bool played = replayer.Play(reader, costs, frames, calls);
+    double seconds = GetTime() - start;
+    UnmapNativeFile(file);
+    if(!played)
+    {
+        printf("%s holds no calls.\n", filename);
+        return 1;
+    }
+
+    double total = 0.0;
+    for(unsigned int i = 0; i < costs.size(); i++)
+    {
+        total += costs[i].seconds;
+    }
+    std::sort(costs.begin(), costs.end());
+    printf("%u frames, %u calls in %.1f ms, %.1f ms in calls", frames, calls, seconds * 1000.0, total * 1000.0);
+    if(frames > 0)
+    {
+        printf(", %.2f ms a frame", total * 1000.0 / frames);
+    }
+    printf("\n%-36s %10s %12s %10s %7s\n", "function", "calls", "total ms", "avg us", "time");
+    for(unsigned int i = 0; i < top && i < costs.size() && costs[i].calls > 0; i++)
+    {
+        const FunctionCost& c = costs[i];
+        printf("%-36s %10u %12.3f %10.2f %6.1f%%\n", GLIntercept::GetFunctionName((GLIntercept::Function) c.function),
+               c.calls, c.seconds * 1000.0, c.seconds * 1e6 / c.calls, (total > 0.0) ? c.seconds * 100.0 / total : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,1291 @@
+#ifndef __GLTRACE_H__
+#define __GLTRACE_H__
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "hashutil.h"
+#include "nativethread.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Binary trace of GL and EGL calls, written through the interception layer
+// (glintercept.h) and read back by glreplay.
+//
+// A trace starts with GLTRACE_MAGIC and the names of the functions, so that
+// it can be read by a build with a different list of entry points. Records
+// follow, each starting with a tag:
+//
+//   'B'  blob: id, size, bytes
+//   'C'  call: thread, function, arguments, result, payloads, extras
+//   'F'  end of a frame
+//
+// Numbers take 7 bits a byte, low bits first; signed numbers are zigzag
+// encoded. Arguments and results are a tag and a value: an integer, a float
+// (4 bytes), a pointer kept by its value, an output with the bytes it takes,
+// or a payload of the call.
+//
+// Payloads are what a pointer argument hands in: buffer and texture data,
+// uniform values, shader sources, attribute lists; and for glUnmapBuffer,
+// what was written into the range mapped before. Up to
+// GLTRACE_INLINE_BYTES are stored in the call, larger ones in blobs. Each
+// blob contents is written once; calls handing in the same bytes again, found
+// by a 64 bit hash and the size, refer to the blob written first.
+//
+// Extras carry what the replay needs beyond the arguments: the vertices of
+// client-side arrays a draw reads, the configs eglChooseConfig returned and
+// the size of window surfaces, which are replayed as pbuffers.
+#define GLTRACE_MAGIC "GLTRACE1"
+
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+
+enum
+{
+    GLTRACE_INLINE_BYTES = 64
+};
+
+enum GLTraceTag
+{
+    GLTRACE_BLOB            = 'B',
+    GLTRACE_CALL            = 'C',
+    GLTRACE_FRAME           = 'F',
+
+    // arguments and results
+    GLTRACE_INTEGER         = 'i',
+    GLTRACE_FLOAT           = 'f',
+    GLTRACE_POINTER         = 'p',
+    GLTRACE_OUTPUT          = 'o',
+    GLTRACE_PAYLOAD         = 'd',
+    GLTRACE_VOID            = 'v',
+
+    // extras
+    GLTRACE_CLIENT_ARRAY    = 'A',
+    GLTRACE_CONFIGS         = 'G',
+    GLTRACE_SURFACE_SIZE    = 'S'
+};
+
+enum GLTracePayloadKind
+{
+    GLTRACE_DATA,
+    GLTRACE_STRINGS,        // NUL terminated, one after the other
+    GLTRACE_NULL            // replayed as NULL, e.g. the lengths of strings
+};
+
+// Bytes of one pixel of a format and type.
+inline unsigned int GLTraceGetPixelSize(GLenum format, GLenum type)
+{
+    unsigned int components = (format == GL_RGBA || format == GL_BGRA_EXT) ? 4 :
+                              (format == GL_RGB) ? 3 :
+                              (format == GL_LUMINANCE_ALPHA || format == GL_RG_EXT) ? 2 : 1;
+    return (type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_4_4_4_4 ||
+            type == GL_UNSIGNED_SHORT_5_5_5_1) ? 2 :
+           (type == GL_UNSIGNED_INT_24_8_OES) ? 4 :
+           (type == GL_FLOAT || type == GL_UNSIGNED_INT) ? 4 * components :
+           (type == GL_HALF_FLOAT_OES || type == GL_UNSIGNED_SHORT || type == GL_SHORT) ? 2 * components :
+           components;
+}
+
+// Bytes of one component of a vertex attribute or index type.
+inline unsigned int GLTraceGetTypeSize(GLenum type)
+{
+    return (type == GL_FLOAT || type == GL_FIXED || type == GL_UNSIGNED_INT || type == GL_INT) ? 4 :
+           (type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT_OES) ? 2 : 1;
+}
+
+inline void GLTracePutNumber(std::vector<unsigned char>& out, khronos_uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back((unsigned char) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char) value);
+}
+
+inline void GLTracePutSigned(std::vector<unsigned char>& out, khronos_int64_t value)
+{
+    GLTracePutNumber(out, ((khronos_uint64_t) value << 1) ^ (khronos_uint64_t) (value >> 63));
+}
+
+inline void GLTracePutBytes(std::vector<unsigned char>& out, const void* data, size_t size)
+{
+    out.insert(out.end(), (const unsigned char*) data, (const unsigned char*) data + size);
+}
+
+// How a context reads pixels handed to texture uploads, as the traced
+// glPixelStorei and glBindBuffer calls set it.
+struct GLTraceUnpack
+{
+    GLint       alignment;
+    GLint       rowLength;
+    GLint       skipRows;
+    GLint       skipPixels;
+    GLuint      buffer;
+};
+
+// A buffer range mapped by glMapBufferRange.
+struct GLTraceMapping
+{
+    const void* pointer;
+    size_t      size;
+    bool        write;
+};
+
+// Payload of a call being recorded; those larger than GLTRACE_INLINE_BYTES
+// are hashed before the writer is taken.
+struct GLTracePendingPayload
+{
+    GLTracePayloadKind  kind;
+    const void*         data;
+    size_t              size;
+    khronos_uint64_t    hash;
+};
+
+// Buffers a call is recorded into, handed from one call to the next.
+struct GLTraceScratch
+{
+    std::vector<unsigned char>          args;
+    std::vector<unsigned char>          result;
+    std::vector<unsigned char>          extras;
+    std::vector<unsigned char>          strings;
+    std::vector<unsigned char>          mapped;
+    std::vector<GLTracePendingPayload>  payloads;
+};
+
+// Writes a trace. Calls are recorded with GLTraceCall, from any thread; the
+// writer serializes them in the order they return, and is only held while
+// one is written.
+class GLTraceWriter
+{
+public:
+    GLTraceWriter() : m_file(NULL), m_mutex(NULL), m_clientArrays(0), m_warned(0)
+    {
+    }
+
+    ~GLTraceWriter()
+    {
+        Close();
+    }
+
+    // Start a trace of the functions named, in the order of their numbers.
+    bool Open(const char* filename, const char* const* names, unsigned int count)
+    {
+        m_file = fopen(filename, "wb");
+        if(m_file == NULL)
+        {
+            return false;
+        }
+        if(!CreateNativeSemaphore(1, &m_mutex))
+        {
+            fclose(m_file);
+            m_file = NULL;
+            return false;
+        }
+        std::vector<unsigned char> header;
+        GLTracePutBytes(header, GLTRACE_MAGIC, strlen(GLTRACE_MAGIC));
+        GLTracePutNumber(header, count);
+        for(unsigned int i = 0; i < count; i++)
+        {
+            GLTracePutNumber(header, strlen(names[i]));
+            GLTracePutBytes(header, names[i], strlen(names[i]));
+        }
+        fwrite(&header[0], 1, header.size(), m_file);
+        return true;
+    }
+
+    // Finish the trace; no call may be recorded meanwhile.
+    void Close()
+    {
+        if(m_file == NULL)
+        {
+            return;
+        }
+        fclose(m_file);
+        DestroyNativeSemaphore(m_mutex);
+        m_file = NULL;
+        m_mutex = NULL;
+        m_blobs.clear();
+        m_threads.clear();
+        m_unpack.clear();
+        m_mapped.clear();
+        for(size_t i = 0; i < m_scratch.size(); i++)
+        {
+            delete m_scratch[i];
+        }
+        m_scratch.clear();
+        m_clientArrays = 0;
+        m_warned = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return m_file != NULL;
+    }
+
+    void EndFrame()
+    {
+        WaitNativeSemaphore(m_mutex);
+        fputc(GLTRACE_FRAME, m_file);
+        PostNativeSemaphore(m_mutex);
+    }
+
+private:
+    friend class GLTraceCall;
+
+    // Id of the blob with the bytes and their hash, written first if it is
+    // new.
+    unsigned int PutBlob(const void* data, size_t size, khronos_uint64_t hash)
+    {
+        std::pair<khronos_uint64_t, size_t> key(hash, size);
+        std::map<std::pair<khronos_uint64_t, size_t>, unsigned int>::iterator found = m_blobs.find(key);
+        if(found != m_blobs.end())
+        {
+            return found->second;
+        }
+        unsigned int id = (unsigned int) m_blobs.size();
+        m_blobs[key] = id;
+        std::vector<unsigned char> header;
+        header.push_back(GLTRACE_BLOB);
+        GLTracePutNumber(header, id);
+        GLTracePutNumber(header, size);
+        fwrite(&header[0], 1, header.size(), m_file);
+        fwrite(data, 1, size, m_file);
+        return id;
+    }
+
+    // Unpack state of a context, at its defaults until set; with the writer
+    // held.
+    GLTraceUnpack& GetUnpack(EGLContext context)
+    {
+        std::map<EGLContext, GLTraceUnpack>::iterator found = m_unpack.find(context);
+        if(found == m_unpack.end())
+        {
+            GLTraceUnpack defaults = { 4, 0, 0, 0, 0 };
+            found = m_unpack.insert(std::make_pair(context, defaults)).first;
+        }
+        return found->second;
+    }
+
+    GLTraceScratch* AcquireScratch()
+    {
+        WaitNativeSemaphore(m_mutex);
+        GLTraceScratch* scratch = NULL;
+        if(!m_scratch.empty())
+        {
+            scratch = m_scratch.back();
+            m_scratch.pop_back();
+        }
+        PostNativeSemaphore(m_mutex);
+        return (scratch != NULL) ? scratch : new GLTraceScratch;
+    }
+
+    unsigned int GetThread()
+    {
+        unsigned long id = GetNativeThreadId();
+        unsigned int thread = 0;
+        while(thread < m_threads.size() && m_threads[thread] != id)
+        {
+            thread++;
+        }
+        if(thread == m_threads.size())
+        {
+            m_threads.push_back(id);
+        }
+        return thread;
+    }
+
+    FILE*                       m_file;
+    NativeSemaphore             m_mutex;
+    // id of every blob by hash and size
+    std::map<std::pair<khronos_uint64_t, size_t>, unsigned int> m_blobs;
+    // native id of every thread that called
+    std::vector<unsigned long>  m_threads;
+    // unpack state by context
+    std::map<EGLContext, GLTraceUnpack> m_unpack;
+    // mapped buffer ranges by context and target
+    std::map<std::pair<EGLContext, GLenum>, GLTraceMapping> m_mapped;
+    // buffers of the calls not being recorded
+    std::vector<GLTraceScratch*> m_scratch;
+    // the call being written
+    std::vector<unsigned char>  m_record;
+    // set once a vertex attribute points to client memory
+    volatile unsigned int       m_clientArrays;
+    volatile unsigned int       m_warned;
+};
+
+// Records one call, written when it is destroyed. The wrapper of an entry
+// point describes the data its pointer arguments hand in (Blob, String, ...),
+// passes its arguments to Arguments(), makes the call and returns through a
+// GLTraceResult, which records the result. The writer is only held while the
+// record is written, after the call returned; what the pointers hand in is
+// read then, except for mapped ranges, which are copied before the unmap.
+class GLTraceCall
+{
+public:
+    GLTraceCall(GLTraceWriter& writer, unsigned int function) :
+        m_writer(writer), m_scratch(writer.AcquireScratch()), m_function(function), m_numArgs(0), m_numExtras(0),
+        m_numKeys(0), m_numOutputs(0), m_resultValue(0), m_configs(NULL), m_numConfigs(NULL),
+        m_surfaceDisplay(EGL_NO_DISPLAY), m_surface(false), m_mapTarget(0), m_mapSize(0), m_mapWrite(false)
+    {
+        m_scratch->args.clear();
+        m_scratch->result.clear();
+        m_scratch->extras.clear();
+        m_scratch->payloads.clear();
+    }
+
+    ~GLTraceCall()
+    {
+        GLTraceWriter& w = m_writer;
+        GLTraceScratch& s = *m_scratch;
+        if(m_configs != NULL && m_numConfigs != NULL)
+        {
+            s.extras.push_back(GLTRACE_CONFIGS);
+            GLTracePutNumber(s.extras, *m_numConfigs);
+            for(EGLint i = 0; i < *m_numConfigs; i++)
+            {
+                GLTracePutNumber(s.extras, (size_t) m_configs[i]);
+            }
+            m_numExtras++;
+        }
+        if(m_surface)
+        {
+            EGLint width = 0;
+            EGLint height = 0;
+            eglQuerySurface(m_surfaceDisplay, (EGLSurface) (size_t) m_resultValue, EGL_WIDTH, &width);
+            eglQuerySurface(m_surfaceDisplay, (EGLSurface) (size_t) m_resultValue, EGL_HEIGHT, &height);
+            s.extras.push_back(GLTRACE_SURFACE_SIZE);
+            GLTracePutNumber(s.extras, width);
+            GLTracePutNumber(s.extras, height);
+            m_numExtras++;
+        }
+        if(s.result.empty())
+        {
+            s.result.push_back(GLTRACE_VOID);
+        }
+        for(size_t i = 0; i < s.payloads.size(); i++)
+        {
+            GLTracePendingPayload& p = s.payloads[i];
+            p.hash = (p.kind != GLTRACE_NULL && p.size > GLTRACE_INLINE_BYTES) ? HashFNV1a(p.data, p.size) : 0;
+        }
+        EGLContext context = (m_mapTarget != 0) ? eglGetCurrentContext() : EGL_NO_CONTEXT;
+
+        WaitNativeSemaphore(w.m_mutex);
+        if(m_mapTarget != 0 && m_resultValue != 0)
+        {
+            GLTraceMapping mapping = { (const void*) (size_t) m_resultValue, m_mapSize, m_mapWrite };
+            w.m_mapped[std::make_pair(context, m_mapTarget)] = mapping;
+        }
+        std::vector<unsigned char>& out = w.m_record;
+        out.clear();
+        out.push_back(GLTRACE_CALL);
+        GLTracePutNumber(out, w.GetThread());
+        GLTracePutNumber(out, m_function);
+        GLTracePutNumber(out, m_numArgs);
+        GLTracePutBytes(out, s.args.empty() ? NULL : &s.args[0], s.args.size());
+        GLTracePutBytes(out, &s.result[0], s.result.size());
+        GLTracePutNumber(out, s.payloads.size());
+        for(size_t i = 0; i < s.payloads.size(); i++)
+        {
+            // blobs are written ahead of the call
+            const GLTracePendingPayload& p = s.payloads[i];
+            GLTracePutNumber(out, p.kind);
+            if(p.kind != GLTRACE_NULL && p.size <= GLTRACE_INLINE_BYTES)
+            {
+                GLTracePutNumber(out, 0);
+                GLTracePutNumber(out, p.size);
+                GLTracePutBytes(out, p.data, p.size);
+            }
+            else if(p.kind != GLTRACE_NULL)
+            {
+                GLTracePutNumber(out, 1);
+                GLTracePutNumber(out, w.PutBlob(p.data, p.size, p.hash));
+            }
+        }
+        GLTracePutNumber(out, m_numExtras);
+        GLTracePutBytes(out, s.extras.empty() ? NULL : &s.extras[0], s.extras.size());
+        fwrite(&out[0], 1, out.size(), w.m_file);
+        w.m_scratch.push_back(m_scratch);
+        PostNativeSemaphore(w.m_mutex);
+    }
+
+    GLTraceCall& NoData()
+    {
+        return *this;
+    }
+
+    // Bytes an argument points to.
+    GLTraceCall& Blob(const void* data, khronos_int64_t size)
+    {
+        if(data != NULL && size > 0)
+        {
+            AddPayload(data, GLTRACE_DATA, data, (size_t) size);
+        }
+        return *this;
+    }
+
+    GLTraceCall& String(const char* s)
+    {
+        return Blob(s, (s != NULL) ? strlen(s) + 1 : 0);
+    }
+
+    // Strings of glShaderSource, replayed NUL terminated without lengths.
+    GLTraceCall& Strings(GLsizei count, const GLchar* const* strings, const GLint* lengths)
+    {
+        std::vector<unsigned char>& text = m_scratch->strings;
+        text.clear();
+        for(GLsizei i = 0; strings != NULL && i < count; i++)
+        {
+            size_t length = (lengths != NULL && lengths[i] >= 0) ? (size_t) lengths[i] : strlen(strings[i]);
+            GLTracePutBytes(text, strings[i], length);
+            text.push_back('\0');
+        }
+        if(!text.empty())
+        {
+            AddPayload(strings, GLTRACE_STRINGS, &text[0], text.size());
+        }
+        if(lengths != NULL)
+        {
+            AddPayload(lengths, GLTRACE_NULL, NULL, 0);
+        }
+        return *this;
+    }
+
+    // EGL attributes up to EGL_NONE.
+    GLTraceCall& AttribList(const EGLint* attribs)
+    {
+        size_t count = 0;
+        while(attribs != NULL && attribs[count] != EGL_NONE)
+        {
+            count += 2;
+        }
+        return Blob(attribs, (attribs != NULL) ? (count + 1) * sizeof(EGLint) : 0);
+    }
+
+    // Pixels of a texture upload, as far as the unpack state has the call
+    // read them: rows of the row length, padded to the alignment, from the
+    // skipped rows and pixels on. From a pixel unpack buffer, pixels is an
+    // offset and recorded as one. Images of 3D textures are taken as one of
+    // height times depth rows.
+    GLTraceCall& Image(GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels)
+    {
+        EGLContext context = eglGetCurrentContext();
+        WaitNativeSemaphore(m_writer.m_mutex);
+        GLTraceUnpack unpack = m_writer.GetUnpack(context);
+        PostNativeSemaphore(m_writer.m_mutex);
+        if(unpack.buffer != 0 || pixels == NULL || width <= 0 || height <= 0)
+        {
+            return *this;
+        }
+        size_t pixel = GLTraceGetPixelSize(format, type);
+        size_t length = (unpack.rowLength > 0) ? (size_t) unpack.rowLength : (size_t) width;
+        size_t alignment = (unpack.alignment > 0) ? (size_t) unpack.alignment : 1;
+        size_t pitch = (length * pixel + alignment - 1) / alignment * alignment;
+        size_t last = ((size_t) unpack.skipPixels + width) * pixel;
+        return Blob(pixels, pitch * ((size_t) unpack.skipRows + height - 1) + last);
+    }
+
+    // Unpack state set by glPixelStorei.
+    GLTraceCall& PixelStore(GLenum pname, GLint param)
+    {
+        EGLContext context = eglGetCurrentContext();
+        WaitNativeSemaphore(m_writer.m_mutex);
+        GLTraceUnpack& unpack = m_writer.GetUnpack(context);
+        unpack.alignment = (pname == GL_UNPACK_ALIGNMENT) ? param : unpack.alignment;
+        unpack.rowLength = (pname == GL_UNPACK_ROW_LENGTH_EXT) ? param : unpack.rowLength;
+        unpack.skipRows = (pname == GL_UNPACK_SKIP_ROWS_EXT) ? param : unpack.skipRows;
+        unpack.skipPixels = (pname == GL_UNPACK_SKIP_PIXELS_EXT) ? param : unpack.skipPixels;
+        PostNativeSemaphore(m_writer.m_mutex);
+        return *this;
+    }
+
+    // Binding of the pixel unpack buffer, the others are read back when
+    // needed.
+    GLTraceCall& BindBuffer(GLenum target, GLuint buffer)
+    {
+        if(target == GL_PIXEL_UNPACK_BUFFER)
+        {
+            EGLContext context = eglGetCurrentContext();
+            WaitNativeSemaphore(m_writer.m_mutex);
+            m_writer.GetUnpack(context).buffer = buffer;
+            PostNativeSemaphore(m_writer.m_mutex);
+        }
+        return *this;
+    }
+
+    // Range mapped by glMapBufferRange, remembered once the call returned
+    // the pointer.
+    GLTraceCall& MapRange(GLenum target, GLsizeiptr length, GLbitfield access)
+    {
+        m_mapTarget = target;
+        m_mapSize = (length > 0) ? (size_t) length : 0;
+        m_mapWrite = (access & GL_MAP_WRITE_BIT_EXT) != 0;
+        return *this;
+    }
+
+    // What was written into the range mapped on target, copied before
+    // glUnmapBuffer makes it invalid.
+    GLTraceCall& Unmap(GLenum target)
+    {
+        GLTraceMapping mapping = { NULL, 0, false };
+        std::pair<EGLContext, GLenum> key(eglGetCurrentContext(), target);
+        WaitNativeSemaphore(m_writer.m_mutex);
+        std::map<std::pair<EGLContext, GLenum>, GLTraceMapping>::iterator found = m_writer.m_mapped.find(key);
+        if(found != m_writer.m_mapped.end())
+        {
+            mapping = found->second;
+            m_writer.m_mapped.erase(found);
+        }
+        PostNativeSemaphore(m_writer.m_mutex);
+        if(mapping.write && mapping.pointer != NULL && mapping.size > 0)
+        {
+            std::vector<unsigned char>& copy = m_scratch->mapped;
+            copy.assign((const unsigned char*) mapping.pointer, (const unsigned char*) mapping.pointer + mapping.size);
+            AddPayload(NULL, GLTRACE_DATA, &copy[0], copy.size());
+        }
+        return *this;
+    }
+
+    // Vertex attribute pointer; one not in a buffer object is client memory,
+    // which the draws then capture.
+    GLTraceCall& Pointer(const GLvoid* pointer)
+    {
+        GLint buffer = 0;
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &buffer);
+        if(buffer == 0 && pointer != NULL)
+        {
+            AtomicStoreRelease(&m_writer.m_clientArrays, 1);
+        }
+        return *this;
+    }
+
+    // Draw of vertices 0 to count - 1.
+    GLTraceCall& Arrays(GLsizei count)
+    {
+        if(AtomicLoadAcquire(&m_writer.m_clientArrays))
+        {
+            ClientArrays(count);
+        }
+        return *this;
+    }
+
+    // Indexed draw; client-side indices are captured, and bound the client
+    // arrays read.
+    GLTraceCall& Elements(GLsizei count, GLenum type, const GLvoid* indices)
+    {
+        GLint buffer = 0;
+        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &buffer);
+        if(buffer != 0 || indices == NULL)
+        {
+            // indices in a buffer object cannot be read back
+            if(AtomicLoadAcquire(&m_writer.m_clientArrays))
+            {
+                ClientArrays(-1);
+            }
+            return *this;
+        }
+        GLsizei size = GLTraceGetTypeSize(type);
+        Blob(indices, (khronos_int64_t) count * size);
+        if(AtomicLoadAcquire(&m_writer.m_clientArrays))
+        {
+            unsigned int vertices = 0;
+            for(GLsizei i = 0; i < count; i++)
+            {
+                unsigned int index = (size == 1) ? ((const GLubyte*) indices)[i] :
+                                     (size == 2) ? ((const GLushort*) indices)[i] : ((const GLuint*) indices)[i];
+                vertices = (index + 1 > vertices) ? index + 1 : vertices;
+            }
+            ClientArrays(vertices);
+        }
+        return *this;
+    }
+
+    // Memory the call writes, of size bytes.
+    GLTraceCall& Output(const void* pointer, khronos_int64_t size)
+    {
+        if(m_numOutputs < MAX_KEYS && size > 0)
+        {
+            m_outputs[m_numOutputs] = pointer;
+            m_outputSizes[m_numOutputs] = (size_t) size;
+            m_numOutputs++;
+        }
+        return *this;
+    }
+
+    // Configs returned by eglChooseConfig or eglGetConfigs.
+    GLTraceCall& Configs(EGLConfig* configs, EGLint* numConfigs)
+    {
+        m_configs = configs;
+        m_numConfigs = numConfigs;
+        return *this;
+    }
+
+    // Window or pixmap surface created on a display; its size is recorded.
+    GLTraceCall& Surface(EGLDisplay display)
+    {
+        m_surfaceDisplay = display;
+        m_surface = true;
+        return *this;
+    }
+
+    void Arguments()
+    {
+    }
+
+    template<class A0>
+    void Arguments(A0 a0)
+    {
+        Arg(a0);
+    }
+
+    template<class A0, class A1>
+    void Arguments(A0 a0, A1 a1)
+    {
+        Arg(a0);
+        Arg(a1);
+    }
+
+    template<class A0, class A1, class A2>
+    void Arguments(A0 a0, A1 a1, A2 a2)
+    {
+        Arguments(a0, a1);
+        Arg(a2);
+    }
+
+    template<class A0, class A1, class A2, class A3>
+    void Arguments(A0 a0, A1 a1, A2 a2, A3 a3)
+    {
+        Arguments(a0, a1, a2);
+        Arg(a3);
+    }
+
+    template<class A0, class A1, class A2, class A3, class A4>
+    void Arguments(A0 a0, A1 a1, A2 a2, A3 a3, A4 a4)
+    {
+        Arguments(a0, a1, a2, a3);
+        Arg(a4);
+    }
+
+    template<class A0, class A1, class A2, class A3, class A4, class A5>
+    void Arguments(A0 a0, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
+    {
+        Arguments(a0, a1, a2, a3, a4);
+        Arg(a5);
+    }
+
+    template<class A0, class A1, class A2, class A3, class A4, class A5, class A6>
+    void Arguments(A0 a0, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
+    {
+        Arguments(a0, a1, a2, a3, a4, a5);
+        Arg(a6);
+    }
+
+    template<class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+    void Arguments(A0 a0, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
+    {
+        Arguments(a0, a1, a2, a3, a4, a5, a6);
+        Arg(a7);
+    }
+
+    template<class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+    void Arguments(A0 a0, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
+    {
+        Arguments(a0, a1, a2, a3, a4, a5, a6, a7);
+        Arg(a8);
+    }
+
+    template<class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+    void Arguments(A0 a0, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
+    {
+        Arguments(a0, a1, a2, a3, a4, a5, a6, a7, a8);
+        Arg(a9);
+    }
+
+    template<class A0, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9,
+             class A10>
+    void Arguments(A0 a0, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
+    {
+        Arguments(a0, a1, a2, a3, a4, a5, a6, a7, a8, a9);
+        Arg(a10);
+    }
+
+    template<class T>
+    void SetResult(const T& value)
+    {
+        PutValue(m_scratch->result, value);
+        m_resultValue = ToNumber(value);
+    }
+
+private:
+    enum { MAX_KEYS = 4 };
+
+    GLTraceCall(const GLTraceCall&);
+    GLTraceCall& operator=(const GLTraceCall&);
+
+    template<class T>
+    static khronos_uint64_t ToNumber(T value)
+    {
+        return (khronos_uint64_t) value;
+    }
+
+    template<class T>
+    static khronos_uint64_t ToNumber(T* value)
+    {
+        return (khronos_uint64_t) (size_t) value;
+    }
+
+    template<class T>
+    static void PutValue(std::vector<unsigned char>& out, T value)
+    {
+        out.push_back(GLTRACE_INTEGER);
+        GLTracePutSigned(out, (khronos_int64_t) value);
+    }
+
+    static void PutValue(std::vector<unsigned char>& out, float value)
+    {
+        out.push_back(GLTRACE_FLOAT);
+        GLTracePutBytes(out, &value, sizeof(value));
+    }
+
+    template<class T>
+    static void PutValue(std::vector<unsigned char>& out, T* value)
+    {
+        out.push_back(GLTRACE_POINTER);
+        GLTracePutNumber(out, (size_t) value);
+    }
+
+    template<class T>
+    void Arg(T value)
+    {
+        PutValue(m_scratch->args, value);
+        m_numArgs++;
+    }
+
+    // Input: a payload, or a pointer kept by its value, such as an offset
+    // into a buffer object.
+    template<class T>
+    void Arg(const T* pointer)
+    {
+        if(!PutPayload(pointer))
+        {
+            PutValue(m_scratch->args, pointer);
+            m_numArgs++;
+        }
+    }
+
+    // Output, of the size given to Output() if any; or a payload, for
+    // inputs declared without const such as the rectangles of
+    // eglSwapBuffersWithDamageEXT.
+    template<class T>
+    void Arg(T* pointer)
+    {
+        if(!PutPayload(pointer))
+        {
+            PutOutput(pointer, true);
+        }
+    }
+
+    // The argument as the payload it is the key of, if any.
+    bool PutPayload(const void* pointer)
+    {
+        unsigned int key = 0;
+        while(key < m_numKeys && (pointer == NULL || m_keys[key] != pointer))
+        {
+            key++;
+        }
+        if(key == m_numKeys)
+        {
+            return false;
+        }
+        m_scratch->args.push_back(GLTRACE_PAYLOAD);
+        GLTracePutNumber(m_scratch->args, m_keyPayloads[key]);
+        m_numArgs++;
+        return true;
+    }
+
+    // EGL handles are void pointers too; they are kept by their value
+    // unless given to Output().
+    void Arg(void* pointer)
+    {
+        PutOutput(pointer, false);
+    }
+
+    void PutOutput(void* pointer, bool output)
+    {
+        size_t size = 0;
+        for(unsigned int i = 0; i < m_numOutputs; i++)
+        {
+            output = output || m_outputs[i] == (const void*) pointer;
+            size = (m_outputs[i] == (const void*) pointer) ? m_outputSizes[i] : size;
+        }
+        if(pointer == NULL || !output)
+        {
+            PutValue(m_scratch->args, pointer);
+        }
+        else
+        {
+            m_scratch->args.push_back(GLTRACE_OUTPUT);
+            GLTracePutNumber(m_scratch->args, size);
+        }
+        m_numArgs++;
+    }
+
+    // Add a payload, which the argument equal to key, if not NULL, refers
+    // to.
+    unsigned int AddPayload(const void* key, GLTracePayloadKind kind, const void* data, size_t size)
+    {
+        GLTracePendingPayload payload = { kind, data, size, 0 };
+        unsigned int index = (unsigned int) m_scratch->payloads.size();
+        m_scratch->payloads.push_back(payload);
+        if(key != NULL && m_numKeys < MAX_KEYS)
+        {
+            m_keys[m_numKeys] = key;
+            m_keyPayloads[m_numKeys] = index;
+            m_numKeys++;
+        }
+        return index;
+    }
+
+    // The enabled attributes in client memory, for a draw of vertices 0 to
+    // vertices - 1; -1 when the count is unknown.
+    void ClientArrays(int vertices)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &count);
+        for(GLint i = 0; i < count; i++)
+        {
+            GLint enabled = 0;
+            GLint buffer = 0;
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+            if(!enabled || buffer != 0)
+            {
+                continue;
+            }
+            if(vertices < 0)
+            {
+                if(AtomicAdd(&m_writer.m_warned, 1) == 0)
+                {
+                    printf("Client-side vertex arrays drawn with indices in a buffer object are not traced.\n");
+                }
+                continue;
+            }
+            GLint size = 0;
+            GLint type = 0;
+            GLint normalized = 0;
+            GLint stride = 0;
+            GLvoid* pointer = NULL;
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &normalized);
+            glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &stride);
+            glGetVertexAttribPointerv(i, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+            size_t element = size * GLTraceGetTypeSize(type);
+            size_t bytes = (vertices > 0) ? (vertices - 1) * ((stride > 0) ? stride : element) + element : 0;
+            if(pointer == NULL || bytes == 0)
+            {
+                continue;
+            }
+            unsigned int payload = AddPayload(NULL, GLTRACE_DATA, pointer, bytes);
+            std::vector<unsigned char>& out = m_scratch->extras;
+            out.push_back(GLTRACE_CLIENT_ARRAY);
+            GLTracePutNumber(out, i);
+            GLTracePutNumber(out, size);
+            GLTracePutNumber(out, type);
+            GLTracePutNumber(out, normalized);
+            GLTracePutNumber(out, stride);
+            GLTracePutNumber(out, payload);
+            m_numExtras++;
+        }
+    }
+
+    GLTraceWriter&      m_writer;
+    GLTraceScratch*     m_scratch;
+    unsigned int        m_function;
+    unsigned int        m_numArgs;
+    unsigned int        m_numExtras;
+    // pointer arguments with a payload
+    const void*         m_keys[MAX_KEYS];
+    unsigned int        m_keyPayloads[MAX_KEYS];
+    unsigned int        m_numKeys;
+    const void*         m_outputs[MAX_KEYS];
+    size_t              m_outputSizes[MAX_KEYS];
+    unsigned int        m_numOutputs;
+    khronos_uint64_t    m_resultValue;
+    EGLConfig*          m_configs;
+    EGLint*             m_numConfigs;
+    EGLDisplay          m_surfaceDisplay;
+    bool                m_surface;
+    // range mapped by the call
+    GLenum              m_mapTarget;
+    size_t              m_mapSize;
+    bool                m_mapWrite;
+};
+
+// Result of a call recorded by a GLTraceCall. In
+//
+//   (call(...), GLTraceResult(record)).Get((ReturnType*) NULL)
+//
+// the comma operator below records what a call returns and Get() hands it
+// on; for calls returning void the built-in comma operator applies and
+// Get() returns nothing.
+class GLTraceResult
+{
+public:
+    explicit GLTraceResult(GLTraceCall& call) : m_call(&call)
+    {
+        memset(m_value, 0, sizeof(m_value));
+    }
+
+    template<class T>
+    void Set(const T& value)
+    {
+        m_call->SetResult(value);
+        memcpy(m_value, &value, sizeof(T));
+    }
+
+    void Get(void*) const
+    {
+    }
+
+    template<class T>
+    T Get(T*) const
+    {
+        T value;
+        memcpy(&value, m_value, sizeof(T));
+        return value;
+    }
+
+private:
+    GLTraceCall*    m_call;
+    unsigned char   m_value[sizeof(khronos_uint64_t)];
+};
+
+template<class T>
+inline GLTraceResult operator,(const T& value, GLTraceResult result)
+{
+    result.Set(value);
+    return result;
+}
+
+// An argument or result read from a trace. integer holds integers, pointer
+// values, the bytes of outputs and the number of payloads.
+struct GLTraceValue
+{
+    unsigned char       tag;
+    khronos_int64_t     integer;
+    float               real;
+};
+
+struct GLTracePayload
+{
+    GLTracePayloadKind      kind;
+    const unsigned char*    data;
+    size_t                  size;
+};
+
+struct GLTraceClientArray
+{
+    GLuint          index;
+    GLint           size;
+    GLenum          type;
+    GLboolean       normalized;
+    GLsizei         stride;
+    unsigned int    payload;
+};
+
+struct GLTraceRecord
+{
+    unsigned char                       tag;        // GLTRACE_CALL or GLTRACE_FRAME
+    unsigned int                        thread;
+    unsigned int                        function;
+    std::vector<GLTraceValue>           args;
+    GLTraceValue                        result;
+    std::vector<GLTracePayload>         payloads;
+    std::vector<GLTraceClientArray>     arrays;
+    std::vector<khronos_uint64_t>       configs;
+    bool                                hasConfigs;
+    EGLint                              width;      // of a window surface
+    EGLint                              height;
+};
+
+// Reads a trace from memory, such as a file mapped with MapNativeFile.
+// Payloads point into that memory.
+class GLTraceReader
+{
+public:
+    GLTraceReader() : m_data(NULL), m_size(0), m_pos(0)
+    {
+    }
+
+    bool Open(const void* data, size_t size)
+    {
+        m_data = (const unsigned char*) data;
+        m_size = size;
+        m_pos = strlen(GLTRACE_MAGIC);
+        m_names.clear();
+        m_blobs.clear();
+        khronos_uint64_t count = 0;
+        if(size < m_pos || memcmp(data, GLTRACE_MAGIC, m_pos) != 0 || !GetNumber(count))
+        {
+            return false;
+        }
+        for(khronos_uint64_t i = 0; i < count; i++)
+        {
+            khronos_uint64_t length = 0;
+            const unsigned char* name = NULL;
+            if(!GetNumber(length) || !GetBytes(length, name))
+            {
+                return false;
+            }
+            m_names.push_back(std::string((const char*) name, (size_t) length));
+        }
+        return true;
+    }
+
+    const std::vector<std::string>& GetFunctionNames() const
+    {
+        return m_names;
+    }
+
+    // The next call or end of frame. False at the end of the trace, or at a
+    // record cut short, such as the last one of a process that crashed.
+    bool Next(GLTraceRecord& record)
+    {
+        while(m_pos < m_size && m_data[m_pos] == GLTRACE_BLOB)
+        {
+            m_pos++;
+            khronos_uint64_t id = 0;
+            khronos_uint64_t size = 0;
+            const unsigned char* bytes = NULL;
+            if(!GetNumber(id) || id != m_blobs.size() || !GetNumber(size) || !GetBytes(size, bytes))
+            {
+                return false;
+            }
+            m_blobs.push_back(std::make_pair(bytes, (size_t) size));
+        }
+        if(m_pos >= m_size)
+        {
+            return false;
+        }
+        record.tag = m_data[m_pos++];
+        record.args.clear();
+        record.payloads.clear();
+        record.arrays.clear();
+        record.configs.clear();
+        record.hasConfigs = false;
+        record.width = 0;
+        record.height = 0;
+        if(record.tag == GLTRACE_FRAME)
+        {
+            return true;
+        }
+        khronos_uint64_t thread = 0;
+        khronos_uint64_t function = 0;
+        khronos_uint64_t count = 0;
+        if(record.tag != GLTRACE_CALL || !GetNumber(thread) || !GetNumber(function) || !GetNumber(count))
+        {
+            return false;
+        }
+        record.thread = (unsigned int) thread;
+        record.function = (unsigned int) function;
+        record.args.resize((size_t) count);
+        for(size_t i = 0; i < record.args.size(); i++)
+        {
+            if(!GetValue(record.args[i]))
+            {
+                return false;
+            }
+        }
+        if(!GetValue(record.result) || !GetNumber(count))
+        {
+            return false;
+        }
+        for(khronos_uint64_t i = 0; i < count; i++)
+        {
+            GLTracePayload payload = { GLTRACE_NULL, NULL, 0 };
+            khronos_uint64_t kind = 0;
+            khronos_uint64_t stored = 0;
+            khronos_uint64_t value = 0;
+            if(!GetNumber(kind))
+            {
+                return false;
+            }
+            payload.kind = (GLTracePayloadKind) kind;
+            if(payload.kind != GLTRACE_NULL)
+            {
+                if(!GetNumber(stored) || !GetNumber(value))
+                {
+                    return false;
+                }
+                if(stored == 0)
+                {
+                    payload.size = (size_t) value;
+                    if(!GetBytes(value, payload.data))
+                    {
+                        return false;
+                    }
+                }
+                else if(value < m_blobs.size())
+                {
+                    payload.data = m_blobs[(size_t) value].first;
+                    payload.size = m_blobs[(size_t) value].second;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            record.payloads.push_back(payload);
+        }
+        if(!GetNumber(count))
+        {
+            return false;
+        }
+        for(khronos_uint64_t i = 0; i < count; i++)
+        {
+            if(!GetExtra(record))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    bool GetNumber(khronos_uint64_t& value)
+    {
+        value = 0;
+        for(int shift = 0; m_pos < m_size && shift < 64; shift += 7)
+        {
+            unsigned char byte = m_data[m_pos++];
+            value |= (khronos_uint64_t) (byte & 0x7f) << shift;
+            if(!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool GetBytes(khronos_uint64_t size, const unsigned char*& bytes)
+    {
+        if(size > m_size - m_pos)
+        {
+            return false;
+        }
+        bytes = m_data + m_pos;
+        m_pos += (size_t) size;
+        return true;
+    }
+
+    bool GetValue(GLTraceValue& value)
+    {
+        khronos_uint64_t number = 0;
+        const unsigned char* bytes = NULL;
+        value.integer = 0;
+        value.real = 0.0f;
+        if(m_pos >= m_size)
+        {
+            return false;
+        }
+        value.tag = m_data[m_pos++];
+        switch(value.tag)
+        {
+        case GLTRACE_INTEGER:
+            if(!GetNumber(number))
+            {
+                return false;
+            }
+            value.integer = (khronos_int64_t) (number >> 1) ^ -(khronos_int64_t) (number & 1);
+            return true;
+        case GLTRACE_FLOAT:
+            if(!GetBytes(sizeof(float), bytes))
+            {
+                return false;
+            }
+            memcpy(&value.real, bytes, sizeof(float));
+            return true;
+        case GLTRACE_POINTER:
+        case GLTRACE_OUTPUT:
+        case GLTRACE_PAYLOAD:
+            if(!GetNumber(number))
+            {
+                return false;
+            }
+            value.integer = (khronos_int64_t) number;
+            return true;
+        case GLTRACE_VOID:
+            return true;
+        }
+        return false;
+    }
+
+    bool GetExtra(GLTraceRecord& record)
+    {
+        if(m_pos >= m_size)
+        {
+            return false;
+        }
+        unsigned char tag = m_data[m_pos++];
+        khronos_uint64_t values[6];
+        if(tag == GLTRACE_CLIENT_ARRAY)
+        {
+            for(int i = 0; i < 6; i++)
+            {
+                if(!GetNumber(values[i]))
+                {
+                    return false;
+                }
+            }
+            GLTraceClientArray a = { (GLuint) values[0], (GLint) values[1], (GLenum) values[2], (GLboolean) values[3],
+                                     (GLsizei) values[4], (unsigned int) values[5] };
+            record.arrays.push_back(a);
+            return a.payload < record.payloads.size();
+        }
+        if(tag == GLTRACE_CONFIGS)
+        {
+            if(!GetNumber(values[0]))
+            {
+                return false;
+            }
+            record.hasConfigs = true;
+            for(khronos_uint64_t i = 0; i < values[0]; i++)
+            {
+                if(!GetNumber(values[1]))
+                {
+                    return false;
+                }
+                record.configs.push_back(values[1]);
+            }
+            return true;
+        }
+        if(tag == GLTRACE_SURFACE_SIZE)
+        {
+            if(!GetNumber(values[0]) || !GetNumber(values[1]))
+            {
+                return false;
+            }
+            record.width = (EGLint) values[0];
+            record.height = (EGLint) values[1];
+            return true;
+        }
+        return false;
+    }
+
+    const unsigned char*        m_data;
+    size_t                      m_size;
+    size_t                      m_pos;
+    std::vector<std::string>    m_names;
+    // data and size of every blob read so far, by id
+    std::vector<std::pair<const unsigned char*, size_t> > m_blobs;
+};
+
+#endif // __GLTRACE_H__
@@ -0,0 +1,22 @@
+#ifndef __HASHUTIL_H__
+#define __HASHUTIL_H__
+
+#include <KHR/khrplatform.h>
+
+#include <cstddef>
+
+const khronos_uint64_t FNV1A_OFFSET = 14695981039346656037ULL;
+
+// 64 bit FNV-1a of some bytes. Passing the hash of earlier bytes as the
+// start hashes their concatenation.
+inline khronos_uint64_t HashFNV1a(const void* data, size_t size, khronos_uint64_t hash = FNV1A_OFFSET)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+#endif // __HASHUTIL_H__
@@ -0,0 +1,84 @@
+#ifndef __LOD_H__
+#define __LOD_H__
+
+#include "vecmath.h"
+
+#include <cfloat>
+#include <cmath>
+
+// Picks a detail level for an SBObject from its projected screen size.
+//
+// The level drops by one every time the projected diameter halves below the
+// full detail size. A small hysteresis band keeps objects hovering around a
+// threshold from popping between levels every frame.
+class LODSelector
+{
+public:
+    LODSelector() : m_fullDetailSize(0.0f), m_hysteresis(0.15f), m_level(0)
+    {}
+
+    // Projected diameter in pixels at or above which level 0 is used.
+    // Zero disables LOD selection.
+    void SetFullDetailSize(float pixels)
+    {
+        m_fullDetailSize = pixels;
+    }
+
+    float GetFullDetailSize() const
+    {
+        return m_fullDetailSize;
+    }
+
+    unsigned int GetLevel() const
+    {
+        return m_level;
+    }
+
+    // Diameter in pixels of a sphere of the given radius at the given eye
+    // distance, using the projection built by mat4::perspective.
+    static float ProjectedDiameter(const mat4& proj, float viewportHeight, float radius, float distance)
+    {
+        if(distance <= radius)
+        {
+            return FLT_MAX;
+        }
+        // proj.y.y is cot(fovY/2); the sphere covers 2r/d * cot of the
+        // [-1,1] clip range, or r/d * cot * height pixels
+        return radius * proj.y.y / distance * viewportHeight;
+    }
+
+    unsigned int Select(float projectedSize, unsigned int numLevels)
+    {
+        if(m_fullDetailSize <= 0.0f || numLevels <= 1)
+        {
+            m_level = 0;
+            return m_level;
+        }
+        float ideal = 0.0f;
+        if(projectedSize <= 0.0f)
+        {
+            ideal = (float) numLevels;
+        }
+        else if(projectedSize < m_fullDetailSize)
+        {
+            ideal = logf(m_fullDetailSize / projectedSize) / logf(2.0f);
+        }
+        if(ideal > m_level + 1 + m_hysteresis || ideal < m_level - m_hysteresis)
+        {
+            unsigned int level = (unsigned int) ideal;
+            m_level = (level < numLevels) ? level : numLevels - 1;
+        }
+        else if(m_level >= numLevels)
+        {
+            m_level = numLevels - 1;
+        }
+        return m_level;
+    }
+
+private:
+    float           m_fullDetailSize;
+    float           m_hysteresis;
+    unsigned int    m_level;
+};
+
+#endif // __LOD_H__
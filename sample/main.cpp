@@ -1,8 +1,31 @@
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
 
+// ahead of the other helpers, so their GL calls are intercepted too
+#include "glintercept.h"
+
+#include "bmp.h"
+#include "batch.h"
+#include "blobcache.h"
+#include "commandlist.h"
+#include "damage.h"
+#include "gldebug.h"
+#include "framepacer.h"
+#include "lod.h"
+#include "meshsimplify.h"
+#include "msaa.h"
 #include "nativewin.h"
+#include "nativethread.h"
+#include "occlusion.h"
+#include "permutation.h"
+#include "prepass.h"
+#include "renderpass.h"
 #include "sbm.h"
+#include "shadercompiler.h"
+#include "softocclusion.h"
+#include "spscqueue.h"
+#include "texarray.h"
+#include "texstream.h"
 #include "vecmath.h"
 
 #include <iostream>
@@ -10,14 +33,17 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <vector>
 
-class RenderState 
+// GL program of the sample and its attribute and uniform locations
+class ProgramState
 {
 public:
-    RenderState() : po(0), vertLoc(0), mvpLoc(0), normalLoc(0), texcoordLoc(0), texUnitLoc(0)
+    ProgramState() : po(0), vertLoc(0), mvpLoc(0), lightLoc(0), normalLoc(0), texcoordLoc(0), texUnitLoc(0),
+        layerLoc(-1), depthPo(0), depthVertLoc(0), depthMvpLoc(0), job(-1)
     {}
-    ~RenderState() {}
 
     GLint po;
     GLint vertLoc;
@@ -26,175 +52,451 @@ public:
     GLint normalLoc;
     GLint texcoordLoc;
     GLint texUnitLoc;
+    // layer of the texture array, -1 when drawing from a 2D texture
+    GLint layerLoc;
+
+    // position-only program of the depth pre-pass
+    GLint depthPo;
+    GLint depthVertLoc;
+    GLint depthMvpLoc;
+
+    // background link of the shading program while po is the placeholder,
+    // -1 once po is final
+    int   job;
+};
+
+class RenderState 
+{
+public:
+    RenderState() :
+        shadingVariant(-1), placeholderVariant(-1),
+        yaw(0), pitch(0), prevYaw(0), prevPitch(0), targetYaw(0), targetPitch(0), moving(false)
+    {}
+    ~RenderState() {}
+
+    ProgramState program;
+    // sources of the programs the materials reference, and the variants
+    // drawn with and drawn while the former links in the background
+    ShaderPermutations shaders;
+    int     shadingVariant;
+    int     placeholderVariant;
 
+    // camera state of the current and the previous simulation step, and
+    // the orientation the camera is easing towards
     GLfloat yaw;
     GLfloat pitch;
+    GLfloat prevYaw;
+    GLfloat prevPitch;
+    GLfloat targetYaw;
+    GLfloat targetPitch;
+    bool    moving;
 
     SBObject            ninja;
     GLuint              ninjaTex[1];
+    // uploads ninjaTex[0] over several frames when streaming
+    TextureStreamer     streamer;
+    // textures the instances pick their layer from, if loaded
+    TextureArray        textureArray;
+    // the instances merged into one model, if batched
+    StaticBatcher       batch;
+    // low-poly xyz triangle list of the model for CPU occlusion culling
+    std::vector<GLfloat> occluder;
+
+};
+
+class Options
+{
+public:
+    Options() : modelPath("./ninja/ninja.sbm"), texturePath("./ninja/ninjacomp.bmp"), textureLayers(NULL), lodPixels(0.0f),
+        targetFps(0.0f), tickRate(60.0f), swapInterval(-1), stats(false), continuous(false),
+        fullRedraw(false), threaded(false), parallel(false), numWindows(1), numPbuffers(0),
+        msaaSamples(0), prepass(DepthPrepassController::PREPASS_OFF), instances(1), occlusion(false), cpuOcclusion(false), batch(false),
+        uploadBudget(0), shaderThreads(0), blobCachePath(NULL), minifyShaders(false), glStats(false), tracePath(NULL)
+    {}
+
+    const char* modelPath;
+    const char* texturePath;
+    // comma separated textures of the array, NULL without one
+    const char* textureLayers;
+    float       lodPixels;
+    float       targetFps;
+    float       tickRate;
+    int         swapInterval;
+    bool        stats;
+    bool        continuous;
+    bool        fullRedraw;
+    bool        threaded;
+    bool        parallel;
+    int         numWindows;
+    int         numPbuffers;
+    int         msaaSamples;
+    DepthPrepassController::Mode prepass;
+    int         instances;
+    bool        occlusion;
+    bool        cpuOcclusion;
+    bool        batch;
+    // KB of texture uploaded per frame, 0 to load it before the first frame
+    int         uploadBudget;
+    // threads linking programs in the background, 0 to link them up front
+    int         shaderThreads;
+    // directory of the driver's shader binaries, NULL to not keep them
+    const char* blobCachePath;
+    bool        minifyShaders;
+    bool        glStats;
+    // file recording every GL and EGL call, NULL for none
+    const char* tracePath;
+};
 
+// reasons the window contents are out of date
+enum DirtyFlags
+{
+    DIRTY_VIEW   = 0x1,     // the camera moved
+    DIRTY_SIZE   = 0x2,     // the window was resized
+    DIRTY_EXPOSE = 0x4      // the window system discarded the contents
+};
+
+// One window or pbuffer surface the scene is presented on. All views share
+// the camera and the GL objects of the model; each looks at the model from
+// its own side and keeps its own size, damage history and, when views are
+// rendered in parallel, its own context and render thread.
+class SurfaceView
+{
+public:
+    enum { MAX_INSTANCES = 36 };
+
+    SurfaceView() :
+        nativeWin(0), eglSurface(EGL_NO_SURFACE), eglContext(EGL_NO_CONTEXT), pbuffer(false),
+        width(0), height(0), mouseX(0), mouseY(0), yawOffset(0),
+        dirty(DIRTY_VIEW | DIRTY_SIZE | DIRTY_EXPOSE),
+        program(0), viewportWidth(0), viewportHeight(0), scissored(false), boundTexture(0), targetsInit(false),
+        renderThread(0)
+    {}
+
+    EGLNativeWindowType nativeWin;
+    EGLSurface  eglSurface;
+    EGLContext  eglContext;
+    bool        pbuffer;
+
+    // main thread state
+    int         width;
+    int         height;
+    int         mouseX;
+    int         mouseY;
+    GLfloat     yawOffset;
+    // DirtyFlags accumulated since the last recorded frame
+    unsigned int dirty;
+    LODSelector lod[MAX_INSTANCES];
+    // window area covered by the models in the last recorded frame
+    DamageRect  ninjaRect;
+
+    // state of the thread executing the view's commands
+    ProgramState* program;
+    GLint       viewportWidth;
+    GLint       viewportHeight;
+    bool        scissored;
+    // texture bound to unit 0 since the view was bound, 0 if unknown
+    GLuint      boundTexture;
+    DamageTracker damage;
+    DamagePresenter presenter;
+    // pass drawing the frame, and the multisampled target it renders into
+    // when enabled
+    RenderPass  pass;
+    MultisampleTarget msaa;
+    bool        targetsInit;
+    // whether the view's draws use a depth pre-pass
+    DepthPrepassController prepass;
+    OcclusionCuller culler;
+
+    // Uniform values belong to the program object and are shared along
+    // with it, so views drawing concurrently each link their own copy.
+    ProgramState ownProgram;
+
+    // frames for the view's own render thread when rendering in parallel
+    BlockingSPSCQueue<CommandList, 2> frames;
+    NativeThread renderThread;
+    // presentation times flowing back to the main thread
+    SPSCQueue<FrameTiming, 16> timings;
 };
 
 class esContext
 {
 public:
+    enum { MAX_VIEWS = 8 };
+
     esContext() :
-        nativeDisplay(0), nativeWin(0),
-        eglDisplay(0), eglSurface(0), eglContext(0), 
-        nWindowWidth(0), nWindowHeight(0), nMouseX(0), nMouseY(0)
-    {}
+        nativeDisplay(0),
+        eglDisplay(0), eglConfig(0), eglContext(0),
+        numViews(0), renderThread(0)
+    {
+        contextAttribs[0] = EGL_NONE;
+    }
 
     ~esContext() {}
 
     EGLNativeDisplayType nativeDisplay;
-    EGLNativeWindowType nativeWin;
     EGLDisplay eglDisplay;
-    EGLSurface eglSurface;
+    EGLConfig  eglConfig;
+    // context that created the shared GL objects, and the attributes all
+    // contexts are created with, with room for the debug flag
     EGLContext eglContext;
+    EGLint     contextAttribs[5];
 
-    int         nWindowWidth;
-    int         nWindowHeight;
-    int         nMouseX;
-    int         nMouseY;
+    SurfaceView views[MAX_VIEWS];
+    int         numViews;
 
     RenderState rs;
+    Options     opts;
+    FrameScheduler sched;
+
+    // frames of all views recorded by the main thread for the single
+    // render thread, which presents the views round-robin
+    BlockingSPSCQueue<CommandList, 2> frames;
+    NativeThread renderThread;
+
+    // depth buffer the main thread culls recorded draws against
+    SoftwareOcclusionCuller softCuller;
+    // workers linking programs on contexts of their own
+    ShaderCompiler compiler;
+    // driver binaries kept across runs and processes
+    BlobCache   blobCache;
 };
 
 GLfloat vWhite[] = { 1.0, 1.0, 1.0, 1.0 };
 
-#pragma pack(1)
-struct RGB { 
-  GLbyte blue;
-  GLbyte green;
-  GLbyte red;
-  GLbyte alpha;
-};
+esContext ctx;
 
-struct BMPInfoHeader {
-  GLuint	size;
-  GLuint	width;
-  GLuint	height;
-  GLushort  planes;
-  GLushort  bits;
-  GLuint	compression;
-  GLuint	imageSize;
-  GLuint	xScale;
-  GLuint	yScale;
-  GLuint	colors;
-  GLuint	importantColors;
-};
+using namespace std;
 
-struct BMPHeader {
-  GLushort	type; 
-  GLuint	size; 
-  GLushort	unused; 
-  GLushort	unused2; 
-  GLuint	offset; 
-}; 
-
-struct BMPInfo {
-  BMPInfoHeader		header;
-  RGB				colors[1];
-};
+SurfaceView* FindView(EGLNativeWindowType nativewin)
+{
+    for(int i = 0; i < ctx.numViews; i++)
+    {
+        if(!ctx.views[i].pbuffer && ctx.views[i].nativeWin == nativewin)
+        {
+            return &ctx.views[i];
+        }
+    }
+    return NULL;
+}
 
-#pragma pack(8)
+void MarkViewsDirty(unsigned int flags)
+{
+    for(int i = 0; i < ctx.numViews; i++)
+    {
+        ctx.views[i].dirty |= flags;
+    }
+}
 
-esContext ctx;
+bool AnyViewDirty()
+{
+    for(int i = 0; i < ctx.numViews; i++)
+    {
+        if(ctx.views[i].dirty != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
-using namespace std;
+void OnNativeWinResize(EGLNativeWindowType nativewin, int width, int height)
+{
+    SurfaceView* view = FindView(nativewin);
+    if(view == NULL)
+    {
+        return;
+    }
+    view->width = width;
+    view->height = height;
+    view->dirty |= DIRTY_SIZE;
+}
 
-void OnNativeWinResize(int width, int height)
+void OnNativeWinExpose(EGLNativeWindowType nativewin)
 {
-    ctx.nWindowWidth = width;
-    ctx.nWindowHeight = height;
-    glViewport(0, 0, width, height);
+    SurfaceView* view = FindView(nativewin);
+    if(view != NULL)
+    {
+        view->dirty |= DIRTY_EXPOSE;
+    }
 }
 
-void OnNativeWinMouseMove(int mousex, int mousey, bool lbutton)
+void OnNativeWinMouseMove(EGLNativeWindowType nativewin, int mousex, int mousey, bool lbutton)
 {
+    SurfaceView* view = FindView(nativewin);
+    if(view == NULL)
+    {
+        return;
+    }
     if(lbutton)
     {
-        int oldx = ctx.nMouseX;
-        int oldy = ctx.nMouseY;
-        GLfloat yaw = ctx.rs.yaw;
-        GLfloat pitch = ctx.rs.pitch;
-        yaw   += (oldx - mousex) * 720.0f/ctx.nWindowWidth;
-        pitch += (oldy - mousey) * 360.0f/ctx.nWindowHeight;
-        yaw = (abs(yaw) <  360) ? yaw : yaw/360;
+        int oldx = view->mouseX;
+        int oldy = view->mouseY;
+        GLfloat yaw = ctx.rs.targetYaw;
+        GLfloat pitch = ctx.rs.targetPitch;
+        yaw   += (oldx - mousex) * 720.0f/view->width;
+        pitch += (oldy - mousey) * 360.0f/view->height;
         pitch = (pitch <  90) ? pitch :  89;
         pitch = (pitch > -90) ? pitch : -89;
-        ctx.rs.yaw = yaw;
-        ctx.rs.pitch = pitch;
+        if(yaw != ctx.rs.targetYaw || pitch != ctx.rs.targetPitch)
+        {
+            ctx.rs.targetYaw = yaw;
+            ctx.rs.targetPitch = pitch;
+            ctx.rs.moving = true;
+            MarkViewsDirty(DIRTY_VIEW);
+            ctx.sched.NoteInput();
+        }
     }
-    ctx.nMouseX = mousex;
-    ctx.nMouseY = mousey;
+    view->mouseX = mousex;
+    view->mouseY = mousey;
 }
 
-bool LoadTexture(esContext &  tx)
+// Derive a low-poly occluder from the full detail frame of the model. Only
+// positions matter, so vertices sharing one are welded and simplified freely.
+void BuildOccluder(RenderState& rs, unsigned int targetTriangles)
 {
-    FILE*	pFile;
-	BMPInfo *pBitmapInfo = NULL;
-	unsigned long lInfoSize = 0;
-	unsigned long lBitSize = 0;
-	GLbyte *pBits = NULL;					
-	BMPHeader	bitmapHeader;
-
-    pFile = fopen("./ninja/ninjacomp.bmp", "rb");
-    if(pFile == NULL)
-        return false;
-
-    if(fread(&bitmapHeader, 1, sizeof(BMPHeader), pFile) != sizeof(BMPHeader))
+    const SBObject& model = rs.ninja;
+    unsigned int frame = model.GetLODFrame(0);
+    unsigned int first = model.GetFirstFrameVertex(frame);
+    unsigned int count = model.GetFrameVertexCount(frame);
+    unsigned int comps = model.GetAttribComponents(0);
+    const GLfloat* pos = (const GLfloat*) model.GetVertexData();
+    std::vector<GLfloat> positions(count * 3);
+    for(unsigned int i = 0; i < count; i++)
     {
-        fclose(pFile);
-        printf("Failed to load texture.\n");
-		return false;
+        memcpy(&positions[i * 3], &pos[(first + i) * comps], 3 * sizeof(GLfloat));
     }
+    MeshSimplifier simplifier(&positions[0], count, 3);
+    simplifier.SimplifyTo(targetTriangles);
+    rs.occluder.clear();
+    simplifier.Extract(rs.occluder);
+}
 
-	lInfoSize = bitmapHeader.offset - sizeof(BMPHeader);
-	pBitmapInfo = (BMPInfo *) malloc(sizeof(GLbyte)*lInfoSize);
-	if(fread(pBitmapInfo, 1, lInfoSize, pFile) != lInfoSize)
-	{
-		free(pBitmapInfo);
-		fclose(pFile);
-        printf("Failed to load texture.\n");
-		return false;
-	}
-
-	GLint nWidth = pBitmapInfo->header.width;
-	GLint nHeight = pBitmapInfo->header.height;
-	lBitSize = pBitmapInfo->header.imageSize;
+bool LoadTexture(esContext &  tx)
+{
+    GLint nWidth = 0;
+    GLint nHeight = 0;
+    GLbyte* pBits = LoadBMP(tx.opts.texturePath, &nWidth, &nHeight);
+    if(pBits == NULL)
+        return false;
+    GL_DEBUG_SITE();
 
-	if(pBitmapInfo->header.bits != 24)
-	{
-        printf("Failed to load texture.\n");
-		free(pBitmapInfo);
-		return false;
-	}
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	if(lBitSize == 0)
-		lBitSize = (nWidth *
-           pBitmapInfo->header.bits + 7) / 8 *
-  		  abs(nHeight);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, nWidth, nHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, pBits);
+    free(pBits);
 
-	free(pBitmapInfo);
-	pBits = (GLbyte*)malloc(sizeof(GLbyte)*lBitSize);
+    return true;
+}
 
-	if(fread(pBits, 1, lBitSize, pFile) != lBitSize)
-	{
-		free(pBits);
-		pBits = NULL;
-	}
+// Load the comma separated list of textures into the layers of the array.
+bool LoadTextureArray(esContext& ctx)
+{
+    char paths[1024];
+    const char* files[TextureArray::MAX_LAYERS];
+    int count = 0;
+    strncpy(paths, ctx.opts.textureLayers, sizeof(paths) - 1);
+    paths[sizeof(paths) - 1] = '\0';
+    for(char* file = strtok(paths, ","); file != NULL && count < TextureArray::MAX_LAYERS; file = strtok(NULL, ","))
+    {
+        files[count++] = file;
+    }
+    return ctx.rs.textureArray.Load(files, count);
+}
 
-	fclose(pFile);
+// Create the surface of a view, and its own context when views render in
+// parallel. Window views get a native window of the given size.
+EGLBoolean CreateView(esContext &ctx, SurfaceView& view, bool pbuffer, int width, int height, int nativeVid)
+{
+    view.pbuffer = pbuffer;
+    view.width = width;
+    view.height = height;
+    if(pbuffer)
+    {
+        EGLint pbufferAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+        view.eglSurface = eglCreatePbufferSurface(ctx.eglDisplay, ctx.eglConfig, pbufferAttribs);
+        if (view.eglSurface == EGL_NO_SURFACE)
+        {
+            printf("Could not create EGL pbuffer surface\n");
+            return GL_FALSE;
+        }
+    }
+    else
+    {
+        if(!CreateNativeWin(ctx.nativeDisplay, width, height, nativeVid, &view.nativeWin))
+        {
+            printf("Could not create window\n");
+            return GL_FALSE;
+        }
+        const EGLint* surfaceAttribs = ctx.opts.fullRedraw ? NULL : DamagePresenter::GetSurfaceAttribs(ctx.eglDisplay);
+        view.eglSurface = eglCreateWindowSurface(ctx.eglDisplay, ctx.eglConfig, view.nativeWin, surfaceAttribs);
+        if (view.eglSurface == EGL_NO_SURFACE)
+        {
+            printf("Could not create EGL surface\n");
+            DestroyNativeWin(ctx.nativeDisplay, view.nativeWin);
+            view.nativeWin = 0;
+            return GL_FALSE;
+        }
+    }
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // views drawn from their own threads need their own context; it shares
+    // the textures and buffers of the primary one
+    view.eglContext = ctx.eglContext;
+    if(ctx.opts.parallel)
+    {
+        view.eglContext = eglCreateContext(ctx.eglDisplay, ctx.eglConfig, ctx.eglContext, ctx.contextAttribs);
+        if (view.eglContext == EGL_NO_CONTEXT)
+        {
+            printf("Could not create shared EGL context\n");
+            return GL_FALSE;
+        }
+    }
+    return GL_TRUE;
+}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, nWidth, nHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, pBits);
+void DestroyViews(esContext &ctx)
+{
+    for(int i = 0; i < ctx.numViews; i++)
+    {
+        SurfaceView& view = ctx.views[i];
+        if(view.eglContext != EGL_NO_CONTEXT && view.eglContext != ctx.eglContext)
+        {
+            eglDestroyContext(ctx.eglDisplay, view.eglContext);
+        }
+        if(view.eglSurface != EGL_NO_SURFACE)
+        {
+            eglDestroySurface(ctx.eglDisplay, view.eglSurface);
+        }
+        if(view.nativeWin != 0)
+        {
+            DestroyNativeWin(ctx.nativeDisplay, view.nativeWin);
+        }
+    }
+    ctx.numViews = 0;
+}
 
-    return true;
+// Create the context owning the shared objects from ctx.contextAttribs,
+// asking for a debug context in GL_DEBUG_LAYER builds. If the driver
+// refuses the debug flag it is dropped again, so the contexts created later
+// from the same attributes are plain ones too.
+EGLContext CreateSharedContext(esContext &ctx, EGLDisplay display, EGLConfig config)
+{
+    int end = 0;
+    while(ctx.contextAttribs[end] != EGL_NONE)
+    {
+        end += 2;
+    }
+    GL_DEBUG_CONTEXT_ATTRIBS(display, ctx.contextAttribs);
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, ctx.contextAttribs);
+    if(context == EGL_NO_CONTEXT && ctx.contextAttribs[end] != EGL_NONE)
+    {
+        printf("Could not create a debug context, retrying without the debug flag.\n");
+        ctx.contextAttribs[end] = EGL_NONE;
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, ctx.contextAttribs);
+    }
+    return context;
 }
 
 EGLBoolean Setup(esContext &ctx)
@@ -237,18 +539,40 @@ EGLBoolean Setup(esContext &ctx)
         CloseNativeDisplay(nativeDisplay);
         return GL_FALSE;
     }
+    if (ctx.opts.glStats)
+    {
+        if (GLIntercept::Instance().IsEnabled())
+        {
+            int loaded = GLIntercept::Instance().Load(eglDisplay);
+            printf("Counting GL calls, %d entry points from eglGetProcAddress.\n", loaded);
+        }
+        else
+        {
+            printf("Built without GL_INTERCEPT, GL calls are not counted.\n");
+        }
+    }
+
+    // the cache has to be in place before any context compiles a shader
+    if (ctx.opts.blobCachePath != NULL &&
+        (!ctx.blobCache.Open(ctx.opts.blobCachePath, BlobCache::DEFAULT_MAX_BYTES) || !ctx.blobCache.Install(eglDisplay)))
+    {
+        printf("Could not set up the blob cache in %s, shaders are compiled every run.\n", ctx.opts.blobCachePath);
+    }
 
-    // Obtain the first configuration with a depth buffer
-    EGLint attrs[] = { EGL_DEPTH_SIZE, 16, EGL_NONE };
+    // Obtain the first configuration with a depth buffer that can back
+    // all requested kinds of surfaces
+    EGLint surfaceType = EGL_WINDOW_BIT | ((ctx.opts.numPbuffers > 0 || ctx.opts.shaderThreads > 0) ? EGL_PBUFFER_BIT : 0);
+    EGLint attrs[] = { EGL_DEPTH_SIZE, 16, EGL_SURFACE_TYPE, surfaceType, EGL_NONE };
     EGLint numConfig =0;
     EGLConfig eglConfig = 0;
     bsuccess = eglChooseConfig(eglDisplay, attrs, &eglConfig, 1, &numConfig);
-    if (!bsuccess)
+    if (!bsuccess || numConfig == 0)
     {
         printf("Could not find valid EGL config\n");
         CloseNativeDisplay(nativeDisplay);
         return GL_FALSE;
     }
+    ctx.eglConfig = eglConfig;
 
     // Get the native visual id
     int nativeVid;
@@ -258,89 +582,204 @@ EGLBoolean Setup(esContext &ctx)
         CloseNativeDisplay(nativeDisplay);
         return GL_FALSE;
     }
+    ctx.nativeDisplay = nativeDisplay;
 
-    EGLNativeWindowType nativeWin;
-    if(!CreateNativeWin(nativeDisplay, 640, 480, nativeVid, &nativeWin))
+    // Create the OpenGL ES context owning the shared objects. Texture
+    // arrays need OpenGL ES 3.0; without it the sample falls back to the 2D
+    // texture.
+    EGLContext eglContext = EGL_NO_CONTEXT;
+    if (ctx.opts.textureLayers != NULL)
     {
-        printf("Could not create window\n");
-        CloseNativeDisplay(nativeDisplay);
-        return GL_FALSE;
+        ctx.contextAttribs[0] = EGL_CONTEXT_CLIENT_VERSION;
+        ctx.contextAttribs[1] = 3;
+        ctx.contextAttribs[2] = EGL_NONE;
+        eglContext = CreateSharedContext(ctx, eglDisplay, eglConfig);
+        if (eglContext == EGL_NO_CONTEXT)
+        {
+            printf("Could not create an OpenGL ES 3.0 context, drawing without the texture array.\n");
+            ctx.opts.textureLayers = NULL;
+            ctx.contextAttribs[0] = EGL_NONE;
+        }
     }
-
-    // Create a surface for the main window
-    EGLSurface eglSurface;
-    eglSurface = eglCreateWindowSurface(eglDisplay, eglConfig, nativeWin, NULL);
-    if (eglSurface == EGL_NO_SURFACE)
+    if (eglContext == EGL_NO_CONTEXT)
     {
-        printf("Could not create EGL surface\n");
-        DestroyNativeWin(nativeDisplay, nativeWin);
-        CloseNativeDisplay(nativeDisplay);
-        return GL_FALSE;
+        eglContext = CreateSharedContext(ctx, eglDisplay, eglConfig);
     }
-    ctx.eglSurface = eglSurface;
-
-    // Create an OpenGL ES context
-    EGLContext eglContext;
-    eglContext = eglCreateContext(eglDisplay, eglConfig, EGL_NO_CONTEXT, NULL);
     if (eglContext == EGL_NO_CONTEXT)
     {
         printf("Could not create EGL context\n");
-        DestroyNativeWin(nativeDisplay, nativeWin);
         CloseNativeDisplay(nativeDisplay);
         return GL_FALSE;
     }
+    ctx.eglContext = eglContext;
 
-    // Make the context and surface current
-    bsuccess = eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext);
-    if(!bsuccess)
+    // Create the windows followed by the pbuffers, each view looking at the
+    // model from another side
+    int numViews = ctx.opts.numWindows + ctx.opts.numPbuffers;
+    for(int i = 0; i < numViews; i++)
     {
-        printf("Could not activate EGL context\n");
-        DestroyNativeWin(nativeDisplay, nativeWin);
-        CloseNativeDisplay(nativeDisplay);
-        return GL_FALSE;
+        SurfaceView& view = ctx.views[i];
+        ctx.numViews = i + 1;
+        view.yawOffset = 360.0f * i / numViews;
+        if(!CreateView(ctx, view, i >= ctx.opts.numWindows, 640, 480, nativeVid))
+        {
+            DestroyViews(ctx);
+            eglDestroyContext(eglDisplay, eglContext);
+            CloseNativeDisplay(nativeDisplay);
+            return GL_FALSE;
+        }
     }
 
-    ctx.nativeDisplay = nativeDisplay;
-    ctx.nativeWin = nativeWin;
+    // The swap interval applies to the surface bound when it is set
+    for(int i = 0; i < ctx.numViews; i++)
+    {
+        SurfaceView& view = ctx.views[i];
+        if(view.pbuffer)
+        {
+            continue;
+        }
+        bsuccess = eglMakeCurrent(eglDisplay, view.eglSurface, view.eglSurface, eglContext);
+        if(!bsuccess)
+        {
+            printf("Could not activate EGL context\n");
+            DestroyViews(ctx);
+            eglDestroyContext(eglDisplay, eglContext);
+            CloseNativeDisplay(nativeDisplay);
+            return GL_FALSE;
+        }
+        if(!ctx.opts.fullRedraw)
+        {
+            view.presenter.Init(eglDisplay, view.eglSurface);
+        }
+        // a negative interval leaves the implementation default in place
+        if(ctx.opts.swapInterval >= 0 && !eglSwapInterval(eglDisplay, ctx.opts.swapInterval))
+        {
+            printf("Could not set swap interval %d\n", ctx.opts.swapInterval);
+        }
+    }
+
+    // Leave the context current on the first window for loading
+    eglMakeCurrent(eglDisplay, ctx.views[0].eglSurface, ctx.views[0].eglSurface, eglContext);
     return GL_TRUE;
 }
 
-GLboolean CreateProgram(esContext &ctx)
+// Print why a shader did not compile or a program did not link.
+void PrintInfoLog(GLuint object, GLboolean program)
+{
+    GLint length = 0;
+    if(program)
+    {
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+    }
+    else
+    {
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+    }
+    if(length <= 1)
+    {
+        return;
+    }
+    std::vector<GLchar> log(length);
+    if(program)
+    {
+        glGetProgramInfoLog(object, length, NULL, &log[0]);
+    }
+    else
+    {
+        glGetShaderInfoLog(object, length, NULL, &log[0]);
+    }
+    printf("%s\n", &log[0]);
+}
+
+// Position-only program for the depth pre-pass. gl_Position is invariant in
+// both programs so the shading pass can test against the pre-pass depth.
+GLboolean CreateDepthProgram(ProgramState &prog)
 {
     const GLchar* vsSource =
       "uniform mat4 mvpMatrix;"
       "attribute vec4 vertPosition;"
-      "attribute vec3 normal;"
-      "attribute vec2 texCoord0;"
-      "varying vec2 vTexCoord;"
-      "varying vec3 vNormal;"
+      "invariant gl_Position;"
       "void main()"
       "{"
       "   gl_Position = mvpMatrix * vertPosition;"
-      "   vTexCoord   = texCoord0;"
-      "   vNormal     = normal;"
       "}";
     const GLchar* fsSource =
-      "uniform vec4 lightVec;"
-      "uniform sampler2D textureUnit0;"
-      "varying vec2 vTexCoord;"
-      "varying vec3 vNormal;"
+      "precision mediump float;"
       "void main()"
       "{"
-      "  vec4 diff = vec4(dot(lightVec.xyz,normalize(vNormal)).xxx, 1);"
-      "  gl_FragColor =  diff * texture(textureUnit0, vTexCoord);"
+      "  gl_FragColor = vec4(0.0);"
       "}";
     GLint status;
+    GL_DEBUG_SITE();
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &vsSource, NULL);
+    glCompileShader(vs);
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &fsSource, NULL);
+    glCompileShader(fs);
+
+    GLuint po = glCreateProgram();
+    GL_DEBUG_LABEL(GL_PROGRAM_OBJECT_EXT, po, "depth program");
+    glAttachShader(po, vs);
+    glAttachShader(po, fs);
+    glLinkProgram(po);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    glGetProgramiv(po, GL_LINK_STATUS, &status);
+    if(!status)
+    {
+        printf("Failed to link the depth program.\n");
+        PrintInfoLog(po, GL_TRUE);
+        glDeleteProgram(po);
+        return GL_FALSE;
+    }
+
+    prog.depthPo = po;
+    prog.depthVertLoc = glGetAttribLocation( po, "vertPosition" );
+    prog.depthMvpLoc  = glGetUniformLocation( po, "mvpMatrix" );
+    assert(prog.depthVertLoc >= 0);
+    assert(prog.depthMvpLoc >= 0);
+
+    return GL_TRUE;
+}
+
+// Look up the inputs of a linked shading program. Inputs of features the
+// program lacks are -1.
+void GetProgramLocations(ProgramState &prog, unsigned int mask)
+{
+    prog.vertLoc     = glGetAttribLocation( prog.po, "vertPosition" );
+    prog.normalLoc   = glGetAttribLocation( prog.po, "normal" );
+    prog.texcoordLoc = glGetAttribLocation( prog.po, "texCoord0" );
+    prog.mvpLoc      = glGetUniformLocation( prog.po, "mvpMatrix" );
+    prog.lightLoc    = glGetUniformLocation( prog.po, "lightVec" );
+    prog.texUnitLoc  = glGetUniformLocation( prog.po, "textureUnit0" );
+    prog.layerLoc    = glGetUniformLocation( prog.po, "layer" );
+    assert(prog.vertLoc >= 0);
+    assert(prog.mvpLoc >= 0);
+    assert(!(mask & SHADER_LIGHTING) || (prog.normalLoc >= 0 && prog.lightLoc >= 0));
+    assert(!(mask & SHADER_TEXTURE) || (prog.texcoordLoc >= 0 && prog.texUnitLoc >= 0));
+    assert(!(mask & SHADER_TEXTURE_ARRAY) || prog.layerLoc >= 0);
+}
+
+GLboolean CreateProgram(ProgramState &prog, const ShaderPermutations::Variant& variant)
+{
+    const GLchar* vsSource = variant.vsSource.c_str();
+    const GLchar* fsSource = variant.fsSource.c_str();
+    GLint status;
+    GL_DEBUG_SITE();
 
     // create and compile the vertex shader
     GLuint vs;
     vs = glCreateShader(GL_VERTEX_SHADER);
+    GL_DEBUG_LABEL(GL_SHADER_OBJECT_EXT, vs, "shading vertex shader");
     glShaderSource(vs, 1, &vsSource, NULL);
     glCompileShader(vs);
     glGetShaderiv(vs, GL_COMPILE_STATUS, &status);
     if (status == 0)
     {
         printf("Failed to create a vertex shader.\n");
+        PrintInfoLog(vs, GL_FALSE);
         glDeleteShader(vs);
         return GL_FALSE;
     }
@@ -348,12 +787,14 @@ GLboolean CreateProgram(esContext &ctx)
     // create and compile the fragment shader
     GLuint fs;
     fs = glCreateShader(GL_FRAGMENT_SHADER);
+    GL_DEBUG_LABEL(GL_SHADER_OBJECT_EXT, fs, "shading fragment shader");
     glShaderSource(fs, 1, &fsSource, NULL);
     glCompileShader(fs);
     glGetShaderiv(fs, GL_COMPILE_STATUS, &status);
     if (status == 0)
     {
         printf("Failed to create a fragment shader.\n");
+        PrintInfoLog(fs, GL_FALSE);
         glDeleteShader(vs);
         glDeleteShader(fs);
         return GL_FALSE;
@@ -367,6 +808,7 @@ GLboolean CreateProgram(esContext &ctx)
         printf("Failed to create a program.\n");
         return GL_FALSE;
     }
+    GL_DEBUG_LABEL(GL_PROGRAM_OBJECT_EXT, po, "shading program");
     glAttachShader(po, vs);
     glAttachShader(po, fs);
 
@@ -376,6 +818,7 @@ GLboolean CreateProgram(esContext &ctx)
     if(!status) 
     {
         printf("Failed to link program.\n");
+        PrintInfoLog(po, GL_TRUE);
         glDeleteProgram(po);
         glDeleteShader(vs);
         glDeleteShader(fs);
@@ -386,140 +829,1091 @@ GLboolean CreateProgram(esContext &ctx)
     glDeleteShader(vs);
     glDeleteShader(fs);
 
-    ctx.rs.po = po;
-    ctx.rs.vertLoc     = glGetAttribLocation( ctx.rs.po, "vertPosition" );
-    ctx.rs.normalLoc   = glGetAttribLocation( ctx.rs.po, "normal" );
-    ctx.rs.texcoordLoc = glGetAttribLocation( ctx.rs.po, "texCoord0" );
-    ctx.rs.mvpLoc      = glGetUniformLocation( ctx.rs.po, "mvpMatrix" );
-    ctx.rs.lightLoc    = glGetUniformLocation( ctx.rs.po, "lightVec" );
-    ctx.rs.texUnitLoc  = glGetUniformLocation( ctx.rs.po, "textureUnit0" );
-    assert(ctx.rs.vertLoc >= 0);
-    assert(ctx.rs.normalLoc >= 0);
-    assert(ctx.rs.texcoordLoc >= 0);
-    assert(ctx.rs.mvpLoc >= 0);
-    assert(ctx.rs.lightLoc >= 0);
-    assert(ctx.rs.texUnitLoc >= 0);
+    prog.po = po;
+    GetProgramLocations(prog, variant.mask);
 
-    return GL_TRUE;
+    return CreateDepthProgram(prog);
 }
 
-void Render(esContext &ctx)
+// Create the shading program for the current context. With shader threads
+// running it is linked in the background, and the untextured placeholder
+// variant is used until UpdateProgram() finds it linked.
+GLboolean RequestProgram(esContext &ctx, ProgramState &prog)
+{
+    const ShaderPermutations& shaders = ctx.rs.shaders;
+    if(ctx.compiler.IsEnabled() && ctx.rs.placeholderVariant >= 0)
+    {
+        const ShaderPermutations::Variant& variant = shaders.GetVariant(ctx.rs.shadingVariant);
+        prog.job = ctx.compiler.Submit(variant.vsSource.c_str(), variant.fsSource.c_str());
+        if(prog.job >= 0)
+        {
+            return CreateProgram(prog, shaders.GetVariant(ctx.rs.placeholderVariant));
+        }
+    }
+    return CreateProgram(prog, shaders.GetVariant(ctx.rs.shadingVariant));
+}
+
+// Swap the placeholder for the program of its job once that linked. Called
+// with a context of the share group current, while the job is pending.
+void UpdateProgram(esContext &ctx, ProgramState &prog)
+{
+    ShaderCompiler::JobStatus status = ctx.compiler.Poll(prog.job);
+    if(status == ShaderCompiler::JOB_PENDING)
+    {
+        return;
+    }
+    if(status == ShaderCompiler::JOB_READY)
+    {
+        glDeleteProgram(prog.po);
+        prog.po = ctx.compiler.GetProgram(prog.job);
+        GetProgramLocations(prog, ctx.rs.shaders.GetVariant(ctx.rs.shadingVariant).mask);
+    }
+    else
+    {
+        printf("Failed to link program, drawing with the placeholder.\n");
+    }
+    prog.job = -1;
+}
+
+void Simulate(esContext &ctx, double dt)
+{
+    RenderState& rs = ctx.rs;
+    rs.prevYaw = rs.yaw;
+    rs.prevPitch = rs.pitch;
+
+    // ease the camera towards the orientation set by the mouse
+    GLfloat k = (GLfloat) (1.0 - exp(-dt * 20.0));
+    rs.yaw   += (rs.targetYaw - rs.yaw) * k;
+    rs.pitch += (rs.targetPitch - rs.pitch) * k;
+    if(fabs(rs.targetYaw - rs.yaw) < 0.01f && fabs(rs.targetPitch - rs.pitch) < 0.01f)
+    {
+        rs.yaw = rs.targetYaw;
+        rs.pitch = rs.targetPitch;
+    }
+
+    // keep the yaw in range, shifting all states by the same amount so the
+    // interpolation between them is unaffected
+    if(fabs(rs.yaw) >= 360.0f)
+    {
+        GLfloat wrap = (rs.yaw > 0.0f) ? 360.0f : -360.0f;
+        rs.yaw -= wrap;
+        rs.prevYaw -= wrap;
+        rs.targetYaw -= wrap;
+    }
+
+    // the frame after the last change still has to show the settled state
+    bool moving = rs.yaw != rs.prevYaw || rs.pitch != rs.prevPitch;
+    if(moving || rs.moving)
+    {
+        MarkViewsDirty(DIRTY_VIEW);
+    }
+    rs.moving = moving;
+}
+
+// Position of instance i on the square grid centred on the origin.
+void GetInstanceOffset(const esContext &ctx, int i, GLfloat offset[3])
+{
+    float center[3];
+    float radius;
+    ctx.rs.ninja.GetBoundingSphere(center, &radius);
+    int gridSize = ctx.opts.instances;
+    float spacing = radius * 2.5f;
+    offset[0] = ((i % gridSize) - (gridSize - 1) * 0.5f) * spacing;
+    offset[1] = 0.0f;
+    offset[2] = ((i / gridSize) - (gridSize - 1) * 0.5f) * spacing;
+}
+
+// Texture instance i is drawn with, and its layer when it is an array.
+void GetInstanceMaterial(const esContext &ctx, int i, GLuint* texture, GLint* layer)
+{
+    GLint layers = ctx.rs.textureArray.GetLayerCount();
+    *texture = (layers > 0) ? ctx.rs.textureArray.GetTexture() : ctx.rs.ninjaTex[0];
+    *layer = (layers > 0) ? i % layers : -1;
+}
+
+// Draws of the static batches, one per run of adjacent instances the CPU
+// culler did not hide; without culling, one per batch.
+void RecordBatches(esContext &ctx, const mat4& vp, const vec4& light, CommandList& list)
+{
+    const StaticBatcher& batcher = ctx.rs.batch;
+    const SoftwareOcclusionCuller& softCuller = ctx.softCuller;
+    for(unsigned int b = 0; b < batcher.GetBatchCount(); b++)
+    {
+        const StaticBatcher::Batch& batch = batcher.GetBatch(b);
+        GLuint runFirst = 0;
+        GLuint runCount = 0;
+        for(unsigned int r = 0; r <= batch.numRanges; r++)
+        {
+            if(r < batch.numRanges)
+            {
+                const StaticBatcher::Range& range = batcher.GetRange(batch.firstRange + r);
+                if(!softCuller.IsEnabled() || softCuller.TestBox(&vp.x.x, range.boxMin, range.boxMax))
+                {
+                    runFirst = (runCount == 0) ? range.first : runFirst;
+                    runCount += range.count;
+                    continue;
+                }
+            }
+            if(runCount == 0)
+            {
+                continue;
+            }
+            RenderCommand* cmd = list.Add(CMD_DRAW_MESH);
+            cmd->mesh.object = &batcher.GetModel();
+            cmd->mesh.texture = batch.texture;
+            cmd->mesh.layer = batch.layer;
+            cmd->mesh.first = runFirst;
+            cmd->mesh.count = runCount;
+            memcpy(cmd->mesh.mvp, &vp.x.x, sizeof(cmd->mesh.mvp));
+            memcpy(cmd->mesh.light, &light.x, sizeof(cmd->mesh.light));
+            memset(&cmd->mesh.bounds, 0, sizeof(cmd->mesh.bounds));
+            cmd->mesh.bounds.node = -1;
+            runCount = 0;
+        }
+    }
+}
+
+// Camera math, detail levels, draw order and damage of one view for the next
+// frame, recorded as commands for ExecuteCommands(). Returns false if nothing
+// in the view needs drawing.
+bool RecordView(esContext &ctx, SurfaceView& view, float alpha, double inputTime, CommandList& list)
 {
-    // get program object
-    GLuint po = ctx.rs.po;
     // get model properties
-    GLuint texture = ctx.rs.ninjaTex[0];
     SBObject* ninja = &ctx.rs.ninja;
-    GLuint arraystart = ninja->GetFirstFrameVertex(0);
-    GLuint arraycount = ninja->GetFrameVertexCount(0);
-
-    // get vertex data
-    GLint posAttrib = ctx.rs.vertLoc;
-    GLint normAttrib = ctx.rs.normalLoc;
-    GLint uvAttrib = ctx.rs.texcoordLoc;
-    int posSize = ninja->GetAttribComponents(0);
-    int normSize = ninja->GetAttribComponents(1);
-    int uvSize = ninja->GetAttribComponents(2);
-    unsigned char * data_pointer = ninja->GetVertexData();
-    GLuint numverts = ninja->GetNumVertices();
-    void* posPtr = data_pointer;
-    data_pointer += posSize * sizeof(GLfloat) * numverts;
-    void* normPtr = data_pointer;
-    data_pointer += normSize * sizeof(GLfloat) * numverts;
-    void* uvPtr = data_pointer;
-
-    // calculate the view matrix from the pitch and yaw of mouse movements
+    int width = view.width;
+    int height = view.height;
+    int gridSize = ctx.opts.instances;
+    int numInstances = gridSize * gridSize;
+    float center[3];
+    float radius;
+    float bmin[3];
+    float bmax[3];
+    ninja->GetBoundingSphere(center, &radius);
+    ninja->GetBoundingBox(bmin, bmax);
+    float extent = radius * 2.5f * (gridSize - 1);
+
+    // calculate the view matrix from the pitch and yaw of mouse movements,
+    // interpolated between the last two simulation steps
+    GLfloat yaw = ctx.rs.prevYaw + (ctx.rs.yaw - ctx.rs.prevYaw) * alpha + view.yawOffset;
+    GLfloat pitch = ctx.rs.prevPitch + (ctx.rs.pitch - ctx.rs.prevPitch) * alpha;
     vec4 target = vec4(0,85,0,0);
-    mat4 yawmtx(mat4::rotate(ctx.rs.yaw, vec4(0,1,0,0)));
-    mat4 pitchmtx(mat4::rotate(ctx.rs.pitch, vec4(1,0,0,0)));
-    vec4 eye = target + (yawmtx * pitchmtx * vec4(0,0,200,1));
-    mat4 view(mat4::lookAt(eye, target,vec4(0,1,0,0)));
+    mat4 yawmtx(mat4::rotate(yaw, vec4(0,1,0,0)));
+    mat4 pitchmtx(mat4::rotate(pitch, vec4(1,0,0,0)));
+    vec4 eye = target + (yawmtx * pitchmtx * vec4(0,0,200 + extent * 0.75f,1));
+    mat4 viewmtx(mat4::lookAt(eye, target,vec4(0,1,0,0)));
     // calculate the projection matrix
-    mat4 proj(mat4::perspective(60, ((float) ctx.nWindowWidth)/ctx.nWindowHeight, 1, 1000));
+    mat4 proj(mat4::perspective(60, ((float) width)/height, 1, 1000 + extent * 2.0f));
     // calvulate the view-projection matrix
-    mat4 mvp = proj * view;
+    mat4 vp = proj * viewmtx;
     // the light vector is the normalized direction vector pointing
     // from the eye to the origin.
     vec4 light = vec4::normalize(vec4(eye.x, eye.y, eye.z, 0));
 
-    glClearColor ( 0.7f, 0.7f, 0.7f, 0.0f );
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    // bind the program
-    glUseProgram(po);
-    glUniform4fv(ctx.rs.lightLoc, 1, &light.x);
-    glUniformMatrix4fv(ctx.rs.mvpLoc, 1, GL_FALSE, &mvp.x.x);
-    // the sampler should use texture unit 0
-    glUniform1i(ctx.rs.texUnitLoc, 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    // sort the instances front to back, so near ones occlude far ones
+    GLfloat offset[SurfaceView::MAX_INSTANCES][3];
+    float distance[SurfaceView::MAX_INSTANCES];
+    int order[SurfaceView::MAX_INSTANCES];
+    DamageRect ninjaRect;
+    for(int i = 0; i < numInstances; i++)
+    {
+        GetInstanceOffset(ctx, i, offset[i]);
+        float world[3] = { center[0] + offset[i][0], center[1] + offset[i][1], center[2] + offset[i][2] };
+        distance[i] = vec4::length(vec4(eye.x - world[0], eye.y - world[1], eye.z - world[2], 0));
+        ninjaRect = ninjaRect.Union(DamageRect::FromSphere(vp, world, radius, width, height));
+        int j = i;
+        for(; j > 0 && distance[order[j-1]] > distance[i]; j--)
+        {
+            order[j] = order[j-1];
+        }
+        order[j] = i;
+    }
+
+    // instances hidden behind the occluders of the others are not recorded
+    // at all
+    bool visible[SurfaceView::MAX_INSTANCES];
+    SoftwareOcclusionCuller& softCuller = ctx.softCuller;
+    if(softCuller.IsEnabled())
+    {
+        const std::vector<GLfloat>& occluder = ctx.rs.occluder;
+        softCuller.BeginFrame(width, height);
+        for(int i = 0; i < numInstances; i++)
+        {
+            mat4 mvp = vp * mat4::translate(offset[i][0], offset[i][1], offset[i][2]);
+            softCuller.AddOccluder(&mvp.x.x, &occluder[0], (unsigned int) occluder.size() / 3);
+        }
+        softCuller.Rasterize();
+    }
+    for(int i = 0; i < numInstances; i++)
+    {
+        mat4 mvp = vp * mat4::translate(offset[i][0], offset[i][1], offset[i][2]);
+        visible[i] = !softCuller.IsEnabled() || softCuller.TestBox(&mvp.x.x, bmin, bmax);
+    }
+
+    // only the area the models cover now or covered in the last frame
+    // changes while the camera moves; anything else damages the whole window
+    DamageRect frameDamage(0, 0, width, height);
+    if(!ctx.opts.fullRedraw && (view.dirty & ~DIRTY_VIEW) == 0)
+    {
+        frameDamage = ninjaRect.Union(view.ninjaRect);
+    }
+    view.ninjaRect = ninjaRect;
+    unsigned int dirty = view.dirty;
+    view.dirty = 0;
+    if(frameDamage.IsEmpty())
+    {
+        return false;
+    }
+
+    // a view never records more than a few dozen commands, so the list
+    // holds those of all views
+    RenderCommand* cmd = list.Add(CMD_BIND_VIEW);
+    cmd->bind.view = &view;
+    if(dirty & DIRTY_SIZE)
+    {
+        cmd = list.Add(CMD_VIEWPORT);
+        cmd->viewport.width = width;
+        cmd->viewport.height = height;
+    }
+
+    RenderCommand* begin = list.Add(CMD_BEGIN_FRAME);
+    begin->frame.damage[0] = frameDamage.x;
+    begin->frame.damage[1] = frameDamage.y;
+    begin->frame.damage[2] = frameDamage.w;
+    begin->frame.damage[3] = frameDamage.h;
+    begin->frame.clearColor[0] = 0.7f;
+    begin->frame.clearColor[1] = 0.7f;
+    begin->frame.clearColor[2] = 0.7f;
+    begin->frame.clearColor[3] = 0.0f;
+    begin->frame.inputTime = 0.0;
+
+    // with occlusion culling, 2x2 blocks of the grid form groups tested as a
+    // whole, in the order of their nearest instance
+    bool grouped = ctx.opts.occlusion && gridSize > 1;
+    int groupsPerRow = (gridSize + 1) / 2;
+    bool emitted[SurfaceView::MAX_INSTANCES];
+    memset(emitted, 0, sizeof(emitted));
+    bool batched = ctx.rs.batch.GetBatchCount() > 0;
+    if(batched)
+    {
+        RecordBatches(ctx, vp, light, list);
+    }
+    for(int k = 0; k < numInstances && !batched; k++)
+    {
+        if(!visible[order[k]])
+        {
+            continue;
+        }
+        int group = ((order[k] / gridSize) / 2) * groupsPerRow + (order[k] % gridSize) / 2;
+        if(grouped && emitted[group])
+        {
+            continue;
+        }
+        RenderCommand* groupCmd = NULL;
+        if(grouped)
+        {
+            emitted[group] = true;
+            groupCmd = list.Add(CMD_CULL_GROUP);
+            groupCmd->group.bounds.node = SurfaceView::MAX_INSTANCES + group;
+            groupCmd->group.children = 0;
+            memcpy(groupCmd->group.mvp, &vp.x.x, sizeof(groupCmd->group.mvp));
+        }
+        for(int m = k; m < numInstances; m++)
+        {
+            int i = order[m];
+            int memberGroup = ((i / gridSize) / 2) * groupsPerRow + (i % gridSize) / 2;
+            if(m != k && (!grouped || memberGroup != group || !visible[i]))
+            {
+                continue;
+            }
+            if(groupCmd != NULL)
+            {
+                CullBounds& bounds = groupCmd->group.bounds;
+                for(int c = 0; c < 3; c++)
+                {
+                    GLfloat lo = bmin[c] + offset[i][c];
+                    GLfloat hi = bmax[c] + offset[i][c];
+                    bool first = groupCmd->group.children == 0;
+                    bounds.boxMin[c] = (first || lo < bounds.boxMin[c]) ? lo : bounds.boxMin[c];
+                    bounds.boxMax[c] = (first || hi > bounds.boxMax[c]) ? hi : bounds.boxMax[c];
+                }
+                groupCmd->group.children++;
+            }
+
+            // pick the detail level from the projected size of the bounding sphere
+            float pixels = LODSelector::ProjectedDiameter(proj, (float) height, radius, distance[i]);
+            GLuint frame = ninja->GetLODFrame(view.lod[i].Select(pixels, ninja->GetLODCount()));
+            mat4 mvp = vp * mat4::translate(offset[i][0], offset[i][1], offset[i][2]);
+
+            cmd = list.Add(CMD_DRAW_MESH);
+            cmd->mesh.object = ninja;
+            GetInstanceMaterial(ctx, i, &cmd->mesh.texture, &cmd->mesh.layer);
+            cmd->mesh.first = ninja->GetFirstFrameVertex(frame);
+            cmd->mesh.count = ninja->GetFrameVertexCount(frame);
+            memcpy(cmd->mesh.mvp, &mvp.x.x, sizeof(cmd->mesh.mvp));
+            memcpy(cmd->mesh.light, &light.x, sizeof(cmd->mesh.light));
+            cmd->mesh.bounds.node = ctx.opts.occlusion ? i : -1;
+            memcpy(cmd->mesh.bounds.boxMin, bmin, sizeof(bmin));
+            memcpy(cmd->mesh.bounds.boxMax, bmax, sizeof(bmax));
+            if(!grouped)
+            {
+                break;
+            }
+        }
+    }
+
+    cmd = list.Add(CMD_END_FRAME);
+    cmd->frame = begin->frame;
+    cmd->frame.inputTime = inputTime;
+    view.culler.NoteFrameRecorded();
+    return true;
+}
+
+void DrawMesh(const ProgramState& prog, const MeshCommand& mesh, bool prepass, GLuint& boundTexture)
+{
+    GL_DEBUG_SITE();
+    const SBObject* object = mesh.object;
+
+    // get vertex data, from the buffer object if the model was uploaded
+    GLint posAttrib = prog.vertLoc;
+    GLint normAttrib = prog.normalLoc;
+    GLint uvAttrib = prog.texcoordLoc;
+    int posSize = object->GetAttribComponents(0);
+    int normSize = object->GetAttribComponents(1);
+    int uvSize = object->GetAttribComponents(2);
+    GLuint buffer = object->GetVertexBuffer();
+    const unsigned char * data_pointer = (buffer != 0) ? NULL : object->GetVertexData();
+    const void* posPtr = data_pointer + object->GetAttribOffset(0);
+    const void* normPtr = data_pointer + object->GetAttribOffset(1);
+    const void* uvPtr = data_pointer + object->GetAttribOffset(2);
+
     // set state
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    // lay down depth only, so the shading pass runs the full fragment
+    // shader once per visible pixel
+    if(prepass)
+    {
+        glUseProgram(prog.depthPo);
+        glUniformMatrix4fv(prog.depthMvpLoc, 1, GL_FALSE, mesh.mvp);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glVertexAttribPointer(prog.depthVertLoc, posSize, GL_FLOAT, GL_FALSE, 0, posPtr);
+        glEnableVertexAttribArray(prog.depthVertLoc);
+        glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
+        glDisableVertexAttribArray(prog.depthVertLoc);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        // depth is final, shade only what matches it
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    // bind the program
+    glUseProgram(prog.po);
+    glUniform4fv(prog.lightLoc, 1, mesh.light);
+    glUniformMatrix4fv(prog.mvpLoc, 1, GL_FALSE, mesh.mvp);
+    // the sampler should use texture unit 0
+    glUniform1i(prog.texUnitLoc, 0);
+    // instances sharing a texture or its array only bind it once
+    if(boundTexture != mesh.texture)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture((mesh.layer >= 0) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, mesh.texture);
+        boundTexture = mesh.texture;
+    }
+    if(mesh.layer >= 0)
+    {
+        glUniform1f(prog.layerLoc, (GLfloat) mesh.layer);
+    }
     // set vertex pointers
     glVertexAttribPointer(posAttrib, posSize, GL_FLOAT, GL_FALSE, 0, posPtr);
     glEnableVertexAttribArray(posAttrib);
-    glVertexAttribPointer(normAttrib, normSize, GL_FLOAT, GL_FALSE, 0, normPtr);
-    glEnableVertexAttribArray(normAttrib);
-    glVertexAttribPointer(uvAttrib, uvSize, GL_FLOAT, GL_FALSE, 0, uvPtr);
-    glEnableVertexAttribArray(uvAttrib);
+    // programs without lighting or texturing lack those inputs
+    if(normAttrib >= 0)
+    {
+        glVertexAttribPointer(normAttrib, normSize, GL_FLOAT, GL_FALSE, 0, normPtr);
+        glEnableVertexAttribArray(normAttrib);
+    }
+    if(uvAttrib >= 0)
+    {
+        glVertexAttribPointer(uvAttrib, uvSize, GL_FLOAT, GL_FALSE, 0, uvPtr);
+        glEnableVertexAttribArray(uvAttrib);
+    }
     // draw
-    glDrawArrays(GL_TRIANGLES, arraystart, arraycount);
-    // clean up state
+    glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
+    // clean up state; arrays left enabled would be fetched by later draws
+    // such as the occlusion boxes, which only set their own
+    glDisableVertexAttribArray(posAttrib);
+    if(normAttrib >= 0)
+    {
+        glDisableVertexAttribArray(normAttrib);
+    }
+    if(uvAttrib >= 0)
+    {
+        glDisableVertexAttribArray(uvAttrib);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDepthMask(GL_TRUE);
     glDisable(GL_DEPTH_TEST);
     glUseProgram(0);
-    // flip the visible buffer
-    eglSwapBuffers(ctx.eglDisplay, ctx.eglSurface);
+}
+
+// GL submission of recorded frames. Runs on whichever thread the list was
+// handed to; CMD_BIND_VIEW makes the surface and context of each view current
+// in turn. Returns false when the list asks the render loop to quit.
+bool ExecuteCommands(esContext &ctx, const CommandList& list)
+{
+    GL_DEBUG_SITE();
+    SurfaceView* view = NULL;
+    for(unsigned int i = 0; i < list.GetCount(); i++)
+    {
+        const RenderCommand& cmd = list.Get(i);
+        switch(cmd.type)
+        {
+        case CMD_BIND_VIEW:
+            view = cmd.bind.view;
+            if(eglGetCurrentSurface(EGL_DRAW) != view->eglSurface || eglGetCurrentContext() != view->eglContext)
+            {
+                eglMakeCurrent(ctx.eglDisplay, view->eglSurface, view->eglSurface, view->eglContext);
+                GL_DEBUG_INSTALL();
+            }
+            // the viewport is context state, shared by all views of the context
+            glViewport(0, 0, view->viewportWidth, view->viewportHeight);
+            view->boundTexture = 0;
+            if(view->program->job >= 0)
+            {
+                UpdateProgram(ctx, *view->program);
+            }
+            break;
+        case CMD_VIEWPORT:
+            glViewport(0, 0, cmd.viewport.width, cmd.viewport.height);
+            view->damage.Reset();
+            view->viewportWidth = cmd.viewport.width;
+            view->viewportHeight = cmd.viewport.height;
+            // the pass and the target belong to the context executing the view
+            if(!view->targetsInit)
+            {
+                view->targetsInit = true;
+                view->pass.Init();
+                view->prepass.SetMode(ctx.opts.prepass);
+                if(ctx.opts.occlusion &&
+                   !view->culler.Init(view->program->depthPo, view->program->depthVertLoc, view->program->depthMvpLoc))
+                {
+                    printf("GL_EXT_occlusion_query_boolean is not supported, drawing without culling.\n");
+                }
+                if(ctx.opts.msaaSamples > 0 && !view->msaa.Init(ctx.opts.msaaSamples))
+                {
+                    printf("Multisampled framebuffers are not supported, rendering single sampled.\n");
+                }
+            }
+            if(ctx.opts.msaaSamples > 0)
+            {
+                view->msaa.Resize(cmd.viewport.width, cmd.viewport.height);
+            }
+            break;
+        case CMD_BEGIN_FRAME:
+        {
+            // repaint what changed since the back buffer was last on screen
+            DamageRect frameDamage(cmd.frame.damage[0], cmd.frame.damage[1], cmd.frame.damage[2], cmd.frame.damage[3]);
+            int age = view->presenter.QueryBufferAge(ctx.eglDisplay, view->eglSurface);
+            // the samples are dropped after every resolve, and queries
+            // issued in a scissored frame would miss what lies outside it
+            if(view->msaa.IsActive() || view->culler.IsEnabled())
+            {
+                age = 0;
+            }
+            view->culler.BeginFrame();
+            DamageRect repaint = view->damage.GetRepaintRegion(age, frameDamage, view->viewportWidth, view->viewportHeight);
+            view->scissored = repaint.w < view->viewportWidth || repaint.h < view->viewportHeight;
+            if(view->scissored)
+            {
+                glEnable(GL_SCISSOR_TEST);
+                glScissor(repaint.x, repaint.y, repaint.w, repaint.h);
+            }
+            // depth is never needed past the frame
+            RenderPassDesc desc = RenderPass::Describe(view->msaa.GetFramebuffer(),
+                                                       LOAD_ACTION_CLEAR, STORE_ACTION_STORE,
+                                                       LOAD_ACTION_CLEAR, STORE_ACTION_DONT_CARE);
+            memcpy(desc.clearColor, cmd.frame.clearColor, sizeof(desc.clearColor));
+            // the first view carries the texture uploads, outside the pass
+            if(view == &ctx.views[0] && !ctx.rs.streamer.IsComplete())
+            {
+                ctx.rs.streamer.Update();
+                view->boundTexture = 0;
+            }
+            view->pass.Begin(desc);
+            break;
+        }
+        case CMD_CULL_GROUP:
+            // skip the meshes of a group hidden in the last test
+            if(!view->culler.BeginGroup(cmd.group.bounds.node, cmd.group.mvp,
+                                        cmd.group.bounds.boxMin, cmd.group.bounds.boxMax, cmd.group.children))
+            {
+                i += cmd.group.children;
+            }
+            break;
+        case CMD_DRAW_MESH:
+        {
+            if(!view->culler.BeginObject(cmd.mesh.bounds.node, cmd.mesh.mvp,
+                                         cmd.mesh.bounds.boxMin, cmd.mesh.bounds.boxMax))
+            {
+                break;
+            }
+            // time probe draws from idle to idle; the stall only hits the
+            // few draws the pre-pass decision is measured on
+            bool timed = false;
+            bool prepass = view->prepass.Next(&timed);
+            double start = 0.0;
+            if(timed)
+            {
+                glFinish();
+                start = GetNativeTime();
+            }
+            DrawMesh(*view->program, cmd.mesh, prepass, view->boundTexture);
+            if(timed)
+            {
+                glFinish();
+                view->prepass.Report(GetNativeTime() - start);
+            }
+            view->culler.EndObject();
+            break;
+        }
+        case CMD_END_FRAME:
+        {
+            DamageRect frameDamage(cmd.frame.damage[0], cmd.frame.damage[1], cmd.frame.damage[2], cmd.frame.damage[3]);
+            if(view->scissored)
+            {
+                glDisable(GL_SCISSOR_TEST);
+                view->scissored = false;
+            }
+            view->pass.End();
+            if(view->msaa.IsActive())
+            {
+                view->msaa.Resolve();
+            }
+            // flip the visible buffer
+            view->presenter.Swap(ctx.eglDisplay, view->eglSurface, frameDamage, view->viewportWidth, view->viewportHeight);
+            view->damage.Push(frameDamage);
+            view->culler.EndFrame();
+            GL_DEBUG_CHECK();
+            FrameTiming timing;
+            timing.inputTime = cmd.frame.inputTime;
+            timing.presentTime = GetNativeTime();
+            view->timings.TryPush(timing);
+            break;
+        }
+        case CMD_QUIT:
+            return false;
+        }
+    }
+    return true;
+}
+
+// Free the framebuffer objects the views created on the current context.
+void DestroyRenderTargets(esContext &ctx, EGLContext context)
+{
+    for(int i = 0; i < ctx.numViews; i++)
+    {
+        if(ctx.views[i].eglContext == context)
+        {
+            ctx.views[i].msaa.Destroy();
+            ctx.views[i].culler.Destroy();
+        }
+    }
+}
+
+// Owns the EGL context while the sample runs threaded: executes the frames
+// the main thread records for all views.
+void RenderThreadProc(void* arg)
+{
+    esContext& ctx = *(esContext*) arg;
+    bool running = true;
+    while(running)
+    {
+        CommandList* list = ctx.frames.BeginRead();
+        running = ExecuteCommands(ctx, *list);
+        ctx.frames.EndRead();
+    }
+    DestroyRenderTargets(ctx, eglGetCurrentContext());
+    eglMakeCurrent(ctx.eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+// Render thread of a single view when views render in parallel, each with
+// its own context.
+void ViewThreadProc(void* arg)
+{
+    SurfaceView& view = *(SurfaceView*) arg;
+    bool running = true;
+    while(running)
+    {
+        CommandList* list = view.frames.BeginRead();
+        running = ExecuteCommands(ctx, *list);
+        view.frames.EndRead();
+    }
+    DestroyRenderTargets(ctx, eglGetCurrentContext());
+    eglMakeCurrent(ctx.eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+bool ParseOptions(int argc, char** argv, Options& opts)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-model") == 0 && i + 1 < argc)
+        {
+            opts.modelPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "-texture") == 0 && i + 1 < argc)
+        {
+            opts.texturePath = argv[++i];
+        }
+        else if(strcmp(argv[i], "-texarray") == 0 && i + 1 < argc)
+        {
+            opts.textureLayers = argv[++i];
+        }
+        else if(strcmp(argv[i], "-lod") == 0 && i + 1 < argc)
+        {
+            opts.lodPixels = (float) atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-fps") == 0 && i + 1 < argc)
+        {
+            opts.targetFps = (float) atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-tick") == 0 && i + 1 < argc)
+        {
+            opts.tickRate = (float) atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-swapinterval") == 0 && i + 1 < argc)
+        {
+            opts.swapInterval = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-stats") == 0)
+        {
+            opts.stats = true;
+        }
+        else if(strcmp(argv[i], "-continuous") == 0)
+        {
+            opts.continuous = true;
+        }
+        else if(strcmp(argv[i], "-fullredraw") == 0)
+        {
+            opts.fullRedraw = true;
+        }
+        else if(strcmp(argv[i], "-threaded") == 0)
+        {
+            opts.threaded = true;
+        }
+        else if(strcmp(argv[i], "-parallel") == 0)
+        {
+            opts.threaded = true;
+            opts.parallel = true;
+        }
+        else if(strcmp(argv[i], "-msaa") == 0 && i + 1 < argc)
+        {
+            opts.msaaSamples = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-prepass") == 0 && i + 1 < argc)
+        {
+            ++i;
+            opts.prepass = (strcmp(argv[i], "on") == 0) ? DepthPrepassController::PREPASS_ON :
+                           (strcmp(argv[i], "auto") == 0) ? DepthPrepassController::PREPASS_AUTO :
+                           DepthPrepassController::PREPASS_OFF;
+        }
+        else if(strcmp(argv[i], "-instances") == 0 && i + 1 < argc)
+        {
+            opts.instances = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-occlusion") == 0)
+        {
+            opts.occlusion = true;
+        }
+        else if(strcmp(argv[i], "-cpuocclusion") == 0)
+        {
+            opts.cpuOcclusion = true;
+        }
+        else if(strcmp(argv[i], "-batch") == 0)
+        {
+            opts.batch = true;
+        }
+        else if(strcmp(argv[i], "-stream") == 0 && i + 1 < argc)
+        {
+            opts.uploadBudget = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-asyncshaders") == 0 && i + 1 < argc)
+        {
+            opts.shaderThreads = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-blobcache") == 0 && i + 1 < argc)
+        {
+            opts.blobCachePath = argv[++i];
+        }
+        else if(strcmp(argv[i], "-minify") == 0)
+        {
+            opts.minifyShaders = true;
+        }
+        else if(strcmp(argv[i], "-glstats") == 0)
+        {
+            opts.glStats = true;
+        }
+        else if(strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+        {
+            opts.tracePath = argv[++i];
+        }
+        else if(strcmp(argv[i], "-windows") == 0 && i + 1 < argc)
+        {
+            opts.numWindows = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-pbuffers") == 0 && i + 1 < argc)
+        {
+            opts.numPbuffers = atoi(argv[++i]);
+        }
+        else
+        {
+            printf("usage: %s [options]\n", argv[0]);
+            printf("  -model <file>   SBM model to display\n");
+            printf("  -texture <file> 24 bit BMP texture of the model, e.g. an atlas\n");
+            printf("  -texarray <file,file,...>  textures of a GLES3 texture array, one\n");
+            printf("                  layer per instance in turn\n");
+            printf("  -lod <pixels>   enable LOD selection, full detail at or above this size\n");
+            printf("  -fps <rate>     target frame rate, 0 for unpaced\n");
+            printf("  -tick <rate>    simulation steps per second\n");
+            printf("  -swapinterval <n>  eglSwapInterval value\n");
+            printf("  -stats          print frame rate and input latency every 5 seconds\n");
+            printf("  -continuous     redraw every frame instead of only when the view changes\n");
+            printf("  -fullredraw     always repaint and present the whole window\n");
+            printf("  -threaded       submit GL commands from a dedicated render thread\n");
+            printf("  -msaa <samples> render multisampled into a framebuffer object\n");
+            printf("  -prepass <off|on|auto>  depth pre-pass, auto picks it from measured cost\n");
+            printf("  -instances <n>  draw an n by n grid of models, n up to 6\n");
+            printf("  -occlusion      skip models hidden behind others using occlusion queries\n");
+            printf("  -cpuocclusion   skip models hidden behind others using a depth buffer\n");
+            printf("                  rasterized on the CPU\n");
+            printf("  -batch          merge the grid of models into one buffer, one draw per texture\n");
+            printf("  -stream <KB>    upload the texture in tiles, at most KB per frame\n");
+            printf("  -asyncshaders <n>  link programs on n threads, drawing a placeholder meanwhile\n");
+            printf("  -blobcache <dir>  keep compiled shader binaries in a directory shared by all runs\n");
+            printf("  -minify         hand the driver minified shader sources\n");
+            printf("  -glstats        print GL calls per frame every 5 seconds, needs a build\n");
+            printf("                  with GL_INTERCEPT defined\n");
+            printf("  -trace <file>   record every GL and EGL call for glreplay, needs GL_INTERCEPT\n");
+            printf("  -windows <n>    number of windows showing the model\n");
+            printf("  -pbuffers <n>   number of additional offscreen pbuffer surfaces\n");
+            printf("  -parallel       render each surface from its own thread and context\n");
+            return false;
+        }
+    }
+    if(opts.numWindows < 1 || opts.numPbuffers < 0 || opts.numWindows + opts.numPbuffers > esContext::MAX_VIEWS)
+    {
+        printf("Between 1 and %d windows and pbuffers are supported.\n", (int) esContext::MAX_VIEWS);
+        return false;
+    }
+    if(opts.instances < 1 || opts.instances * opts.instances > SurfaceView::MAX_INSTANCES)
+    {
+        printf("The grid of models can be between 1 and 6 models wide.\n");
+        return false;
+    }
+    if(opts.batch && (opts.lodPixels > 0.0f || opts.occlusion))
+    {
+        printf("-batch draws every model at full detail without queries; it cannot be\n"
+               "combined with -lod or -occlusion.\n");
+        return false;
+    }
+    return true;
 }
 
 int main(int argc, char** argv)
 {
-    ctx.nWindowWidth  = 640;
-    ctx.nWindowHeight = 480;
     int lRet = 0;
 
-    // create window and setup egl
+    if(!ParseOptions(argc, argv, ctx.opts))
+    {
+        return lRet;
+    }
+
+    // from the first EGL call on
+    if (ctx.opts.tracePath != NULL && !GLIntercept::Instance().StartTrace(ctx.opts.tracePath))
+    {
+        printf(GLIntercept::Instance().IsEnabled() ? "Could not write the trace %s.\n" :
+               "Built without GL_INTERCEPT, %s is not written.\n", ctx.opts.tracePath);
+    }
+
+    // create the windows and setup egl
     if(Setup(ctx) == GL_FALSE)
     {
         return lRet;
     }
+    GL_DEBUG_INSTALL();
+    GL_DEBUG_SITE();
+
+    // link programs on background contexts
+    if (ctx.opts.shaderThreads > 0 &&
+        !ctx.compiler.Init(ctx.eglDisplay, ctx.eglConfig, ctx.eglContext, ctx.contextAttribs, ctx.opts.shaderThreads))
+    {
+        printf("Could not start the shader threads, linking programs up front.\n");
+    }
+
+    // only the permutations the materials use are compiled
+    unsigned int material = SHADER_LIGHTING | ((ctx.opts.textureLayers != NULL) ? SHADER_TEXTURE_ARRAY : SHADER_TEXTURE);
+    ctx.rs.shaders.SetMinify(ctx.opts.minifyShaders);
+    ctx.rs.shadingVariant = ctx.rs.shaders.Reference(material);
+    if (ctx.compiler.IsEnabled())
+    {
+        ctx.rs.placeholderVariant = ctx.rs.shaders.Reference(SHADER_LIGHTING);
+    }
 
     // create the GLSL program
-    if (!CreateProgram(ctx))
+    if (ctx.rs.shadingVariant < 0 || !RequestProgram(ctx, ctx.rs.program))
     {
         printf("Failed to Setup state.\n");
         return lRet;
     }
 
     // load the model
-    if (!ctx.rs.ninja.LoadFromSBM("./ninja/ninja.sbm"))
+    if (!ctx.rs.ninja.LoadFromSBM(ctx.opts.modelPath) || !ctx.rs.ninja.CreateBuffers())
     {
         printf("Failed load the model.\n");
         return lRet;
     }
+    GL_DEBUG_LABEL(GL_BUFFER_OBJECT_EXT, ctx.rs.ninja.GetVertexBuffer(), "model vertices");
 
     // load the texture
     glActiveTexture(GL_TEXTURE0);
     glGenTextures(1, ctx.rs.ninjaTex);
     glBindTexture(GL_TEXTURE_2D, ctx.rs.ninjaTex[0]);
-    if (!LoadTexture(ctx))
+    GL_DEBUG_LABEL(GL_TEXTURE, ctx.rs.ninjaTex[0], "model texture");
+    if (ctx.opts.uploadBudget > 0 ?
+        !ctx.rs.streamer.Begin(ctx.opts.texturePath, ctx.rs.ninjaTex[0], ctx.opts.uploadBudget * 1024,
+                               ctx.opts.parallel && ctx.numViews > 1) :
+        !LoadTexture(ctx))
     {
         printf("Failed load the texture.\n");
         return lRet;
     }
+    if (ctx.opts.textureLayers != NULL && !LoadTextureArray(ctx))
+    {
+        printf("Failed load the texture array.\n");
+        return lRet;
+    }
+    // merge the instances, at full detail, into one static model
+    if (ctx.opts.batch)
+    {
+        for (int i = 0; i < ctx.opts.instances * ctx.opts.instances; i++)
+        {
+            GLfloat offset[3];
+            GLuint texture;
+            GLint layer;
+            GetInstanceOffset(ctx, i, offset);
+            GetInstanceMaterial(ctx, i, &texture, &layer);
+            mat4 transform(mat4::translate(offset[0], offset[1], offset[2]));
+            ctx.rs.batch.Add(&ctx.rs.ninja, ctx.rs.ninja.GetLODFrame(0), &transform.x.x, texture, layer);
+        }
+        if (!ctx.rs.batch.Build())
+        {
+            printf("Failed to batch the models, drawing them one by one.\n");
+            ctx.rs.batch.Destroy();
+        }
+    }
+
+    // occluders are rasterized by all cores
+    if (ctx.opts.cpuOcclusion)
+    {
+        BuildOccluder(ctx.rs, 128);
+        if (!ctx.rs.occluder.empty())
+        {
+            ctx.softCuller.Init(GetNativeCpuCount());
+        }
+    }
+
+    // contexts sharing the objects only see them once the uploads completed
+    glFinish();
+    GL_DEBUG_CHECK();
+
+    // every context drawing concurrently links its own program
+    for (int i = 0; i < ctx.numViews; i++)
+    {
+        SurfaceView& view = ctx.views[i];
+        for (int j = 0; j < SurfaceView::MAX_INSTANCES; j++)
+        {
+            view.lod[j].SetFullDetailSize(ctx.opts.lodPixels);
+        }
+        view.program = &ctx.rs.program;
+        if (view.eglContext != ctx.eglContext)
+        {
+            eglMakeCurrent(ctx.eglDisplay, view.eglSurface, view.eglSurface, view.eglContext);
+            GL_DEBUG_INSTALL();
+            if (!RequestProgram(ctx, view.ownProgram))
+            {
+                printf("Failed to Setup state.\n");
+                return lRet;
+            }
+            view.program = &view.ownProgram;
+        }
+    }
+
+    // hand the contexts over to the render threads
+    if (ctx.opts.threaded)
+    {
+        eglMakeCurrent(ctx.eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        bool started = true;
+        if (ctx.opts.parallel)
+        {
+            for (int i = 0; i < ctx.numViews && started; i++)
+            {
+                SurfaceView& view = ctx.views[i];
+                started = view.frames.Init() && CreateNativeThread(ViewThreadProc, &view, &view.renderThread);
+            }
+        }
+        else
+        {
+            started = ctx.frames.Init() && CreateNativeThread(RenderThreadProc, &ctx, &ctx.renderThread);
+        }
+        if (!started)
+        {
+            printf("Failed to start the render thread.\n");
+            return lRet;
+        }
+    }
 
     // main loop
-    while (UpdateNativeWin(ctx.nativeDisplay, ctx.nativeWin))
+    FrameScheduler& sched = ctx.sched;
+    CommandList list;
+    FrameTiming timing;
+    sched.SetSimulationRate(ctx.opts.tickRate);
+    sched.SetTargetFrameRate(ctx.opts.targetFps);
+    sched.SetReportInterval(ctx.opts.stats ? 5.0 : 0.0);
+    GLIntercept::Instance().SetReportInterval(ctx.opts.glStats ? 5.0 : 0.0);
+    sched.Start();
+    while (UpdateNativeWin(ctx.nativeDisplay, ctx.views[0].nativeWin))
     {
-        // render the model
-        Render(ctx);
+        // keep drawing while the texture is still arriving or programs link
+        if (ctx.opts.continuous || !ctx.rs.streamer.IsComplete() || ctx.compiler.GetPendingCount() > 0)
+        {
+            MarkViewsDirty(DIRTY_VIEW);
+        }
+        // and while occlusion queries may still show hidden models. Frames
+        // the render threads have not executed yet may leave some, so their
+        // outcome is polled for; it is only current once none are queued.
+        bool queued = false;
+        for (int i = 0; i < ctx.numViews; i++)
+        {
+            bool viewQueued = ctx.views[i].culler.HasQueuedFrames();
+            if (ctx.views[i].culler.HasPendingWork())
+            {
+                ctx.views[i].dirty |= DIRTY_VIEW;
+            }
+            queued = queued || viewQueued;
+        }
+        // with nothing to draw and the camera at rest on its target, sleep
+        // in the window system until the next event arrives
+        bool atTarget = ctx.rs.yaw == ctx.rs.targetYaw && ctx.rs.pitch == ctx.rs.targetPitch;
+        if (!AnyViewDirty() && !ctx.rs.moving && atTarget)
+        {
+            WaitNativeWin(ctx.nativeDisplay, ctx.views[0].nativeWin, queued ? 0.005 : -1.0);
+            sched.Resume();
+            continue;
+        }
+        // advance the camera in fixed steps
+        sched.BeginFrame();
+        while (sched.Step())
+        {
+            Simulate(ctx, sched.GetTimestep());
+        }
+        // render the views in which something changed
+        bool rendered = false;
+        if (AnyViewDirty())
+        {
+            double inputTime = sched.TakeInputTime();
+            if (ctx.opts.parallel)
+            {
+                for (int i = 0; i < ctx.numViews; i++)
+                {
+                    SurfaceView& view = ctx.views[i];
+                    if (view.dirty == 0)
+                    {
+                        continue;
+                    }
+                    // blocks while the view's thread is two frames behind
+                    CommandList* frame = view.frames.BeginWrite();
+                    frame->Reset();
+                    rendered = RecordView(ctx, view, sched.GetAlpha(), inputTime, *frame) || rendered;
+                    view.frames.EndWrite();
+                }
+            }
+            else
+            {
+                // blocks while the render thread is two frames behind
+                CommandList* frame = ctx.opts.threaded ? ctx.frames.BeginWrite() : &list;
+                frame->Reset();
+                for (int i = 0; i < ctx.numViews; i++)
+                {
+                    if (ctx.views[i].dirty != 0)
+                    {
+                        rendered = RecordView(ctx, ctx.views[i], sched.GetAlpha(), inputTime, *frame) || rendered;
+                    }
+                }
+                if (ctx.opts.threaded)
+                {
+                    ctx.frames.EndWrite();
+                }
+                else
+                {
+                    ExecuteCommands(ctx, list);
+                }
+            }
+        }
+        for (int i = 0; i < ctx.numViews; i++)
+        {
+            while (ctx.views[i].timings.TryPop(timing))
+            {
+                sched.NotePresented(timing);
+            }
+        }
+        if (rendered)
+        {
+            GLIntercept::Instance().EndFrame();
+        }
+        sched.EndFrame(rendered);
     }
 
-    eglMakeCurrent(EGL_NO_DISPLAY, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (ctx.opts.parallel)
+    {
+        for (int i = 0; i < ctx.numViews; i++)
+        {
+            SurfaceView& view = ctx.views[i];
+            CommandList* frame = view.frames.BeginWrite();
+            frame->Reset();
+            frame->Add(CMD_QUIT);
+            view.frames.EndWrite();
+            JoinNativeThread(view.renderThread);
+        }
+    }
+    else if (ctx.opts.threaded)
+    {
+        CommandList* frame = ctx.frames.BeginWrite();
+        frame->Reset();
+        frame->Add(CMD_QUIT);
+        ctx.frames.EndWrite();
+        JoinNativeThread(ctx.renderThread);
+    }
+    else
+    {
+        DestroyRenderTargets(ctx, eglGetCurrentContext());
+    }
+
+    ctx.softCuller.Destroy();
+    ctx.rs.streamer.End();
+    ctx.compiler.Destroy();
+    eglMakeCurrent(ctx.eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    DestroyViews(ctx);
     eglDestroyContext(ctx.eglDisplay, ctx.eglContext);
-    eglDestroySurface(ctx.eglDisplay, ctx.eglSurface);
     eglTerminate(ctx.eglDisplay);
-    DestroyNativeWin(ctx.nativeDisplay, ctx.nativeWin);
+    GLIntercept::Instance().StopTrace();
+    GL_DEBUG_REPORT();
     CloseNativeDisplay(ctx.nativeDisplay);
+    if (ctx.opts.stats && ctx.blobCache.IsOpen())
+    {
+        ctx.blobCache.PrintStats();
+    }
+    ctx.blobCache.Close();
 
     return lRet;
 }
@@ -0,0 +1,403 @@
+#ifndef __MESHSIMPLIFY_H__
+#define __MESHSIMPLIFY_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <vector>
+
+// Quadric error metric simplifier (Garland/Heckbert) for the non-indexed
+// triangle lists stored in SBM frames.
+//
+// Input vertices are interleaved floats, 'stride' floats per vertex, with the
+// xyz position in the first three floats. Vertices with identical attributes
+// are welded before simplification. Collapses are half-edge collapses onto an
+// existing vertex, so normals and texture coordinates are never interpolated.
+// Vertices that share a position with a differently attributed vertex (uv or
+// normal seams) are never moved, which keeps seams crack free.
+//
+// Simplification is progressive: calling SimplifyTo() with decreasing
+// targets produces a chain of LODs, each derived from the previous one.
+class MeshSimplifier
+{
+public:
+    MeshSimplifier(const float* vertices, unsigned int numVertices, unsigned int stride)
+        : m_stride(stride), m_liveTris(0)
+    {
+        Weld(vertices, numVertices);
+        BuildQuadrics();
+        for(unsigned int f = 0; f < m_indices.size() / 3; f++)
+        {
+            PushFaceEdges(f);
+        }
+    }
+
+    unsigned int GetTriangleCount() const
+    {
+        return m_liveTris;
+    }
+
+    // Collapse edges in order of increasing error until at most
+    // targetTriangles remain or no valid collapse is left.
+    unsigned int SimplifyTo(unsigned int targetTriangles)
+    {
+        while(m_liveTris > targetTriangles && !m_heap.empty())
+        {
+            Collapse c = m_heap.top();
+            m_heap.pop();
+            if(m_removed[c.u] || m_removed[c.v] ||
+               m_version[c.u] != c.uver || m_version[c.v] != c.vver)
+            {
+                continue;
+            }
+            if(!CanCollapse(c.u, c.v))
+            {
+                continue;
+            }
+            DoCollapse(c.u, c.v);
+        }
+        return m_liveTris;
+    }
+
+    // Append the current mesh to 'out' as a non-indexed interleaved triangle
+    // list. Returns the number of vertices written.
+    unsigned int Extract(std::vector<float>& out) const
+    {
+        unsigned int count = 0;
+        for(unsigned int f = 0; f < m_faceAlive.size(); f++)
+        {
+            if(!m_faceAlive[f])
+                continue;
+            for(int k = 0; k < 3; k++)
+            {
+                const float* v = &m_vertices[m_indices[f*3+k] * m_stride];
+                out.insert(out.end(), v, v + m_stride);
+                count++;
+            }
+        }
+        return count;
+    }
+
+private:
+    struct Quadric
+    {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+        Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0)
+        {
+        }
+
+        void AddPlane(double a, double b, double c, double d, double w)
+        {
+            a2 += w*a*a; ab += w*a*b; ac += w*a*c; ad += w*a*d;
+            b2 += w*b*b; bc += w*b*c; bd += w*b*d;
+            c2 += w*c*c; cd += w*c*d;
+            d2 += w*d*d;
+        }
+
+        void Add(const Quadric& q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+        }
+
+        double Evaluate(double x, double y, double z) const
+        {
+            return a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x
+                 + b2*y*y + 2*bc*y*z + 2*bd*y
+                 + c2*z*z + 2*cd*z
+                 + d2;
+        }
+    };
+
+    struct Collapse
+    {
+        double cost;
+        unsigned int u;
+        unsigned int v;
+        unsigned int uver;
+        unsigned int vver;
+
+        bool operator >(const Collapse& other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    struct VertexLess
+    {
+        const float* data;
+        unsigned int stride;
+        unsigned int compare;
+
+        bool operator ()(unsigned int a, unsigned int b) const
+        {
+            const float* va = data + a * stride;
+            const float* vb = data + b * stride;
+            for(unsigned int i = 0; i < compare; i++)
+            {
+                if(va[i] != vb[i])
+                    return va[i] < vb[i];
+            }
+            return a < b;
+        }
+    };
+
+    const float* Pos(unsigned int v) const
+    {
+        return &m_vertices[v * m_stride];
+    }
+
+    void Weld(const float* vertices, unsigned int numVertices)
+    {
+        std::vector<unsigned int> order(numVertices);
+        for(unsigned int i = 0; i < numVertices; i++)
+            order[i] = i;
+        VertexLess less;
+        less.data = vertices;
+        less.stride = m_stride;
+        less.compare = m_stride;
+        std::sort(order.begin(), order.end(), less);
+
+        std::vector<unsigned int> remap(numVertices);
+        for(unsigned int i = 0; i < numVertices; i++)
+        {
+            const float* v = vertices + order[i] * m_stride;
+            if(i == 0 || memcmp(v, vertices + order[i-1] * m_stride, m_stride * sizeof(float)) != 0)
+            {
+                m_vertices.insert(m_vertices.end(), v, v + m_stride);
+            }
+            remap[order[i]] = (unsigned int)(m_vertices.size() / m_stride) - 1;
+        }
+
+        unsigned int numUnique = (unsigned int)(m_vertices.size() / m_stride);
+        m_removed.assign(numUnique, false);
+        m_locked.assign(numUnique, false);
+        m_version.assign(numUnique, 0);
+        m_faces.resize(numUnique);
+
+        // drop triangles that are degenerate after welding
+        for(unsigned int i = 0; i + 2 < numVertices; i += 3)
+        {
+            unsigned int a = remap[i], b = remap[i+1], c = remap[i+2];
+            if(a == b || b == c || a == c)
+                continue;
+            unsigned int f = (unsigned int)(m_indices.size() / 3);
+            m_indices.push_back(a);
+            m_indices.push_back(b);
+            m_indices.push_back(c);
+            m_faceAlive.push_back(true);
+            m_faces[a].push_back(f);
+            m_faces[b].push_back(f);
+            m_faces[c].push_back(f);
+            m_liveTris++;
+        }
+
+        // lock vertices whose position is shared with another unique vertex
+        std::vector<unsigned int> unique(numUnique);
+        for(unsigned int i = 0; i < numUnique; i++)
+            unique[i] = i;
+        less.data = &m_vertices[0];
+        less.compare = 3;
+        std::sort(unique.begin(), unique.end(), less);
+        for(unsigned int i = 1; i < numUnique; i++)
+        {
+            if(memcmp(Pos(unique[i]), Pos(unique[i-1]), 3 * sizeof(float)) == 0)
+            {
+                m_locked[unique[i]] = true;
+                m_locked[unique[i-1]] = true;
+            }
+        }
+    }
+
+    bool FaceNormal(unsigned int a, unsigned int b, unsigned int c, double n[3]) const
+    {
+        const float* pa = Pos(a);
+        const float* pb = Pos(b);
+        const float* pc = Pos(c);
+        double e1[3] = { pb[0]-pa[0], pb[1]-pa[1], pb[2]-pa[2] };
+        double e2[3] = { pc[0]-pa[0], pc[1]-pa[1], pc[2]-pa[2] };
+        n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+        n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+        n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+        double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if(len <= 0.0)
+            return false;
+        n[0] /= len; n[1] /= len; n[2] /= len;
+        return true;
+    }
+
+    void BuildQuadrics()
+    {
+        m_quadrics.assign(m_removed.size(), Quadric());
+
+        // count edge usage to find open borders
+        std::vector<std::pair<unsigned int, unsigned int> > edges;
+        unsigned int numFaces = (unsigned int)(m_indices.size() / 3);
+        for(unsigned int f = 0; f < numFaces; f++)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                unsigned int a = m_indices[f*3+k];
+                unsigned int b = m_indices[f*3+(k+1)%3];
+                edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        for(unsigned int f = 0; f < numFaces; f++)
+        {
+            unsigned int idx[3] = { m_indices[f*3], m_indices[f*3+1], m_indices[f*3+2] };
+            double n[3];
+            if(!FaceNormal(idx[0], idx[1], idx[2], n))
+                continue;
+            const float* p0 = Pos(idx[0]);
+            double d = -(n[0]*p0[0] + n[1]*p0[1] + n[2]*p0[2]);
+            for(int k = 0; k < 3; k++)
+            {
+                m_quadrics[idx[k]].AddPlane(n[0], n[1], n[2], d, 1.0);
+            }
+
+            // constrain border edges with a heavily weighted perpendicular plane
+            for(int k = 0; k < 3; k++)
+            {
+                unsigned int a = idx[k];
+                unsigned int b = idx[(k+1)%3];
+                std::pair<unsigned int, unsigned int> e(std::min(a, b), std::max(a, b));
+                std::pair<std::vector<std::pair<unsigned int, unsigned int> >::iterator,
+                          std::vector<std::pair<unsigned int, unsigned int> >::iterator> range =
+                    std::equal_range(edges.begin(), edges.end(), e);
+                if(range.second - range.first != 1)
+                    continue;
+                const float* pa = Pos(a);
+                const float* pb = Pos(b);
+                double ed[3] = { pb[0]-pa[0], pb[1]-pa[1], pb[2]-pa[2] };
+                double bn[3] = { ed[1]*n[2] - ed[2]*n[1], ed[2]*n[0] - ed[0]*n[2], ed[0]*n[1] - ed[1]*n[0] };
+                double len = sqrt(bn[0]*bn[0] + bn[1]*bn[1] + bn[2]*bn[2]);
+                if(len <= 0.0)
+                    continue;
+                bn[0] /= len; bn[1] /= len; bn[2] /= len;
+                double bd = -(bn[0]*pa[0] + bn[1]*pa[1] + bn[2]*pa[2]);
+                m_quadrics[a].AddPlane(bn[0], bn[1], bn[2], bd, 100.0);
+                m_quadrics[b].AddPlane(bn[0], bn[1], bn[2], bd, 100.0);
+            }
+        }
+    }
+
+    void PushCollapse(unsigned int u, unsigned int v)
+    {
+        if(m_locked[u])
+            return;
+        Quadric q = m_quadrics[u];
+        q.Add(m_quadrics[v]);
+        const float* p = Pos(v);
+        Collapse c;
+        c.cost = q.Evaluate(p[0], p[1], p[2]);
+        c.u = u;
+        c.v = v;
+        c.uver = m_version[u];
+        c.vver = m_version[v];
+        m_heap.push(c);
+    }
+
+    void PushFaceEdges(unsigned int f)
+    {
+        for(int k = 0; k < 3; k++)
+        {
+            unsigned int a = m_indices[f*3+k];
+            unsigned int b = m_indices[f*3+(k+1)%3];
+            PushCollapse(a, b);
+            PushCollapse(b, a);
+        }
+    }
+
+    // Reject collapses that would flip or degenerate a surviving face.
+    bool CanCollapse(unsigned int u, unsigned int v) const
+    {
+        const std::vector<unsigned int>& faces = m_faces[u];
+        for(unsigned int i = 0; i < faces.size(); i++)
+        {
+            unsigned int f = faces[i];
+            if(!m_faceAlive[f])
+                continue;
+            unsigned int idx[3] = { m_indices[f*3], m_indices[f*3+1], m_indices[f*3+2] };
+            if(idx[0] == v || idx[1] == v || idx[2] == v)
+                continue;
+            double before[3];
+            if(!FaceNormal(idx[0], idx[1], idx[2], before))
+                continue;
+            for(int k = 0; k < 3; k++)
+            {
+                if(idx[k] == u)
+                    idx[k] = v;
+            }
+            double after[3];
+            if(!FaceNormal(idx[0], idx[1], idx[2], after))
+                return false;
+            if(before[0]*after[0] + before[1]*after[1] + before[2]*after[2] < 0.2)
+                return false;
+        }
+        return true;
+    }
+
+    void DoCollapse(unsigned int u, unsigned int v)
+    {
+        std::vector<unsigned int>& faces = m_faces[u];
+        for(unsigned int i = 0; i < faces.size(); i++)
+        {
+            unsigned int f = faces[i];
+            if(!m_faceAlive[f])
+                continue;
+            unsigned int* idx = &m_indices[f*3];
+            if(idx[0] == v || idx[1] == v || idx[2] == v)
+            {
+                m_faceAlive[f] = false;
+                m_liveTris--;
+                continue;
+            }
+            for(int k = 0; k < 3; k++)
+            {
+                if(idx[k] == u)
+                    idx[k] = v;
+            }
+            m_faces[v].push_back(f);
+        }
+        std::vector<unsigned int>().swap(faces);
+
+        m_removed[u] = true;
+        m_quadrics[v].Add(m_quadrics[u]);
+        m_version[v]++;
+
+        // drop dead faces from v and requeue its edges with the merged quadric
+        std::vector<unsigned int>& vfaces = m_faces[v];
+        unsigned int live = 0;
+        for(unsigned int i = 0; i < vfaces.size(); i++)
+        {
+            if(m_faceAlive[vfaces[i]])
+            {
+                vfaces[live++] = vfaces[i];
+                PushFaceEdges(vfaces[i]);
+            }
+        }
+        vfaces.resize(live);
+    }
+
+    unsigned int m_stride;
+    unsigned int m_liveTris;
+
+    std::vector<float> m_vertices;
+    std::vector<unsigned int> m_indices;
+    std::vector<bool> m_faceAlive;
+    std::vector<std::vector<unsigned int> > m_faces;
+    std::vector<Quadric> m_quadrics;
+    std::vector<bool> m_removed;
+    std::vector<bool> m_locked;
+    std::vector<unsigned int> m_version;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > m_heap;
+};
+
+#endif /* __MESHSIMPLIFY_H__ */
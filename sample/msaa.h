@@ -0,0 +1,295 @@
+#ifndef __MSAA_H__
+#define __MSAA_H__
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "renderpass.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Multisampled offscreen target the frame is rendered into before it is
+// resolved to the window surface.
+//
+// With GL_EXT_multisampled_render_to_texture the samples live only in tile
+// memory and are resolved into a single sampled texture when the tile is
+// flushed, which is then copied to the window. Otherwise
+// GL_ANGLE_framebuffer_multisample renderbuffers are resolved straight into
+// the window with glBlitFramebufferANGLE. Either way the multisample data is
+// invalidated once resolved, so it is never written back to memory.
+//
+// The target holds framebuffer objects, which are not shared between
+// contexts, so it must be created, used and destroyed on one context.
+class MultisampleTarget
+{
+public:
+    enum Mode
+    {
+        MODE_NONE,
+        MODE_RENDER_TO_TEXTURE,     // GL_EXT_multisampled_render_to_texture
+        MODE_BLIT                   // GL_ANGLE_framebuffer_multisample + blit
+    };
+
+    MultisampleTarget() :
+        m_mode(MODE_NONE), m_samples(0), m_width(0), m_height(0),
+        m_fbo(0), m_colorTex(0), m_colorRb(0), m_depthRb(0),
+        m_copyProgram(0), m_copyPosLoc(-1), m_copyTexLoc(-1),
+        m_renderbufferStorageMultisampleEXT(NULL), m_framebufferTexture2DMultisampleEXT(NULL),
+        m_renderbufferStorageMultisampleANGLE(NULL), m_blitFramebufferANGLE(NULL)
+    {}
+
+    // Pick a path for the current context and clamp the requested sample
+    // count to what it supports. Returns false if no multisampled
+    // framebuffer extension is available.
+    bool Init(GLsizei samples)
+    {
+        if(HasGLExtension("GL_EXT_multisampled_render_to_texture"))
+        {
+            m_renderbufferStorageMultisampleEXT = (PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC) eglGetProcAddress("glRenderbufferStorageMultisampleEXT");
+            m_framebufferTexture2DMultisampleEXT = (PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC) eglGetProcAddress("glFramebufferTexture2DMultisampleEXT");
+            if(m_renderbufferStorageMultisampleEXT != NULL && m_framebufferTexture2DMultisampleEXT != NULL && CreateCopyProgram())
+            {
+                m_mode = MODE_RENDER_TO_TEXTURE;
+            }
+        }
+        if(m_mode == MODE_NONE &&
+           HasGLExtension("GL_ANGLE_framebuffer_multisample") && HasGLExtension("GL_ANGLE_framebuffer_blit"))
+        {
+            m_renderbufferStorageMultisampleANGLE = (PFNGLRENDERBUFFERSTORAGEMULTISAMPLEANGLEPROC) eglGetProcAddress("glRenderbufferStorageMultisampleANGLE");
+            m_blitFramebufferANGLE = (PFNGLBLITFRAMEBUFFERANGLEPROC) eglGetProcAddress("glBlitFramebufferANGLE");
+            if(m_renderbufferStorageMultisampleANGLE != NULL && m_blitFramebufferANGLE != NULL)
+            {
+                m_mode = MODE_BLIT;
+            }
+        }
+        if(m_mode == MODE_NONE)
+        {
+            return false;
+        }
+        m_window.Init();
+
+        // GL_MAX_SAMPLES_EXT and GL_MAX_SAMPLES_ANGLE share one value
+        GLint maxSamples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES_EXT, &maxSamples);
+        m_samples = (samples < maxSamples) ? samples : maxSamples;
+        return m_samples > 0;
+    }
+
+    // (Re)allocate the attachments for a new window size.
+    bool Resize(GLsizei width, GLsizei height)
+    {
+        DestroyAttachments();
+        m_width = width;
+        m_height = height;
+        if(m_mode == MODE_NONE || width <= 0 || height <= 0)
+        {
+            return false;
+        }
+
+        glGenFramebuffers(1, &m_fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+        glGenRenderbuffers(1, &m_depthRb);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_depthRb);
+        if(m_mode == MODE_RENDER_TO_TEXTURE)
+        {
+            glGenTextures(1, &m_colorTex);
+            glBindTexture(GL_TEXTURE_2D, m_colorTex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            m_framebufferTexture2DMultisampleEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTex, 0, m_samples);
+            m_renderbufferStorageMultisampleEXT(GL_RENDERBUFFER, m_samples, GL_DEPTH_COMPONENT16, width, height);
+        }
+        else
+        {
+            m_renderbufferStorageMultisampleANGLE(GL_RENDERBUFFER, m_samples, GL_DEPTH_COMPONENT16, width, height);
+            glGenRenderbuffers(1, &m_colorRb);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_colorRb);
+            m_renderbufferStorageMultisampleANGLE(GL_RENDERBUFFER, m_samples, GL_RGBA8_OES, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRb);
+        }
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRb);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if(status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            printf("Multisample framebuffer incomplete (0x%04x).\n", status);
+            DestroyAttachments();
+            return false;
+        }
+        return true;
+    }
+
+    // Framebuffer object to render into.
+    GLuint GetFramebuffer() const
+    {
+        return m_fbo;
+    }
+
+    // Resolve the samples into the window surface, which is overwritten
+    // entirely and needs no depth. Call once the pass rendering into the
+    // target ended; its depth should have been declared STORE_ACTION_DONT_CARE.
+    // Leaves the window framebuffer bound.
+    void Resolve()
+    {
+        m_window.Begin(RenderPass::Describe(0, LOAD_ACTION_DONT_CARE, STORE_ACTION_STORE,
+                                            LOAD_ACTION_DONT_CARE, STORE_ACTION_DONT_CARE));
+        if(m_mode == MODE_BLIT)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER_ANGLE, m_fbo);
+            m_blitFramebufferANGLE(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            // the samples were only needed for the blit
+            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+            m_window.GetInvalidator().Invalidate(GL_COLOR_BUFFER_BIT, false);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        else if(m_mode == MODE_RENDER_TO_TEXTURE)
+        {
+            // the color samples were resolved into the texture when the
+            // target was unbound
+            CopyToWindow();
+        }
+        m_window.End();
+    }
+
+    void Destroy()
+    {
+        DestroyAttachments();
+        if(m_copyProgram != 0)
+        {
+            glDeleteProgram(m_copyProgram);
+            m_copyProgram = 0;
+        }
+        m_mode = MODE_NONE;
+    }
+
+    bool IsActive() const
+    {
+        return m_fbo != 0;
+    }
+
+    Mode GetMode() const
+    {
+        return m_mode;
+    }
+
+    GLsizei GetSamples() const
+    {
+        return m_samples;
+    }
+
+private:
+    void DestroyAttachments()
+    {
+        if(m_fbo != 0)
+        {
+            glDeleteFramebuffers(1, &m_fbo);
+            m_fbo = 0;
+        }
+        if(m_colorTex != 0)
+        {
+            glDeleteTextures(1, &m_colorTex);
+            m_colorTex = 0;
+        }
+        if(m_colorRb != 0)
+        {
+            glDeleteRenderbuffers(1, &m_colorRb);
+            m_colorRb = 0;
+        }
+        if(m_depthRb != 0)
+        {
+            glDeleteRenderbuffers(1, &m_depthRb);
+            m_depthRb = 0;
+        }
+    }
+
+    bool CreateCopyProgram()
+    {
+        const GLchar* vsSource =
+          "attribute vec2 position;"
+          "varying vec2 vTexCoord;"
+          "void main()"
+          "{"
+          "   vTexCoord   = position * 0.5 + 0.5;"
+          "   gl_Position = vec4(position, 0.0, 1.0);"
+          "}";
+        const GLchar* fsSource =
+          "precision mediump float;"
+          "uniform sampler2D source;"
+          "varying vec2 vTexCoord;"
+          "void main()"
+          "{"
+          "  gl_FragColor = texture2D(source, vTexCoord);"
+          "}";
+        GLint status = 0;
+        GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vs, 1, &vsSource, NULL);
+        glCompileShader(vs);
+        GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fs, 1, &fsSource, NULL);
+        glCompileShader(fs);
+        GLuint po = glCreateProgram();
+        glAttachShader(po, vs);
+        glAttachShader(po, fs);
+        glLinkProgram(po);
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        glGetProgramiv(po, GL_LINK_STATUS, &status);
+        if(!status)
+        {
+            printf("Failed to link the multisample resolve program.\n");
+            glDeleteProgram(po);
+            return false;
+        }
+        m_copyProgram = po;
+        m_copyPosLoc = glGetAttribLocation(po, "position");
+        m_copyTexLoc = glGetUniformLocation(po, "source");
+        return true;
+    }
+
+    void CopyToWindow() const
+    {
+        static const GLfloat quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+        glUseProgram(m_copyProgram);
+        glUniform1i(m_copyTexLoc, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_colorTex);
+        glVertexAttribPointer(m_copyPosLoc, 2, GL_FLOAT, GL_FALSE, 0, quad);
+        glEnableVertexAttribArray(m_copyPosLoc);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glDisableVertexAttribArray(m_copyPosLoc);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glUseProgram(0);
+    }
+
+    Mode    m_mode;
+    GLsizei m_samples;
+    GLsizei m_width;
+    GLsizei m_height;
+
+    GLuint  m_fbo;
+    GLuint  m_colorTex;
+    GLuint  m_colorRb;
+    GLuint  m_depthRb;
+
+    GLuint  m_copyProgram;
+    GLint   m_copyPosLoc;
+    GLint   m_copyTexLoc;
+
+    PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC      m_renderbufferStorageMultisampleEXT;
+    PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC     m_framebufferTexture2DMultisampleEXT;
+    PFNGLRENDERBUFFERSTORAGEMULTISAMPLEANGLEPROC    m_renderbufferStorageMultisampleANGLE;
+    PFNGLBLITFRAMEBUFFERANGLEPROC                   m_blitFramebufferANGLE;
+
+    // pass writing the resolved frame to the window
+    RenderPass  m_window;
+};
+
+#endif // __MSAA_H__
@@ -0,0 +1,41 @@
+#ifndef __NATIVEFILE_H__
+#define __NATIVEFILE_H__
+
+#include <stddef.h>
+
+typedef void* NativeFile;
+
+// Map a whole file read-only into memory. Pages are read on first access,
+// so mapping a large file is cheap and its contents can be consumed
+// piecemeal.
+bool MapNativeFile(const char* filename, NativeFile* file_out, const void** data_out, size_t* size_out);
+
+void UnmapNativeFile(NativeFile file);
+
+typedef void* NativeSharedFile;
+
+// Open or create a file that several processes read and write through a
+// shared mapping of its first size bytes. A shorter file is extended with
+// zeros.
+bool OpenNativeSharedFile(const char* filename, size_t size, NativeSharedFile* file_out, void** data_out);
+
+void CloseNativeSharedFile(NativeSharedFile file);
+
+// Exclusive lock of the file against other processes, blocking until it is
+// granted. Threads of one process are not excluded from each other.
+void LockNativeSharedFile(NativeSharedFile file);
+
+void UnlockNativeSharedFile(NativeSharedFile file);
+
+// Replace a file in one step: it is written to a temporary file, flushed to
+// disk and renamed, so readers find the old or the new contents, never part
+// of them, even if the process dies while writing. The rename is flushed as
+// well before this returns.
+bool ReplaceNativeFile(const char* filename, const void* data, size_t size);
+
+bool DeleteNativeFile(const char* filename);
+
+// Create a directory; succeeds if it already exists.
+bool CreateNativeDirectory(const char* path);
+
+#endif // __NATIVEFILE_H__
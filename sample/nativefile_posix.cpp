@@ -0,0 +1,186 @@
+#include "nativefile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct FileMapping
+{
+    void* data;
+    size_t size;
+};
+
+bool MapNativeFile(const char* filename, NativeFile* file_out, const void** data_out, size_t* size_out)
+{
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        return false;
+    }
+    FileMapping* mapping = (FileMapping*) malloc(sizeof(FileMapping));
+    mapping->data = data;
+    mapping->size = (size_t) st.st_size;
+    *file_out = (NativeFile) mapping;
+    *data_out = data;
+    *size_out = mapping->size;
+    return true;
+}
+
+void UnmapNativeFile(NativeFile file)
+{
+    FileMapping* mapping = (FileMapping*) file;
+    munmap(mapping->data, mapping->size);
+    free(mapping);
+}
+
+struct SharedMapping
+{
+    int fd;
+    void* data;
+    size_t size;
+};
+
+bool OpenNativeSharedFile(const char* filename, size_t size, NativeSharedFile* file_out, void** data_out)
+{
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || ((size_t) st.st_size < size && ftruncate(fd, (off_t) size) != 0))
+    {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(data == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+    SharedMapping* mapping = (SharedMapping*) malloc(sizeof(SharedMapping));
+    mapping->fd = fd;
+    mapping->data = data;
+    mapping->size = size;
+    *file_out = (NativeSharedFile) mapping;
+    *data_out = data;
+    return true;
+}
+
+void CloseNativeSharedFile(NativeSharedFile file)
+{
+    SharedMapping* mapping = (SharedMapping*) file;
+    munmap(mapping->data, mapping->size);
+    close(mapping->fd);
+    free(mapping);
+}
+
+static void SetLock(int fd, short type)
+{
+    struct flock lock;
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = 0;
+    lock.l_len = 0;
+    while(fcntl(fd, F_SETLKW, &lock) != 0 && errno == EINTR)
+    {
+    }
+}
+
+void LockNativeSharedFile(NativeSharedFile file)
+{
+    SetLock(((SharedMapping*) file)->fd, F_WRLCK);
+}
+
+void UnlockNativeSharedFile(NativeSharedFile file)
+{
+    SetLock(((SharedMapping*) file)->fd, F_UNLCK);
+}
+
+// Flush the directory holding a file, so that a rename into it is on disk.
+static bool SyncDirectory(const char* filename)
+{
+    char dir[1024];
+    const char* slash = strrchr(filename, '/');
+    size_t length = (slash != NULL) ? (size_t) (slash - filename) : 0;
+    if(length >= sizeof(dir))
+    {
+        return false;
+    }
+    memcpy(dir, filename, length);
+    strcpy(dir + length, (slash == NULL) ? "." : (length == 0) ? "/" : "");
+    int fd = open(dir, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+bool ReplaceNativeFile(const char* filename, const void* data, size_t size)
+{
+    // unique per process, so concurrent writers never share a temporary
+    char temp[1024];
+    if(snprintf(temp, sizeof(temp), "%s.%ld.tmp", filename, (long) getpid()) >= (int) sizeof(temp))
+    {
+        return false;
+    }
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        return false;
+    }
+    const char* bytes = (const char*) data;
+    size_t written = 0;
+    while(written < size)
+    {
+        ssize_t n = write(fd, bytes + written, size - written);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            break;
+        }
+        written += (size_t) n;
+    }
+    bool ok = written == size && fsync(fd) == 0;
+    close(fd);
+    if(!ok || rename(temp, filename) != 0)
+    {
+        unlink(temp);
+        return false;
+    }
+    return SyncDirectory(filename);
+}
+
+bool DeleteNativeFile(const char* filename)
+{
+    return unlink(filename) == 0;
+}
+
+bool CreateNativeDirectory(const char* path)
+{
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
@@ -0,0 +1,153 @@
+#include "nativefile.h"
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct FileMapping
+{
+    HANDLE file;
+    HANDLE mapping;
+    const void* data;
+};
+
+bool MapNativeFile(const char* filename, NativeFile* file_out, const void** data_out, size_t* size_out)
+{
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(data == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    FileMapping* m = (FileMapping*) malloc(sizeof(FileMapping));
+    m->file = file;
+    m->mapping = mapping;
+    m->data = data;
+    *file_out = (NativeFile) m;
+    *data_out = data;
+    *size_out = (size_t) size.QuadPart;
+    return true;
+}
+
+void UnmapNativeFile(NativeFile file)
+{
+    FileMapping* m = (FileMapping*) file;
+    UnmapViewOfFile(m->data);
+    CloseHandle(m->mapping);
+    CloseHandle(m->file);
+    free(m);
+}
+
+struct SharedMapping
+{
+    HANDLE file;
+    HANDLE mapping;
+    void* data;
+};
+
+bool OpenNativeSharedFile(const char* filename, size_t size, NativeSharedFile* file_out, void** data_out)
+{
+    HANDLE file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    // a mapping larger than the file extends it with zeros
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READWRITE, 0, (DWORD) size, NULL);
+    if(mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    void* data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if(data == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    SharedMapping* m = (SharedMapping*) malloc(sizeof(SharedMapping));
+    m->file = file;
+    m->mapping = mapping;
+    m->data = data;
+    *file_out = (NativeSharedFile) m;
+    *data_out = data;
+    return true;
+}
+
+void CloseNativeSharedFile(NativeSharedFile file)
+{
+    SharedMapping* m = (SharedMapping*) file;
+    UnmapViewOfFile(m->data);
+    CloseHandle(m->mapping);
+    CloseHandle(m->file);
+    free(m);
+}
+
+void LockNativeSharedFile(NativeSharedFile file)
+{
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(overlapped));
+    LockFileEx(((SharedMapping*) file)->file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
+}
+
+void UnlockNativeSharedFile(NativeSharedFile file)
+{
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(overlapped));
+    UnlockFileEx(((SharedMapping*) file)->file, 0, MAXDWORD, MAXDWORD, &overlapped);
+}
+
+bool ReplaceNativeFile(const char* filename, const void* data, size_t size)
+{
+    // unique per process, so concurrent writers never share a temporary
+    char temp[1024];
+    if(_snprintf(temp, sizeof(temp), "%s.%lu.tmp", filename, GetCurrentProcessId()) < 0)
+    {
+        return false;
+    }
+    temp[sizeof(temp) - 1] = '\0';
+    HANDLE file = CreateFileA(temp, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    DWORD written = 0;
+    bool ok = WriteFile(file, data, (DWORD) size, &written, NULL) && written == size && FlushFileBuffers(file);
+    CloseHandle(file);
+    if(!ok || !MoveFileExA(temp, filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        DeleteFileA(temp);
+        return false;
+    }
+    return true;
+}
+
+bool DeleteNativeFile(const char* filename)
+{
+    return DeleteFileA(filename) != 0;
+}
+
+bool CreateNativeDirectory(const char* path)
+{
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
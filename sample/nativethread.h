@@ -0,0 +1,69 @@
+#ifndef __NATIVETHREAD_H__
+#define __NATIVETHREAD_H__
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#pragma intrinsic(_ReadWriteBarrier)
+#pragma intrinsic(_InterlockedExchangeAdd)
+#endif
+
+typedef void* NativeThread;
+typedef void* NativeSemaphore;
+
+typedef void (*NativeThreadProc)(void* arg);
+
+bool CreateNativeThread(NativeThreadProc proc, void* arg, NativeThread* thread_out);
+
+void JoinNativeThread(NativeThread thread);
+
+bool CreateNativeSemaphore(unsigned int initial, NativeSemaphore* sem_out);
+
+void DestroyNativeSemaphore(NativeSemaphore sem);
+
+void PostNativeSemaphore(NativeSemaphore sem);
+
+void WaitNativeSemaphore(NativeSemaphore sem);
+
+// Identifies the calling thread among the running ones.
+unsigned long GetNativeThreadId();
+
+// Number of processors available to the process, at least 1.
+unsigned int GetNativeCpuCount();
+
+// Loads and stores of a 32 bit index shared between two threads. The load
+// has acquire and the store release semantics, which is all a single
+// producer, single consumer ring needs.
+inline unsigned int AtomicLoadAcquire(const volatile unsigned int* p)
+{
+#if defined(_MSC_VER)
+    // aligned x86 loads are atomic and never reordered with later accesses
+    unsigned int value = *p;
+    _ReadWriteBarrier();
+    return value;
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void AtomicStoreRelease(volatile unsigned int* p, unsigned int value)
+{
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+    *p = value;
+#else
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+#endif
+}
+
+// Add to a 32 bit counter shared between any number of threads, returning
+// its previous value. Orders no other memory accesses.
+inline unsigned int AtomicAdd(volatile unsigned int* p, unsigned int value)
+{
+#if defined(_MSC_VER)
+    return (unsigned int) _InterlockedExchangeAdd((volatile long*) p, (long) value);
+#else
+    return __atomic_fetch_add(p, value, __ATOMIC_RELAXED);
+#endif
+}
+
+#endif // __NATIVETHREAD_H__
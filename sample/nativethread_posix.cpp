@@ -0,0 +1,84 @@
+#include "nativethread.h"
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct ThreadStart
+{
+    NativeThreadProc proc;
+    void* arg;
+};
+
+static void* ThreadEntry(void* param)
+{
+    ThreadStart start = *(ThreadStart*) param;
+    free(param);
+    start.proc(start.arg);
+    return NULL;
+}
+
+bool CreateNativeThread(NativeThreadProc proc, void* arg, NativeThread* thread_out)
+{
+    pthread_t* thread = (pthread_t*) malloc(sizeof(pthread_t));
+    ThreadStart* start = (ThreadStart*) malloc(sizeof(ThreadStart));
+    start->proc = proc;
+    start->arg = arg;
+    if(pthread_create(thread, NULL, ThreadEntry, start) != 0)
+    {
+        free(start);
+        free(thread);
+        return false;
+    }
+    *thread_out = (NativeThread) thread;
+    return true;
+}
+
+void JoinNativeThread(NativeThread thread)
+{
+    pthread_t* pthread = (pthread_t*) thread;
+    pthread_join(*pthread, NULL);
+    free(pthread);
+}
+
+bool CreateNativeSemaphore(unsigned int initial, NativeSemaphore* sem_out)
+{
+    sem_t* sem = (sem_t*) malloc(sizeof(sem_t));
+    if(sem_init(sem, 0, initial) != 0)
+    {
+        free(sem);
+        return false;
+    }
+    *sem_out = (NativeSemaphore) sem;
+    return true;
+}
+
+void DestroyNativeSemaphore(NativeSemaphore sem)
+{
+    sem_destroy((sem_t*) sem);
+    free(sem);
+}
+
+void PostNativeSemaphore(NativeSemaphore sem)
+{
+    sem_post((sem_t*) sem);
+}
+
+void WaitNativeSemaphore(NativeSemaphore sem)
+{
+    while(sem_wait((sem_t*) sem) != 0 && errno == EINTR)
+    {
+    }
+}
+
+unsigned long GetNativeThreadId()
+{
+    return (unsigned long) pthread_self();
+}
+
+unsigned int GetNativeCpuCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (unsigned int) count : 1;
+}
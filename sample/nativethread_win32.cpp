@@ -0,0 +1,74 @@
+#include "nativethread.h"
+#include <windows.h>
+#include <process.h>
+#include <stdlib.h>
+
+struct ThreadStart
+{
+    NativeThreadProc proc;
+    void* arg;
+};
+
+static unsigned __stdcall ThreadEntry(void* param)
+{
+    ThreadStart start = *(ThreadStart*) param;
+    free(param);
+    start.proc(start.arg);
+    return 0;
+}
+
+bool CreateNativeThread(NativeThreadProc proc, void* arg, NativeThread* thread_out)
+{
+    ThreadStart* start = (ThreadStart*) malloc(sizeof(ThreadStart));
+    start->proc = proc;
+    start->arg = arg;
+    // _beginthreadex keeps the CRT usable from the new thread
+    HANDLE thread = (HANDLE) _beginthreadex(NULL, 0, ThreadEntry, start, 0, NULL);
+    if(thread == NULL)
+    {
+        free(start);
+        return false;
+    }
+    *thread_out = (NativeThread) thread;
+    return true;
+}
+
+void JoinNativeThread(NativeThread thread)
+{
+    WaitForSingleObject((HANDLE) thread, INFINITE);
+    CloseHandle((HANDLE) thread);
+}
+
+bool CreateNativeSemaphore(unsigned int initial, NativeSemaphore* sem_out)
+{
+    HANDLE sem = CreateSemaphore(NULL, (LONG) initial, 0x7fffffff, NULL);
+    *sem_out = (NativeSemaphore) sem;
+    return sem != NULL;
+}
+
+void DestroyNativeSemaphore(NativeSemaphore sem)
+{
+    CloseHandle((HANDLE) sem);
+}
+
+void PostNativeSemaphore(NativeSemaphore sem)
+{
+    ReleaseSemaphore((HANDLE) sem, 1, NULL);
+}
+
+void WaitNativeSemaphore(NativeSemaphore sem)
+{
+    WaitForSingleObject((HANDLE) sem, INFINITE);
+}
+
+unsigned long GetNativeThreadId()
+{
+    return GetCurrentThreadId();
+}
+
+unsigned int GetNativeCpuCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (info.dwNumberOfProcessors > 0) ? (unsigned int) info.dwNumberOfProcessors : 1;
+}
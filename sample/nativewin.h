@@ -3,9 +3,13 @@
 
 #include <EGL/egl.h>
 
-void OnNativeWinResize(int width, int height);
+// Window callbacks, implemented by the application. Each names the window
+// the event was sent to.
+void OnNativeWinResize(EGLNativeWindowType nativewin, int width, int height);
 
-void OnNativeWinMouseMove(int mousex, int mousey, bool lbutton);
+void OnNativeWinMouseMove(EGLNativeWindowType nativewin, int mousex, int mousey, bool lbutton);
+
+void OnNativeWinExpose(EGLNativeWindowType nativewin);
 
 bool OpenNativeDisplay(EGLNativeDisplayType* nativedisp_out);
 
@@ -15,7 +19,20 @@ bool CreateNativeWin(EGLNativeDisplayType nativedisp, int width, int height, int
 
 void DestroyNativeWin(EGLNativeDisplayType nativedisp, EGLNativeWindowType nativewin);
 
+// Dispatch the pending events of all windows on the display. Motion and size
+// changes may be coalesced, so only the latest of them is reported. Returns
+// false once any of the windows was asked to close.
 bool UpdateNativeWin(EGLNativeDisplayType nativedisp, EGLNativeWindowType nativewin);
 
+// Block until window events are pending or the timeout in seconds expires.
+// A negative timeout waits indefinitely and a zero timeout only polls.
+// Returns true if events are pending.
+bool WaitNativeWin(EGLNativeDisplayType nativedisp, EGLNativeWindowType nativewin, double timeout);
+
+// Monotonic time in seconds from an arbitrary origin.
+double GetNativeTime();
+
+void SleepNative(double seconds);
+
 #endif // __NATIVEWIN_H__
 
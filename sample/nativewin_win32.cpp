@@ -12,7 +12,10 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
     case WM_SETFOCUS:
         return 0;
     case WM_SIZE:
-        OnNativeWinResize(LOWORD(lParam), HIWORD(lParam));
+        OnNativeWinResize((EGLNativeWindowType) hWnd, LOWORD(lParam), HIWORD(lParam));
+        break;
+    case WM_PAINT:
+        OnNativeWinExpose((EGLNativeWindowType) hWnd);
         break;
     case WM_CLOSE:
         PostQuitMessage(0);
@@ -28,7 +31,7 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
         }
         break;
     case WM_MOUSEMOVE:
-        OnNativeWinMouseMove( GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam), (wParam & MK_LBUTTON) != 0);
+        OnNativeWinMouseMove((EGLNativeWindowType) hWnd, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam), (wParam & MK_LBUTTON) != 0);
         break;
     default:
         break;
@@ -72,8 +75,8 @@ bool CreateNativeWin(EGLNativeDisplayType nativedisp, int width, int height, int
     wndClass.cbClsExtra    = 0;                          // Extra class memory
     wndClass.cbWndExtra    = 0;                          // Extra window memory
 
-    // Register the newly defined class
-    if(!RegisterClass( &wndClass ))
+    // Register the newly defined class, unless an earlier window already did
+    if(!RegisterClass( &wndClass ) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
     {
         result = false;
     }
@@ -147,3 +150,30 @@ bool UpdateNativeWin(EGLNativeDisplayType nativedisp, EGLNativeWindowType native
     }
     return result;
 }
+
+bool WaitNativeWin(EGLNativeDisplayType nativedisp, EGLNativeWindowType nativewin, double timeout)
+{
+    DWORD ms = (timeout < 0.0) ? INFINITE : (DWORD) (timeout * 1000.0);
+    return MsgWaitForMultipleObjects(0, NULL, FALSE, ms, QS_ALLINPUT) == WAIT_OBJECT_0;
+}
+
+double GetNativeTime()
+{
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if(freq.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+    return (double) now.QuadPart / (double) freq.QuadPart;
+}
+
+void SleepNative(double seconds)
+{
+    if(seconds <= 0.0)
+    {
+        return;
+    }
+    Sleep((DWORD) (seconds * 1000.0));
+}
@@ -1,8 +1,72 @@
 #include "nativewin.h"
 #include <X11/Xutil.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// Atoms of the window manager protocol, interned once when the first window
+// is created instead of on every client message.
+static Atom s_wmProtocols = None;
+static Atom s_wmDelete = None;
+
+// Latest motion and size of a window seen while draining the event queue.
+// Only these are passed on, so a drag or an interactive resize costs one
+// callback per update instead of one per event.
+struct PendingWinEvents
+{
+    Window  xwin;
+    bool    resized;
+    int     width;
+    int     height;
+    bool    moved;
+    int     mousex;
+    int     mousey;
+    bool    button1;
+};
+
+enum { MAX_PENDING_WINS = 16 };
+
+static void FlushPendingEvents(PendingWinEvents& pending)
+{
+    EGLNativeWindowType nativewin = (EGLNativeWindowType) pending.xwin;
+    // the new size first, so the mouse callback sees the current dimensions
+    if(pending.resized)
+    {
+        OnNativeWinResize(nativewin, pending.width, pending.height);
+        pending.resized = false;
+    }
+    if(pending.moved)
+    {
+        OnNativeWinMouseMove(nativewin, pending.mousex, pending.mousey, pending.button1);
+        pending.moved = false;
+    }
+}
+
+static PendingWinEvents* FindPendingEvents(PendingWinEvents* pending, int* count, Window xwin)
+{
+    int i;
+    for(i = 0; i < *count; i++)
+    {
+        if(pending[i].xwin == xwin)
+        {
+            return &pending[i];
+        }
+    }
+    if(*count == MAX_PENDING_WINS)
+    {
+        // more windows than slots, pass the events of the oldest one on
+        FlushPendingEvents(pending[0]);
+        pending[0].xwin = xwin;
+        return &pending[0];
+    }
+    PendingWinEvents* entry = &pending[(*count)++];
+    memset(entry, 0, sizeof(*entry));
+    entry->xwin = xwin;
+    return entry;
+}
 
 bool OpenNativeDisplay(EGLNativeDisplayType* nativedisp_out)
 {
@@ -28,7 +92,6 @@ bool CreateNativeWin(EGLNativeDisplayType nativedisp, int width, int height, int
     Colormap colormap;
     XSetWindowAttributes swa;
     Window xwin;
-    Atom wmdelete;
     // find the screen and the root window
     screen = XDefaultScreen(xdisplay);
     xroot = XRootWindow(xdisplay, screen);
@@ -82,12 +145,16 @@ bool CreateNativeWin(EGLNativeDisplayType nativedisp, int width, int height, int
             visual,
             CWBackPixel|CWBorderPixel|CWColormap|CWEventMask,
             &swa);
-        wmdelete = XInternAtom(xdisplay, "WM_DELETE_WINDOW", True);
-        XSetWMProtocols(xdisplay, xwin, &wmdelete, 1);
+        if(s_wmDelete == None)
+        {
+            s_wmProtocols = XInternAtom(xdisplay, "WM_PROTOCOLS", False);
+            s_wmDelete = XInternAtom(xdisplay, "WM_DELETE_WINDOW", False);
+        }
+        XSetWMProtocols(xdisplay, xwin, &s_wmDelete, 1);
         // make the window visible
         XMapWindow(xdisplay, xwin);
         // make sure an initial resize event is provided to the application
-        OnNativeWinResize(width, height);
+        OnNativeWinResize((EGLNativeWindowType) xwin, width, height);
         // set out param
         *nativewin_out = (EGLNativeWindowType) xwin;
     }
@@ -109,10 +176,11 @@ bool UpdateNativeWin(EGLNativeDisplayType nativedisp, EGLNativeWindowType native
 {
     bool result = true;
     Display* xdisplay = (Display*) nativedisp;
-    Window xwin = (Window) nativewin;
     XEvent evt;
-    int w;
-    int h;
+    PendingWinEvents pending[MAX_PENDING_WINS];
+    PendingWinEvents* entry;
+    int numPending = 0;
+    int i;
 
     while(XEventsQueued(xdisplay, QueuedAfterFlush))
     {
@@ -121,37 +189,94 @@ bool UpdateNativeWin(EGLNativeDisplayType nativedisp, EGLNativeWindowType native
         {
         case ClientMessage:
             // close window
-            if(evt.xmotion.window == xwin)
+            if(evt.xclient.message_type == s_wmProtocols &&
+               (Atom) evt.xclient.data.l[0] == s_wmDelete)
             {
-                long wmdel;
-                wmdel = (long) XInternAtom(xdisplay, "WM_DELETE_WINDOW", True);
-                if(evt.xclient.data.l[0] == wmdel)
-                {
-                    result = false;
-                }
+                result = false;
             }
             break;
-        case ConfigureNotify:
-            // assume it's a window resize
-            if(evt.xconfigure.window == xwin)
+        case Expose:
+            // only the last expose of a series needs a redraw
+            if(evt.xexpose.count == 0)
             {
-                w = evt.xconfigure.width;
-                h = evt.xconfigure.height;
-                OnNativeWinResize(w, h);
+                OnNativeWinExpose((EGLNativeWindowType) evt.xexpose.window);
             }
             break;
+        case ConfigureNotify:
+            // assume it's a window resize, keep only the latest size
+            entry = FindPendingEvents(pending, &numPending, evt.xconfigure.window);
+            entry->resized = true;
+            entry->width = evt.xconfigure.width;
+            entry->height = evt.xconfigure.height;
+            break;
         case MotionNotify:
             // mouse cursor moved
-            if(evt.xmotion.window == xwin)
             {
-                int cursorx = evt.xmotion.x;
-                int cursory = evt.xmotion.y;
                 bool button1 = (evt.xmotion.state & Button1Mask) != 0;
-                OnNativeWinMouseMove(cursorx, cursory, button1);
+                entry = FindPendingEvents(pending, &numPending, evt.xmotion.window);
+                // a drag starts or ends here: the earlier position must be
+                // seen with the old button state
+                if(entry->moved && entry->button1 != button1)
+                {
+                    FlushPendingEvents(*entry);
+                }
+                entry->moved = true;
+                entry->mousex = evt.xmotion.x;
+                entry->mousey = evt.xmotion.y;
+                entry->button1 = button1;
             }
             break;
         }
     }
+    for(i = 0; i < numPending; i++)
+    {
+        FlushPendingEvents(pending[i]);
+    }
     return result;
 }
 
+bool WaitNativeWin(EGLNativeDisplayType nativedisp, EGLNativeWindowType nativewin, double timeout)
+{
+    Display* xdisplay = (Display*) nativedisp;
+    struct pollfd pfd;
+    int ms;
+    int ret;
+
+    // xlib may already hold queued events, in which case the connection
+    // won't become readable; XPending also flushes pending requests
+    if(XPending(xdisplay))
+    {
+        return true;
+    }
+    pfd.fd = ConnectionNumber(xdisplay);
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    ms = (timeout < 0.0) ? -1 : (int) (timeout * 1000.0);
+    do
+    {
+        ret = poll(&pfd, 1, ms);
+    } while(ret < 0 && errno == EINTR);
+    return ret > 0;
+}
+
+double GetNativeTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void SleepNative(double seconds)
+{
+    if(seconds <= 0.0)
+    {
+        return;
+    }
+    struct timespec ts;
+    ts.tv_sec = (time_t) seconds;
+    ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+    // resume after signals until the full interval has elapsed
+    while(nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
@@ -0,0 +1,356 @@
+#ifndef __OCCLUSION_H__
+#define __OCCLUSION_H__
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "hashutil.h"
+#include "nativethread.h"
+#include "renderpass.h"
+
+#include <cstring>
+
+// Hierarchical occlusion culling with GL_EXT_occlusion_query_boolean.
+//
+// Objects and groups of objects are nodes identified by small integers.
+// Every node remembers whether it was visible. Query results are only read
+// once GL_QUERY_RESULT_AVAILABLE_EXT says they are ready, usually a frame
+// later, so testing never stalls the pipeline; until then the last known
+// visibility is used.
+//
+// - A hidden group skips all its children and only has its bounding box
+//   tested. Once the box shows, the children are tested one by one.
+// - A visible group is visible as long as any of its children is.
+// - A hidden object is not drawn; its bounding box is tested every frame.
+// - A visible object is drawn, and only every few frames the draw itself is
+//   wrapped in a query to re-test it. The frames are staggered between nodes
+//   so the queries spread out.
+//
+// Objects becoming visible appear a frame or two late, the usual price of
+// reading results late, so a view drawn on demand has to keep drawing after
+// it stopped moving until those results are in: the culler tells the thread
+// recording frames whether queries it still needs are in flight. A query is
+// needed while no visibility or view change came after it was issued; once
+// the results of the first frame after the last change arrive without
+// changing anything, new tests would only repeat them. Queries are context
+// objects, so a culler belongs to the context that executes the draws.
+class OcclusionCuller
+{
+public:
+    enum { MAX_NODES = 64, RETEST_INTERVAL = 8 };
+
+    OcclusionCuller() :
+        m_enabled(false), m_frame(0),
+        m_program(0), m_posLoc(-1), m_mvpLoc(-1),
+        m_group(-1), m_groupRemaining(0), m_groupVisible(false),
+        m_drawQuery(-1), m_changed(0), m_frameHash(0), m_lastHash(0),
+        m_recorded(0), m_executed(0), m_pendingWork(0),
+        m_genQueries(NULL), m_deleteQueries(NULL), m_beginQuery(NULL),
+        m_endQuery(NULL), m_getQueryObjectuiv(NULL)
+    {
+        memset(m_nodes, 0, sizeof(m_nodes));
+    }
+
+    // Load the query entry points for the current context. Proxy boxes are
+    // drawn with a position-only program taking an mvpMatrix uniform.
+    bool Init(GLuint program, GLint posLoc, GLint mvpLoc)
+    {
+        if(!HasGLExtension("GL_EXT_occlusion_query_boolean"))
+        {
+            return false;
+        }
+        m_genQueries = (PFNGLGENQUERIESEXTPROC) eglGetProcAddress("glGenQueriesEXT");
+        m_deleteQueries = (PFNGLDELETEQUERIESEXTPROC) eglGetProcAddress("glDeleteQueriesEXT");
+        m_beginQuery = (PFNGLBEGINQUERYEXTPROC) eglGetProcAddress("glBeginQueryEXT");
+        m_endQuery = (PFNGLENDQUERYEXTPROC) eglGetProcAddress("glEndQueryEXT");
+        m_getQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC) eglGetProcAddress("glGetQueryObjectuivEXT");
+        if(m_genQueries == NULL || m_deleteQueries == NULL || m_beginQuery == NULL ||
+           m_endQuery == NULL || m_getQueryObjectuiv == NULL)
+        {
+            return false;
+        }
+        m_program = program;
+        m_posLoc = posLoc;
+        m_mvpLoc = mvpLoc;
+        for(int i = 0; i < MAX_NODES; i++)
+        {
+            m_nodes[i].visible = true;
+        }
+        m_enabled = true;
+        return true;
+    }
+
+    bool IsEnabled() const
+    {
+        return m_enabled;
+    }
+
+    void BeginFrame()
+    {
+        m_frame++;
+        m_group = -1;
+        m_groupRemaining = 0;
+        m_frameHash = FNV1A_OFFSET;
+    }
+
+    // Publish whether queries needed for the frame's visibility are still
+    // in flight. Every frame begun has to be ended, culling or not.
+    void EndFrame()
+    {
+        // a view that moved or drew other objects tests against new depth
+        if(m_frameHash != m_lastHash)
+        {
+            m_changed = m_frame;
+            m_lastHash = m_frameHash;
+        }
+        bool work = false;
+        for(int i = 0; i < MAX_NODES && m_enabled && !work; i++)
+        {
+            const Node& n = m_nodes[i];
+            work = n.lastSeen == m_frame && n.pending && n.lastTest <= m_changed;
+        }
+        AtomicStoreRelease(&m_pendingWork, work ? 1 : 0);
+        AtomicStoreRelease(&m_executed, m_executed + 1);
+    }
+
+    // Called by the thread recording frames for each frame it hands over.
+    void NoteFrameRecorded()
+    {
+        AtomicStoreRelease(&m_recorded, m_recorded + 1);
+    }
+
+    // Whether recorded frames have not been executed yet, so that
+    // HasPendingWork() does not cover them. Any thread.
+    bool HasQueuedFrames() const
+    {
+        return AtomicLoadAcquire(&m_executed) != AtomicLoadAcquire(&m_recorded);
+    }
+
+    // Whether the view has to be drawn again to read back queries that may
+    // still show hidden nodes. Any thread.
+    bool HasPendingWork() const
+    {
+        return AtomicLoadAcquire(&m_pendingWork) != 0;
+    }
+
+    // Decide whether the 'children' objects following a group are processed.
+    // The box is given in the space 'mvp' transforms from.
+    bool BeginGroup(int node, const GLfloat mvp[16], const GLfloat boxMin[3], const GLfloat boxMax[3], unsigned int children)
+    {
+        if(!m_enabled || node < 0 || node >= MAX_NODES)
+        {
+            return true;
+        }
+        Node& n = m_nodes[node];
+        See(n, node, mvp);
+        if(!n.visible)
+        {
+            if(!n.pending)
+            {
+                TestBox(n, mvp, boxMin, boxMax);
+            }
+            if(!n.visible)
+            {
+                return false;
+            }
+        }
+        m_group = node;
+        m_groupRemaining = children;
+        m_groupVisible = false;
+        if(children == 0)
+        {
+            SetVisible(n, false);
+            m_group = -1;
+        }
+        return true;
+    }
+
+    // Decide whether an object is drawn. When it is, the draw has to be
+    // bracketed by EndObject().
+    bool BeginObject(int node, const GLfloat mvp[16], const GLfloat boxMin[3], const GLfloat boxMax[3])
+    {
+        m_drawQuery = -1;
+        if(!m_enabled || node < 0 || node >= MAX_NODES)
+        {
+            return true;
+        }
+        Node& n = m_nodes[node];
+        See(n, node, mvp);
+        if(!n.visible && !n.pending)
+        {
+            TestBox(n, mvp, boxMin, boxMax);
+        }
+        else if(n.visible && !n.pending && m_frame - n.lastTest >= RETEST_INTERVAL &&
+                (m_frame + node) % RETEST_INTERVAL == 0)
+        {
+            // re-test with the draw itself, costing no extra geometry
+            BeginQuery(n);
+            m_drawQuery = node;
+        }
+        bool draw = n.visible;
+        // the enclosing group stays visible while any child is
+        if(m_group >= 0)
+        {
+            m_groupVisible = m_groupVisible || n.visible;
+            if(--m_groupRemaining == 0)
+            {
+                SetVisible(m_nodes[m_group], m_groupVisible);
+                m_group = -1;
+            }
+        }
+        return draw;
+    }
+
+    void EndObject()
+    {
+        if(m_drawQuery >= 0)
+        {
+            m_endQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE_EXT);
+            m_drawQuery = -1;
+        }
+    }
+
+    void Destroy()
+    {
+        for(int i = 0; i < MAX_NODES && m_enabled; i++)
+        {
+            if(m_nodes[i].query != 0)
+            {
+                m_deleteQueries(1, &m_nodes[i].query);
+            }
+        }
+        memset(m_nodes, 0, sizeof(m_nodes));
+        m_enabled = false;
+    }
+
+private:
+    struct Node
+    {
+        GLuint          query;
+        bool            pending;
+        bool            visible;
+        unsigned int    lastTest;
+        unsigned int    lastSeen;
+    };
+
+    // Poll a node about to be processed, and fold it and its transform into
+    // the frame's hash.
+    void See(Node& n, int node, const GLfloat mvp[16])
+    {
+        n.lastSeen = m_frame;
+        m_frameHash = HashFNV1a(&node, sizeof(node), m_frameHash);
+        m_frameHash = HashFNV1a(mvp, 16 * sizeof(GLfloat), m_frameHash);
+        Poll(n);
+    }
+
+    void SetVisible(Node& n, bool visible)
+    {
+        m_changed = (n.visible != visible) ? m_frame : m_changed;
+        n.visible = visible;
+    }
+
+    // Pick up a finished query without waiting for one in flight.
+    void Poll(Node& n)
+    {
+        if(!n.pending)
+        {
+            return;
+        }
+        GLuint available = GL_FALSE;
+        m_getQueryObjectuiv(n.query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if(available)
+        {
+            GLuint passed = GL_FALSE;
+            m_getQueryObjectuiv(n.query, GL_QUERY_RESULT_EXT, &passed);
+            SetVisible(n, passed != GL_FALSE);
+            n.pending = false;
+        }
+    }
+
+    void BeginQuery(Node& n)
+    {
+        if(n.query == 0)
+        {
+            m_genQueries(1, &n.query);
+        }
+        m_beginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE_EXT, n.query);
+        n.pending = true;
+        n.lastTest = m_frame;
+    }
+
+    // Test a bounding box against the depth buffer without touching it. A
+    // box reaching behind the near plane would be clipped, so it counts as
+    // visible without a test.
+    void TestBox(Node& n, const GLfloat mvp[16], const GLfloat boxMin[3], const GLfloat boxMax[3])
+    {
+        static const GLubyte indices[36] = {
+            0,1,3, 0,3,2,  4,6,7, 4,7,5,  0,4,5, 0,5,1,
+            2,3,7, 2,7,6,  0,2,6, 0,6,4,  1,5,7, 1,7,3 };
+        GLfloat corners[8 * 3];
+        for(int i = 0; i < 8; i++)
+        {
+            corners[i * 3 + 0] = (i & 1) ? boxMax[0] : boxMin[0];
+            corners[i * 3 + 1] = (i & 2) ? boxMax[1] : boxMin[1];
+            corners[i * 3 + 2] = (i & 4) ? boxMax[2] : boxMin[2];
+            GLfloat w = mvp[3] * corners[i * 3 + 0] + mvp[7] * corners[i * 3 + 1] +
+                        mvp[11] * corners[i * 3 + 2] + mvp[15];
+            if(w <= 0.0f)
+            {
+                SetVisible(n, true);
+                return;
+            }
+        }
+        glUseProgram(m_program);
+        glUniformMatrix4fv(m_mvpLoc, 1, GL_FALSE, mvp);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glVertexAttribPointer(m_posLoc, 3, GL_FLOAT, GL_FALSE, 0, corners);
+        glEnableVertexAttribArray(m_posLoc);
+        BeginQuery(n);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, indices);
+        m_endQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE_EXT);
+        glDisableVertexAttribArray(m_posLoc);
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glUseProgram(0);
+    }
+
+    bool            m_enabled;
+    unsigned int    m_frame;
+    Node            m_nodes[MAX_NODES];
+
+    GLuint          m_program;
+    GLint           m_posLoc;
+    GLint           m_mvpLoc;
+
+    // group whose children are being processed
+    int             m_group;
+    unsigned int    m_groupRemaining;
+    bool            m_groupVisible;
+    // object whose draw is wrapped in a query
+    int             m_drawQuery;
+
+    // last frame whose visibility or view differed from the one before
+    unsigned int    m_changed;
+    khronos_uint64_t m_frameHash;
+    khronos_uint64_t m_lastHash;
+    // frames handed over by the recording thread and executed, and whether
+    // the last executed one left needed queries in flight
+    volatile unsigned int m_recorded;
+    volatile unsigned int m_executed;
+    volatile unsigned int m_pendingWork;
+
+    PFNGLGENQUERIESEXTPROC          m_genQueries;
+    PFNGLDELETEQUERIESEXTPROC       m_deleteQueries;
+    PFNGLBEGINQUERYEXTPROC          m_beginQuery;
+    PFNGLENDQUERYEXTPROC            m_endQuery;
+    PFNGLGETQUERYOBJECTUIVEXTPROC   m_getQueryObjectuiv;
+};
+
+#endif // __OCCLUSION_H__
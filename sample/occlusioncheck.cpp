@@ -0,0 +1,160 @@
+// occlusioncheck - checks the software occlusion culler against known scenes.
+//
+// usage: occlusioncheck [-threads <n>]
+//
+// Rasterizes fixed occluders with softocclusion.h on 1 to n threads (default
+// SoftwareOcclusionCuller::MAX_THREADS) and compares what TestBox() answers
+// for boxes behind, in front of, beside and around them with the expected
+// results. Among the occluders are a floor and a side wall reaching behind
+// the eye and a wall nearer than the near plane, which must be clipped as GL
+// clips them. The depth buffer of every scene must be the same on any number
+// of threads. Needs no GPU or window; prints every failed check and exits
+// with 1 if any failed.
+
+#include "softocclusion.h"
+#include "vecmath.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct TestCase
+{
+    const char*     name;
+    float           boxMin[3];
+    float           boxMax[3];
+    bool            visible;
+};
+
+struct Scene
+{
+    const char*     name;
+    float           occluder[6][3];     // a quad as two triangles
+    bool            hasOccluder;
+    TestCase        cases[3];
+    unsigned int    numCases;
+};
+
+// The eye is at the origin looking down -z, near plane at 1, far plane at 100.
+static const Scene s_scenes[] =
+{
+    {
+        "wall",
+        { { -20, -20, -5 }, { 20, -20, -5 }, { 20, 20, -5 }, { -20, -20, -5 }, { 20, 20, -5 }, { -20, 20, -5 } }, true,
+        {
+            { "behind", { -1, -1, -9 }, { 1, 1, -8 }, false },
+            { "in front", { -1, -1, -4 }, { 1, 1, -3 }, true },
+            { "through", { -1, -1, -6 }, { 1, 1, -4 }, true }
+        }, 3
+    },
+    {
+        "half wall",
+        { { -20, -20, -5 }, { 0, -20, -5 }, { 0, 20, -5 }, { -20, -20, -5 }, { 0, 20, -5 }, { -20, 20, -5 } }, true,
+        {
+            { "behind the wall", { -3, -1, -10 }, { -2, 1, -9 }, false },
+            { "behind the opening", { 2, -1, -10 }, { 3, 1, -9 }, true },
+            { "behind the edge", { -1, -1, -10 }, { 1, 1, -9 }, true }
+        }, 3
+    },
+    {
+        "floor through the eye",
+        { { -50, -1, 10 }, { 50, -1, 10 }, { 50, -1, -50 }, { -50, -1, 10 }, { 50, -1, -50 }, { -50, -1, -50 } }, true,
+        {
+            { "under it", { -1, -4, -12 }, { 1, -3, -10 }, false },
+            { "above it", { -1, -0.5f, -12 }, { 1, 0.5f, -10 }, true },
+            { "around the eye", { -1, -1, -1 }, { 1, 1, 1 }, true }
+        }, 3
+    },
+    {
+        "side wall through the eye",
+        { { -2, -20, 10 }, { -2, -20, -50 }, { -2, 20, -50 }, { -2, -20, 10 }, { -2, 20, -50 }, { -2, 20, 10 } }, true,
+        {
+            { "behind it", { -6, -1, -12 }, { -5, 1, -10 }, false },
+            { "beside it", { 1, -1, -12 }, { 2, 1, -10 }, true }
+        }, 2
+    },
+    {
+        "wall before the near plane",
+        { { -20, -20, -0.5f }, { 20, -20, -0.5f }, { 20, 20, -0.5f }, { -20, -20, -0.5f }, { 20, 20, -0.5f },
+          { -20, 20, -0.5f } }, true,
+        {
+            { "behind it", { -1, -1, -9 }, { 1, 1, -8 }, true }
+        }, 1
+    },
+    {
+        "no occluders",
+        { { 0 } }, false,
+        {
+            { "anywhere", { -1, -1, -9 }, { 1, 1, -8 }, true }
+        }, 1
+    }
+};
+
+static const unsigned int s_numScenes = sizeof(s_scenes) / sizeof(s_scenes[0]);
+
+int main(int argc, char** argv)
+{
+    unsigned int maxThreads = SoftwareOcclusionCuller::MAX_THREADS;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            maxThreads = (unsigned int) atoi(argv[++i]);
+        }
+        else
+        {
+            printf("usage: %s [-threads <n>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    mat4 mvp = mat4::perspective(90.0f, 1.0f, 1.0f, 100.0f);
+    std::vector<std::vector<float> > depths(s_numScenes);
+    unsigned int checks = 0;
+    unsigned int failed = 0;
+    for(unsigned int threads = 1; threads <= maxThreads; threads++)
+    {
+        SoftwareOcclusionCuller culler;
+        culler.Init(threads);
+        for(unsigned int s = 0; s < s_numScenes; s++)
+        {
+            const Scene& scene = s_scenes[s];
+            culler.BeginFrame(256, 256);
+            if(scene.hasOccluder)
+            {
+                culler.AddOccluder(&mvp.x.x, &scene.occluder[0][0], 6);
+            }
+            culler.Rasterize();
+            for(unsigned int c = 0; c < scene.numCases; c++)
+            {
+                const TestCase& t = scene.cases[c];
+                bool visible = culler.TestBox(&mvp.x.x, t.boxMin, t.boxMax);
+                checks++;
+                if(visible != t.visible)
+                {
+                    printf("%s, box %s, %u threads: %s, expected %s\n", scene.name, t.name, culler.GetThreadCount(),
+                           visible ? "visible" : "hidden", t.visible ? "visible" : "hidden");
+                    failed++;
+                }
+            }
+
+            // the same depth on any number of threads
+            const float* depth = culler.GetDepth();
+            size_t size = (size_t) culler.GetWidth() * culler.GetHeight();
+            checks++;
+            if(depths[s].empty())
+            {
+                depths[s].assign(depth, depth + size);
+            }
+            else if(depths[s].size() != size || memcmp(&depths[s][0], depth, size * sizeof(float)) != 0)
+            {
+                printf("%s, %u threads: depth differs from 1 thread\n", scene.name, culler.GetThreadCount());
+                failed++;
+            }
+        }
+        culler.Destroy();
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,325 @@
+#ifndef __PERMUTATION_H__
+#define __PERMUTATION_H__
+
+#include <GLES2/gl2.h>
+
+#ifdef SHADER_TRANSLATOR
+#include "compilerpool.h"
+#endif
+
+#include "shaderminify.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Features a shading program can be specialized for.
+enum ShaderFeature
+{
+    SHADER_LIGHTING      = 0x1,     // diffuse lighting from lightVec
+    SHADER_TEXTURE       = 0x2,     // color from a 2D texture
+    SHADER_TEXTURE_ARRAY = 0x4,     // color from a layer of a texture array,
+                                    // GLSL ES 3.00
+    SHADER_SKINNING      = 0x8      // up to four bones per vertex
+};
+
+// Expands feature masks into shader sources specialized with #defines.
+//
+// One source per stage holds every feature between #ifdef blocks, so each
+// permutation only contains the code its features need, and the fragment
+// shader has no branches on features at run time. Only the permutations
+// materials reference are expanded, and references whose code comes out the
+// same share a variant, so the programs to compile are at most the distinct
+// ones in use.
+//
+// Built with SHADER_TRANSLATOR defined, and linked with the translator and
+// preprocessor libraries, GLSL ES 1.00 permutations are compared by the code
+// the translator outputs for them; this also reports errors in a permutation
+// before any driver sees it. Otherwise, and for GLSL ES 3.00, which the
+// translator does not accept, they are compared by their sources.
+//
+// With SetMinify() the variants keep minified sources (ShaderMinifier), with
+// unused code and varyings removed and names shortened, which is what the
+// driver is then given to compile.
+class ShaderPermutations
+{
+public:
+    enum { MAX_VARIANTS = 16, MAX_BONES = 32 };
+
+    struct Variant
+    {
+        unsigned int    mask;
+        std::string     vsSource;
+        std::string     fsSource;
+    };
+
+    ShaderPermutations() : m_numVariants(0), m_translatorInit(false), m_minify(false)
+    {}
+
+    ~ShaderPermutations()
+    {
+#ifdef SHADER_TRANSLATOR
+        if(m_translatorInit)
+        {
+            m_compilers.Clear();
+            ShFinalize();
+        }
+#endif
+    }
+
+    // Texture arrays are textures too.
+    static unsigned int Normalize(unsigned int mask)
+    {
+        return (mask & SHADER_TEXTURE_ARRAY) ? (mask | SHADER_TEXTURE) : mask;
+    }
+
+    // Sources of the permutation with the given features.
+    static void Expand(unsigned int mask, std::string& vsSource, std::string& fsSource)
+    {
+        mask = Normalize(mask);
+        std::string defines;
+        if(mask & SHADER_LIGHTING)
+        {
+            defines += "#define LIGHTING\n";
+        }
+        if(mask & SHADER_TEXTURE)
+        {
+            defines += "#define TEXTURE\n";
+        }
+        if(mask & SHADER_TEXTURE_ARRAY)
+        {
+            defines += "#define TEXTURE_ARRAY\n";
+        }
+        if(mask & SHADER_SKINNING)
+        {
+            char bones[64];
+            sprintf(bones, "#define SKINNING\n#define MAX_BONES %d\n", (int) MAX_BONES);
+            defines += bones;
+        }
+        // #version has to come first, the stage's keywords follow it
+        bool essl3 = (mask & SHADER_TEXTURE_ARRAY) != 0;
+        vsSource = std::string(essl3 ? "#version 300 es\n#define VS_IN in\n#define VS_OUT out\n" :
+                                       "#define VS_IN attribute\n#define VS_OUT varying\n") +
+                   defines + GetVertexSource();
+        fsSource = std::string(essl3 ? "#version 300 es\nprecision mediump float;\n#define FS_IN in\n"
+                                       "out vec4 fragColor;\n#define FRAG_COLOR fragColor\n" :
+                                       "precision mediump float;\n#define FS_IN varying\n"
+                                       "#define FRAG_COLOR gl_FragColor\n") +
+                   defines + GetFragmentSource();
+    }
+
+    // Minify the sources of variants referenced from now on.
+    void SetMinify(bool minify)
+    {
+        m_minify = minify;
+    }
+
+    // Reference the permutation a material needs. Returns its variant, or -1
+    // if it failed to translate or there are too many.
+    int Reference(unsigned int mask)
+    {
+        mask = Normalize(mask);
+        for(unsigned int i = 0; i < m_refs.size(); i++)
+        {
+            if(m_refs[i].mask == mask)
+            {
+                return m_refs[i].variant;
+            }
+        }
+        Variant v;
+        v.mask = mask;
+        Expand(mask, v.vsSource, v.fsSource);
+        std::string key = v.vsSource + '\0' + v.fsSource;
+#ifdef SHADER_TRANSLATOR
+        if(!(mask & SHADER_TEXTURE_ARRAY))
+        {
+            std::string vsCode;
+            std::string fsCode;
+            if(!Translate(GL_VERTEX_SHADER, v.vsSource, vsCode) || !Translate(GL_FRAGMENT_SHADER, v.fsSource, fsCode))
+            {
+                printf("Permutation 0x%x does not compile.\n", mask);
+                return -1;
+            }
+            key = vsCode + '\0' + fsCode;
+        }
+#endif
+        int variant = -1;
+        for(unsigned int i = 0; i < m_numVariants && variant < 0; i++)
+        {
+            variant = (m_keys[i] == key) ? (int) i : -1;
+        }
+        if(variant < 0)
+        {
+            if(m_numVariants >= MAX_VARIANTS)
+            {
+                return -1;
+            }
+            if(m_minify)
+            {
+                // the sources are kept as they are when they cannot be
+                // minified
+                std::string vsSource;
+                std::string fsSource;
+                ShaderMinifier minifier;
+                if(minifier.MinifyProgram(v.vsSource, v.fsSource, vsSource, fsSource))
+                {
+                    v.vsSource = vsSource;
+                    v.fsSource = fsSource;
+                }
+            }
+            variant = (int) m_numVariants++;
+            m_variants[variant] = v;
+            m_keys[variant] = key;
+        }
+        MaskRef ref = { mask, variant };
+        m_refs.push_back(ref);
+        return variant;
+    }
+
+    unsigned int GetVariantCount() const
+    {
+        return m_numVariants;
+    }
+
+    const Variant& GetVariant(int i) const
+    {
+        return m_variants[i];
+    }
+
+private:
+    struct MaskRef
+    {
+        unsigned int    mask;
+        int             variant;
+    };
+
+    static const char* GetVertexSource()
+    {
+        return
+          "uniform mat4 mvpMatrix;\n"
+          "VS_IN vec4 vertPosition;\n"
+          "#ifdef LIGHTING\n"
+          "VS_IN vec3 normal;\n"
+          "VS_OUT vec3 vNormal;\n"
+          "#endif\n"
+          "#ifdef TEXTURE\n"
+          "VS_IN vec2 texCoord0;\n"
+          "VS_OUT vec2 vTexCoord;\n"
+          "#endif\n"
+          "#ifdef SKINNING\n"
+          // rows of the 3x4 bone matrices
+          "uniform vec4 boneRows[3 * MAX_BONES];\n"
+          "VS_IN vec4 boneIndices;\n"
+          "VS_IN vec4 boneWeights;\n"
+          "vec3 Skin(vec4 v, float bone)\n"
+          "{\n"
+          "   int i = int(bone) * 3;\n"
+          "   return vec3(dot(boneRows[i], v), dot(boneRows[i + 1], v), dot(boneRows[i + 2], v));\n"
+          "}\n"
+          "vec3 SkinBlend(vec4 v)\n"
+          "{\n"
+          "   return Skin(v, boneIndices.x) * boneWeights.x + Skin(v, boneIndices.y) * boneWeights.y +\n"
+          "          Skin(v, boneIndices.z) * boneWeights.z + Skin(v, boneIndices.w) * boneWeights.w;\n"
+          "}\n"
+          "#endif\n"
+          "invariant gl_Position;\n"
+          "void main()\n"
+          "{\n"
+          "#ifdef SKINNING\n"
+          "   gl_Position = mvpMatrix * vec4(SkinBlend(vertPosition), 1.0);\n"
+          "#else\n"
+          "   gl_Position = mvpMatrix * vertPosition;\n"
+          "#endif\n"
+          "#ifdef TEXTURE\n"
+          "   vTexCoord   = texCoord0;\n"
+          "#endif\n"
+          "#if defined(LIGHTING) && defined(SKINNING)\n"
+          "   vNormal     = SkinBlend(vec4(normal, 0.0));\n"
+          "#elif defined(LIGHTING)\n"
+          "   vNormal     = normal;\n"
+          "#endif\n"
+          "}\n";
+    }
+
+    static const char* GetFragmentSource()
+    {
+        return
+          "#ifdef LIGHTING\n"
+          "uniform vec4 lightVec;\n"
+          "FS_IN vec3 vNormal;\n"
+          "#endif\n"
+          "#ifdef TEXTURE_ARRAY\n"
+          "precision mediump sampler2DArray;\n"
+          "uniform sampler2DArray textureUnit0;\n"
+          "uniform float layer;\n"
+          "#elif defined(TEXTURE)\n"
+          "uniform sampler2D textureUnit0;\n"
+          "#endif\n"
+          "#ifdef TEXTURE\n"
+          "FS_IN vec2 vTexCoord;\n"
+          "#endif\n"
+          "void main()\n"
+          "{\n"
+          "#ifdef TEXTURE_ARRAY\n"
+          "  vec4 color = texture(textureUnit0, vec3(vTexCoord, layer));\n"
+          "#elif defined(TEXTURE)\n"
+          "  vec4 color = texture2D(textureUnit0, vTexCoord);\n"
+          "#else\n"
+          "  vec4 color = vec4(0.5, 0.5, 0.5, 1.0);\n"
+          "#endif\n"
+          "#ifdef LIGHTING\n"
+          "  color *= vec4(dot(lightVec.xyz, normalize(vNormal)).xxx, 1.0);\n"
+          "#endif\n"
+          "  FRAG_COLOR = color;\n"
+          "}\n";
+    }
+
+#ifdef SHADER_TRANSLATOR
+    // Translate a GLSL ES 1.00 shader to ESSL. Prints the info log when it
+    // does not compile.
+    bool Translate(GLenum type, const std::string& source, std::string& code)
+    {
+        if(!m_translatorInit)
+        {
+            m_translatorInit = ShInitialize() != 0;
+        }
+        ShBuiltInResources resources;
+        ShInitBuiltInResources(&resources);
+        ShHandle compiler = m_compilers.Acquire(type, SH_GLES2_SPEC, SH_ESSL_OUTPUT, resources);
+        if(compiler == NULL)
+        {
+            return false;
+        }
+        const char* strings[] = { source.c_str() };
+        bool compiled = ShCompile(compiler, strings, 1, SH_OBJECT_CODE) != 0;
+        size_t length = 0;
+        ShGetInfo(compiler, compiled ? SH_OBJECT_CODE_LENGTH : SH_INFO_LOG_LENGTH, &length);
+        std::vector<char> text(length + 1, '\0');
+        if(compiled)
+        {
+            ShGetObjectCode(compiler, &text[0]);
+            code = &text[0];
+        }
+        else
+        {
+            ShGetInfoLog(compiler, &text[0]);
+            printf("%s", &text[0]);
+        }
+        m_compilers.Release(compiler);
+        return compiled;
+    }
+#endif
+
+    Variant                 m_variants[MAX_VARIANTS];
+    std::string             m_keys[MAX_VARIANTS];
+    unsigned int            m_numVariants;
+    std::vector<MaskRef>    m_refs;
+    bool                    m_translatorInit;
+    bool                    m_minify;
+#ifdef SHADER_TRANSLATOR
+    // every permutation is translated with the same two compilers
+    ShaderCompilerPool      m_compilers;
+#endif
+};
+
+#endif // __PERMUTATION_H__
@@ -0,0 +1,711 @@
+#ifndef __PRECISIONLOWER_H__
+#define __PRECISIONLOWER_H__
+
+#include "shadertree.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+// Finds the float variables of a GLSL ES 1.00 fragment shader that can be
+// declared mediump or lowp, and rewrites their declarations.
+//
+// Every value in the shader's intermediate tree is given a bound on its
+// magnitude: constants bound themselves, texture lookups return colors in
+// [0,1], normalize() returns unit vectors, and arithmetic combines the bounds
+// of its operands (dot products of unit vectors stay within 1, clamp() and
+// mix() within their limits). A variable is bounded by everything assigned to
+// it, found by repeating the walk until the bounds stop growing; one still
+// growing after a few walks, such as an accumulator in a loop, is unbounded.
+// Calls to functions of the shader are unbounded, and so are the variables
+// passed to them.
+//
+// The fragment shader alone does not tell the range of its uniforms and
+// varyings. Those given a range with SetInputRange() are bounded by it,
+// inputs used as texture coordinates are assumed to lie within the texture
+// coordinate range, and inputs only used as the argument of normalize() need
+// no range to be mediump. Any other input keeps its precision.
+//
+// Variables are then lowered to:
+//  - lowp (range 2, steps of 1/256) when bounded by 2 and computed from a
+//    texture lookup, that is colors;
+//  - mediump (range 2^14, 10 bits of mantissa) when bounded by 2^14, except
+//    texture coordinates, which additionally need steps of at most half a
+//    texel of the largest texture: coordinate range * texture size <= 512.
+// Uniforms declared in the vertex shader too keep their precision, since both
+// stages must agree on it.
+class PrecisionLowering
+{
+public:
+    enum Precision
+    {
+        PRECISION_LOW,
+        PRECISION_MEDIUM,
+        PRECISION_HIGH
+    };
+
+    struct Variable
+    {
+        std::string     name;
+        std::string     qualifier;      // "uniform", "varying" or empty for locals
+        std::string     type;
+        Precision       current;
+        Precision       suggested;
+        double          bound;          // HUGE_VAL when unbounded
+        std::string     reason;
+    };
+
+    PrecisionLowering() : m_coordRange(1.0), m_textureSize(512)
+    {}
+
+    // Bound the magnitude of a uniform or varying.
+    void SetInputRange(const std::string& name, double maxAbs)
+    {
+        m_ranges[name] = maxAbs;
+    }
+
+    // Range of the inputs used as texture coordinates, and the size in texels
+    // of the largest texture they address.
+    void SetTextureCoordinates(double range, unsigned int textureSize)
+    {
+        m_coordRange = range;
+        m_textureSize = textureSize;
+    }
+
+    // Uniforms that must keep their precision.
+    void AddSharedUniform(const std::string& name)
+    {
+        m_shared.push_back(name);
+    }
+
+    // Bound every float variable of the tree and choose its precision.
+    void Analyze(const ShaderTree& tree)
+    {
+        m_tree = &tree;
+        m_vars.clear();
+        m_variables.clear();
+        CollectVariables(0, 0);
+        for(std::map<std::string, VarState>::iterator it = m_vars.begin(); it != m_vars.end(); ++it)
+        {
+            InitBound(it->first, it->second);
+        }
+
+        // raise the bounds of assigned variables until they settle; ones
+        // still growing after MAX_WALKS walks are unbounded
+        for(unsigned int walk = 0; ; walk++)
+        {
+            Evaluate(0);
+            bool changed = false;
+            for(std::map<std::string, VarState>::iterator it = m_vars.begin(); it != m_vars.end(); ++it)
+            {
+                VarState& v = it->second;
+                if(v.next.maxAbs > v.value.maxAbs || v.next.flags != v.value.flags)
+                {
+                    v.value.maxAbs = (walk >= MAX_WALKS) ? HUGE_VAL : v.next.maxAbs;
+                    v.value.flags = v.next.flags;
+                    changed = true;
+                }
+            }
+            if(!changed)
+            {
+                break;
+            }
+        }
+
+        for(std::map<std::string, VarState>::iterator it = m_vars.begin(); it != m_vars.end(); ++it)
+        {
+            Choose(it->first, it->second);
+        }
+    }
+
+    unsigned int GetVariableCount() const
+    {
+        return (unsigned int) m_variables.size();
+    }
+
+    const Variable& GetVariable(unsigned int i) const
+    {
+        return m_variables[i];
+    }
+
+    static const char* GetPrecisionName(Precision p)
+    {
+        return (p == PRECISION_LOW) ? "lowp" : (p == PRECISION_MEDIUM) ? "mediump" : "highp";
+    }
+
+    // Write the declarations of the lowered variables in source with their
+    // new precision qualifier. A declaration of several variables gets the
+    // highest precision any of them needs; declarations hidden behind
+    // macros are not found. Returns the number of declarations changed.
+    unsigned int Rewrite(const std::string& source, std::string& output) const
+    {
+        std::vector<Token> tokens;
+        Tokenize(source, tokens);
+        output = source;
+        unsigned int changed = 0;
+        // edit from the end so earlier offsets stay valid
+        for(int i = (int) tokens.size() - 1; i >= 0; i--)
+        {
+            if(!tokens[i].statementStart)
+            {
+                continue;
+            }
+            // qualifiers and the type come before the first declared name
+            unsigned int type = i;
+            int precision = -1;
+            for(; type < tokens.size() && tokens[type].identifier && !IsFloatType(tokens[type].text); type++)
+            {
+                const std::string& w = tokens[type].text;
+                precision = (w == "highp" || w == "mediump" || w == "lowp") ? (int) type : precision;
+            }
+            if(type + 2 >= tokens.size() || !tokens[type].identifier || !tokens[type + 1].identifier ||
+               tokens[type + 2].text == "(")
+            {
+                continue;       // not a declaration, or a function
+            }
+            // the names are the first identifier and those after commas
+            // outside brackets
+            Precision needed = PRECISION_LOW;
+            Precision current = PRECISION_LOW;
+            bool known = true;
+            unsigned int t = type + 1;
+            for(int depth = 0; t < tokens.size() && tokens[t].text != ";" && tokens[t].text != "{"; t++)
+            {
+                const std::string& w = tokens[t].text;
+                depth += (w == "(" || w == "[") ? 1 : (w == ")" || w == "]") ? -1 : 0;
+                if(depth < 0)
+                {
+                    break;      // a parameter
+                }
+                if(tokens[t].identifier && (t == type + 1 || (depth == 0 && tokens[t - 1].text == ",")))
+                {
+                    const Variable* v = Find(w);
+                    known = known && v != NULL;
+                    needed = (v != NULL && v->suggested > needed) ? v->suggested : needed;
+                    current = (v != NULL && v->current > current) ? v->current : current;
+                }
+            }
+            if(!known || needed >= current || t >= tokens.size() || tokens[t].text != ";")
+            {
+                continue;
+            }
+            output.insert(tokens[type].offset, std::string(GetPrecisionName(needed)) + " ");
+            if(precision >= 0)
+            {
+                output.erase(tokens[precision].offset, tokens[type].offset - tokens[precision].offset);
+            }
+            changed++;
+        }
+        return changed;
+    }
+
+private:
+    enum { MAX_WALKS = 8 };
+
+    enum
+    {
+        VALUE_TEXEL = 0x1,      // computed from a texture lookup
+        VALUE_UNIT  = 0x2       // unit length vector
+    };
+
+    struct Value
+    {
+        double          maxAbs;
+        double          minAbs;
+        unsigned int    flags;
+    };
+
+    struct VarState
+    {
+        VarState() :
+            decl(NULL), input(false), assigned(false), escapes(false), coordinate(false), uses(0),
+            normalizedUses(0)
+        {}
+
+        const ShaderTree::Node* decl;
+        Value           value;
+        Value           next;           // join of this walk's assignments
+        bool            input;
+        bool            assigned;
+        bool            escapes;        // passed to a function of the shader
+        bool            coordinate;     // used in a texture coordinate
+        unsigned int    uses;
+        unsigned int    normalizedUses;
+    };
+
+    struct Token
+    {
+        std::string     text;
+        size_t          offset;
+        bool            identifier;
+        bool            statementStart;
+    };
+
+    const Variable* Find(const std::string& name) const
+    {
+        for(unsigned int i = 0; i < m_variables.size(); i++)
+        {
+            if(m_variables[i].name == name)
+            {
+                return &m_variables[i];
+            }
+        }
+        return NULL;
+    }
+
+    static Value MakeValue(double maxAbs, unsigned int flags)
+    {
+        Value v = { maxAbs, 0.0, flags };
+        return v;
+    }
+
+    static double Max(double a, double b)
+    {
+        return (a > b) ? a : b;
+    }
+
+    static bool IsFloatType(const std::string& w)
+    {
+        return w == "float" || w == "vec2" || w == "vec3" || w == "vec4" ||
+               w == "mat2" || w == "mat3" || w == "mat4";
+    }
+
+    // Find the float variables and how they are used.
+    void CollectVariables(int i, int parent)
+    {
+        const ShaderTree::Node& n = m_tree->GetNode(i);
+        if(n.kind == ShaderTree::NODE_SYMBOL && n.type.basic == "float" && n.text.compare(0, 3, "gl_") != 0)
+        {
+            VarState& v = m_vars[n.text];
+            if(v.uses == 0 && v.decl == NULL)
+            {
+                v.decl = &n;
+                v.input = n.type.qualifier == "uniform" || n.type.qualifier == "varying";
+            }
+            v.uses++;
+            v.normalizedUses += m_tree->Is(parent, "normalize") ? 1 : 0;
+        }
+        if(n.kind != ShaderTree::NODE_OPERATION)
+        {
+            return;
+        }
+        if(m_tree->Is(i, "Function Call: texture") && n.children.size() >= 2)
+        {
+            MarkSymbols(n.children[1], &VarState::coordinate);
+        }
+        else if(m_tree->Is(i, "Function Call: "))
+        {
+            for(unsigned int c = 0; c < n.children.size(); c++)
+            {
+                MarkSymbols(n.children[c], &VarState::escapes);
+            }
+        }
+        else if(m_tree->Is(i, "Function Parameters"))
+        {
+            // parameters are bound by their callers, which are not followed
+            for(unsigned int c = 0; c < n.children.size(); c++)
+            {
+                MarkSymbols(n.children[c], &VarState::escapes);
+            }
+        }
+        for(unsigned int c = 0; c < n.children.size(); c++)
+        {
+            CollectVariables(n.children[c], i);
+        }
+    }
+
+    void MarkSymbols(int i, bool VarState::*flag)
+    {
+        const ShaderTree::Node& n = m_tree->GetNode(i);
+        if(n.kind == ShaderTree::NODE_SYMBOL)
+        {
+            m_vars[n.text].*flag = true;
+        }
+        for(unsigned int c = 0; c < n.children.size(); c++)
+        {
+            MarkSymbols(n.children[c], flag);
+        }
+    }
+
+    void InitBound(const std::string& name, VarState& v)
+    {
+        v.value = MakeValue(0.0, 0);
+        if(v.input)
+        {
+            std::map<std::string, double>::const_iterator range = m_ranges.find(name);
+            double maxAbs = (range != m_ranges.end()) ? range->second : v.coordinate ? m_coordRange : HUGE_VAL;
+            v.value = MakeValue(maxAbs, 0);
+        }
+        else if(v.escapes)
+        {
+            v.value = MakeValue(HUGE_VAL, 0);
+        }
+        v.next = v.value;
+    }
+
+    // Record an assignment to the variable an lvalue writes to.
+    void Assign(int lvalue, const Value& value)
+    {
+        int symbol = m_tree->GetBaseSymbol(lvalue);
+        if(symbol < 0)
+        {
+            return;
+        }
+        std::map<std::string, VarState>::iterator it = m_vars.find(m_tree->GetNode(symbol).text);
+        if(it == m_vars.end())
+        {
+            return;
+        }
+        VarState& v = it->second;
+        // colors stay colors whatever else is assigned; a vector is only unit
+        // length if every value written to all of it is
+        unsigned int unit = (symbol == lvalue) ? (value.flags & VALUE_UNIT) : 0;
+        unit = v.assigned ? (unit & v.next.flags) : unit;
+        v.next.maxAbs = Max(v.next.maxAbs, value.maxAbs);
+        v.next.flags = ((v.next.flags | value.flags) & VALUE_TEXEL) | unit;
+        v.assigned = true;
+    }
+
+    // Bound the value of a node with the variable bounds of the last walk,
+    // recording the assignments it makes.
+    Value Evaluate(int i)
+    {
+        const ShaderTree::Node& n = m_tree->GetNode(i);
+        if(n.kind == ShaderTree::NODE_CONSTANT)
+        {
+            Value v = { n.maxAbs, n.minAbs, 0 };
+            return v;
+        }
+        if(n.kind == ShaderTree::NODE_SYMBOL)
+        {
+            std::map<std::string, VarState>::const_iterator it = m_vars.find(n.text);
+            if(it != m_vars.end())
+            {
+                return it->second.value;
+            }
+            // built-ins; gl_FragCoord is in window coordinates
+            return MakeValue((n.text == "gl_PointCoord" || n.text == "gl_FrontFacing") ? 1.0 : HUGE_VAL, 0);
+        }
+
+        std::vector<Value> args(n.children.size());
+        for(unsigned int c = 0; c < n.children.size(); c++)
+        {
+            args[c] = Evaluate(n.children[c]);
+        }
+        double a = args.empty() ? 0.0 : args[0].maxAbs;
+        double b = (args.size() < 2) ? a : args[1].maxAbs;
+        double all = 0.0;
+        unsigned int texel = 0;
+        for(unsigned int c = 0; c < args.size(); c++)
+        {
+            all = Max(all, args[c].maxAbs);
+            texel |= args[c].flags & VALUE_TEXEL;
+        }
+        unsigned int units = (args.size() >= 2) ? (args[0].flags & args[1].flags & VALUE_UNIT) : 0;
+        double size = (n.type.components > 0) ? n.type.components : 1.0;
+        double argSize = (!n.children.empty() && m_tree->GetNode(n.children[0]).type.components > 0) ?
+                         m_tree->GetNode(n.children[0]).type.components : 1.0;
+
+        // assignments
+        if(m_tree->Is(i, "move second child to first child") || m_tree->Is(i, "initialize first child with second child"))
+        {
+            if(args.size() == 2)
+            {
+                Assign(n.children[0], args[1]);
+                return args[1];
+            }
+            return MakeValue(0.0, 0);
+        }
+        if(args.size() == 2 && n.text.find("second child into first child") != std::string::npos)
+        {
+            // a += b and the like: the result of the operation is assigned
+            bool add = m_tree->Is(i, "add") || m_tree->Is(i, "subtract");
+            bool div = m_tree->Is(i, "divide");
+            double scale = m_tree->Is(i, "matrix mult") ? argSize : 1.0;
+            Value v = MakeValue(add ? a + b : div ? (args[1].minAbs > 0.0 ? a / args[1].minAbs : HUGE_VAL) : a * b * scale,
+                                texel);
+            Assign(n.children[0], v);
+            return v;
+        }
+
+        // indexing
+        if(m_tree->Is(i, "vector swizzle") || m_tree->Is(i, "direct index") || m_tree->Is(i, "indirect index"))
+        {
+            return MakeValue(a, args.empty() ? 0 : (args[0].flags & VALUE_TEXEL));
+        }
+
+        // arithmetic
+        if(m_tree->Is(i, "add") || m_tree->Is(i, "subtract"))
+        {
+            return MakeValue(a + b, texel);
+        }
+        if(m_tree->Is(i, "component-wise multiply") || m_tree->Is(i, "vector-scale") || m_tree->Is(i, "matrix-scale"))
+        {
+            return MakeValue(a * b, texel);
+        }
+        if(m_tree->Is(i, "vector-times-matrix") || m_tree->Is(i, "matrix-times-vector") || m_tree->Is(i, "matrix-multiply"))
+        {
+            return MakeValue(a * b * size, texel);
+        }
+        if(m_tree->Is(i, "divide"))
+        {
+            return MakeValue((args.size() == 2 && args[1].minAbs > 0.0) ? a / args[1].minAbs : HUGE_VAL, texel);
+        }
+        if(m_tree->Is(i, "Negate value") || m_tree->Is(i, "Absolute value"))
+        {
+            return args.empty() ? MakeValue(0.0, 0) : args[0];
+        }
+        if(m_tree->Is(i, "Floor") || m_tree->Is(i, "Ceiling"))
+        {
+            return MakeValue(a + 1.0, texel);
+        }
+        if(m_tree->Is(i, "Sign") || m_tree->Is(i, "Fraction") || m_tree->Is(i, "sine") || m_tree->Is(i, "cosine") ||
+           m_tree->Is(i, "step") || m_tree->Is(i, "smoothstep") || m_tree->Is(i, "Compare") ||
+           m_tree->Is(i, "logical") || m_tree->Is(i, "Negate conditional"))
+        {
+            return MakeValue(1.0, texel);
+        }
+        if(m_tree->Is(i, "normalize"))
+        {
+            return MakeValue(1.0, VALUE_UNIT);
+        }
+        if(m_tree->Is(i, "length"))
+        {
+            return MakeValue((args.size() == 1 && (args[0].flags & VALUE_UNIT)) ? 1.0 : a * sqrt(argSize), 0);
+        }
+        if(m_tree->Is(i, "sqrt"))
+        {
+            return MakeValue(sqrt(a), texel);
+        }
+        if(m_tree->Is(i, "exp2"))
+        {
+            return MakeValue(pow(2.0, a), texel);
+        }
+        if(m_tree->Is(i, "exp"))
+        {
+            return MakeValue(exp(a), texel);
+        }
+        if(m_tree->Is(i, "dot-product"))
+        {
+            double vectorSize = sqrt(argSize);
+            double d = units ? 1.0 : (args.size() == 2 && (args[0].flags & VALUE_UNIT)) ? b * vectorSize :
+                       (args.size() == 2 && (args[1].flags & VALUE_UNIT)) ? a * vectorSize : a * b * argSize;
+            return MakeValue(d, texel);
+        }
+        if(m_tree->Is(i, "cross-product"))
+        {
+            return MakeValue(units ? 1.0 : 2.0 * a * b, texel);
+        }
+        if(m_tree->Is(i, "distance"))
+        {
+            return MakeValue((a + b) * sqrt(argSize), 0);
+        }
+        if(m_tree->Is(i, "reflect"))
+        {
+            // I - 2 dot(N, I) N
+            double d = (args.size() == 2 && (args[1].flags & VALUE_UNIT)) ? 3.0 * a : a + 2.0 * argSize * a * b * b;
+            return MakeValue(d, units);
+        }
+        if(m_tree->Is(i, "face-forward"))
+        {
+            return args.empty() ? MakeValue(0.0, 0) : args[0];
+        }
+        if(m_tree->Is(i, "min") || m_tree->Is(i, "max") || m_tree->Is(i, "Construct"))
+        {
+            return MakeValue(all, texel);
+        }
+        if(m_tree->Is(i, "clamp"))
+        {
+            // constant limits may have been read as one node
+            double limits = 0.0;
+            for(unsigned int c = 1; c < args.size(); c++)
+            {
+                limits = Max(limits, args[c].maxAbs);
+            }
+            return MakeValue((args.size() > 1) ? limits : a, texel);
+        }
+        if(m_tree->Is(i, "mix"))
+        {
+            // x * (1 - t) + y * t stays between x and y for t in [0,1]
+            return MakeValue((!args.empty() && args.back().maxAbs <= 1.0) ? all : HUGE_VAL, texel);
+        }
+        if(m_tree->Is(i, "mod"))
+        {
+            return MakeValue(b, texel);
+        }
+        if(m_tree->Is(i, "arc tangent"))
+        {
+            return MakeValue(4.0, 0);
+        }
+        if(m_tree->Is(i, "Function Call: texture"))
+        {
+            return MakeValue(1.0, VALUE_TEXEL);
+        }
+        if(m_tree->Is(i, "Test condition and select"))
+        {
+            // children are "Condition", the condition, "true case", the
+            // true expression, "false case" and the false expression
+            double selected = 0.0;
+            for(unsigned int c = 1; c < n.children.size(); c++)
+            {
+                selected = (m_tree->Is(n.children[c - 1], "true case") || m_tree->Is(n.children[c - 1], "false case")) ?
+                           Max(selected, args[c].maxAbs) : selected;
+            }
+            return MakeValue(selected, texel);
+        }
+        if(m_tree->Is(i, "Comma"))
+        {
+            return args.empty() ? MakeValue(0.0, 0) : args.back();
+        }
+        if(m_tree->Is(i, "Post-") || m_tree->Is(i, "Pre-"))
+        {
+            if(!n.children.empty())
+            {
+                Assign(n.children[0], MakeValue(HUGE_VAL, 0));
+            }
+            return MakeValue(HUGE_VAL, 0);
+        }
+        // statements, labels, calls of the shader's own functions and
+        // operations not known to be bounded
+        return MakeValue(n.typed ? HUGE_VAL : 0.0, 0);
+    }
+
+    void Choose(const std::string& name, const VarState& v)
+    {
+        const std::string& qualifier = v.decl->type.qualifier;
+        if(qualifier == "const" || qualifier == "in" || qualifier == "out" || qualifier == "inout")
+        {
+            return;
+        }
+        Variable var;
+        var.name = name;
+        var.qualifier = v.input ? v.decl->type.qualifier : std::string();
+        var.type = v.decl->type.name;
+        var.current = (v.decl->type.precision == "lowp") ? PRECISION_LOW :
+                      (v.decl->type.precision == "mediump") ? PRECISION_MEDIUM : PRECISION_HIGH;
+        var.bound = v.value.maxAbs;
+        var.suggested = var.current;
+
+        char text[128];
+        bool shared = false;
+        for(unsigned int i = 0; i < m_shared.size(); i++)
+        {
+            shared = shared || m_shared[i] == name;
+        }
+        bool normalizedOnly = v.input && v.normalizedUses == v.uses && !v.coordinate;
+        double coordinateLimit = 512.0 / m_textureSize;
+        if(shared)
+        {
+            var.reason = "declared in the vertex shader too";
+        }
+        else if(v.escapes && !v.input)
+        {
+            var.reason = "passed to a function";
+        }
+        else if(normalizedOnly)
+        {
+            var.suggested = PRECISION_MEDIUM;
+            var.reason = "only used normalized";
+        }
+        else if(v.value.maxAbs == HUGE_VAL)
+        {
+            var.reason = v.input ? "range unknown" : "unbounded";
+        }
+        else if(v.coordinate)
+        {
+            var.suggested = (v.value.maxAbs <= coordinateLimit) ? PRECISION_MEDIUM : PRECISION_HIGH;
+            sprintf(text, "texture coordinate, %u texel texture", m_textureSize);
+            var.reason = text;
+        }
+        else if(v.value.maxAbs <= 2.0 && (v.value.flags & VALUE_TEXEL))
+        {
+            var.suggested = PRECISION_LOW;
+            var.reason = "color";
+        }
+        else if(v.value.maxAbs <= 16384.0)
+        {
+            var.suggested = PRECISION_MEDIUM;
+            var.reason = (v.value.flags & VALUE_UNIT) ? "unit vector" : "bounded";
+        }
+        else
+        {
+            var.reason = "exceeds the mediump range";
+        }
+        // never raise a precision the shader asked for
+        var.suggested = (var.suggested < var.current) ? var.suggested : var.current;
+        m_variables.push_back(var);
+    }
+
+    // Split source into identifiers and single characters, skipping comments
+    // and preprocessor lines. Statements start after ';', '{', '}' and
+    // preprocessor lines.
+    static void Tokenize(const std::string& source, std::vector<Token>& tokens)
+    {
+        bool statementStart = true;
+        bool lineStart = true;
+        size_t i = 0;
+        while(i < source.size())
+        {
+            char c = source[i];
+            if(c == '\n')
+            {
+                lineStart = true;
+                i++;
+            }
+            else if(c == ' ' || c == '\t' || c == '\r')
+            {
+                i++;
+            }
+            else if(c == '#' && lineStart)
+            {
+                while(i < source.size() && (source[i] != '\n' || source[i - 1] == '\\'))
+                {
+                    i++;
+                }
+                statementStart = true;
+            }
+            else if(source.compare(i, 2, "//") == 0)
+            {
+                i = source.find('\n', i);
+                i = (i != std::string::npos) ? i : source.size();
+            }
+            else if(source.compare(i, 2, "/*") == 0)
+            {
+                i = source.find("*/", i + 2);
+                i = (i != std::string::npos) ? i + 2 : source.size();
+            }
+            else
+            {
+                Token t;
+                t.offset = i;
+                t.statementStart = statementStart;
+                t.identifier = isalpha((unsigned char) c) || c == '_';
+                bool number = isdigit((unsigned char) c) || c == '.';
+                size_t end = i + 1;
+                while(end < source.size() && (t.identifier || number) &&
+                      (isalnum((unsigned char) source[end]) || source[end] == '_' || (number && source[end] == '.')))
+                {
+                    end++;
+                }
+                t.text = source.substr(i, end - i);
+                tokens.push_back(t);
+                statementStart = c == ';' || c == '{' || c == '}';
+                lineStart = false;
+                i = end;
+            }
+        }
+    }
+
+    const ShaderTree*               m_tree;
+    std::map<std::string, VarState> m_vars;
+    std::vector<Variable>           m_variables;
+    std::map<std::string, double>   m_ranges;
+    std::vector<std::string>        m_shared;
+    double                          m_coordRange;
+    unsigned int                    m_textureSize;
+};
+
+#endif // __PRECISIONLOWER_H__
@@ -0,0 +1,107 @@
+#ifndef __PREPASS_H__
+#define __PREPASS_H__
+
+// Decides whether a draw lays down depth in a position-only pre-pass before
+// shading, so occluded fragments fail the depth test instead of running the
+// full fragment shader.
+//
+// Whether that pays off depends on overdraw and on how expensive the shading
+// is, so in automatic mode the controller measures it: every few hundred
+// draws a short probe alternates draws with and without the pre-pass, timed
+// by the caller, and the cheaper variant is kept until the next probe. The
+// other variant has to be clearly cheaper before the decision flips.
+class DepthPrepassController
+{
+public:
+    enum Mode
+    {
+        PREPASS_OFF,
+        PREPASS_ON,
+        PREPASS_AUTO
+    };
+
+    enum { PROBE_DRAWS = 8, PROBE_INTERVAL = 300 };
+
+    DepthPrepassController() :
+        m_mode(PREPASS_OFF), m_enabled(false), m_hysteresis(0.1),
+        m_draws(0), m_nextProbe(0), m_probe(-1)
+    {
+        m_cost[0] = m_cost[1] = 0.0;
+    }
+
+    void SetMode(Mode mode)
+    {
+        m_mode = mode;
+        m_enabled = mode == PREPASS_ON;
+        m_nextProbe = m_draws;
+        m_probe = -1;
+    }
+
+    Mode GetMode() const
+    {
+        return m_mode;
+    }
+
+    // Whether the next draw uses the pre-pass. Sets 'timed' when the caller
+    // has to measure the draw and pass the time to Report().
+    bool Next(bool* timed)
+    {
+        *timed = false;
+        if(m_mode != PREPASS_AUTO)
+        {
+            return m_mode == PREPASS_ON;
+        }
+        if(m_probe < 0 && m_draws >= m_nextProbe)
+        {
+            m_probe = 0;
+            m_cost[0] = m_cost[1] = -1.0;
+        }
+        m_draws++;
+        if(m_probe < 0)
+        {
+            return m_enabled;
+        }
+        *timed = true;
+        return (m_probe & 1) != 0;
+    }
+
+    // Time in seconds the last timed draw took, pre-pass included.
+    void Report(double seconds)
+    {
+        if(m_probe < 0)
+        {
+            return;
+        }
+        // the fastest sample is the one least disturbed by other work
+        double& cost = m_cost[m_probe & 1];
+        cost = (cost < 0.0 || seconds < cost) ? seconds : cost;
+        if(++m_probe < PROBE_DRAWS)
+        {
+            return;
+        }
+        double current = m_enabled ? m_cost[1] : m_cost[0];
+        double other = m_enabled ? m_cost[0] : m_cost[1];
+        if(other < current * (1.0 - m_hysteresis))
+        {
+            m_enabled = !m_enabled;
+        }
+        m_probe = -1;
+        m_nextProbe = m_draws + PROBE_INTERVAL;
+    }
+
+    bool IsEnabled() const
+    {
+        return m_enabled;
+    }
+
+private:
+    Mode            m_mode;
+    bool            m_enabled;
+    double          m_hysteresis;
+    unsigned int    m_draws;
+    unsigned int    m_nextProbe;
+    int             m_probe;
+    double          m_cost[2];
+};
+
+#endif // __PREPASS_H__
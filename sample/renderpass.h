@@ -0,0 +1,200 @@
+#ifndef __RENDERPASS_H__
+#define __RENDERPASS_H__
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <cstring>
+
+// Whether the current context exposes a GL extension.
+inline bool HasGLExtension(const char* name)
+{
+    const char* exts = (const char*) glGetString(GL_EXTENSIONS);
+    size_t len = strlen(name);
+    while(exts != NULL && *exts != '\0')
+    {
+        const char* end = strchr(exts, ' ');
+        size_t extlen = (end != NULL) ? (size_t) (end - exts) : strlen(exts);
+        if(extlen == len && strncmp(exts, name, len) == 0)
+        {
+            return true;
+        }
+        exts = (end != NULL) ? end + 1 : NULL;
+    }
+    return false;
+}
+
+// Tells the driver that framebuffer contents are no longer needed, so a tiled
+// GPU neither loads them into tile memory nor writes them back.
+//
+// Uses glInvalidateFramebuffer on OpenGL ES 3.0 contexts and
+// glDiscardFramebufferEXT from GL_EXT_discard_framebuffer otherwise. Both take
+// the same arguments, and GL_COLOR/GL_DEPTH share their values with
+// GL_COLOR_EXT/GL_DEPTH_EXT, so one entry point serves either.
+class FramebufferInvalidator
+{
+public:
+    FramebufferInvalidator() : m_invalidate(NULL)
+    {}
+
+    // Look up the entry point for the current context.
+    void Init()
+    {
+        const char* version = (const char*) glGetString(GL_VERSION);
+        if(version != NULL && strncmp(version, "OpenGL ES 3", 11) == 0)
+        {
+            m_invalidate = (PFNGLDISCARDFRAMEBUFFEREXTPROC) eglGetProcAddress("glInvalidateFramebuffer");
+        }
+        if(m_invalidate == NULL && HasGLExtension("GL_EXT_discard_framebuffer"))
+        {
+            m_invalidate = (PFNGLDISCARDFRAMEBUFFEREXTPROC) eglGetProcAddress("glDiscardFramebufferEXT");
+        }
+    }
+
+    bool IsSupported() const
+    {
+        return m_invalidate != NULL;
+    }
+
+    // Drop the attachments selected by a glClear style mask of the
+    // framebuffer currently bound to GL_FRAMEBUFFER. 'window' selects the
+    // attachment names of the window system framebuffer.
+    void Invalidate(GLbitfield mask, bool window) const
+    {
+        if(m_invalidate == NULL || mask == 0)
+        {
+            return;
+        }
+        GLenum attachments[2];
+        GLsizei count = 0;
+        if(mask & GL_COLOR_BUFFER_BIT)
+        {
+            attachments[count++] = window ? GL_COLOR_EXT : GL_COLOR_ATTACHMENT0;
+        }
+        if(mask & GL_DEPTH_BUFFER_BIT)
+        {
+            attachments[count++] = window ? GL_DEPTH_EXT : GL_DEPTH_ATTACHMENT;
+        }
+        m_invalidate(GL_FRAMEBUFFER, count, attachments);
+    }
+
+private:
+    PFNGLDISCARDFRAMEBUFFEREXTPROC  m_invalidate;
+};
+
+// What happens to an attachment's contents when a pass begins.
+enum LoadAction
+{
+    LOAD_ACTION_LOAD,       // keep the previous contents
+    LOAD_ACTION_CLEAR,      // clear to the pass' clear value
+    LOAD_ACTION_DONT_CARE   // every pixel will be overwritten
+};
+
+// What happens to an attachment's contents when a pass ends.
+enum StoreAction
+{
+    STORE_ACTION_STORE,     // needed later, e.g. presented or resolved
+    STORE_ACTION_DONT_CARE  // may be dropped
+};
+
+struct RenderPassAttachment
+{
+    LoadAction  load;
+    StoreAction store;
+};
+
+struct RenderPassDesc
+{
+    // framebuffer object to render to, 0 for the window surface
+    GLuint                  framebuffer;
+    RenderPassAttachment    color;
+    RenderPassAttachment    depth;
+    GLfloat                 clearColor[4];
+    GLfloat                 clearDepth;
+};
+
+// A sequence of draws into one framebuffer with declared load and store
+// actions per attachment. Begin() clears only what the pass asks to clear and
+// invalidates what it will overwrite anyway; End() invalidates what the pass
+// does not store.
+//
+// Clears honour the scissor box, so a scissored pass that clears keeps the
+// rest of the attachment. LOAD_ACTION_DONT_CARE must only be used when the
+// whole attachment is overwritten.
+class RenderPass
+{
+public:
+    RenderPass()
+    {
+        memset(&m_desc, 0, sizeof(m_desc));
+    }
+
+    static RenderPassDesc Describe(GLuint framebuffer,
+                                   LoadAction colorLoad, StoreAction colorStore,
+                                   LoadAction depthLoad, StoreAction depthStore)
+    {
+        RenderPassDesc desc;
+        memset(&desc, 0, sizeof(desc));
+        desc.framebuffer = framebuffer;
+        desc.color.load = colorLoad;
+        desc.color.store = colorStore;
+        desc.depth.load = depthLoad;
+        desc.depth.store = depthStore;
+        desc.clearDepth = 1.0f;
+        return desc;
+    }
+
+    void Init()
+    {
+        m_invalidator.Init();
+    }
+
+    void Begin(const RenderPassDesc& desc)
+    {
+        m_desc = desc;
+        glBindFramebuffer(GL_FRAMEBUFFER, desc.framebuffer);
+        m_invalidator.Invalidate(Mask(LOAD_ACTION_DONT_CARE), desc.framebuffer == 0);
+        GLbitfield clear = Mask(LOAD_ACTION_CLEAR);
+        if(clear & GL_COLOR_BUFFER_BIT)
+        {
+            glClearColor(desc.clearColor[0], desc.clearColor[1], desc.clearColor[2], desc.clearColor[3]);
+        }
+        if(clear & GL_DEPTH_BUFFER_BIT)
+        {
+            glClearDepthf(desc.clearDepth);
+        }
+        if(clear != 0)
+        {
+            glClear(clear);
+        }
+    }
+
+    // Ends the pass with its framebuffer still bound.
+    void End()
+    {
+        GLbitfield drop = 0;
+        drop |= (m_desc.color.store == STORE_ACTION_DONT_CARE) ? GL_COLOR_BUFFER_BIT : 0;
+        drop |= (m_desc.depth.store == STORE_ACTION_DONT_CARE) ? GL_DEPTH_BUFFER_BIT : 0;
+        m_invalidator.Invalidate(drop, m_desc.framebuffer == 0);
+    }
+
+    const FramebufferInvalidator& GetInvalidator() const
+    {
+        return m_invalidator;
+    }
+
+private:
+    GLbitfield Mask(LoadAction load) const
+    {
+        GLbitfield mask = 0;
+        mask |= (m_desc.color.load == load) ? GL_COLOR_BUFFER_BIT : 0;
+        mask |= (m_desc.depth.load == load) ? GL_DEPTH_BUFFER_BIT : 0;
+        return mask;
+    }
+
+    FramebufferInvalidator  m_invalidator;
+    RenderPassDesc          m_desc;
+};
+
+#endif // __RENDERPASS_H__
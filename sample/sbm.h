@@ -2,6 +2,7 @@
 #define __SBM_H__
 
 #include <GLES2/gl2.h>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 
@@ -32,6 +33,12 @@ typedef struct SBM_FRAME_HEADER_t
     unsigned int flags;
 } SBM_FRAME_HEADER;
 
+// Frames flagged with SBM_FRAME_FLAG_LOD hold a simplified copy of frame 0.
+// The low byte of the flags holds the LOD level, starting at 1.
+#define SBM_FRAME_FLAG_LOD          0x00000100
+#define SBM_FRAME_LOD_LEVEL_MASK    0x000000FF
+#define SBM_MAX_LODS                16
+
 typedef struct SBM_VEC4F_t
 {
     float x;
@@ -48,8 +55,17 @@ public:
           m_attribute_buffer(0),
           m_index_buffer(0),
           m_attrib(0),
-          m_frame(0)
+          m_frame(0),
+          m_data(0),
+          m_raw_data(0),
+          m_num_lods(1),
+          m_radius(0.0f)
     {
+        memset(&m_header, 0, sizeof(m_header));
+        m_lod_frame[0] = 0;
+        m_center[0] = m_center[1] = m_center[2] = 0.0f;
+        m_bmin[0] = m_bmin[1] = m_bmin[2] = 0.0f;
+        m_bmax[0] = m_bmax[1] = m_bmax[2] = 0.0f;
     }
 
     virtual ~SBObject(void)
@@ -82,18 +98,43 @@ public:
         }
         fclose(f);
 
-        SBM_HEADER * header = (SBM_HEADER *)m_data;
-        m_raw_data = m_data + sizeof(SBM_HEADER) + header->num_attribs * sizeof(SBM_ATTRIB_HEADER) + header->num_frames * sizeof(SBM_FRAME_HEADER);
-        SBM_ATTRIB_HEADER * attrib_header = (SBM_ATTRIB_HEADER *)(m_data + sizeof(SBM_HEADER));
-        SBM_FRAME_HEADER * frame_header = (SBM_FRAME_HEADER *)(m_data + sizeof(SBM_HEADER) + header->num_attribs * sizeof(SBM_ATTRIB_HEADER));
+        return Parse();
+    }
 
-        memcpy(&m_header, header, sizeof(SBM_HEADER));
-        m_attrib = new SBM_ATTRIB_HEADER[header->num_attribs];
-        memcpy(m_attrib, attrib_header, header->num_attribs * sizeof(SBM_ATTRIB_HEADER));
-        m_frame = new SBM_FRAME_HEADER[header->num_frames];
-        memcpy(m_frame, frame_header, header->num_frames * sizeof(SBM_FRAME_HEADER));
+    // Load a model laid out like an SBM file, e.g. one assembled at runtime.
+    // The data is copied.
+    bool LoadFromMemory(const void * data, size_t size)
+    {
+        if(size < sizeof(SBM_HEADER))
+        {
+            return false;
+        }
+        m_data = new unsigned char [size];
+        memcpy(m_data, data, size);
+        return Parse();
+    }
 
-        return true;
+    // Write the model back, with any changes made through GetVertexData().
+    bool SaveToSBM(const char * filename) const
+    {
+        FILE * f = fopen(filename, "wb");
+        if(f == NULL)
+        {
+            printf("Could not open %s for writing.\n", filename);
+            return false;
+        }
+
+        SBM_HEADER header = m_header;
+        header.size = sizeof(SBM_HEADER);
+        header.num_indices = 0;
+        fwrite(&header, sizeof(header), 1, f);
+        fwrite(m_attrib, sizeof(SBM_ATTRIB_HEADER), m_header.num_attribs, f);
+        fwrite(m_frame, sizeof(SBM_FRAME_HEADER), m_header.num_frames, f);
+        fwrite(m_raw_data, 1, GetAttribOffset(m_header.num_attribs), f);
+
+        bool ok = ferror(f) == 0;
+        fclose(f);
+        return ok;
     }
 
     bool Free(void)
@@ -109,6 +150,8 @@ public:
         m_frame = NULL;
         
         delete [] m_data;
+        m_data = NULL;
+        m_raw_data = NULL;
 
         return true;
     }
@@ -128,11 +171,31 @@ public:
         return index < m_header.num_attribs ? m_attrib[index].components : 0;
     }
 
+    const SBM_HEADER& GetHeader(void) const
+    {
+        return m_header;
+    }
+
+    const SBM_ATTRIB_HEADER* GetAttributeHeader(unsigned int index) const
+    {
+        return index < m_header.num_attribs ? &m_attrib[index] : 0;
+    }
+
+    const SBM_FRAME_HEADER* GetFrameHeader(unsigned int frame) const
+    {
+        return frame < m_header.num_frames ? &m_frame[frame] : 0;
+    }
+
     unsigned char* GetVertexData()
     {
         return m_raw_data;
     }
 
+    const unsigned char* GetVertexData() const
+    {
+        return m_raw_data;
+    }
+
     unsigned int GetNumVertices() const
     {
         return m_header.num_vertices;
@@ -148,7 +211,190 @@ public:
         return (frame < m_header.num_frames) ? m_frame[frame].count : 0;
     }
 
+    unsigned int GetNumFrames() const
+    {
+        return m_header.num_frames;
+    }
+
+    // Number of detail levels, including the full resolution frame 0.
+    unsigned int GetLODCount() const
+    {
+        return m_num_lods;
+    }
+
+    // Frame holding the given detail level. Levels missing from the file
+    // fall back to the next finer level that exists.
+    unsigned int GetLODFrame(unsigned int lod) const
+    {
+        return m_lod_frame[(lod < m_num_lods) ? lod : m_num_lods - 1];
+    }
+
+    // Bounding sphere of the position attribute over all vertices.
+    void GetBoundingSphere(float center[3], float* radius) const
+    {
+        center[0] = m_center[0];
+        center[1] = m_center[1];
+        center[2] = m_center[2];
+        *radius = m_radius;
+    }
+
+    // Axis aligned bounding box of the position attribute over all vertices.
+    void GetBoundingBox(float bmin[3], float bmax[3]) const
+    {
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            bmin[k] = m_bmin[k];
+            bmax[k] = m_bmax[k];
+        }
+    }
+
+    // Upload the vertex data into a buffer object. The attribute arrays keep
+    // the layout of the file, so attribute i starts at GetAttribOffset(i).
+    bool CreateBuffers(void)
+    {
+        GLsizeiptr size = 0;
+        for(unsigned int i = 0; i < m_header.num_attribs; i++)
+        {
+            size += m_attrib[i].components * sizeof(GLfloat) * m_header.num_vertices;
+        }
+        glGenBuffers(1, &m_attribute_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_attribute_buffer);
+        glBufferData(GL_ARRAY_BUFFER, size, m_raw_data, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return glGetError() == GL_NO_ERROR;
+    }
+
+    void DeleteBuffers(void)
+    {
+        if(m_attribute_buffer != 0)
+        {
+            glDeleteBuffers(1, &m_attribute_buffer);
+            m_attribute_buffer = 0;
+        }
+    }
+
+    // Buffer created by CreateBuffers(), 0 if the data is only in memory.
+    GLuint GetVertexBuffer(void) const
+    {
+        return m_attribute_buffer;
+    }
+
+    // Byte offset of an attribute array within the vertex data.
+    unsigned int GetAttribOffset(unsigned int index) const
+    {
+        unsigned int offset = 0;
+        for(unsigned int i = 0; i < index && i < m_header.num_attribs; i++)
+        {
+            offset += m_attrib[i].components * sizeof(GLfloat) * m_header.num_vertices;
+        }
+        return offset;
+    }
+
 protected:
+    // Set up the model from the file contents in m_data.
+    bool Parse(void)
+    {
+        SBM_HEADER * header = (SBM_HEADER *)m_data;
+        m_raw_data = m_data + sizeof(SBM_HEADER) + header->num_attribs * sizeof(SBM_ATTRIB_HEADER) + header->num_frames * sizeof(SBM_FRAME_HEADER);
+        SBM_ATTRIB_HEADER * attrib_header = (SBM_ATTRIB_HEADER *)(m_data + sizeof(SBM_HEADER));
+        SBM_FRAME_HEADER * frame_header = (SBM_FRAME_HEADER *)(m_data + sizeof(SBM_HEADER) + header->num_attribs * sizeof(SBM_ATTRIB_HEADER));
+
+        memcpy(&m_header, header, sizeof(SBM_HEADER));
+        m_attrib = new SBM_ATTRIB_HEADER[header->num_attribs];
+        memcpy(m_attrib, attrib_header, header->num_attribs * sizeof(SBM_ATTRIB_HEADER));
+        m_frame = new SBM_FRAME_HEADER[header->num_frames];
+        memcpy(m_frame, frame_header, header->num_frames * sizeof(SBM_FRAME_HEADER));
+
+        BuildLODTable();
+        ComputeBounds();
+
+        return true;
+    }
+
+    void BuildLODTable(void)
+    {
+        unsigned int i;
+        m_num_lods = 1;
+        m_lod_frame[0] = 0;
+        for(i = 0; i < m_header.num_frames; i++)
+        {
+            if(m_frame[i].flags & SBM_FRAME_FLAG_LOD)
+            {
+                unsigned int level = m_frame[i].flags & SBM_FRAME_LOD_LEVEL_MASK;
+                if(level > 0 && level < SBM_MAX_LODS && level >= m_num_lods)
+                {
+                    m_num_lods = level + 1;
+                }
+            }
+        }
+        for(i = 1; i < m_num_lods; i++)
+        {
+            m_lod_frame[i] = m_lod_frame[i-1];
+        }
+        for(i = 0; i < m_header.num_frames; i++)
+        {
+            unsigned int level = m_frame[i].flags & SBM_FRAME_LOD_LEVEL_MASK;
+            if((m_frame[i].flags & SBM_FRAME_FLAG_LOD) && level > 0 && level < m_num_lods)
+            {
+                m_lod_frame[level] = i;
+            }
+        }
+        // fill holes from the next finer level
+        for(i = 1; i < m_num_lods; i++)
+        {
+            if(m_lod_frame[i] == 0)
+            {
+                m_lod_frame[i] = m_lod_frame[i-1];
+            }
+        }
+    }
+
+    void ComputeBounds(void)
+    {
+        unsigned int comps = GetAttribComponents(0);
+        unsigned int count = m_header.num_vertices;
+        const float* pos = (const float*) m_raw_data;
+        float* bmin = m_bmin;
+        float* bmax = m_bmax;
+        unsigned int i, k;
+
+        m_radius = 0.0f;
+        for(k = 0; k < 3; k++)
+        {
+            bmin[k] = bmax[k] = 0.0f;
+        }
+        if(comps < 3 || count == 0)
+        {
+            return;
+        }
+        for(k = 0; k < 3; k++)
+        {
+            bmin[k] = bmax[k] = pos[k];
+        }
+        for(i = 1; i < count; i++)
+        {
+            for(k = 0; k < 3; k++)
+            {
+                float p = pos[i * comps + k];
+                bmin[k] = (p < bmin[k]) ? p : bmin[k];
+                bmax[k] = (p > bmax[k]) ? p : bmax[k];
+            }
+        }
+        for(k = 0; k < 3; k++)
+        {
+            m_center[k] = (bmin[k] + bmax[k]) * 0.5f;
+        }
+        for(i = 0; i < count; i++)
+        {
+            float dx = pos[i * comps + 0] - m_center[0];
+            float dy = pos[i * comps + 1] - m_center[1];
+            float dz = pos[i * comps + 2] - m_center[2];
+            float d2 = dx*dx + dy*dy + dz*dz;
+            m_radius = (d2 > m_radius) ? d2 : m_radius;
+        }
+        m_radius = sqrtf(m_radius);
+    }
+
     GLuint m_vao;
     GLuint m_attribute_buffer;
     GLuint m_index_buffer;
@@ -166,6 +412,13 @@ protected:
 
     unsigned char * m_data;
     unsigned char * m_raw_data;
+
+    unsigned int m_lod_frame[SBM_MAX_LODS];
+    unsigned int m_num_lods;
+    float m_center[3];
+    float m_radius;
+    float m_bmin[3];
+    float m_bmax[3];
 };
 
 #endif /* __SBM_H__ */
@@ -0,0 +1,245 @@
+// sbmatlas - packs the textures of SBM models into one atlas.
+//
+// usage: sbmatlas [-max <size>] <atlas.bmp> <model.sbm> <texture.bmp> <output.sbm> [...]
+//
+// Every texture is copied into one 24 bit BMP atlas, and the texture
+// coordinates (attribute 2) of its model are remapped to the texture's place
+// in the atlas, so all the models can be drawn with a single texture bound.
+// Textures are packed on shelves, tallest first, into the smallest power of
+// two atlas they fit in, square before 2:1 of the same area, with no side
+// over -max (default 4096). Each one is surrounded by a border of texels copied
+// from its edge, so bilinear filtering at the edge of a texture samples what
+// GL_CLAMP_TO_EDGE would have. Texture coordinates are clamped to [0,1] for the
+// same reason; models repeating their texture cannot share an atlas.
+
+#include "bmp.h"
+#include "sbm.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const GLint ATLAS_BORDER = 1;
+static const GLint ATLAS_DEFAULT_MAX_SIZE = 4096;
+// keeps the area of the largest atlas in a GLint
+static const GLint ATLAS_LIMIT_SIZE = 16384;
+
+struct AtlasEntry
+{
+    const char* modelPath;
+    const char* texturePath;
+    const char* outputPath;
+    GLbyte*     bits;
+    GLint       width;
+    GLint       height;
+    // position of the texture in the atlas, border excluded
+    GLint       x;
+    GLint       y;
+};
+
+struct TallerFirst
+{
+    const std::vector<AtlasEntry>* entries;
+
+    bool operator ()(unsigned int a, unsigned int b) const
+    {
+        return (*entries)[a].height > (*entries)[b].height;
+    }
+};
+
+static bool Pack(std::vector<AtlasEntry>& entries, GLint atlasWidth, GLint atlasHeight)
+{
+    std::vector<unsigned int> order(entries.size());
+    for(unsigned int i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    TallerFirst taller = { &entries };
+    std::stable_sort(order.begin(), order.end(), taller);
+
+    GLint x = 0;
+    GLint y = 0;
+    GLint shelfHeight = 0;
+    for(unsigned int i = 0; i < order.size(); i++)
+    {
+        AtlasEntry& e = entries[order[i]];
+        GLint w = e.width + 2 * ATLAS_BORDER;
+        GLint h = e.height + 2 * ATLAS_BORDER;
+        if(x + w > atlasWidth)
+        {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        if(w > atlasWidth || y + h > atlasHeight)
+        {
+            return false;
+        }
+        e.x = x + ATLAS_BORDER;
+        e.y = y + ATLAS_BORDER;
+        x += w;
+        shelfHeight = (h > shelfHeight) ? h : shelfHeight;
+    }
+    return true;
+}
+
+// Pick the smallest atlas the shelves fit in, trying sizes by area: the
+// square of an area first, then its wide and tall 2:1 rectangles. Returns
+// false if none with sides up to maxSize holds the textures.
+static bool ChooseSize(std::vector<AtlasEntry>& entries, GLint area, GLint maxSize,
+                       GLint* atlasWidth, GLint* atlasHeight)
+{
+    for(int k = 0; (1 << ((k + 1) / 2)) <= maxSize; k++)
+    {
+        GLint longSide = 1 << ((k + 1) / 2);
+        GLint shortSide = 1 << (k / 2);
+        if(longSide * shortSide < area)
+        {
+            continue;
+        }
+        if(Pack(entries, longSide, shortSide))
+        {
+            *atlasWidth = longSide;
+            *atlasHeight = shortSide;
+            return true;
+        }
+        if(longSide != shortSide && Pack(entries, shortSide, longSide))
+        {
+            *atlasWidth = shortSide;
+            *atlasHeight = longSide;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Copy a texture and its border into the atlas. Rows of both are bottom-up.
+static void Blit(const AtlasEntry& e, GLbyte* atlas, GLint atlasWidth)
+{
+    GLuint srcRow = GetBMPRowSize(e.width);
+    GLuint dstRow = GetBMPRowSize(atlasWidth);
+    for(GLint y = -ATLAS_BORDER; y < e.height + ATLAS_BORDER; y++)
+    {
+        GLint sy = (y < 0) ? 0 : (y >= e.height) ? e.height - 1 : y;
+        for(GLint x = -ATLAS_BORDER; x < e.width + ATLAS_BORDER; x++)
+        {
+            GLint sx = (x < 0) ? 0 : (x >= e.width) ? e.width - 1 : x;
+            memcpy(&atlas[(e.y + y) * dstRow + (e.x + x) * 3], &e.bits[sy * srcRow + sx * 3], 3);
+        }
+    }
+}
+
+// Move the texture coordinates of a model into its rectangle of the atlas.
+// Returns the number of coordinates that had to be clamped.
+static unsigned int Remap(SBObject& obj, const AtlasEntry& e, GLint atlasWidth, GLint atlasHeight)
+{
+    unsigned int comps = obj.GetAttribComponents(2);
+    float* uv = (float*) (obj.GetVertexData() + obj.GetAttribOffset(2));
+    unsigned int clamped = 0;
+    for(unsigned int v = 0; v < obj.GetNumVertices(); v++)
+    {
+        float* t = &uv[v * comps];
+        for(int k = 0; k < 2; k++)
+        {
+            if(t[k] < 0.0f || t[k] > 1.0f)
+            {
+                t[k] = (t[k] < 0.0f) ? 0.0f : 1.0f;
+                clamped++;
+            }
+        }
+        t[0] = (e.x + t[0] * e.width) / atlasWidth;
+        t[1] = (e.y + t[1] * e.height) / atlasHeight;
+    }
+    return clamped;
+}
+
+int main(int argc, char** argv)
+{
+    GLint maxSize = ATLAS_DEFAULT_MAX_SIZE;
+    int first = 1;
+    if(argc > 2 && strcmp(argv[1], "-max") == 0)
+    {
+        maxSize = atoi(argv[2]);
+        first = 3;
+        if(maxSize <= 0 || maxSize > ATLAS_LIMIT_SIZE || (maxSize & (maxSize - 1)) != 0)
+        {
+            printf("-max takes a power of two up to %d.\n", ATLAS_LIMIT_SIZE);
+            return 1;
+        }
+    }
+    if(argc - first < 4 || (argc - first - 1) % 3 != 0)
+    {
+        printf("usage: %s [-max <size>] <atlas.bmp> <model.sbm> <texture.bmp> <output.sbm> [...]\n", argv[0]);
+        return 1;
+    }
+    const char* atlasPath = argv[first];
+
+    std::vector<AtlasEntry> entries;
+    GLint area = 0;
+    for(int i = first + 1; i < argc; i += 3)
+    {
+        AtlasEntry e;
+        e.modelPath = argv[i];
+        e.texturePath = argv[i + 1];
+        e.outputPath = argv[i + 2];
+        e.x = e.y = 0;
+        e.bits = LoadBMP(e.texturePath, &e.width, &e.height);
+        if(e.bits == NULL)
+        {
+            printf("Failed to load %s.\n", e.texturePath);
+            return 1;
+        }
+        entries.push_back(e);
+        area += (e.width + 2 * ATLAS_BORDER) * (e.height + 2 * ATLAS_BORDER);
+    }
+
+    GLint atlasWidth = 0;
+    GLint atlasHeight = 0;
+    if(!ChooseSize(entries, area, maxSize, &atlasWidth, &atlasHeight))
+    {
+        printf("The textures do not fit a %dx%d atlas; raise -max.\n", maxSize, maxSize);
+        return 1;
+    }
+
+    std::vector<GLbyte> atlas(GetBMPRowSize(atlasWidth) * atlasHeight, 0);
+    for(unsigned int i = 0; i < entries.size(); i++)
+    {
+        const AtlasEntry& e = entries[i];
+        Blit(e, &atlas[0], atlasWidth);
+
+        SBObject obj;
+        if(!obj.LoadFromSBM(e.modelPath))
+        {
+            printf("Failed to load %s.\n", e.modelPath);
+            return 1;
+        }
+        if(obj.GetAttributeCount() < 3 || obj.GetAttributeHeader(2)->type != GL_FLOAT ||
+           obj.GetAttribComponents(2) < 2)
+        {
+            printf("%s has no GL_FLOAT texture coordinates in attribute 2.\n", e.modelPath);
+            return 1;
+        }
+        unsigned int clamped = Remap(obj, e, atlasWidth, atlasHeight);
+        if(clamped != 0)
+        {
+            printf("%s: clamped %u texture coordinates outside [0,1].\n", e.modelPath, clamped);
+        }
+        if(!obj.SaveToSBM(e.outputPath))
+        {
+            printf("Failed to write %s.\n", e.outputPath);
+            return 1;
+        }
+        printf("%s: %dx%d at %d,%d\n", e.texturePath, e.width, e.height, e.x, e.y);
+        free(e.bits);
+    }
+
+    if(!SaveBMP(atlasPath, atlasWidth, atlasHeight, &atlas[0]))
+    {
+        printf("Failed to write %s.\n", atlasPath);
+        return 1;
+    }
+    printf("%s: %dx%d\n", atlasPath, atlasWidth, atlasHeight);
+    return 0;
+}
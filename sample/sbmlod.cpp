@@ -0,0 +1,199 @@
+// sbmlod - appends quadric error simplified detail levels to an SBM model.
+//
+// usage: sbmlod <input.sbm> <output.sbm> [levels] [ratio]
+//
+// Frame 0 of the input is simplified 'levels' times, each level keeping
+// 'ratio' of the triangles of the previous one; generation stops early at
+// the first level that removes no triangles. Every level is written as an
+// extra frame flagged with SBM_FRAME_FLAG_LOD so SBObject::GetLODFrame() can
+// find it at runtime. Other frames of the input are copied through after
+// frame 0; LOD frames already present in it are dropped.
+
+#include "sbm.h"
+#include "meshsimplify.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Append the vertices of a frame to 'out' interleaved, so the simplifier sees
+// whole vertices.
+static void Interleave(const SBObject& obj, unsigned int frame, unsigned int stride, std::vector<float>& out)
+{
+    unsigned int numVerts = obj.GetNumVertices();
+    unsigned int first = obj.GetFirstFrameVertex(frame);
+    unsigned int count = obj.GetFrameVertexCount(frame);
+    const float* planar = (const float*) obj.GetVertexData();
+    size_t base = out.size();
+    out.resize(base + count * stride);
+    unsigned int offset = 0;
+    for(unsigned int a = 0; a < obj.GetAttributeCount(); a++)
+    {
+        unsigned int comps = obj.GetAttribComponents(a);
+        for(unsigned int v = 0; v < count; v++)
+        {
+            for(unsigned int c = 0; c < comps; c++)
+            {
+                out[base + v * stride + offset + c] = planar[(first + v) * comps + c];
+            }
+        }
+        planar += numVerts * comps;
+        offset += comps;
+    }
+}
+
+// The frames are written in order, each starting where the previous one
+// ends; only their counts and flags are read.
+static bool WriteSBM(const char* filename, const SBObject& obj, const std::vector<float>& interleaved,
+                     const std::vector<SBM_FRAME_HEADER>& frames, unsigned int stride)
+{
+    FILE* f = fopen(filename, "wb");
+    if(f == NULL)
+    {
+        printf("Could not open %s for writing.\n", filename);
+        return false;
+    }
+
+    unsigned int numAttribs = obj.GetAttributeCount();
+    unsigned int totalVerts = (unsigned int)(interleaved.size() / stride);
+
+    SBM_HEADER header = obj.GetHeader();
+    header.size = sizeof(SBM_HEADER);
+    header.num_frames = (unsigned int) frames.size();
+    header.num_vertices = totalVerts;
+    header.num_indices = 0;
+    fwrite(&header, sizeof(header), 1, f);
+
+    for(unsigned int a = 0; a < numAttribs; a++)
+    {
+        fwrite(obj.GetAttributeHeader(a), sizeof(SBM_ATTRIB_HEADER), 1, f);
+    }
+
+    unsigned int first = 0;
+    for(unsigned int i = 0; i < frames.size(); i++)
+    {
+        SBM_FRAME_HEADER frame = frames[i];
+        frame.first = first;
+        fwrite(&frame, sizeof(frame), 1, f);
+        first += frame.count;
+    }
+
+    // SBM stores each attribute as its own array
+    unsigned int offset = 0;
+    for(unsigned int a = 0; a < numAttribs; a++)
+    {
+        unsigned int comps = obj.GetAttribComponents(a);
+        for(unsigned int v = 0; v < totalVerts; v++)
+        {
+            fwrite(&interleaved[v * stride + offset], sizeof(float), comps, f);
+        }
+        offset += comps;
+    }
+
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        printf("usage: %s <input.sbm> <output.sbm> [levels] [ratio]\n", argv[0]);
+        return 1;
+    }
+    unsigned int levels = (argc > 3) ? (unsigned int) atoi(argv[3]) : 3;
+    float ratio = (argc > 4) ? (float) atof(argv[4]) : 0.5f;
+    if(levels >= SBM_MAX_LODS || ratio <= 0.0f || ratio >= 1.0f)
+    {
+        printf("levels must be below %d and ratio between 0 and 1.\n", SBM_MAX_LODS);
+        return 1;
+    }
+
+    SBObject obj;
+    if(!obj.LoadFromSBM(argv[1]))
+    {
+        printf("Failed to load %s.\n", argv[1]);
+        return 1;
+    }
+    if(obj.GetHeader().num_indices != 0)
+    {
+        printf("Indexed SBM files are not supported.\n");
+        return 1;
+    }
+
+    unsigned int stride = 0;
+    for(unsigned int a = 0; a < obj.GetAttributeCount(); a++)
+    {
+        if(obj.GetAttributeHeader(a)->type != GL_FLOAT)
+        {
+            printf("Attribute %s is not GL_FLOAT.\n", obj.GetAttributeName(a));
+            return 1;
+        }
+        stride += obj.GetAttribComponents(a);
+    }
+    if(obj.GetAttribComponents(0) < 3)
+    {
+        printf("Attribute 0 must be an xyz position.\n");
+        return 1;
+    }
+
+    std::vector<float> base;
+    Interleave(obj, 0, stride, base);
+    unsigned int count = obj.GetFrameVertexCount(0);
+    if(count < 3)
+    {
+        printf("Frame 0 of %s has no triangles.\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<float> out(base);
+    std::vector<SBM_FRAME_HEADER> frames;
+    const SBM_FRAME_HEADER source = *obj.GetFrameHeader(0);
+    SBM_FRAME_HEADER frame = source;
+    frame.first = 0;
+    frame.count = count;
+    frames.push_back(frame);
+    printf("LOD 0: %u triangles\n", count / 3);
+
+    for(unsigned int i = 1; i < obj.GetNumFrames(); i++)
+    {
+        frame = *obj.GetFrameHeader(i);
+        if(frame.flags & SBM_FRAME_FLAG_LOD)
+        {
+            printf("Frame %u: replaced LOD %u\n", i, frame.flags & SBM_FRAME_LOD_LEVEL_MASK);
+            continue;
+        }
+        Interleave(obj, i, stride, out);
+        frames.push_back(frame);
+        printf("Frame %u: copied, %u vertices\n", i, frame.count);
+    }
+
+    // levels carry the flags of frame 0 besides their own
+    MeshSimplifier simplifier(&base[0], count, stride);
+    unsigned int last = simplifier.GetTriangleCount();
+    float target = (float) last;
+    for(unsigned int l = 1; l <= levels; l++)
+    {
+        target *= ratio;
+        unsigned int tris = simplifier.SimplifyTo((unsigned int) target);
+        if(tris >= last)
+        {
+            printf("LOD %u: no triangles removed, %u levels written\n", l, l - 1);
+            break;
+        }
+        frame = source;
+        frame.count = simplifier.Extract(out);
+        frame.flags = (source.flags & ~(SBM_FRAME_FLAG_LOD | SBM_FRAME_LOD_LEVEL_MASK)) | SBM_FRAME_FLAG_LOD | l;
+        frames.push_back(frame);
+        printf("LOD %u: %u triangles\n", l, tris);
+        last = tris;
+    }
+
+    if(!WriteSBM(argv[2], obj, out, frames, stride))
+    {
+        printf("Failed to write %s.\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,296 @@
+// shaderbench - measures how many shaders per second the translator compiles.
+//
+// usage: shaderbench [-threads <n,n,...>] [-repeat <n>] [-code] [-permutations]
+//                    <shader> | @<list> [...]
+//
+// The corpus is the shaders given, files listed one per line in @<list>
+// files, and with -permutations the sample's own GLSL ES 1.00 shading
+// program permutations. Shaders are vertex shaders when their name ends in
+// .vert or .vs, fragment shaders otherwise.
+//
+// For every thread count (default 1, 2, 4 and the number of processors) the
+// corpus is compiled -repeat times (default 10), split evenly between the
+// threads, twice: constructing and destructing a compiler for every shader,
+// and with compilers from a ShaderCompilerPool. Shaders are validated only,
+// or also translated to ESSL with -code. Shaders that do not compile are
+// listed once before the runs. For each thread count the shaders compiled
+// per second both ways are printed, with the gain of pooling and how the
+// pooled rate scales from the first thread count.
+//
+// Needs the translator and preprocessor libraries (make shadertools).
+
+#include "compilerpool.h"
+#include "fileutil.h"
+#include "nativethread.h"
+#include "permutation.h"
+
+#include <GLSLANG/ShaderLang.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct CorpusShader
+{
+    std::string     name;
+    std::string     source;
+    sh::GLenum      type;
+};
+
+struct BenchThread
+{
+    const std::vector<CorpusShader>*    corpus;
+    ShaderCompilerPool*                 pool;       // NULL to construct every compiler
+    const ShBuiltInResources*           resources;
+    int                                 options;
+    unsigned int                        first;      // every count-th shader from first
+    unsigned int                        count;
+    unsigned int                        repeat;
+};
+
+static double GetTime()
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static bool EndsWith(const std::string& s, const char* suffix)
+{
+    size_t length = strlen(suffix);
+    return s.size() >= length && s.compare(s.size() - length, length, suffix) == 0;
+}
+
+static bool AddShader(const std::string& filename, std::vector<CorpusShader>& corpus)
+{
+    CorpusShader shader;
+    shader.name = filename;
+    shader.type = (EndsWith(filename, ".vert") || EndsWith(filename, ".vs")) ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER;
+    if(!ReadText(filename.c_str(), shader.source))
+    {
+        return false;
+    }
+    corpus.push_back(shader);
+    return true;
+}
+
+// A file naming one shader per line.
+static bool AddList(const char* filename, std::vector<CorpusShader>& corpus)
+{
+    std::string list;
+    if(!ReadText(filename, list))
+    {
+        return false;
+    }
+    size_t pos = 0;
+    while(pos < list.size())
+    {
+        size_t end = list.find('\n', pos);
+        end = (end != std::string::npos) ? end : list.size();
+        std::string line = list.substr(pos, end - pos);
+        pos = end + 1;
+        if(!line.empty() && line[line.size() - 1] == '\r')
+        {
+            line.resize(line.size() - 1);
+        }
+        if(!line.empty() && !AddShader(line, corpus))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Compile(const CorpusShader& shader, ShaderCompilerPool* pool, const ShBuiltInResources& resources,
+                    int options)
+{
+    ShHandle compiler = (pool != NULL) ? pool->Acquire(shader.type, SH_GLES2_SPEC, SH_ESSL_OUTPUT, resources) :
+                                         ShConstructCompiler(shader.type, SH_GLES2_SPEC, SH_ESSL_OUTPUT, &resources);
+    if(compiler == NULL)
+    {
+        return false;
+    }
+    const char* strings[] = { shader.source.c_str() };
+    bool compiled = ShCompile(compiler, strings, 1, options) != 0;
+    if(pool != NULL)
+    {
+        pool->Release(compiler);
+    }
+    else
+    {
+        ShDestruct(compiler);
+    }
+    return compiled;
+}
+
+static void BenchThreadProc(void* arg)
+{
+    BenchThread& t = *(BenchThread*) arg;
+    for(unsigned int r = 0; r < t.repeat; r++)
+    {
+        for(unsigned int i = t.first; i < t.corpus->size(); i += t.count)
+        {
+            Compile((*t.corpus)[i], t.pool, *t.resources, t.options);
+        }
+    }
+}
+
+// Shaders per second compiling the corpus repeat times on numThreads threads.
+static double Run(const std::vector<CorpusShader>& corpus, ShaderCompilerPool* pool,
+                  const ShBuiltInResources& resources, int options, unsigned int numThreads, unsigned int repeat)
+{
+    std::vector<BenchThread> threads(numThreads);
+    std::vector<NativeThread> handles(numThreads, (NativeThread) NULL);
+    for(unsigned int i = 0; i < numThreads; i++)
+    {
+        BenchThread t = { &corpus, pool, &resources, options, i, numThreads, repeat };
+        threads[i] = t;
+    }
+    double start = GetTime();
+    // the calling thread is the first one
+    for(unsigned int i = 1; i < numThreads; i++)
+    {
+        if(!CreateNativeThread(BenchThreadProc, &threads[i], &handles[i]))
+        {
+            printf("Could not start thread %u, running its share on the main thread.\n", i);
+            BenchThreadProc(&threads[i]);
+        }
+    }
+    BenchThreadProc(&threads[0]);
+    for(unsigned int i = 1; i < numThreads; i++)
+    {
+        if(handles[i] != NULL)
+        {
+            JoinNativeThread(handles[i]);
+        }
+    }
+    double seconds = GetTime() - start;
+    return (seconds > 0.0) ? corpus.size() * repeat / seconds : 0.0;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<CorpusShader> corpus;
+    std::vector<unsigned int> threadCounts;
+    unsigned int repeat = 10;
+    int options = SH_VALIDATE;
+    bool valid = true;
+    for(int i = 1; i < argc && valid; i++)
+    {
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if(strcmp(argv[i], "-threads") == 0 && value != NULL)
+        {
+            for(const char* p = value; *p != '\0'; p++)
+            {
+                threadCounts.push_back((unsigned int) strtoul(p, (char**) &p, 10));
+                valid = valid && threadCounts.back() > 0 && (*p == ',' || *p == '\0');
+                if(*p == '\0')
+                {
+                    break;
+                }
+            }
+            i++;
+        }
+        else if(strcmp(argv[i], "-repeat") == 0 && value != NULL)
+        {
+            repeat = (unsigned int) atoi(value);
+            i++;
+        }
+        else if(strcmp(argv[i], "-code") == 0)
+        {
+            options |= SH_OBJECT_CODE;
+        }
+        else if(strcmp(argv[i], "-permutations") == 0)
+        {
+            // texture arrays need GLSL ES 3.00, which the translator does
+            // not accept
+            for(unsigned int mask = 0; mask <= (SHADER_LIGHTING | SHADER_TEXTURE | SHADER_SKINNING); mask++)
+            {
+                if(!(mask & SHADER_TEXTURE_ARRAY))
+                {
+                    char name[32];
+                    sprintf(name, "permutation 0x%x", mask);
+                    CorpusShader vs = { std::string(name) + " vs", std::string(), GL_VERTEX_SHADER };
+                    CorpusShader fs = { std::string(name) + " fs", std::string(), GL_FRAGMENT_SHADER };
+                    ShaderPermutations::Expand(mask, vs.source, fs.source);
+                    corpus.push_back(vs);
+                    corpus.push_back(fs);
+                }
+            }
+        }
+        else if(argv[i][0] == '@')
+        {
+            valid = AddList(argv[i] + 1, corpus);
+        }
+        else if(argv[i][0] != '-')
+        {
+            valid = AddShader(argv[i], corpus);
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+    if(!valid || corpus.empty() || repeat == 0)
+    {
+        printf("usage: %s [-threads <n,n,...>] [-repeat <n>] [-code] [-permutations]\n"
+               "       <shader> | @<list> [...]\n", argv[0]);
+        return 1;
+    }
+    if(threadCounts.empty())
+    {
+        unsigned int cpus = GetNativeCpuCount();
+        for(unsigned int n = 1; n < cpus && n <= 4; n *= 2)
+        {
+            threadCounts.push_back(n);
+        }
+        threadCounts.push_back(cpus);
+    }
+
+    ShInitialize();
+    ShBuiltInResources resources;
+    ShInitBuiltInResources(&resources);
+    unsigned int failed = 0;
+    for(unsigned int i = 0; i < corpus.size(); i++)
+    {
+        if(!Compile(corpus[i], NULL, resources, options))
+        {
+            printf("%s does not compile.\n", corpus[i].name.c_str());
+            failed++;
+        }
+    }
+    printf("%u shaders, %u do not compile, %u passes.\n", (unsigned int) corpus.size(), failed, repeat);
+
+    // gain is pooled over constructing, scaling relative to the first row
+    printf("%8s %12s %12s %6s %8s %10s\n", "threads", "construct/s", "pooled/s", "gain", "scaling", "compilers");
+    double first = 0.0;
+    for(unsigned int i = 0; i < threadCounts.size(); i++)
+    {
+        ShaderCompilerPool pool;
+        double constructing = Run(corpus, NULL, resources, options, threadCounts[i], repeat);
+        double pooled = Run(corpus, &pool, resources, options, threadCounts[i], repeat);
+        first = (i == 0) ? pooled : first;
+        printf("%8u %12.0f %12.0f %5.2fx %7.2fx %10u\n", threadCounts[i], constructing, pooled,
+               (constructing > 0.0) ? pooled / constructing : 0.0, (first > 0.0) ? pooled / first : 0.0,
+               pool.GetConstructedCount());
+        pool.Clear();
+    }
+    ShFinalize();
+    return 0;
+}
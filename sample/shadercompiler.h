@@ -0,0 +1,306 @@
+#ifndef __SHADERCOMPILER_H__
+#define __SHADERCOMPILER_H__
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#include "nativethread.h"
+#include "eglutil.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Compiles and links programs on worker threads, off the render thread.
+//
+// Every worker owns a context sharing objects with the render contexts, so
+// the programs it links can be used by all of them. A worker compiles,
+// attaches and links, then inserts a fence and flushes without waiting for
+// anything. The render thread polls a job each frame: only once the fence
+// has signalled does it ask for the link status, which then returns at once
+// instead of blocking until the driver is done. Without EGL_KHR_fence_sync
+// the worker waits for the link with glFinish instead.
+//
+// Jobs are handed to the workers in turn, each in its own slot, so no locks
+// are needed: a slot is written by the submitting thread before the worker
+// is woken, by the worker before it publishes the job as linked, and then
+// only by the thread polling it. Slots are not reused.
+class ShaderCompiler
+{
+public:
+    enum { MAX_THREADS = 4, MAX_JOBS = 32 };
+
+    enum JobStatus
+    {
+        JOB_PENDING,
+        JOB_READY,
+        JOB_FAILED
+    };
+
+    ShaderCompiler() :
+        m_display(EGL_NO_DISPLAY), m_numThreads(0), m_numJobs(0), m_quit(false),
+        m_createSync(NULL), m_destroySync(NULL), m_clientWaitSync(NULL)
+    {
+        memset(m_workers, 0, sizeof(m_workers));
+    }
+
+    // Start numThreads workers with contexts sharing objects with
+    // shareContext. Returns false if none could be started.
+    bool Init(EGLDisplay display, EGLConfig config, EGLContext shareContext, const EGLint* contextAttribs,
+              unsigned int numThreads)
+    {
+        numThreads = (numThreads > MAX_THREADS) ? MAX_THREADS : numThreads;
+        m_display = display;
+        m_quit = false;
+        if(HasEGLExtension(display, "EGL_KHR_fence_sync"))
+        {
+            m_createSync = (PFNEGLCREATESYNCKHRPROC) eglGetProcAddress("eglCreateSyncKHR");
+            m_destroySync = (PFNEGLDESTROYSYNCKHRPROC) eglGetProcAddress("eglDestroySyncKHR");
+            m_clientWaitSync = (PFNEGLCLIENTWAITSYNCKHRPROC) eglGetProcAddress("eglClientWaitSyncKHR");
+        }
+        // a context needs a surface to be made current unless surfaceless
+        // contexts are supported
+        bool surfaceless = HasEGLExtension(display, "EGL_KHR_surfaceless_context");
+        for(unsigned int i = 0; i < numThreads; i++)
+        {
+            Worker& w = m_workers[m_numThreads];
+            w.owner = this;
+            w.index = m_numThreads;
+            w.surface = EGL_NO_SURFACE;
+            if(!surfaceless)
+            {
+                EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+                w.surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+                if(w.surface == EGL_NO_SURFACE)
+                {
+                    break;
+                }
+            }
+            w.context = eglCreateContext(display, config, shareContext, contextAttribs);
+            if(w.context == EGL_NO_CONTEXT || !CreateNativeSemaphore(0, &w.start))
+            {
+                DestroyWorkerContext(w);
+                break;
+            }
+            if(!CreateNativeThread(WorkerProc, &w, &w.thread))
+            {
+                DestroyNativeSemaphore(w.start);
+                DestroyWorkerContext(w);
+                break;
+            }
+            m_numThreads++;
+        }
+        return m_numThreads > 0;
+    }
+
+    // Stop the workers. Programs not yet handed out are left to the share
+    // group, which frees them along with the last context.
+    void Destroy()
+    {
+        m_quit = true;
+        for(unsigned int i = 0; i < m_numThreads; i++)
+        {
+            Worker& w = m_workers[i];
+            PostNativeSemaphore(w.start);
+            JoinNativeThread(w.thread);
+            DestroyNativeSemaphore(w.start);
+            DestroyWorkerContext(w);
+        }
+        for(unsigned int i = 0; i < m_numJobs; i++)
+        {
+            if(m_jobs[i].sync != NULL)
+            {
+                m_destroySync(m_display, m_jobs[i].sync);
+                m_jobs[i].sync = NULL;
+            }
+        }
+        m_numThreads = 0;
+    }
+
+    bool IsEnabled() const
+    {
+        return m_numThreads > 0;
+    }
+
+    // Queue a program for linking. Returns the job, or -1 once all job
+    // slots were used. Submit from a single thread.
+    int Submit(const char* vsSource, const char* fsSource)
+    {
+        if(m_numThreads == 0 || m_numJobs >= MAX_JOBS)
+        {
+            return -1;
+        }
+        int job = (int) m_numJobs++;
+        Job& j = m_jobs[job];
+        j.vsSource = vsSource;
+        j.fsSource = fsSource;
+        j.program = 0;
+        j.sync = NULL;
+        j.state = STATE_QUEUED;
+        PostNativeSemaphore(m_workers[job % m_numThreads].start);
+        return job;
+    }
+
+    // Check on a job from a thread with a sharing context current. Never
+    // blocks on the driver while the job is still pending.
+    JobStatus Poll(int job)
+    {
+        Job& j = m_jobs[job];
+        unsigned int state = AtomicLoadAcquire(&j.state);
+        if(state == STATE_READY || state == STATE_FAILED)
+        {
+            return (state == STATE_READY) ? JOB_READY : JOB_FAILED;
+        }
+        if(state != STATE_LINKED)
+        {
+            return JOB_PENDING;
+        }
+        if(j.sync != NULL)
+        {
+            if(m_clientWaitSync(m_display, j.sync, 0, 0) != EGL_CONDITION_SATISFIED_KHR)
+            {
+                return JOB_PENDING;
+            }
+            m_destroySync(m_display, j.sync);
+            j.sync = NULL;
+        }
+        GLint status = 0;
+        glGetProgramiv(j.program, GL_LINK_STATUS, &status);
+        if(!status)
+        {
+            glDeleteProgram(j.program);
+            j.program = 0;
+        }
+        AtomicStoreRelease(&j.state, status ? STATE_READY : STATE_FAILED);
+        return status ? JOB_READY : JOB_FAILED;
+    }
+
+    // The linked program of a ready job.
+    GLuint GetProgram(int job) const
+    {
+        return m_jobs[job].program;
+    }
+
+    // Jobs not yet polled to completion. Safe to call from any thread.
+    unsigned int GetPendingCount() const
+    {
+        unsigned int pending = 0;
+        for(unsigned int i = 0; i < m_numJobs; i++)
+        {
+            unsigned int state = AtomicLoadAcquire(&m_jobs[i].state);
+            pending += (state != STATE_READY && state != STATE_FAILED) ? 1 : 0;
+        }
+        return pending;
+    }
+
+private:
+    enum
+    {
+        STATE_QUEUED,
+        STATE_LINKED,
+        STATE_READY,
+        STATE_FAILED
+    };
+
+    struct Job
+    {
+        std::string     vsSource;
+        std::string     fsSource;
+        GLuint          program;
+        EGLSyncKHR      sync;
+        volatile unsigned int state;
+    };
+
+    struct Worker
+    {
+        ShaderCompiler* owner;
+        unsigned int    index;
+        EGLSurface      surface;
+        EGLContext      context;
+        NativeSemaphore start;
+        NativeThread    thread;
+    };
+
+    void DestroyWorkerContext(Worker& w)
+    {
+        if(w.context != EGL_NO_CONTEXT)
+        {
+            eglDestroyContext(m_display, w.context);
+        }
+        if(w.surface != EGL_NO_SURFACE)
+        {
+            eglDestroySurface(m_display, w.surface);
+        }
+        w.context = EGL_NO_CONTEXT;
+        w.surface = EGL_NO_SURFACE;
+    }
+
+    static void WorkerProc(void* arg)
+    {
+        Worker& w = *(Worker*) arg;
+        ShaderCompiler& c = *w.owner;
+        eglBindAPI(EGL_OPENGL_ES_API);
+        eglMakeCurrent(c.m_display, w.surface, w.surface, w.context);
+        // jobs are dealt out in turn, so this worker takes every
+        // m_numThreads'th one, in order
+        unsigned int next = w.index;
+        for(;;)
+        {
+            WaitNativeSemaphore(w.start);
+            if(c.m_quit)
+            {
+                break;
+            }
+            c.Link(c.m_jobs[next]);
+            next += c.m_numThreads;
+        }
+        eglMakeCurrent(c.m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglReleaseThread();
+    }
+
+    // Issue the compile and link and publish the job, without querying
+    // anything that would wait for the driver.
+    void Link(Job& j)
+    {
+        const GLchar* vsSource = j.vsSource.c_str();
+        const GLchar* fsSource = j.fsSource.c_str();
+        GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vs, 1, &vsSource, NULL);
+        glCompileShader(vs);
+        GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fs, 1, &fsSource, NULL);
+        glCompileShader(fs);
+        GLuint po = glCreateProgram();
+        glAttachShader(po, vs);
+        glAttachShader(po, fs);
+        glLinkProgram(po);
+        // flagged for deletion, freed along with the program
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        j.program = po;
+        j.sync = (m_createSync != NULL) ? m_createSync(m_display, EGL_SYNC_FENCE_KHR, NULL) : NULL;
+        if(j.sync != NULL)
+        {
+            glFlush();
+        }
+        else
+        {
+            glFinish();
+        }
+        AtomicStoreRelease(&j.state, STATE_LINKED);
+    }
+
+    EGLDisplay      m_display;
+    Worker          m_workers[MAX_THREADS];
+    unsigned int    m_numThreads;
+    Job             m_jobs[MAX_JOBS];
+    unsigned int    m_numJobs;
+    volatile bool   m_quit;
+
+    PFNEGLCREATESYNCKHRPROC     m_createSync;
+    PFNEGLDESTROYSYNCKHRPROC    m_destroySync;
+    PFNEGLCLIENTWAITSYNCKHRPROC m_clientWaitSync;
+};
+
+#endif // __SHADERCOMPILER_H__
@@ -0,0 +1,166 @@
+// shadermin - minifies GLSL ES shaders.
+//
+// usage: shadermin [-c <name>] <shader.vert> <shader.frag> <output.vert> <output.frag>
+//        shadermin [-c <name>] -vs | -fs <shader> <output>
+//        shadermin [-c <name>] -permutation <mask> <output.vert> <output.frag>
+//
+// With both stages of a program the varyings the fragment shader does not
+// read are removed from the vertex shader, and the others are renamed in
+// both; a single shader keeps its varyings' names (ShaderMinifier). The size
+// of every shader before and after is printed.
+//
+// -c writes the output as a C header declaring the shader as a string
+// constant called <name>, or <name>VS and <name>FS for a program, to be
+// compiled into an application.
+//
+// -permutation minifies the sample's own shading program permutation for a
+// ShaderFeature mask.
+
+#include "fileutil.h"
+#include "permutation.h"
+#include "shaderminify.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// The shader as it is, or as a C string constant called name.
+static bool WriteShader(const char* filename, const std::string& text, const char* name)
+{
+    FILE* f = fopen(filename, "wb");
+    if(f == NULL)
+    {
+        printf("Could not open %s for writing.\n", filename);
+        return false;
+    }
+    if(name == NULL)
+    {
+        fwrite(text.data(), 1, text.size(), f);
+    }
+    else
+    {
+        // one string literal per line, so directives stay on their own lines
+        fprintf(f, "static const char %s[] =\n", name);
+        size_t pos = 0;
+        while(pos < text.size())
+        {
+            size_t end = text.find('\n', pos);
+            bool newline = (end != std::string::npos);
+            end = newline ? end : text.size();
+            fputs("    \"", f);
+            for(size_t i = pos; i < end; i++)
+            {
+                if(text[i] == '"' || text[i] == '\\')
+                {
+                    fputc('\\', f);
+                }
+                fputc(text[i], f);
+            }
+            fputs(newline ? "\\n\"\n" : "\"\n", f);
+            pos = end + 1;
+        }
+        fputs("    ;\n", f);
+    }
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+static void PrintSize(const char* label, const std::string& source, const std::string& output)
+{
+    printf("%s: %u -> %u bytes (%u%%)\n", label, (unsigned int) source.size(), (unsigned int) output.size(),
+           source.empty() ? 100 : (unsigned int) (output.size() * 100 / source.size()));
+}
+
+int main(int argc, char** argv)
+{
+    const char* name = NULL;
+    GLenum single = GL_NONE;
+    int permutation = -1;
+    const char* files[4] = { NULL, NULL, NULL, NULL };
+    unsigned int numFiles = 0;
+    bool valid = true;
+    for(int i = 1; i < argc && valid; i++)
+    {
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if(strcmp(argv[i], "-c") == 0 && value != NULL)
+        {
+            name = value;
+            i++;
+        }
+        else if(strcmp(argv[i], "-vs") == 0 || strcmp(argv[i], "-fs") == 0)
+        {
+            single = (argv[i][1] == 'v') ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER;
+        }
+        else if(strcmp(argv[i], "-permutation") == 0 && value != NULL)
+        {
+            permutation = (int) strtol(value, NULL, 0);
+            i++;
+        }
+        else if(argv[i][0] != '-' && numFiles < 4)
+        {
+            files[numFiles++] = argv[i];
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+    unsigned int needed = (single != GL_NONE) ? 2 : (permutation >= 0) ? 2 : 4;
+    if(!valid || numFiles != needed || (single != GL_NONE && permutation >= 0))
+    {
+        printf("usage: %s [-c <name>] <shader.vert> <shader.frag> <output.vert> <output.frag>\n"
+               "       %s [-c <name>] -vs | -fs <shader> <output>\n"
+               "       %s [-c <name>] -permutation <mask> <output.vert> <output.frag>\n", argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    ShaderMinifier minifier;
+    if(single != GL_NONE)
+    {
+        std::string source;
+        std::string output;
+        if(!ReadText(files[0], source))
+        {
+            return 1;
+        }
+        if(!minifier.Minify(single, source, output))
+        {
+            printf("%s uses preprocessor features that cannot be minified.\n", files[0]);
+            return 1;
+        }
+        PrintSize(files[0], source, output);
+        return WriteShader(files[1], output, name) ? 0 : 1;
+    }
+
+    std::string vsSource;
+    std::string fsSource;
+    const char** outputs = &files[2];
+    if(permutation >= 0)
+    {
+        ShaderPermutations::Expand((unsigned int) permutation, vsSource, fsSource);
+        outputs = &files[0];
+    }
+    else if(!ReadText(files[0], vsSource) || !ReadText(files[1], fsSource))
+    {
+        return 1;
+    }
+    std::string vsOutput;
+    std::string fsOutput;
+    if(!minifier.MinifyProgram(vsSource, fsSource, vsOutput, fsOutput))
+    {
+        printf("The program uses preprocessor features that cannot be minified.\n");
+        return 1;
+    }
+    PrintSize("vertex shader", vsSource, vsOutput);
+    PrintSize("fragment shader", fsSource, fsOutput);
+    std::string vsName = (name != NULL) ? std::string(name) + "VS" : std::string();
+    std::string fsName = (name != NULL) ? std::string(name) + "FS" : std::string();
+    if(!WriteShader(outputs[0], vsOutput, (name != NULL) ? vsName.c_str() : NULL) ||
+       !WriteShader(outputs[1], fsOutput, (name != NULL) ? fsName.c_str() : NULL))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,1233 @@
+#ifndef __SHADERMINIFY_H__
+#define __SHADERMINIFY_H__
+
+#include <GLES2/gl2.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Shrinks GLSL ES shaders before they are handed to glShaderSource or
+// embedded in an executable, so drivers have less to parse and blobs less to
+// store.
+//
+// The source is preprocessed, since #defines and #ifdefs hide what is used,
+// and split into tokens. Comments and whitespace are dropped, constant
+// arithmetic on literals is folded and literals are written in their
+// shortest form. Functions main() does not reach are removed, and so are
+// varyings the fragment shader never reads. Names the shader declares are
+// replaced by the shortest names not in use, the most frequent first.
+// Attributes, uniforms and outputs keep their names, since the application
+// looks them up; varyings are renamed only when both stages are minified
+// together.
+//
+// Shaders are left alone, and Minify() returns false, when their meaning
+// depends on the implementation or on something not handled here: function
+// macros, #if on predefined macros such as GL_FRAGMENT_PRECISION_HIGH,
+// #error. Shaders are not checked for errors; an invalid shader comes out
+// invalid.
+class ShaderMinifier
+{
+public:
+    ShaderMinifier() : m_expr(NULL), m_exprPos(0), m_exprError(false)
+    {}
+
+    // Minify one shader; its varyings keep their names.
+    bool Minify(GLenum type, const std::string& source, std::string& output)
+    {
+        Shader shader;
+        if(!Load(type, source, shader))
+        {
+            return false;
+        }
+        RemoveDeadFunctions(shader);
+        if(type == GL_FRAGMENT_SHADER)
+        {
+            RemoveUnreadVaryings(shader, NULL);
+        }
+        std::set<std::string> keep;
+        CollectInterface(shader, keep, true);
+        Rename(shader, keep, std::map<std::string, std::string>());
+        output = Write(shader);
+        return true;
+    }
+
+    // Minify both shaders of a program. Varyings the fragment shader does
+    // not read are removed from the vertex shader along with the writes to
+    // them, and the others get the same short name in both stages.
+    bool MinifyProgram(const std::string& vsSource, const std::string& fsSource, std::string& vsOutput,
+                       std::string& fsOutput)
+    {
+        Shader vs;
+        Shader fs;
+        if(!Load(GL_VERTEX_SHADER, vsSource, vs) || !Load(GL_FRAGMENT_SHADER, fsSource, fs))
+        {
+            return false;
+        }
+        RemoveDeadFunctions(vs);
+        RemoveDeadFunctions(fs);
+        RemoveUnreadVaryings(fs, NULL);
+        std::set<std::string> read;
+        CollectVaryings(fs, read);
+        RemoveUnreadVaryings(vs, &read);
+
+        // varyings are named first, with names neither stage uses
+        std::set<std::string> keep;
+        CollectInterface(vs, keep, false);
+        CollectInterface(fs, keep, false);
+        std::set<std::string> varyings;
+        CollectVaryings(vs, varyings);
+        CollectVaryings(fs, varyings);
+        std::set<std::string> used(keep);
+        used.insert(vs.tokens.begin(), vs.tokens.end());
+        used.insert(fs.tokens.begin(), fs.tokens.end());
+        std::map<std::string, std::string> names;
+        unsigned int next = 0;
+        for(std::set<std::string>::iterator v = varyings.begin(); v != varyings.end(); ++v)
+        {
+            std::string name = GenerateName(used, next);
+            if(name.size() < v->size())
+            {
+                names[*v] = name;
+                used.insert(name);
+            }
+        }
+        Rename(vs, keep, names);
+        Rename(fs, keep, names);
+        vsOutput = Write(vs);
+        fsOutput = Write(fs);
+        return true;
+    }
+
+private:
+    struct Shader
+    {
+        GLenum                      type;
+        std::vector<std::string>    directives;     // #version, #extension, #pragma
+        std::vector<std::string>    tokens;
+    };
+
+    struct Conditional
+    {
+        bool    enclosingActive;
+        bool    taken;          // a branch of this #if was active
+        bool    active;
+    };
+
+    typedef std::map<std::string, std::vector<std::string> > MacroMap;
+
+    bool Load(GLenum type, const std::string& source, Shader& shader)
+    {
+        shader.type = type;
+        return Preprocess(source, shader) && Fold(shader.tokens);
+    }
+
+    // Preprocessing
+
+    bool Preprocess(const std::string& source, Shader& shader)
+    {
+        std::string text = StripComments(source);
+        MacroMap macros;
+        macros["GL_ES"] = std::vector<std::string>(1, "1");
+        std::vector<Conditional> conditionals;
+        size_t pos = 0;
+        while(pos < text.size())
+        {
+            // a backslash at the end of a line continues it
+            std::string line;
+            for(;;)
+            {
+                size_t end = text.find('\n', pos);
+                end = (end != std::string::npos) ? end : text.size();
+                line += text.substr(pos, end - pos);
+                pos = end + 1;
+                if(line.empty() || line[line.size() - 1] != '\\' || pos >= text.size())
+                {
+                    break;
+                }
+                line.resize(line.size() - 1);
+            }
+
+            bool active = conditionals.empty() || conditionals.back().active;
+            size_t first = line.find_first_not_of(" \t\r");
+            if(first == std::string::npos)
+            {
+                continue;
+            }
+            std::vector<std::string> tokens;
+            if(line[first] != '#')
+            {
+                if(active)
+                {
+                    Tokenize(line.substr(first), tokens);
+                    if(!Expand(tokens, macros, shader.tokens, 0))
+                    {
+                        return false;
+                    }
+                }
+                continue;
+            }
+
+            Tokenize(line.substr(first + 1), tokens);
+            std::string directive = tokens.empty() ? std::string() : tokens[0];
+            if(directive == "ifdef" || directive == "ifndef" || directive == "if")
+            {
+                bool value = false;
+                if(active && !Condition(directive, tokens, macros, value))
+                {
+                    return false;
+                }
+                Conditional c = { active, active && value, active && value };
+                conditionals.push_back(c);
+            }
+            else if(directive == "elif" || directive == "else")
+            {
+                if(conditionals.empty())
+                {
+                    return false;
+                }
+                Conditional& c = conditionals.back();
+                bool value = directive == "else";
+                if(c.enclosingActive && !c.taken && !value && !Condition(directive, tokens, macros, value))
+                {
+                    return false;
+                }
+                c.active = c.enclosingActive && !c.taken && value;
+                c.taken = c.taken || c.active;
+            }
+            else if(directive == "endif")
+            {
+                if(conditionals.empty())
+                {
+                    return false;
+                }
+                conditionals.pop_back();
+            }
+            else if(!active || directive.empty() || directive == "line")
+            {
+                continue;
+            }
+            else if(directive == "define")
+            {
+                // function-like macros have the parenthesis right after the name
+                size_t name = line.find(tokens.size() > 1 ? tokens[1] : std::string("define"), line.find("define") + 6);
+                if(tokens.size() < 2 || line.compare(name + tokens[1].size(), 1, "(") == 0 || IsReserved(tokens[1]))
+                {
+                    return false;
+                }
+                macros[tokens[1]] = std::vector<std::string>(tokens.begin() + 2, tokens.end());
+            }
+            else if(directive == "undef" && tokens.size() > 1)
+            {
+                macros.erase(tokens[1]);
+            }
+            else if(directive == "version" || directive == "extension" || directive == "pragma")
+            {
+                shader.directives.push_back(line.substr(first));
+            }
+            else
+            {
+                return false;       // #error, or unknown
+            }
+        }
+        return conditionals.empty();
+    }
+
+    static std::string StripComments(const std::string& source)
+    {
+        std::string text;
+        text.reserve(source.size());
+        for(size_t i = 0; i < source.size(); )
+        {
+            if(source.compare(i, 2, "//") == 0)
+            {
+                i = source.find('\n', i);
+                i = (i != std::string::npos) ? i : source.size();
+            }
+            else if(source.compare(i, 2, "/*") == 0)
+            {
+                // keep the line breaks, they end directives
+                size_t end = source.find("*/", i + 2);
+                end = (end != std::string::npos) ? end + 2 : source.size();
+                text += ' ';
+                for(; i < end; i++)
+                {
+                    text += (source[i] == '\n') ? "\n" : "";
+                }
+            }
+            else
+            {
+                text += source[i++];
+            }
+        }
+        return text;
+    }
+
+    // Macros predefined by the implementation, whose values are not known
+    // here.
+    static bool IsReserved(const std::string& name)
+    {
+        return (name.compare(0, 3, "GL_") == 0 && name != "GL_ES") || name.compare(0, 2, "__") == 0;
+    }
+
+    static bool Expand(const std::vector<std::string>& tokens, const MacroMap& macros, std::vector<std::string>& out,
+                       unsigned int depth)
+    {
+        if(depth > 32)
+        {
+            return false;
+        }
+        for(unsigned int i = 0; i < tokens.size(); i++)
+        {
+            MacroMap::const_iterator m = macros.find(tokens[i]);
+            if(tokens[i].compare(0, 2, "__") == 0)
+            {
+                return false;       // __LINE__, __VERSION__, ...
+            }
+            else if(m == macros.end())
+            {
+                out.push_back(tokens[i]);
+            }
+            else
+            {
+                // a macro is not expanded again inside its own expansion
+                MacroMap inner(macros);
+                inner.erase(tokens[i]);
+                if(!Expand(m->second, inner, out, depth + 1))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool Condition(const std::string& directive, const std::vector<std::string>& tokens, const MacroMap& macros,
+                   bool& value)
+    {
+        if(directive == "ifdef" || directive == "ifndef")
+        {
+            if(tokens.size() != 2 || IsReserved(tokens[1]))
+            {
+                return false;
+            }
+            value = (macros.find(tokens[1]) != macros.end()) == (directive == "ifdef");
+            return true;
+        }
+        // defined() is resolved before expansion
+        std::vector<std::string> resolved;
+        for(unsigned int i = 1; i < tokens.size(); i++)
+        {
+            if(tokens[i] != "defined")
+            {
+                resolved.push_back(tokens[i]);
+                continue;
+            }
+            bool paren = i + 1 < tokens.size() && tokens[i + 1] == "(";
+            unsigned int name = i + (paren ? 2 : 1);
+            if(name >= tokens.size() || IsReserved(tokens[name]) || (paren && (name + 1 >= tokens.size() || tokens[name + 1] != ")")))
+            {
+                return false;
+            }
+            resolved.push_back((macros.find(tokens[name]) != macros.end()) ? "1" : "0");
+            i = name + (paren ? 1 : 0);
+        }
+        std::vector<std::string> expr;
+        if(!Expand(resolved, macros, expr, 0))
+        {
+            return false;
+        }
+        m_expr = &expr;
+        m_exprPos = 0;
+        m_exprError = false;
+        long result = ParseOr();
+        value = result != 0;
+        return !m_exprError && m_exprPos == expr.size();
+    }
+
+    // #if expressions, by recursive descent
+    long ParseOr()
+    {
+        long v = ParseAnd();
+        while(Accept("||"))
+        {
+            long r = ParseAnd();
+            v = (v || r) ? 1 : 0;
+        }
+        return v;
+    }
+
+    long ParseAnd()
+    {
+        long v = ParseEquality();
+        while(Accept("&&"))
+        {
+            long r = ParseEquality();
+            v = (v && r) ? 1 : 0;
+        }
+        return v;
+    }
+
+    long ParseEquality()
+    {
+        long v = ParseRelational();
+        for(;;)
+        {
+            if(Accept("=="))
+            {
+                v = (v == ParseRelational()) ? 1 : 0;
+            }
+            else if(Accept("!="))
+            {
+                v = (v != ParseRelational()) ? 1 : 0;
+            }
+            else
+            {
+                return v;
+            }
+        }
+    }
+
+    long ParseRelational()
+    {
+        long v = ParseAdditive();
+        for(;;)
+        {
+            if(Accept("<="))
+            {
+                v = (v <= ParseAdditive()) ? 1 : 0;
+            }
+            else if(Accept(">="))
+            {
+                v = (v >= ParseAdditive()) ? 1 : 0;
+            }
+            else if(Accept("<"))
+            {
+                v = (v < ParseAdditive()) ? 1 : 0;
+            }
+            else if(Accept(">"))
+            {
+                v = (v > ParseAdditive()) ? 1 : 0;
+            }
+            else
+            {
+                return v;
+            }
+        }
+    }
+
+    long ParseAdditive()
+    {
+        long v = ParseMultiplicative();
+        for(;;)
+        {
+            if(Accept("+"))
+            {
+                v += ParseMultiplicative();
+            }
+            else if(Accept("-"))
+            {
+                v -= ParseMultiplicative();
+            }
+            else
+            {
+                return v;
+            }
+        }
+    }
+
+    long ParseMultiplicative()
+    {
+        long v = ParseUnary();
+        for(;;)
+        {
+            if(Accept("*"))
+            {
+                v *= ParseUnary();
+            }
+            else if(Accept("/") || Accept("%"))
+            {
+                bool mod = (*m_expr)[m_exprPos - 1] == "%";
+                long r = ParseUnary();
+                m_exprError = m_exprError || r == 0;
+                v = (r == 0) ? 0 : mod ? v % r : v / r;
+            }
+            else
+            {
+                return v;
+            }
+        }
+    }
+
+    long ParseUnary()
+    {
+        if(Accept("!"))
+        {
+            return ParseUnary() ? 0 : 1;
+        }
+        if(Accept("-"))
+        {
+            return -ParseUnary();
+        }
+        if(Accept("+"))
+        {
+            return ParseUnary();
+        }
+        if(Accept("("))
+        {
+            long v = ParseOr();
+            m_exprError = m_exprError || !Accept(")");
+            return v;
+        }
+        // identifiers left after expansion are errors in GLSL
+        if(m_exprPos < m_expr->size() && isdigit((unsigned char) (*m_expr)[m_exprPos][0]))
+        {
+            return strtol((*m_expr)[m_exprPos++].c_str(), NULL, 0);
+        }
+        m_exprError = true;
+        return 0;
+    }
+
+    bool Accept(const char* token)
+    {
+        if(m_exprPos < m_expr->size() && (*m_expr)[m_exprPos] == token)
+        {
+            m_exprPos++;
+            return true;
+        }
+        return false;
+    }
+
+    // Tokens
+
+    static bool IsIdentifier(const std::string& t)
+    {
+        return !t.empty() && (isalpha((unsigned char) t[0]) || t[0] == '_');
+    }
+
+    static bool IsNumber(const std::string& t)
+    {
+        size_t start = (t.size() > 1 && t[0] == '-') ? 1 : 0;
+        return t.size() > start && (isdigit((unsigned char) t[start]) ||
+               (t[start] == '.' && t.size() > start + 1 && isdigit((unsigned char) t[start + 1])));
+    }
+
+    static bool IsFloat(const std::string& t)
+    {
+        return IsNumber(t) && t.find_first_of(".eE") != std::string::npos && t.find_first_of("xX") == std::string::npos;
+    }
+
+    // Decimal integers only; octal and hexadecimal are left as they are.
+    static bool IsDecimalInt(const std::string& t)
+    {
+        size_t start = (t[0] == '-') ? 1 : 0;
+        return IsNumber(t) && t.find_first_not_of("0123456789", start) == std::string::npos &&
+               (t[start] != '0' || t.size() == start + 1);
+    }
+
+    static void Tokenize(const std::string& line, std::vector<std::string>& tokens)
+    {
+        static const char* operators[] =
+        {
+            "<<=", ">>=", "++", "--", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "==", "!=", "<=", ">=",
+            "&&", "||", "^^", "<<", ">>"
+        };
+        size_t i = 0;
+        while(i < line.size())
+        {
+            char c = line[i];
+            size_t end = i + 1;
+            if(c == ' ' || c == '\t' || c == '\r')
+            {
+                i++;
+                continue;
+            }
+            if(isalpha((unsigned char) c) || c == '_')
+            {
+                while(end < line.size() && (isalnum((unsigned char) line[end]) || line[end] == '_'))
+                {
+                    end++;
+                }
+            }
+            else if(isdigit((unsigned char) c) || (c == '.' && i + 1 < line.size() && isdigit((unsigned char) line[i + 1])))
+            {
+                bool hex = c == '0' && i + 1 < line.size() && (line[i + 1] == 'x' || line[i + 1] == 'X');
+                while(end < line.size() && (isalnum((unsigned char) line[end]) || line[end] == '.' ||
+                      (!hex && (line[end] == '+' || line[end] == '-') && (line[end - 1] == 'e' || line[end - 1] == 'E'))))
+                {
+                    end++;
+                }
+            }
+            else
+            {
+                for(unsigned int o = 0; o < sizeof(operators) / sizeof(operators[0]); o++)
+                {
+                    if(line.compare(i, strlen(operators[o]), operators[o]) == 0)
+                    {
+                        end = i + strlen(operators[o]);
+                        break;
+                    }
+                }
+            }
+            tokens.push_back(line.substr(i, end - i));
+            i = end;
+        }
+    }
+
+    // Constant folding
+
+    // The shortest literal reading back as the same float.
+    static std::string FormatFloat(float value)
+    {
+        char text[32];
+        for(int digits = 1; digits <= 9; digits++)
+        {
+            sprintf(text, "%.*g", digits, value);
+            if((float) strtod(text, NULL) == value)
+            {
+                break;
+            }
+        }
+        std::string s = text;
+        if(s.find_first_of(".e") == std::string::npos)
+        {
+            s += '.';
+        }
+        size_t zero = (s[0] == '-') ? 1 : 0;
+        if(s.compare(zero, 2, "0.") == 0 && s.size() > zero + 2)
+        {
+            s.erase(zero, 1);
+        }
+        return s;
+    }
+
+    static bool IsFinite(float v)
+    {
+        return v == v && v - v == 0.0f;
+    }
+
+    // Binary operators whose neighbours bind less tightly than + and -.
+    static bool IsLooseLeft(const std::string& t)
+    {
+        static const char* loose[] =
+        {
+            "(", ",", "[", ";", "{", "}", "?", ":", "return", "=", "+=", "-=", "*=", "/=",
+            "==", "!=", "<", ">", "<=", ">=", "&&", "||", "^^"
+        };
+        for(unsigned int i = 0; i < sizeof(loose) / sizeof(loose[0]); i++)
+        {
+            if(t == loose[i])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool IsLooseRight(const std::string& t)
+    {
+        return t == ")" || t == "]" || t == "+" || t == "-" || (t != "(" && t != "[" && t != "{" && t != "}" &&
+               t != "return" && IsLooseLeft(t));
+    }
+
+    // Fold arithmetic on literals and drop parentheses around lone
+    // literals, repeating until nothing changes. Fails on nothing; returns
+    // true so it can be chained.
+    static bool Fold(std::vector<std::string>& t)
+    {
+        for(unsigned int i = 0; i < t.size(); i++)
+        {
+            t[i] = (IsFloat(t[i]) && IsFinite((float) atof(t[i].c_str()))) ? FormatFloat((float) atof(t[i].c_str())) : t[i];
+        }
+        bool changed = true;
+        while(changed)
+        {
+            changed = false;
+            for(unsigned int i = 0; i + 2 < t.size(); i++)
+            {
+                const std::string prev = (i > 0) ? t[i - 1] : ";";
+                const std::string next = (i + 3 < t.size()) ? t[i + 3] : ";";
+                // unary minus on a literal, which nothing binds tighter than
+                bool operand = (IsIdentifier(prev) && prev != "return") || IsNumber(prev) || prev == ")" ||
+                               prev == "]" || prev == "++" || prev == "--";
+                if(t[i] == "-" && IsNumber(t[i + 1]) && t[i + 1][0] != '-' && !operand)
+                {
+                    t[i + 1] = std::string("-") + t[i + 1];
+                    t.erase(t.begin() + i);
+                    changed = true;
+                    continue;
+                }
+                // (literal), but not a call or a constructor
+                if(t[i] == "(" && IsNumber(t[i + 1]) && t[i + 2] == ")" && !IsIdentifier(prev) && prev != ")" &&
+                   prev != "]" && next != "." && next != "[")
+                {
+                    std::string literal = t[i + 1];
+                    t.erase(t.begin() + i, t.begin() + i + 3);
+                    t.insert(t.begin() + i, literal);
+                    changed = true;
+                    continue;
+                }
+                const std::string& a = t[i];
+                const std::string& op = t[i + 1];
+                const std::string& b = t[i + 2];
+                bool additive = op == "+" || op == "-";
+                bool multiplicative = op == "*" || op == "/";
+                if(!(additive || multiplicative) || !IsNumber(a) || !IsNumber(b))
+                {
+                    continue;
+                }
+                if(additive ? (!IsLooseLeft(prev) || !IsLooseRight(next)) :
+                              (prev == "*" || prev == "/" || prev == "%" || next == "." || next == "["))
+                {
+                    continue;
+                }
+                std::string result;
+                if(IsFloat(a) && IsFloat(b))
+                {
+                    float x = (float) atof(a.c_str());
+                    float y = (float) atof(b.c_str());
+                    float r = (op == "+") ? x + y : (op == "-") ? x - y : (op == "*") ? x * y : (y != 0.0f) ? x / y : 0.0f;
+                    if((op == "/" && y == 0.0f) || !IsFinite(r))
+                    {
+                        continue;
+                    }
+                    result = FormatFloat(r);
+                }
+                else if(IsDecimalInt(a) && IsDecimalInt(b))
+                {
+                    long x = atol(a.c_str());
+                    long y = atol(b.c_str());
+                    // integer division rounds differently for negative values
+                    if(op == "/" && (y <= 0 || x < 0))
+                    {
+                        continue;
+                    }
+                    long r = (op == "+") ? x + y : (op == "-") ? x - y : (op == "*") ? x * y : x / y;
+                    if(r > 65535 || r < -65535)
+                    {
+                        continue;
+                    }
+                    char text[32];
+                    sprintf(text, "%ld", r);
+                    result = text;
+                }
+                else
+                {
+                    continue;
+                }
+                t.erase(t.begin() + i, t.begin() + i + 3);
+                t.insert(t.begin() + i, result);
+                changed = true;
+            }
+        }
+        return true;
+    }
+
+    // Structure
+
+    // Where a global declaration or a function ends: after its ';' or, for
+    // a function definition, after its body.
+    static unsigned int FindItemEnd(const std::vector<std::string>& t, unsigned int start, std::string* function)
+    {
+        int depth = 0;
+        bool sawParen = false;
+        if(function != NULL)
+        {
+            function->clear();
+        }
+        for(unsigned int i = start; i < t.size(); i++)
+        {
+            if(t[i] == "(" && depth == 0 && !sawParen && i > start + 1 && IsIdentifier(t[i - 1]) &&
+               IsIdentifier(t[i - 2]) && function != NULL)
+            {
+                *function = t[i - 1];
+            }
+            sawParen = sawParen || (t[i] == "(" && depth == 0);
+            if(t[i] == "{" || t[i] == "(" || t[i] == "[")
+            {
+                depth++;
+            }
+            else if(t[i] == "}" || t[i] == ")" || t[i] == "]")
+            {
+                depth--;
+                // the body of a function definition
+                if(depth == 0 && t[i] == "}" && function != NULL && !function->empty())
+                {
+                    return i + 1;
+                }
+            }
+            else if(t[i] == ";" && depth == 0)
+            {
+                return i + 1;
+            }
+        }
+        return (unsigned int) t.size();
+    }
+
+    static void RemoveDeadFunctions(Shader& shader)
+    {
+        std::vector<std::string>& t = shader.tokens;
+        std::vector<unsigned int> starts;
+        std::vector<std::string> names;
+        std::set<std::string> functions;
+        for(unsigned int i = 0; i < t.size(); )
+        {
+            std::string name;
+            unsigned int end = FindItemEnd(t, i, &name);
+            starts.push_back(i);
+            names.push_back(name);
+            if(!name.empty())
+            {
+                functions.insert(name);
+            }
+            i = end;
+        }
+        starts.push_back((unsigned int) t.size());
+
+        // follow calls from main; overloads share a name and are kept
+        // together
+        std::set<std::string> reached;
+        std::vector<std::string> pending(1, "main");
+        while(!pending.empty())
+        {
+            std::string name = pending.back();
+            pending.pop_back();
+            if(!reached.insert(name).second)
+            {
+                continue;
+            }
+            for(unsigned int item = 0; item < names.size(); item++)
+            {
+                for(unsigned int i = starts[item]; names[item] == name && i + 1 < starts[item + 1]; i++)
+                {
+                    if(t[i + 1] == "(" && functions.count(t[i]) && !reached.count(t[i]))
+                    {
+                        pending.push_back(t[i]);
+                    }
+                }
+            }
+        }
+
+        std::vector<std::string> kept;
+        for(unsigned int item = 0; item < names.size(); item++)
+        {
+            if(names[item].empty() || reached.count(names[item]))
+            {
+                kept.insert(kept.end(), t.begin() + starts[item], t.begin() + starts[item + 1]);
+            }
+        }
+        t.swap(kept);
+    }
+
+    enum Storage
+    {
+        STORAGE_NONE,
+        STORAGE_INTERFACE,      // attributes, uniforms, outputs, uniform blocks
+        STORAGE_VARYING
+    };
+
+    // The storage of a global declaration from its qualifiers.
+    static Storage GetStorage(const Shader& shader, const std::vector<std::string>& t, unsigned int start, unsigned int end)
+    {
+        bool vs = shader.type == GL_VERTEX_SHADER;
+        for(unsigned int i = start; i < end && (IsIdentifier(t[i]) || t[i] == "("); i++)
+        {
+            const std::string& w = t[i];
+            if(w == "layout")
+            {
+                // skip the layout qualifier's parameters
+                while(i < end && t[i] != ")")
+                {
+                    i++;
+                }
+                continue;
+            }
+            if(w == "attribute" || w == "uniform" || w == "buffer" || (vs && w == "in") || (!vs && w == "out"))
+            {
+                return STORAGE_INTERFACE;
+            }
+            if(w == "varying" || (vs && w == "out") || (!vs && w == "in"))
+            {
+                return STORAGE_VARYING;
+            }
+        }
+        return STORAGE_NONE;
+    }
+
+    // The names a declaration declares: the first identifier after the type
+    // and those after commas outside brackets. Returns the type's index.
+    static void GetDeclaredNames(const std::vector<std::string>& t, unsigned int start, unsigned int end,
+                                 std::vector<unsigned int>& names)
+    {
+        unsigned int i = start;
+        while(i + 1 < end && IsIdentifier(t[i]) && IsIdentifier(t[i + 1]))
+        {
+            i++;
+        }
+        if(i >= end || !IsIdentifier(t[i]) || i == start)
+        {
+            return;
+        }
+        names.push_back(i);
+        int depth = 0;
+        for(i++; i < end; i++)
+        {
+            depth += (t[i] == "(" || t[i] == "[" || t[i] == "{") ? 1 : (t[i] == ")" || t[i] == "]" || t[i] == "}") ? -1 : 0;
+            if(depth == 0 && t[i - 1] == "," && IsIdentifier(t[i]))
+            {
+                names.push_back(i);
+            }
+        }
+    }
+
+    static void CollectVaryings(const Shader& shader, std::set<std::string>& varyings)
+    {
+        const std::vector<std::string>& t = shader.tokens;
+        for(unsigned int i = 0; i < t.size(); )
+        {
+            std::string function;
+            unsigned int end = FindItemEnd(t, i, &function);
+            std::vector<unsigned int> names;
+            if(function.empty() && GetStorage(shader, t, i, end) == STORAGE_VARYING)
+            {
+                GetDeclaredNames(t, i, end, names);
+            }
+            for(unsigned int n = 0; n < names.size(); n++)
+            {
+                varyings.insert(t[names[n]]);
+            }
+            i = end;
+        }
+    }
+
+    // Remove varyings declared alone that are never used, or with read set,
+    // that the other stage does not read: their declaration and the
+    // statements writing them, unless the varying is read or a write has
+    // side effects.
+    static void RemoveUnreadVaryings(Shader& shader, const std::set<std::string>* read)
+    {
+        std::vector<std::string>& t = shader.tokens;
+        for(unsigned int i = 0; i < t.size(); )
+        {
+            std::string function;
+            unsigned int end = FindItemEnd(t, i, &function);
+            std::vector<unsigned int> names;
+            if(function.empty() && GetStorage(shader, t, i, end) == STORAGE_VARYING)
+            {
+                GetDeclaredNames(t, i, end, names);
+            }
+            if(names.size() != 1 || (read != NULL && read->count(t[names[0]])))
+            {
+                i = end;
+                continue;
+            }
+            std::string name = t[names[0]];
+            std::vector<std::pair<unsigned int, unsigned int> > writes;
+            bool removable = true;
+            for(unsigned int j = 0; j < t.size() && removable; j++)
+            {
+                if(t[j] != name || (j >= i && j < end))
+                {
+                    continue;
+                }
+                // a statement "name[.xyz] = expression;"
+                unsigned int k = j + 1;
+                while(k + 1 < t.size() && t[k] == "." && IsIdentifier(t[k + 1]))
+                {
+                    k += 2;
+                }
+                bool statement = j > 0 && (t[j - 1] == ";" || t[j - 1] == "{" || t[j - 1] == "}");
+                removable = read != NULL && statement && k < t.size() && t[k] == "=";
+                unsigned int stop = k;
+                for(; removable && stop < t.size() && t[stop] != ";"; stop++)
+                {
+                    // calls may write out parameters; constructors and
+                    // built-ins do not, but cannot be told apart here
+                    // from functions of the shader
+                    removable = t[stop] != "++" && t[stop] != "--" && t[stop] != name &&
+                                !(t[stop] == "(" && IsIdentifier(t[stop - 1]) && IsShaderFunction(t, t[stop - 1]));
+                }
+                if(removable)
+                {
+                    writes.push_back(std::make_pair(j, stop + 1));
+                    j = stop;
+                }
+            }
+            if(!removable)
+            {
+                i = end;
+                continue;
+            }
+            for(int w = (int) writes.size() - 1; w >= 0; w--)
+            {
+                t.erase(t.begin() + writes[w].first, t.begin() + writes[w].second);
+            }
+            t.erase(t.begin() + i, t.begin() + end);
+        }
+    }
+
+    static bool IsShaderFunction(const std::vector<std::string>& t, const std::string& name)
+    {
+        for(unsigned int i = 0; i < t.size(); )
+        {
+            std::string function;
+            i = FindItemEnd(t, i, &function);
+            if(function == name)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Names that must not change: main, interface variables (varyings too
+    // unless renamed across both stages), anything declared inside struct
+    // or block braces and anything selected with '.', since fields are
+    // matched by name.
+    static void CollectInterface(const Shader& shader, std::set<std::string>& keep, bool keepVaryings)
+    {
+        const std::vector<std::string>& t = shader.tokens;
+        keep.insert("main");
+        for(unsigned int i = 0; i < t.size(); )
+        {
+            std::string function;
+            unsigned int end = FindItemEnd(t, i, &function);
+            Storage storage = function.empty() ? GetStorage(shader, t, i, end) : STORAGE_NONE;
+            bool block = false;
+            for(unsigned int j = i; function.empty() && j < end; j++)
+            {
+                // block and struct members, and the instance name after them
+                block = block || t[j] == "{";
+                if(IsIdentifier(t[j]) && (block || storage == STORAGE_INTERFACE ||
+                   (storage == STORAGE_VARYING && keepVaryings)))
+                {
+                    keep.insert(t[j]);
+                }
+            }
+            i = end;
+        }
+        for(unsigned int i = 1; i < t.size(); i++)
+        {
+            if(t[i - 1] == ".")
+            {
+                keep.insert(t[i]);
+            }
+        }
+    }
+
+    static bool IsType(const std::string& w, const std::set<std::string>& structs)
+    {
+        static const char* types[] =
+        {
+            "void", "bool", "int", "uint", "float", "vec2", "vec3", "vec4", "bvec2", "bvec3", "bvec4",
+            "ivec2", "ivec3", "ivec4", "uvec2", "uvec3", "uvec4", "mat2", "mat3", "mat4", "mat2x2", "mat2x3",
+            "mat2x4", "mat3x2", "mat3x3", "mat3x4", "mat4x2", "mat4x3", "mat4x4", "sampler2D", "sampler3D",
+            "samplerCube", "sampler2DShadow", "samplerCubeShadow", "sampler2DArray", "sampler2DArrayShadow",
+            "isampler2D", "isampler3D", "isamplerCube", "isampler2DArray", "usampler2D", "usampler3D",
+            "usamplerCube", "usampler2DArray", "samplerExternalOES"
+        };
+        for(unsigned int i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+        {
+            if(w == types[i])
+            {
+                return true;
+            }
+        }
+        return structs.count(w) != 0;
+    }
+
+    static bool IsKeyword(const std::string& w)
+    {
+        // keywords and reserved words short enough to be generated names
+        static const char* keywords[] =
+        {
+            "do", "if", "in", "for", "int", "out", "asm", "vec2", "vec3", "vec4", "mat2", "mat3", "mat4",
+            "uint", "void", "bool", "case", "else", "enum", "flat", "goto", "long", "true", "lowp"
+        };
+        for(unsigned int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
+        {
+            if(w == keywords[i])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Give the names the shader declares the shortest unused names, the
+    // most frequent first. Names in fixed were chosen beforehand.
+    static void Rename(Shader& shader, const std::set<std::string>& keep, const std::map<std::string, std::string>& fixed)
+    {
+        std::vector<std::string>& t = shader.tokens;
+        std::set<std::string> structs;
+        for(unsigned int i = 0; i + 1 < t.size(); i++)
+        {
+            if(t[i] == "struct" && IsIdentifier(t[i + 1]))
+            {
+                structs.insert(t[i + 1]);
+            }
+        }
+
+        // declared names: after a type, after a struct keyword or body,
+        // and after commas in the declaration they belong to
+        std::map<std::string, unsigned int> declared;
+        std::vector<int> listDepth;
+        int depth = 0;
+        for(unsigned int i = 1; i < t.size(); i++)
+        {
+            depth += (t[i - 1] == "(" || t[i - 1] == "{" || t[i - 1] == "[") ? 1 :
+                     (t[i - 1] == ")" || t[i - 1] == "}" || t[i - 1] == "]") ? -1 : 0;
+            while(!listDepth.empty() && (listDepth.back() > depth || t[i - 1] == ";" ||
+                  (listDepth.back() == depth && (t[i - 1] == ")" || t[i - 1] == "{"))))
+            {
+                listDepth.pop_back();
+            }
+            const std::string next = (i + 1 < t.size()) ? t[i + 1] : ";";
+            bool instance = t[i - 1] == "}" && (next == ";" || next == "," || next == "[");
+            bool afterType = IsType(t[i - 1], structs) || t[i - 1] == "struct" || instance;
+            bool inList = !listDepth.empty() && listDepth.back() == depth && t[i - 1] == ",";
+            if(IsIdentifier(t[i]) && (!IsType(t[i], structs) || t[i - 1] == "struct") && (afterType || inList))
+            {
+                declared[t[i]] = 0;
+                if(afterType && next != "(")
+                {
+                    listDepth.push_back(depth);
+                }
+            }
+        }
+        for(unsigned int i = 0; i < t.size(); i++)
+        {
+            std::map<std::string, unsigned int>::iterator d = declared.find(t[i]);
+            if(d != declared.end() && (i == 0 || t[i - 1] != "."))
+            {
+                d->second++;
+            }
+        }
+
+        std::set<std::string> used(t.begin(), t.end());
+        used.insert(keep.begin(), keep.end());
+        std::map<std::string, std::string> names;
+        for(std::map<std::string, std::string>::const_iterator f = fixed.begin(); f != fixed.end(); ++f)
+        {
+            used.insert(f->second);
+            names[f->first] = f->second;
+        }
+
+        // most frequent first
+        std::vector<std::pair<unsigned int, std::string> > order;
+        for(std::map<std::string, unsigned int>::iterator d = declared.begin(); d != declared.end(); ++d)
+        {
+            if(!keep.count(d->first) && !fixed.count(d->first))
+            {
+                order.push_back(std::make_pair(~d->second, d->first));
+            }
+        }
+        std::sort(order.begin(), order.end());
+        unsigned int next = 0;
+        for(unsigned int i = 0; i < order.size(); i++)
+        {
+            const std::string& name = order[i].second;
+            unsigned int last = next;
+            std::string generated = GenerateName(used, next);
+            if(generated.size() >= name.size())
+            {
+                next = last;        // already as short
+                continue;
+            }
+            names[name] = generated;
+            used.insert(generated);
+        }
+        for(unsigned int i = 0; i < t.size(); i++)
+        {
+            std::map<std::string, std::string>::iterator n = names.find(t[i]);
+            if(n != names.end() && (i == 0 || t[i - 1] != "."))
+            {
+                t[i] = n->second;
+            }
+        }
+    }
+
+    // The next of a, b, ... z, A, ... Z, aa, ab, ... that is not used and
+    // not a keyword.
+    static std::string GenerateName(const std::set<std::string>& used, unsigned int& index)
+    {
+        static const char first[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        static const char rest[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+        for(;;)
+        {
+            unsigned int n = index++;
+            std::string name(1, first[n % 52]);
+            for(n /= 52; n > 0; n = (n - 1) / 62)
+            {
+                name += rest[(n - 1) % 62];
+            }
+            if(!used.count(name) && !IsKeyword(name))
+            {
+                return name;
+            }
+        }
+    }
+
+    static bool IsWordChar(char c)
+    {
+        return isalnum((unsigned char) c) || c == '_';
+    }
+
+    // Whether two tokens written without a space would read differently:
+    // words and numbers running together, or operators forming a longer
+    // operator or a comment.
+    static bool NeedsSpace(const std::string& a, const std::string& b)
+    {
+        static const char* pairs[] =
+        {
+            "++", "--", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "==", "!=", "<=", ">=",
+            "&&", "||", "^^", "<<", ">>", "//", "/*"
+        };
+        char last = a[a.size() - 1];
+        if((IsWordChar(last) || (last == '.' && IsNumber(a))) && (IsWordChar(b[0]) || (b[0] == '.' && IsNumber(b))))
+        {
+            return true;
+        }
+        for(unsigned int i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++)
+        {
+            if(last == pairs[i][0] && b[0] == pairs[i][1])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Directives on their own lines, then the tokens with a space only
+    // where two of them would otherwise run together.
+    static std::string Write(const Shader& shader)
+    {
+        std::string out;
+        for(unsigned int i = 0; i < shader.directives.size(); i++)
+        {
+            out += shader.directives[i] + "\n";
+        }
+        for(unsigned int i = 0; i < shader.tokens.size(); i++)
+        {
+            if(i > 0 && NeedsSpace(shader.tokens[i - 1], shader.tokens[i]))
+            {
+                out += ' ';
+            }
+            out += shader.tokens[i];
+        }
+        return out + "\n";
+    }
+
+    // state of the #if expression being parsed
+    const std::vector<std::string>*     m_expr;
+    unsigned int                        m_exprPos;
+    bool                                m_exprError;
+};
+
+#endif // __SHADERMINIFY_H__
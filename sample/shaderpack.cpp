@@ -0,0 +1,243 @@
+// shaderpack - checks that programs fit the registers of target profiles.
+//
+// usage: shaderpack [-profile <name>[=<limits>]] [-v] [-permutations]
+//                   [<shader.vert> <shader.frag>] [...]
+//
+// Every pair of shaders given, and with -permutations every GLSL ES 1.00
+// permutation of the sample's shading program, is compiled with the
+// built-in resources of each profile and analyzed as one program
+// (ProgramPacking): the attribute slots, uniform rows of each stage,
+// varying rows and texture units it takes are printed against the
+// profile's limits, with "!" where they are exceeded, followed by any
+// mismatch between the two shaders. -v also lists what each variable takes.
+//
+// The profiles are "es2" and "es3", the minimum limits of OpenGL ES 2.0 and
+// 3.0; all of them are checked unless one is chosen with -profile. Other
+// targets are given as
+//
+//   -profile <name>=<attributes>,<vs uniforms>,<varyings>,<vs samplers>,
+//                   <fs samplers>,<fs uniforms>
+//
+// with uniforms and varyings in vectors, as the GL queries report them.
+//
+// Exits with 1 if a program does not fit a profile or does not link.
+// Needs the translator and preprocessor libraries (make shadertools).
+
+#include "compilerpool.h"
+#include "fileutil.h"
+#include "permutation.h"
+#include "shaderpacking.h"
+
+#include <GLSLANG/ShaderLang.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct PackProfile
+{
+    std::string         name;
+    ShBuiltInResources  resources;
+};
+
+struct PackProgram
+{
+    std::string     name;
+    std::string     vsSource;
+    std::string     fsSource;
+};
+
+static PackProfile MakeProfile(const char* name, int attributes, int vsUniforms, int varyings, int vsSamplers,
+                               int fsSamplers, int fsUniforms)
+{
+    PackProfile p;
+    p.name = name;
+    ShInitBuiltInResources(&p.resources);
+    p.resources.MaxVertexAttribs = attributes;
+    p.resources.MaxVertexUniformVectors = vsUniforms;
+    p.resources.MaxVaryingVectors = varyings;
+    p.resources.MaxVertexTextureImageUnits = vsSamplers;
+    p.resources.MaxTextureImageUnits = fsSamplers;
+    p.resources.MaxCombinedTextureImageUnits = vsSamplers + fsSamplers;
+    p.resources.MaxFragmentUniformVectors = fsUniforms;
+    return p;
+}
+
+// "name" of a built-in profile or "name=<limits>".
+static bool ParseProfile(const char* text, std::vector<PackProfile>& profiles)
+{
+    const char* equals = strchr(text, '=');
+    if(equals == NULL)
+    {
+        if(strcmp(text, "es2") == 0)
+        {
+            profiles.push_back(MakeProfile("es2", 8, 128, 8, 0, 8, 16));
+            return true;
+        }
+        if(strcmp(text, "es3") == 0)
+        {
+            // GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS is 32 on OpenGL ES 3.0
+            profiles.push_back(MakeProfile("es3", 16, 256, 15, 16, 16, 224));
+            return true;
+        }
+        return false;
+    }
+    int limits[6];
+    const char* p = equals + 1;
+    for(int i = 0; i < 6; i++)
+    {
+        char* end = NULL;
+        limits[i] = (int) strtol(p, &end, 10);
+        if(end == p || limits[i] < 0 || *end != ((i < 5) ? ',' : '\0'))
+        {
+            return false;
+        }
+        p = end + 1;
+    }
+    std::string name(text, equals);
+    profiles.push_back(MakeProfile(name.c_str(), limits[0], limits[1], limits[2], limits[3], limits[4], limits[5]));
+    return true;
+}
+
+static bool Compile(ShHandle compiler, const std::string& source)
+{
+    const char* strings[] = { source.c_str() };
+    if(ShCompile(compiler, strings, 1, SH_VARIABLES) != 0)
+    {
+        return true;
+    }
+    size_t length = 0;
+    ShGetInfo(compiler, SH_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(length + 1, '\0');
+    ShGetInfoLog(compiler, &log[0]);
+    printf("%s", &log[0]);
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<PackProfile> profiles;
+    std::vector<PackProgram> programs;
+    std::vector<const char*> files;
+    bool verbose = false;
+    bool valid = true;
+    ShInitialize();
+    for(int i = 1; i < argc && valid; i++)
+    {
+        if(strcmp(argv[i], "-profile") == 0 && i + 1 < argc)
+        {
+            valid = ParseProfile(argv[++i], profiles);
+        }
+        else if(strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[i], "-permutations") == 0)
+        {
+            for(unsigned int mask = 0; mask <= (SHADER_LIGHTING | SHADER_TEXTURE | SHADER_SKINNING); mask++)
+            {
+                if(!(mask & SHADER_TEXTURE_ARRAY))
+                {
+                    char name[32];
+                    sprintf(name, "permutation 0x%x", mask);
+                    PackProgram program;
+                    program.name = name;
+                    ShaderPermutations::Expand(mask, program.vsSource, program.fsSource);
+                    programs.push_back(program);
+                }
+            }
+        }
+        else if(argv[i][0] != '-')
+        {
+            files.push_back(argv[i]);
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+    for(unsigned int i = 0; valid && i + 1 < files.size(); i += 2)
+    {
+        PackProgram program;
+        program.name = std::string(files[i]) + " + " + files[i + 1];
+        valid = ReadText(files[i], program.vsSource) && ReadText(files[i + 1], program.fsSource);
+        programs.push_back(program);
+    }
+    if(!valid || files.size() % 2 != 0 || programs.empty())
+    {
+        printf("usage: %s [-profile <name>[=<limits>]] [-v] [-permutations]\n"
+               "       [<shader.vert> <shader.frag>] [...]\n"
+               "profiles: es2, es3, or <name>=<attributes>,<vs uniforms>,<varyings>,\n"
+               "          <vs samplers>,<fs samplers>,<fs uniforms>\n", argv[0]);
+        ShFinalize();
+        return 1;
+    }
+    if(profiles.empty())
+    {
+        ParseProfile("es2", profiles);
+        ParseProfile("es3", profiles);
+    }
+
+    int result = 0;
+    ShaderCompilerPool compilers;
+    for(unsigned int p = 0; p < programs.size(); p++)
+    {
+        printf("%s\n  %-10s", programs[p].name.c_str(), "profile");
+        for(int r = 0; r < ProgramPacking::PACK_RESOURCE_COUNT; r++)
+        {
+            printf(" %12s", ProgramPacking::GetResourceName((ProgramPacking::Resource) r));
+        }
+        printf("\n");
+        for(unsigned int f = 0; f < profiles.size(); f++)
+        {
+            const ShBuiltInResources& resources = profiles[f].resources;
+            ShHandle vs = compilers.Acquire(GL_VERTEX_SHADER, SH_GLES2_SPEC, SH_ESSL_OUTPUT, resources);
+            ShHandle fs = compilers.Acquire(GL_FRAGMENT_SHADER, SH_GLES2_SPEC, SH_ESSL_OUTPUT, resources);
+            if(vs == NULL || fs == NULL || !Compile(vs, programs[p].vsSource) || !Compile(fs, programs[p].fsSource))
+            {
+                printf("  %-10s does not compile\n", profiles[f].name.c_str());
+                result = 1;
+            }
+            else
+            {
+                ProgramPacking packing;
+                packing.Analyze(vs, fs, resources);
+                printf("  %-10s", profiles[f].name.c_str());
+                for(int r = 0; r < ProgramPacking::PACK_RESOURCE_COUNT; r++)
+                {
+                    ProgramPacking::Resource resource = (ProgramPacking::Resource) r;
+                    char usage[32];
+                    sprintf(usage, "%d/%d%s", packing.GetUsed(resource), packing.GetLimit(resource),
+                            packing.Fits(resource) ? "" : "!");
+                    printf(" %12s", usage);
+                }
+                printf("\n");
+                // the variables are the same for every profile
+                for(unsigned int i = 0; verbose && f == 0 && i < packing.GetRows().size(); i++)
+                {
+                    const ProgramPacking::Row& row = packing.GetRows()[i];
+                    printf("    %-24s %-12s %d\n", row.name.c_str(), ProgramPacking::GetResourceName(row.resource),
+                           row.rows);
+                }
+                for(unsigned int i = 0; f == 0 && i < packing.GetErrors().size(); i++)
+                {
+                    printf("    error: %s\n", packing.GetErrors()[i].c_str());
+                }
+                result = packing.Fits() ? result : 1;
+            }
+            if(vs != NULL)
+            {
+                compilers.Release(vs);
+            }
+            if(fs != NULL)
+            {
+                compilers.Release(fs);
+            }
+        }
+    }
+    compilers.Clear();
+    ShFinalize();
+    return result;
+}
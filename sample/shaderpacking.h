@@ -0,0 +1,317 @@
+#ifndef __SHADERPACKING_H__
+#define __SHADERPACKING_H__
+
+#include <angle_gl.h>
+#include <GLSLANG/ShaderLang.h>
+
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+// What a program's shaders occupy of the registers and units a target
+// provides, checked before any driver links it.
+//
+// Uniforms and varyings are packed into rows of four components with the
+// rules of GLSL ES 1.00 appendix A section 7, by the translator's own
+// ShCheckVariablesWithinPackingLimits. The rows a stage uses are the fewest
+// the packing succeeds with. As with SH_ENFORCE_PACKING_RESTRICTIONS, only
+// variables the shaders use are counted, samplers included; varyings are
+// those the fragment shader reads. Attributes take a slot per vector or
+// matrix column, samplers a texture unit per element.
+//
+// Mismatches that fail to link anyway are listed as errors: varyings the
+// fragment shader reads that the vertex shader does not declare, and
+// variables of both stages whose types or precisions differ.
+class ProgramPacking
+{
+public:
+    enum Resource
+    {
+        PACK_ATTRIBUTES,
+        PACK_VERTEX_UNIFORMS,
+        PACK_FRAGMENT_UNIFORMS,
+        PACK_VARYINGS,
+        PACK_VERTEX_SAMPLERS,
+        PACK_FRAGMENT_SAMPLERS,
+        PACK_COMBINED_SAMPLERS,
+        PACK_RESOURCE_COUNT
+    };
+
+    struct Row
+    {
+        std::string     name;
+        Resource        resource;
+        int             rows;       // taken on its own
+    };
+
+    // Analyze a program from the compilers its shaders were compiled with,
+    // with SH_VARIABLES, against the limits in resources.
+    void Analyze(ShHandle vs, ShHandle fs, const ShBuiltInResources& resources)
+    {
+        m_errors.clear();
+        m_rows.clear();
+        const std::vector<sh::Uniform>* vsUniforms = ShGetUniforms(vs);
+        const std::vector<sh::Uniform>* fsUniforms = ShGetUniforms(fs);
+        const std::vector<sh::Varying>* vsVaryings = ShGetVaryings(vs);
+        const std::vector<sh::Varying>* fsVaryings = ShGetVaryings(fs);
+        const std::vector<sh::Attribute>* attributes = ShGetAttributes(vs);
+
+        m_limits[PACK_ATTRIBUTES] = resources.MaxVertexAttribs;
+        m_limits[PACK_VERTEX_UNIFORMS] = resources.MaxVertexUniformVectors;
+        m_limits[PACK_FRAGMENT_UNIFORMS] = resources.MaxFragmentUniformVectors;
+        m_limits[PACK_VARYINGS] = resources.MaxVaryingVectors;
+        m_limits[PACK_VERTEX_SAMPLERS] = resources.MaxVertexTextureImageUnits;
+        m_limits[PACK_FRAGMENT_SAMPLERS] = resources.MaxTextureImageUnits;
+        m_limits[PACK_COMBINED_SAMPLERS] = resources.MaxCombinedTextureImageUnits;
+
+        m_used[PACK_ATTRIBUTES] = 0;
+        for(unsigned int i = 0; attributes != NULL && i < attributes->size(); i++)
+        {
+            const sh::Attribute& a = (*attributes)[i];
+            if(a.staticUse && !IsBuiltIn(a.name))
+            {
+                int slots = GetRows(a.type) * (int) a.elementCount();
+                AddRow(a.name, PACK_ATTRIBUTES, slots);
+                m_used[PACK_ATTRIBUTES] += slots;
+            }
+        }
+
+        std::set<std::string> vsSamplers;
+        std::set<std::string> fsSamplers;
+        m_used[PACK_VERTEX_UNIFORMS] = PackUniforms(vsUniforms, PACK_VERTEX_UNIFORMS, vsSamplers);
+        m_used[PACK_FRAGMENT_UNIFORMS] = PackUniforms(fsUniforms, PACK_FRAGMENT_UNIFORMS, fsSamplers);
+        m_used[PACK_VERTEX_SAMPLERS] = (int) vsSamplers.size();
+        m_used[PACK_FRAGMENT_SAMPLERS] = (int) fsSamplers.size();
+        // a sampler used by both stages takes one unit
+        vsSamplers.insert(fsSamplers.begin(), fsSamplers.end());
+        m_used[PACK_COMBINED_SAMPLERS] = (int) vsSamplers.size();
+
+        std::vector<ShVariableInfo> varyings;
+        for(unsigned int i = 0; fsVaryings != NULL && i < fsVaryings->size(); i++)
+        {
+            const sh::Varying& v = (*fsVaryings)[i];
+            if(!v.staticUse || IsBuiltIn(v.name))
+            {
+                continue;
+            }
+            const sh::Varying* written = Find(vsVaryings, v.name);
+            if(written == NULL)
+            {
+                AddError("varying " + v.name + " is read by the fragment shader but not declared by the vertex shader");
+            }
+            else if(written->type != v.type || written->arraySize != v.arraySize)
+            {
+                AddError("varying " + v.name + " has different types in the two shaders");
+            }
+            unsigned int first = (unsigned int) varyings.size();
+            Flatten(v, varyings);
+            AddRow(v.name, PACK_VARYINGS, CountRows(varyings, first));
+        }
+        m_used[PACK_VARYINGS] = Pack(varyings);
+
+        for(unsigned int i = 0; vsUniforms != NULL && i < vsUniforms->size(); i++)
+        {
+            const sh::Uniform& u = (*vsUniforms)[i];
+            const sh::Uniform* other = Find(fsUniforms, u.name);
+            if(other != NULL && (other->type != u.type || other->arraySize != u.arraySize || !SameFields(u, *other)))
+            {
+                AddError("uniform " + u.name + " has different types in the two shaders");
+            }
+            else if(other != NULL && other->precision != u.precision)
+            {
+                AddError("uniform " + u.name + " has different precisions in the two shaders");
+            }
+        }
+    }
+
+    int GetUsed(Resource resource) const
+    {
+        return m_used[resource];
+    }
+
+    int GetLimit(Resource resource) const
+    {
+        return m_limits[resource];
+    }
+
+    bool Fits(Resource resource) const
+    {
+        return m_used[resource] <= m_limits[resource];
+    }
+
+    // Whether everything fits and the shaders match.
+    bool Fits() const
+    {
+        bool fits = m_errors.empty();
+        for(int r = 0; r < PACK_RESOURCE_COUNT; r++)
+        {
+            fits = fits && Fits((Resource) r);
+        }
+        return fits;
+    }
+
+    const std::vector<std::string>& GetErrors() const
+    {
+        return m_errors;
+    }
+
+    // What each variable takes, by itself.
+    const std::vector<Row>& GetRows() const
+    {
+        return m_rows;
+    }
+
+    static const char* GetResourceName(Resource resource)
+    {
+        static const char* names[PACK_RESOURCE_COUNT] =
+        {
+            "attributes", "vs uniforms", "fs uniforms", "varyings", "vs samplers", "fs samplers", "samplers"
+        };
+        return names[resource];
+    }
+
+private:
+    static bool IsBuiltIn(const std::string& name)
+    {
+        return name.compare(0, 3, "gl_") == 0;
+    }
+
+    static bool IsSampler(sh::GLenum type)
+    {
+        return type == GL_SAMPLER_2D || type == GL_SAMPLER_CUBE || type == GL_SAMPLER_EXTERNAL_OES ||
+               type == GL_SAMPLER_2D_RECT_ARB || type == GL_SAMPLER_3D || type == GL_SAMPLER_2D_ARRAY ||
+               type == GL_SAMPLER_2D_SHADOW;
+    }
+
+    // Rows of one element; the packing rules only need matrices told apart.
+    static int GetRows(sh::GLenum type)
+    {
+        return (type == GL_FLOAT_MAT4) ? 4 : (type == GL_FLOAT_MAT3) ? 3 : (type == GL_FLOAT_MAT2) ? 2 : 1;
+    }
+
+    template<class T>
+    static const T* Find(const std::vector<T>* variables, const std::string& name)
+    {
+        for(unsigned int i = 0; variables != NULL && i < variables->size(); i++)
+        {
+            if((*variables)[i].name == name)
+            {
+                return &(*variables)[i];
+            }
+        }
+        return NULL;
+    }
+
+    static bool SameFields(const sh::ShaderVariable& a, const sh::ShaderVariable& b)
+    {
+        if(a.fields.size() != b.fields.size())
+        {
+            return false;
+        }
+        for(unsigned int i = 0; i < a.fields.size(); i++)
+        {
+            const sh::ShaderVariable& fa = a.fields[i];
+            const sh::ShaderVariable& fb = b.fields[i];
+            if(fa.name != fb.name || fa.type != fb.type || fa.arraySize != fb.arraySize || !SameFields(fa, fb))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The leaf variables of a structure, one entry per element of arrays of
+    // structures.
+    static void Flatten(const sh::ShaderVariable& v, std::vector<ShVariableInfo>& out)
+    {
+        if(!v.isStruct())
+        {
+            ShVariableInfo info = { v.type, (int) v.elementCount() };
+            out.push_back(info);
+            return;
+        }
+        for(unsigned int e = 0; e < v.elementCount(); e++)
+        {
+            for(unsigned int f = 0; f < v.fields.size(); f++)
+            {
+                Flatten(v.fields[f], out);
+            }
+        }
+    }
+
+    static int CountRows(const std::vector<ShVariableInfo>& variables, unsigned int first)
+    {
+        int rows = 0;
+        for(unsigned int i = first; i < variables.size(); i++)
+        {
+            rows += GetRows(variables[i].type) * variables[i].size;
+        }
+        return rows;
+    }
+
+    // The fewest rows the variables pack into. Taking one row per element
+    // always fits, and more rows never fit worse.
+    static int Pack(std::vector<ShVariableInfo>& variables)
+    {
+        int low = variables.empty() ? 0 : 1;
+        int high = CountRows(variables, 0);
+        while(low < high)
+        {
+            int rows = (low + high) / 2;
+            if(ShCheckVariablesWithinPackingLimits(rows, &variables[0], variables.size()))
+            {
+                high = rows;
+            }
+            else
+            {
+                low = rows + 1;
+            }
+        }
+        return high;
+    }
+
+    int PackUniforms(const std::vector<sh::Uniform>* uniforms, Resource resource, std::set<std::string>& samplers)
+    {
+        std::vector<ShVariableInfo> variables;
+        for(unsigned int i = 0; uniforms != NULL && i < uniforms->size(); i++)
+        {
+            const sh::Uniform& u = (*uniforms)[i];
+            if(!u.staticUse || IsBuiltIn(u.name))
+            {
+                continue;
+            }
+            unsigned int first = (unsigned int) variables.size();
+            Flatten(u, variables);
+            AddRow(u.name, resource, CountRows(variables, first));
+            for(unsigned int v = first; v < variables.size(); v++)
+            {
+                for(int e = 0; IsSampler(variables[v].type) && e < variables[v].size; e++)
+                {
+                    char element[32];
+                    sprintf(element, "#%u.%d", v - first, e);
+                    samplers.insert(u.name + element);
+                }
+            }
+        }
+        return Pack(variables);
+    }
+
+    void AddRow(const std::string& name, Resource resource, int rows)
+    {
+        Row row = { name, resource, rows };
+        m_rows.push_back(row);
+    }
+
+    void AddError(const std::string& error)
+    {
+        m_errors.push_back(error);
+    }
+
+    int                         m_used[PACK_RESOURCE_COUNT];
+    int                         m_limits[PACK_RESOURCE_COUNT];
+    std::vector<std::string>    m_errors;
+    std::vector<Row>            m_rows;
+};
+
+#endif // __SHADERPACKING_H__
@@ -0,0 +1,220 @@
+// shaderprec - finds fragment shader variables that can be mediump or lowp.
+//
+// usage: shaderprec [options] <shader.frag> [output.frag]
+//        shaderprec [options] -permutation <mask> [output.frag]
+//
+// options:
+//   -vs <shader.vert>    vertex shader of the program; uniforms it declares
+//                        keep their precision
+//   -range <name>=<max>  largest magnitude of a uniform or varying
+//   -uvrange <max>       largest magnitude of texture coordinates (default 1)
+//   -texsize <texels>    size of the largest texture sampled (default 512)
+//
+// The shader is compiled with the translator, which writes its intermediate
+// tree to the info log (SH_INTERMEDIATE_TREE) and lists its uniforms and
+// varyings (SH_VARIABLES). PrecisionLowering bounds every float variable on
+// the tree, and a report of each variable's precision, bound and suggested
+// precision is printed. With an output file the shader is written there with
+// the lowered declarations, and compiled again to check it.
+//
+// -permutation analyzes the sample's own shading program permutation for a
+// ShaderFeature mask (GLSL ES 1.00 permutations only), together with its
+// vertex shader.
+//
+// Needs the translator and preprocessor libraries (make shadertools).
+
+#include "fileutil.h"
+#include "permutation.h"
+#include "precisionlower.h"
+
+#include <GLSLANG/ShaderLang.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static bool WriteText(const char* filename, const std::string& text)
+{
+    FILE* f = fopen(filename, "wb");
+    if(f == NULL)
+    {
+        printf("Could not open %s for writing.\n", filename);
+        return false;
+    }
+    fwrite(text.data(), 1, text.size(), f);
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+static ShHandle ConstructCompiler(GLenum type)
+{
+    ShBuiltInResources resources;
+    ShInitBuiltInResources(&resources);
+    return ShConstructCompiler(type, SH_GLES2_SPEC, SH_ESSL_OUTPUT, &resources);
+}
+
+static const char* GetPrecisionName(GLenum precision)
+{
+    return (precision == GL_LOW_FLOAT) ? "lowp" : (precision == GL_MEDIUM_FLOAT) ? "mediump" :
+           (precision == GL_HIGH_FLOAT) ? "highp" : "-";
+}
+
+// Uniforms and varyings the shader declares but never uses get no node in
+// the tree; list them from the reflection instead.
+template<class T>
+static void PrintUnused(const std::vector<T>* variables, const char* qualifier)
+{
+    for(unsigned int i = 0; variables != NULL && i < variables->size(); i++)
+    {
+        const T& v = (*variables)[i];
+        if(!v.staticUse)
+        {
+            printf("  %-20s %-8s %-6s %-9s %-8s not used\n", v.name.c_str(), qualifier, "", "",
+                   GetPrecisionName(v.precision));
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    PrecisionLowering lowering;
+    const char* vsFile = NULL;
+    const char* files[2] = { NULL, NULL };
+    unsigned int numFiles = 0;
+    int permutation = -1;
+    double uvRange = 1.0;
+    unsigned int textureSize = 512;
+    for(int i = 1; i < argc; i++)
+    {
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if(strcmp(argv[i], "-vs") == 0 && value != NULL)
+        {
+            vsFile = value;
+            i++;
+        }
+        else if(strcmp(argv[i], "-range") == 0 && value != NULL && strchr(value, '=') != NULL)
+        {
+            const char* equals = strchr(value, '=');
+            lowering.SetInputRange(std::string(value, equals), atof(equals + 1));
+            i++;
+        }
+        else if(strcmp(argv[i], "-uvrange") == 0 && value != NULL)
+        {
+            uvRange = atof(value);
+            i++;
+        }
+        else if(strcmp(argv[i], "-texsize") == 0 && value != NULL)
+        {
+            textureSize = (unsigned int) atoi(value);
+            i++;
+        }
+        else if(strcmp(argv[i], "-permutation") == 0 && value != NULL)
+        {
+            permutation = (int) strtol(value, NULL, 0);
+            i++;
+        }
+        else if(argv[i][0] != '-' && numFiles < 2)
+        {
+            files[numFiles++] = argv[i];
+        }
+        else
+        {
+            numFiles = 3;
+            break;
+        }
+    }
+    unsigned int numInputs = (permutation >= 0) ? 0 : 1;
+    if(numFiles < numInputs || numFiles > numInputs + 1 || textureSize == 0 ||
+       (permutation >= 0 && (permutation & SHADER_TEXTURE_ARRAY)))
+    {
+        printf("usage: %s [-vs <shader.vert>] [-range <name>=<max>] [-uvrange <max>] [-texsize <texels>]\n"
+               "       <shader.frag> | -permutation <mask> [output.frag]\n", argv[0]);
+        return 1;
+    }
+    const char* outputFile = (numFiles > numInputs) ? files[numInputs] : NULL;
+    lowering.SetTextureCoordinates(uvRange, textureSize);
+
+    std::string fsSource;
+    std::string vsSource;
+    if(permutation >= 0)
+    {
+        ShaderPermutations::Expand((unsigned int) permutation, vsSource, fsSource);
+    }
+    else if(!ReadText(files[0], fsSource) || (vsFile != NULL && !ReadText(vsFile, vsSource)))
+    {
+        return 1;
+    }
+
+    ShInitialize();
+    int result = 0;
+    ShHandle fs = ConstructCompiler(GL_FRAGMENT_SHADER);
+    ShHandle vs = ConstructCompiler(GL_VERTEX_SHADER);
+    ShaderTree tree;
+    if(!vsSource.empty())
+    {
+        const char* strings[] = { vsSource.c_str() };
+        if(!ShCompile(vs, strings, 1, SH_VARIABLES))
+        {
+            printf("The vertex shader does not compile.\n");
+            result = 1;
+        }
+        const std::vector<sh::Uniform>* uniforms = ShGetUniforms(vs);
+        for(unsigned int i = 0; uniforms != NULL && i < uniforms->size(); i++)
+        {
+            lowering.AddSharedUniform((*uniforms)[i].name);
+        }
+    }
+    if(result == 0 && !tree.Compile(fs, fsSource.c_str(), SH_VARIABLES))
+    {
+        printf("The fragment shader does not compile.\n");
+        result = 1;
+    }
+
+    if(result == 0)
+    {
+        lowering.Analyze(tree);
+        unsigned int lowered = 0;
+        printf("  %-20s %-8s %-6s %-9s %-8s suggested\n", "variable", "", "type", "bound", "current");
+        for(unsigned int i = 0; i < lowering.GetVariableCount(); i++)
+        {
+            const PrecisionLowering::Variable& v = lowering.GetVariable(i);
+            char bound[32] = "-";
+            if(v.bound != HUGE_VAL)
+            {
+                sprintf(bound, "%g", v.bound);
+            }
+            printf("  %-20s %-8s %-6s %-9s %-8s %-8s %s\n", v.name.c_str(), v.qualifier.c_str(), v.type.c_str(), bound,
+                   PrecisionLowering::GetPrecisionName(v.current), PrecisionLowering::GetPrecisionName(v.suggested),
+                   v.reason.c_str());
+            lowered += (v.suggested < v.current) ? 1 : 0;
+        }
+        PrintUnused(ShGetUniforms(fs), "uniform");
+        PrintUnused(ShGetVaryings(fs), "varying");
+        printf("%u of %u variables can be lowered.\n", lowered, lowering.GetVariableCount());
+
+        if(outputFile != NULL)
+        {
+            std::string output;
+            unsigned int changed = lowering.Rewrite(fsSource, output);
+            printf("%u declarations rewritten.\n", changed);
+            ShaderTree check;
+            if(!check.Compile(fs, output.c_str(), SH_VALIDATE))
+            {
+                printf("The rewritten shader does not compile.\n");
+                result = 1;
+            }
+            else if(!WriteText(outputFile, output))
+            {
+                result = 1;
+            }
+        }
+    }
+
+    ShDestruct(vs);
+    ShDestruct(fs);
+    ShFinalize();
+    return result;
+}
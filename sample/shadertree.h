@@ -0,0 +1,256 @@
+#ifndef __SHADERTREE_H__
+#define __SHADERTREE_H__
+
+#include <GLSLANG/ShaderLang.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// The intermediate tree the translator writes to its info log when compiling
+// with SH_INTERMEDIATE_TREE, read back into nodes.
+//
+// Every node is one line: a source location, two spaces of indentation per
+// level, the node's text and, for typed nodes, its type in parentheses:
+//
+//   0:7:       component-wise multiply (mediump 4-component vector of float)
+//   0:7:         'color' (mediump 4-component vector of float)
+//   0:7:         0.5 (const float)
+//
+// Constant vectors are written one component per line; consecutive constant
+// lines are read as one node. Labels such as "Condition" or "true case" are
+// nodes of their own, siblings of the subtrees they introduce.
+class ShaderTree
+{
+public:
+    enum NodeKind
+    {
+        NODE_SYMBOL,        // 'name'
+        NODE_CONSTANT,      // one or more constant values
+        NODE_OPERATION      // anything else
+    };
+
+    struct Type
+    {
+        std::string     qualifier;      // "uniform", "varying", "const", "in",
+                                        // "FragColor", ... or empty
+        std::string     precision;      // "highp", "mediump", "lowp" or empty
+        std::string     basic;          // "float", "int", "bool", "sampler2D", ...
+        std::string     name;           // as declared: "vec3", "mat4", ...
+        unsigned int    components;     // vector size, rows * columns of matrices
+    };
+
+    struct Node
+    {
+        NodeKind            kind;
+        std::string         text;       // symbol name without quotes, or the
+                                        // operation text
+        Type                type;
+        bool                typed;
+        unsigned int        line;
+        double              minAbs;     // constants only
+        double              maxAbs;
+        std::vector<int>    children;
+    };
+
+    // Compile a shader with the tree written to the info log and read it.
+    // Prints the info log and returns false if the shader does not compile.
+    bool Compile(ShHandle compiler, const char* source, int options)
+    {
+        const char* strings[] = { source };
+        bool compiled = ShCompile(compiler, strings, 1, options | SH_INTERMEDIATE_TREE) != 0;
+        size_t length = 0;
+        ShGetInfo(compiler, SH_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(length + 1, '\0');
+        ShGetInfoLog(compiler, &log[0]);
+        if(!compiled)
+        {
+            printf("%s", &log[0]);
+            return false;
+        }
+        Parse(&log[0]);
+        return true;
+    }
+
+    // Read a tree from info log text. Lines that are not tree nodes, such as
+    // warnings, are skipped. The root is a node of its own holding the
+    // outermost nodes.
+    void Parse(const char* log)
+    {
+        m_nodes.clear();
+        Node root;
+        root.kind = NODE_OPERATION;
+        root.text = "Root";
+        root.typed = false;
+        root.line = 0;
+        root.minAbs = root.maxAbs = 0.0;
+        root.type.components = 0;
+        m_nodes.push_back(root);
+
+        // parents[d] is the last node read at depth d - 1
+        std::vector<int> parents(1, 0);
+        const char* p = log;
+        while(*p != '\0')
+        {
+            const char* end = strchr(p, '\n');
+            end = (end != NULL) ? end : p + strlen(p);
+            std::string line(p, end);
+            p = (*end != '\0') ? end + 1 : end;
+
+            unsigned int depth = 0;
+            Node node;
+            if(!ParseLine(line, depth, node))
+            {
+                continue;
+            }
+            depth = (depth < parents.size()) ? depth : (unsigned int) parents.size() - 1;
+            std::vector<int>& siblings = m_nodes[parents[depth]].children;
+            if(node.kind == NODE_CONSTANT && !siblings.empty() && m_nodes[siblings.back()].kind == NODE_CONSTANT)
+            {
+                Node& last = m_nodes[siblings.back()];
+                last.minAbs = (node.minAbs < last.minAbs) ? node.minAbs : last.minAbs;
+                last.maxAbs = (node.maxAbs > last.maxAbs) ? node.maxAbs : last.maxAbs;
+                continue;
+            }
+            int index = (int) m_nodes.size();
+            m_nodes.push_back(node);
+            m_nodes[parents[depth]].children.push_back(index);
+            parents.resize(depth + 1);
+            parents.push_back(index);
+        }
+    }
+
+    const Node& GetNode(int i) const
+    {
+        return m_nodes[i];
+    }
+
+    unsigned int GetNodeCount() const
+    {
+        return (unsigned int) m_nodes.size();
+    }
+
+    // Whether the operation text of a node starts with a prefix.
+    bool Is(int i, const char* prefix) const
+    {
+        return m_nodes[i].kind == NODE_OPERATION && m_nodes[i].text.compare(0, strlen(prefix), prefix) == 0;
+    }
+
+    // The symbol an lvalue expression writes to, through swizzles, indexing
+    // and structure fields; -1 if there is none.
+    int GetBaseSymbol(int i) const
+    {
+        while(m_nodes[i].kind == NODE_OPERATION && !m_nodes[i].children.empty() &&
+              (Is(i, "vector swizzle") || Is(i, "direct index") || Is(i, "indirect index")))
+        {
+            i = m_nodes[i].children[0];
+        }
+        return (m_nodes[i].kind == NODE_SYMBOL) ? i : -1;
+    }
+
+private:
+    static bool ParseLine(const std::string& line, unsigned int& depth, Node& node)
+    {
+        // the location is "<file>:<line>: ", or "<file>:? : " for none
+        size_t colon = line.find(':');
+        size_t start = line.find(": ");
+        if(colon == std::string::npos || colon == 0 || start == std::string::npos ||
+           line.find_first_not_of("0123456789") != colon)
+        {
+            return false;
+        }
+        node.line = (unsigned int) atoi(line.c_str() + colon + 1);
+        size_t text = line.find_first_not_of(' ', start + 2);
+        if(text == std::string::npos)
+        {
+            return false;
+        }
+        depth = (unsigned int) (text - start - 2) / 2;
+
+        std::string body = line.substr(text);
+        node.typed = false;
+        node.type.components = 0;
+        node.minAbs = node.maxAbs = 0.0;
+        size_t open = body.rfind(" (");
+        if(open != std::string::npos && body[body.size() - 1] == ')')
+        {
+            ParseType(body.substr(open + 2, body.size() - open - 3), node.type);
+            node.typed = true;
+            body.resize(open);
+        }
+        if(body.size() >= 2 && body[0] == '\'' && body[body.size() - 1] == '\'')
+        {
+            node.kind = NODE_SYMBOL;
+            node.text = body.substr(1, body.size() - 2);
+        }
+        else if(node.typed && node.type.qualifier == "const")
+        {
+            node.kind = NODE_CONSTANT;
+            node.text = body;
+            double value = (body == "true") ? 1.0 : (body == "false") ? 0.0 : atof(body.c_str());
+            node.minAbs = node.maxAbs = (value < 0.0) ? -value : value;
+        }
+        else
+        {
+            node.kind = NODE_OPERATION;
+            node.text = body;
+        }
+        return true;
+    }
+
+    // "[qualifier] [precision] [array[n] of] [N-component vector of |
+    // CxR matrix of] basic"
+    static void ParseType(const std::string& text, Type& type)
+    {
+        type.components = 1;
+        std::vector<std::string> words;
+        size_t pos = 0;
+        while(pos < text.size())
+        {
+            size_t next = text.find(' ', pos);
+            next = (next != std::string::npos) ? next : text.size();
+            words.push_back(text.substr(pos, next - pos));
+            pos = next + 1;
+        }
+        for(unsigned int i = 0; i < words.size(); i++)
+        {
+            const std::string& w = words[i];
+            if(w == "highp" || w == "mediump" || w == "lowp")
+            {
+                type.precision = w;
+            }
+            else if(w.find("-component") != std::string::npos)
+            {
+                type.components = (unsigned int) atoi(w.c_str());
+            }
+            else if(w.size() == 3 && w[1] == 'X')
+            {
+                type.components = (unsigned int) (w[0] - '0') * (w[2] - '0');
+            }
+            else if(i == 0 && words.size() > 1 && w != "array" && w.compare(0, 6, "array[") != 0)
+            {
+                type.qualifier = w;
+            }
+        }
+        type.basic = words.empty() ? std::string() : words.back();
+        type.name = type.basic;
+        for(unsigned int i = 0; i < words.size(); i++)
+        {
+            const char* prefix = (type.basic == "int") ? "i" : (type.basic == "bool") ? "b" : "";
+            if(words[i].find("-component") != std::string::npos)
+            {
+                type.name = std::string(prefix) + "vec" + words[i][0];
+            }
+            else if(words[i].size() == 3 && words[i][1] == 'X')
+            {
+                type.name = std::string("mat") + words[i][0];
+            }
+        }
+    }
+
+    std::vector<Node>   m_nodes;
+};
+
+#endif // __SHADERTREE_H__
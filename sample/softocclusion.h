@@ -0,0 +1,453 @@
+#ifndef __SOFTOCCLUSION_H__
+#define __SOFTOCCLUSION_H__
+
+#include "nativethread.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTOCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+// Occlusion culling against a small depth buffer rasterized on the CPU.
+//
+// Each frame the caller adds low-poly occluder meshes, rasterizes them, and
+// then tests bounding boxes of the objects it is about to submit. Unlike GPU
+// queries the answer is available immediately and needs no GL call, and the
+// result does not depend on the GPU, the driver or the number of threads:
+// every pixel keeps the nearest depth of all triangles covering it, which is
+// the same in any order.
+//
+// The buffer is split into bands of rows rasterized in parallel, one per
+// thread, and four pixels of a row are processed at once with SSE2 where
+// available. Occluders only cover pixels whose centre lies inside them, and a
+// box counts as visible if any pixel it touches is not nearer, so small
+// errors keep objects rather than drop them. Occluders must lie inside the
+// objects they stand for, or objects behind them are culled wrongly.
+//
+// Matrices are column-major like those of vecmath.h.
+class SoftwareOcclusionCuller
+{
+public:
+    enum { MAX_WIDTH = 256, MAX_HEIGHT = 256, MAX_THREADS = 8, MAX_TRIANGLES = 16384 };
+
+    SoftwareOcclusionCuller() :
+        m_depth(NULL), m_width(0), m_height(0),
+        m_tris(NULL), m_numTris(0),
+        m_numThreads(0), m_quit(false), m_done(NULL)
+    {
+        memset(m_workers, 0, sizeof(m_workers));
+    }
+
+    // Allocate the buffers and start numThreads - 1 workers; the caller's
+    // thread rasterizes the first band.
+    bool Init(unsigned int numThreads)
+    {
+        numThreads = (numThreads < 1) ? 1 : numThreads;
+        numThreads = (numThreads > MAX_THREADS) ? MAX_THREADS : numThreads;
+        m_depth = new float[MAX_WIDTH * MAX_HEIGHT];
+        m_tris = new Triangle[MAX_TRIANGLES];
+        m_quit = false;
+        m_numThreads = 1;
+        if(numThreads > 1 && !CreateNativeSemaphore(0, &m_done))
+        {
+            return true;
+        }
+        for(unsigned int i = 1; i < numThreads; i++)
+        {
+            Worker& w = m_workers[i];
+            w.owner = this;
+            w.band = i;
+            if(!CreateNativeSemaphore(0, &w.start))
+            {
+                break;
+            }
+            if(!CreateNativeThread(WorkerProc, &w, &w.thread))
+            {
+                DestroyNativeSemaphore(w.start);
+                break;
+            }
+            m_numThreads++;
+        }
+        return true;
+    }
+
+    void Destroy()
+    {
+        m_quit = true;
+        for(unsigned int i = 1; i < m_numThreads; i++)
+        {
+            PostNativeSemaphore(m_workers[i].start);
+            JoinNativeThread(m_workers[i].thread);
+            DestroyNativeSemaphore(m_workers[i].start);
+        }
+        if(m_done != NULL)
+        {
+            DestroyNativeSemaphore(m_done);
+            m_done = NULL;
+        }
+        m_numThreads = 0;
+        delete[] m_depth;
+        m_depth = NULL;
+        delete[] m_tris;
+        m_tris = NULL;
+    }
+
+    bool IsEnabled() const
+    {
+        return m_depth != NULL;
+    }
+
+    unsigned int GetThreadCount() const
+    {
+        return m_numThreads;
+    }
+
+    // Start a frame for a viewport of the given size. The buffer keeps the
+    // viewport's aspect ratio, its width a multiple of four.
+    void BeginFrame(int width, int height)
+    {
+        if(width >= height)
+        {
+            m_width = MAX_WIDTH;
+            m_height = (int) ((float) MAX_WIDTH * height / width + 0.5f);
+        }
+        else
+        {
+            m_height = MAX_HEIGHT;
+            m_width = ((int) ((float) MAX_HEIGHT * width / height + 0.5f) + 3) & ~3;
+        }
+        m_width = (m_width < 4) ? 4 : m_width;
+        m_height = (m_height < 1) ? 1 : m_height;
+        m_numTris = 0;
+    }
+
+    // Add a triangle list of xyz positions, transformed by mvp. Triangles
+    // are clipped to the near plane, as GL would clip them, so the part of an
+    // occluder in front of it hides nothing.
+    void AddOccluder(const float mvp[16], const float* positions, unsigned int numVertices)
+    {
+        for(unsigned int v = 0; v + 2 < numVertices && m_numTris < MAX_TRIANGLES; v += 3)
+        {
+            float clip[4][4];
+            for(int k = 0; k < 3; k++)
+            {
+                Transform(mvp, &positions[(v + k) * 3], clip[k]);
+            }
+            unsigned int n = ClipNear(clip);
+            float s[4][3];
+            bool behind = false;
+            for(unsigned int k = 0; k < n && !behind; k++)
+            {
+                behind = !ToBuffer(clip[k], s[k]);
+            }
+            for(unsigned int k = 1; k + 1 < n && !behind && m_numTris < MAX_TRIANGLES; k++)
+            {
+                Setup(s[0], s[k], s[k + 1]);
+            }
+        }
+    }
+
+    // Rasterize all occluders added since BeginFrame().
+    void Rasterize()
+    {
+        for(unsigned int i = 1; i < m_numThreads; i++)
+        {
+            PostNativeSemaphore(m_workers[i].start);
+        }
+        RasterizeBand(0);
+        for(unsigned int i = 1; i < m_numThreads; i++)
+        {
+            WaitNativeSemaphore(m_done);
+        }
+    }
+
+    // Whether any part of the box may be visible. The box is given in the
+    // space 'mvp' transforms from.
+    bool TestBox(const float mvp[16], const float boxMin[3], const float boxMax[3]) const
+    {
+        float minX = (float) m_width, minY = (float) m_height, minZ = 1.0f;
+        float maxX = 0.0f, maxY = 0.0f;
+        for(int i = 0; i < 8; i++)
+        {
+            float corner[3] = {
+                (i & 1) ? boxMax[0] : boxMin[0],
+                (i & 2) ? boxMax[1] : boxMin[1],
+                (i & 4) ? boxMax[2] : boxMin[2] };
+            float s[3];
+            if(!Project(mvp, corner, s))
+            {
+                return true;
+            }
+            minX = (s[0] < minX) ? s[0] : minX;
+            maxX = (s[0] > maxX) ? s[0] : maxX;
+            minY = (s[1] < minY) ? s[1] : minY;
+            maxY = (s[1] > maxY) ? s[1] : maxY;
+            minZ = (s[2] < minZ) ? s[2] : minZ;
+        }
+        // every pixel the box touches, not only those whose centre it covers
+        int x0 = (minX > 0.0f) ? (int) minX : 0;
+        int y0 = (minY > 0.0f) ? (int) minY : 0;
+        int x1 = (maxX < (float) m_width) ? (int) ceilf(maxX) : m_width;
+        int y1 = (maxY < (float) m_height) ? (int) ceilf(maxY) : m_height;
+        for(int y = y0; y < y1; y++)
+        {
+            const float* row = &m_depth[y * m_width];
+            for(int x = x0; x < x1; x++)
+            {
+                if(row[x] >= minZ)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Depth in [0,1] of the last rasterized frame, one row after another,
+    // e.g. to compare frames on machines without a GPU.
+    const float* GetDepth() const
+    {
+        return m_depth;
+    }
+
+    int GetWidth() const
+    {
+        return m_width;
+    }
+
+    int GetHeight() const
+    {
+        return m_height;
+    }
+
+private:
+    // Edge functions a*x + b*y + c, non-negative inside, and the depth plane
+    // of a triangle in buffer pixels, with its bounds.
+    struct Triangle
+    {
+        float   a[3], b[3], c[3];
+        float   za, zb, zc;
+        int     minX, maxX, minY, maxY;
+    };
+
+    struct Worker
+    {
+        SoftwareOcclusionCuller*    owner;
+        unsigned int                band;
+        NativeSemaphore             start;
+        NativeThread                thread;
+    };
+
+    static void WorkerProc(void* arg)
+    {
+        Worker* w = (Worker*) arg;
+        SoftwareOcclusionCuller* self = w->owner;
+        for(;;)
+        {
+            WaitNativeSemaphore(w->start);
+            if(self->m_quit)
+            {
+                break;
+            }
+            self->RasterizeBand(w->band);
+            PostNativeSemaphore(self->m_done);
+        }
+    }
+
+    static void Transform(const float m[16], const float p[3], float out[4])
+    {
+        out[0] = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+        out[1] = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+        out[2] = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14];
+        out[3] = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+    }
+
+    // Clip coordinates to buffer pixels and depth in [0,1]. Fails for points
+    // at or behind the eye.
+    bool ToBuffer(const float c[4], float out[3]) const
+    {
+        if(c[3] <= 1e-5f)
+        {
+            return false;
+        }
+        out[0] = (c[0] / c[3] * 0.5f + 0.5f) * m_width;
+        out[1] = (c[1] / c[3] * 0.5f + 0.5f) * m_height;
+        out[2] = c[2] / c[3] * 0.5f + 0.5f;
+        return true;
+    }
+
+    bool Project(const float m[16], const float p[3], float out[3]) const
+    {
+        float c[4];
+        Transform(m, p, c);
+        return ToBuffer(c, out);
+    }
+
+    // Clip the triangle in the first three vertices to z >= -w, leaving a
+    // convex polygon of up to four. Returns its number of vertices, below
+    // three if nothing is left.
+    static unsigned int ClipNear(float poly[4][4])
+    {
+        float in[3][4];
+        memcpy(in, poly, sizeof(in));
+        unsigned int n = 0;
+        for(int i = 0; i < 3; i++)
+        {
+            const float* p = in[i];
+            const float* q = in[(i + 1) % 3];
+            float dp = p[2] + p[3];
+            float dq = q[2] + q[3];
+            if(dp >= 0.0f)
+            {
+                memcpy(poly[n++], p, sizeof(in[i]));
+            }
+            if((dp >= 0.0f) != (dq >= 0.0f))
+            {
+                float t = dp / (dp - dq);
+                for(int k = 0; k < 4; k++)
+                {
+                    poly[n][k] = p[k] + (q[k] - p[k]) * t;
+                }
+                n++;
+            }
+        }
+        return n;
+    }
+
+    void Setup(const float* v0, const float* v1, const float* v2)
+    {
+        float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v2[0] - v0[0]) * (v1[1] - v0[1]);
+        if(fabsf(area) < 1e-6f)
+        {
+            return;
+        }
+        // both sides occlude; wind every triangle counter-clockwise
+        if(area < 0.0f)
+        {
+            const float* t = v1;
+            v1 = v2;
+            v2 = t;
+            area = -area;
+        }
+        Triangle& t = m_tris[m_numTris];
+        const float* v[3] = { v0, v1, v2 };
+        float minX = v0[0], maxX = v0[0], minY = v0[1], maxY = v0[1];
+        for(int i = 0; i < 3; i++)
+        {
+            const float* p = v[i];
+            const float* q = v[(i + 1) % 3];
+            t.a[i] = p[1] - q[1];
+            t.b[i] = q[0] - p[0];
+            t.c[i] = p[0] * q[1] - p[1] * q[0];
+            minX = (p[0] < minX) ? p[0] : minX;
+            maxX = (p[0] > maxX) ? p[0] : maxX;
+            minY = (p[1] < minY) ? p[1] : minY;
+            maxY = (p[1] > maxY) ? p[1] : maxY;
+        }
+        float dzdx = ((v1[2] - v0[2]) * (v2[1] - v0[1]) - (v2[2] - v0[2]) * (v1[1] - v0[1])) / area;
+        float dzdy = ((v2[2] - v0[2]) * (v1[0] - v0[0]) - (v1[2] - v0[2]) * (v2[0] - v0[0])) / area;
+        t.za = dzdx;
+        t.zb = dzdy;
+        t.zc = v0[2] - dzdx * v0[0] - dzdy * v0[1];
+        // pixel centres at +0.5; x bounds aligned to groups of four
+        t.minX = (minX > 0.0f) ? ((int) minX & ~3) : 0;
+        t.maxX = (maxX < (float) m_width) ? (int) maxX : m_width - 1;
+        t.minY = (minY > 0.0f) ? (int) minY : 0;
+        t.maxY = (maxY < (float) m_height) ? (int) maxY : m_height - 1;
+        if(t.minX <= t.maxX && t.minY <= t.maxY)
+        {
+            m_numTris++;
+        }
+    }
+
+    void RasterizeBand(unsigned int band)
+    {
+        int rows = (m_height + m_numThreads - 1) / m_numThreads;
+        int y0 = band * rows;
+        int y1 = (y0 + rows < m_height) ? y0 + rows : m_height;
+        for(int y = y0; y < y1; y++)
+        {
+            float* row = &m_depth[y * m_width];
+            for(int x = 0; x < m_width; x++)
+            {
+                row[x] = 1.0f;
+            }
+        }
+        for(unsigned int i = 0; i < m_numTris; i++)
+        {
+            const Triangle& t = m_tris[i];
+            int ty0 = (t.minY > y0) ? t.minY : y0;
+            int ty1 = (t.maxY < y1 - 1) ? t.maxY : y1 - 1;
+            for(int y = ty0; y <= ty1; y++)
+            {
+                RasterizeSpan(t, &m_depth[y * m_width], y + 0.5f);
+            }
+        }
+    }
+
+#if defined(SOFTOCCLUSION_SSE2)
+    void RasterizeSpan(const Triangle& t, float* row, float fy) const
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 step = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128 e0 = _mm_set1_ps(t.b[0] * fy + t.c[0]);
+        __m128 e1 = _mm_set1_ps(t.b[1] * fy + t.c[1]);
+        __m128 e2 = _mm_set1_ps(t.b[2] * fy + t.c[2]);
+        __m128 ez = _mm_set1_ps(t.zb * fy + t.zc);
+        __m128 a0 = _mm_set1_ps(t.a[0]);
+        __m128 a1 = _mm_set1_ps(t.a[1]);
+        __m128 a2 = _mm_set1_ps(t.a[2]);
+        __m128 az = _mm_set1_ps(t.za);
+        for(int x = t.minX; x <= t.maxX; x += 4)
+        {
+            __m128 fx = _mm_add_ps(_mm_set1_ps((float) x), step);
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, fx), e0), zero);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, fx), e1), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, fx), e2), zero));
+            if(_mm_movemask_ps(inside) == 0)
+            {
+                continue;
+            }
+            __m128 z = _mm_add_ps(_mm_mul_ps(az, fx), ez);
+            __m128 depth = _mm_loadu_ps(&row[x]);
+            __m128 nearest = _mm_min_ps(depth, z);
+            depth = _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, depth));
+            _mm_storeu_ps(&row[x], depth);
+        }
+    }
+#else
+    void RasterizeSpan(const Triangle& t, float* row, float fy) const
+    {
+        float e0 = t.b[0] * fy + t.c[0];
+        float e1 = t.b[1] * fy + t.c[1];
+        float e2 = t.b[2] * fy + t.c[2];
+        float ez = t.zb * fy + t.zc;
+        for(int x = t.minX; x <= t.maxX && x < m_width; x++)
+        {
+            float fx = x + 0.5f;
+            if(t.a[0] * fx + e0 >= 0.0f && t.a[1] * fx + e1 >= 0.0f && t.a[2] * fx + e2 >= 0.0f)
+            {
+                float z = t.za * fx + ez;
+                row[x] = (z < row[x]) ? z : row[x];
+            }
+        }
+    }
+#endif
+
+    float*              m_depth;
+    int                 m_width;
+    int                 m_height;
+
+    Triangle*           m_tris;
+    unsigned int        m_numTris;
+
+    unsigned int        m_numThreads;
+    volatile bool       m_quit;
+    NativeSemaphore     m_done;
+    Worker              m_workers[MAX_THREADS];
+};
+
+#endif // __SOFTOCCLUSION_H__
@@ -0,0 +1,137 @@
+#ifndef __SPSCQUEUE_H__
+#define __SPSCQUEUE_H__
+
+#include "nativethread.h"
+
+// Lock-free ring of N slots between exactly one producer and one consumer
+// thread. N must be a power of two.
+//
+// Slots are written and read in place, so large elements such as a frame's
+// command list are never copied: the producer fills the slot returned by
+// BeginWrite() and publishes it with EndWrite(), the consumer processes the
+// slot returned by BeginRead() and hands it back with EndRead().
+template <class T, unsigned int N>
+class SPSCQueue
+{
+public:
+    SPSCQueue() : m_head(0), m_tail(0)
+    {}
+
+    // Producer side. Returns NULL while the ring is full.
+    T* BeginWrite()
+    {
+        unsigned int tail = m_tail;
+        if(tail - AtomicLoadAcquire(&m_head) >= N)
+        {
+            return 0;
+        }
+        return &m_slots[tail & (N - 1)];
+    }
+
+    void EndWrite()
+    {
+        AtomicStoreRelease(&m_tail, m_tail + 1);
+    }
+
+    // Consumer side. Returns NULL while the ring is empty.
+    T* BeginRead()
+    {
+        unsigned int head = m_head;
+        if(AtomicLoadAcquire(&m_tail) == head)
+        {
+            return 0;
+        }
+        return &m_slots[head & (N - 1)];
+    }
+
+    void EndRead()
+    {
+        AtomicStoreRelease(&m_head, m_head + 1);
+    }
+
+    bool TryPush(const T& value)
+    {
+        T* slot = BeginWrite();
+        if(slot == 0)
+        {
+            return false;
+        }
+        *slot = value;
+        EndWrite();
+        return true;
+    }
+
+    bool TryPop(T& value)
+    {
+        T* slot = BeginRead();
+        if(slot == 0)
+        {
+            return false;
+        }
+        value = *slot;
+        EndRead();
+        return true;
+    }
+
+private:
+    // only the consumer writes the head and only the producer the tail;
+    // keep them on separate cache lines so the threads don't share one
+    volatile unsigned int m_head;
+    char m_pad[64];
+    volatile unsigned int m_tail;
+    T m_slots[N];
+};
+
+// SPSCQueue whose ends block instead of failing: the producer waits while all
+// slots are in flight and the consumer sleeps while the ring is empty.
+template <class T, unsigned int N>
+class BlockingSPSCQueue
+{
+public:
+    BlockingSPSCQueue() : m_free(0), m_filled(0)
+    {}
+
+    ~BlockingSPSCQueue()
+    {
+        if(m_free != 0)
+            DestroyNativeSemaphore(m_free);
+        if(m_filled != 0)
+            DestroyNativeSemaphore(m_filled);
+    }
+
+    bool Init()
+    {
+        return CreateNativeSemaphore(N, &m_free) && CreateNativeSemaphore(0, &m_filled);
+    }
+
+    T* BeginWrite()
+    {
+        WaitNativeSemaphore(m_free);
+        return m_queue.BeginWrite();
+    }
+
+    void EndWrite()
+    {
+        m_queue.EndWrite();
+        PostNativeSemaphore(m_filled);
+    }
+
+    T* BeginRead()
+    {
+        WaitNativeSemaphore(m_filled);
+        return m_queue.BeginRead();
+    }
+
+    void EndRead()
+    {
+        m_queue.EndRead();
+        PostNativeSemaphore(m_free);
+    }
+
+private:
+    SPSCQueue<T, N> m_queue;
+    NativeSemaphore m_free;
+    NativeSemaphore m_filled;
+};
+
+#endif // __SPSCQUEUE_H__
@@ -0,0 +1,128 @@
+#ifndef __TEXARRAY_H__
+#define __TEXARRAY_H__
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include "bmp.h"
+
+#include <cstring>
+
+// core in OpenGL ES 3.0, which gl2.h does not cover
+#ifndef GL_TEXTURE_2D_ARRAY
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#endif
+
+// Textures of one size stored as the layers of a GL_TEXTURE_2D_ARRAY, so draws
+// using different textures bind the array once and select their layer with a
+// uniform. Needs an OpenGL ES 3.0 context; the entry points are looked up at
+// runtime so the sample still links against OpenGL ES 2.0 libraries.
+class TextureArray
+{
+public:
+    enum { MAX_LAYERS = 16 };
+
+    TextureArray() :
+        m_texture(0), m_layers(0), m_width(0), m_height(0),
+        m_texImage3D(NULL), m_texSubImage3D(NULL)
+    {}
+
+    // Whether the current context is an OpenGL ES 3 context.
+    static bool IsSupported()
+    {
+        const char* version = (const char*) glGetString(GL_VERSION);
+        return version != NULL && strncmp(version, "OpenGL ES 3", 11) == 0;
+    }
+
+    // Create the array from 24 bit BMP files of equal size, one layer each.
+    bool Load(const char* const* files, int count)
+    {
+        if(count < 1 || count > MAX_LAYERS || !IsSupported())
+        {
+            return false;
+        }
+        m_texImage3D = (TexImage3DProc) eglGetProcAddress("glTexImage3D");
+        m_texSubImage3D = (TexSubImage3DProc) eglGetProcAddress("glTexSubImage3D");
+        if(m_texImage3D == NULL || m_texSubImage3D == NULL)
+        {
+            return false;
+        }
+        // drop errors raised before, so only this load's calls are checked
+        while(glGetError() != GL_NO_ERROR)
+        {
+        }
+        for(int i = 0; i < count; i++)
+        {
+            GLint width = 0;
+            GLint height = 0;
+            GLbyte* bits = LoadBMP(files[i], &width, &height);
+            if(bits == NULL)
+            {
+                printf("Failed to load %s.\n", files[i]);
+                Destroy();
+                return false;
+            }
+            if(i == 0)
+            {
+                m_width = width;
+                m_height = height;
+                glGenTextures(1, &m_texture);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                m_texImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, width, height, count, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+            }
+            else if(width != m_width || height != m_height)
+            {
+                printf("%s is %dx%d, the other layers %dx%d.\n", files[i], width, height, m_width, m_height);
+                free(bits);
+                Destroy();
+                return false;
+            }
+            m_texSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, bits);
+            free(bits);
+        }
+        m_layers = count;
+        return glGetError() == GL_NO_ERROR;
+    }
+
+    void Destroy()
+    {
+        if(m_texture != 0)
+        {
+            glDeleteTextures(1, &m_texture);
+        }
+        m_texture = 0;
+        m_layers = 0;
+    }
+
+    GLuint GetTexture() const
+    {
+        return m_texture;
+    }
+
+    GLint GetLayerCount() const
+    {
+        return m_layers;
+    }
+
+private:
+    typedef void (GL_APIENTRYP TexImage3DProc)(GLenum target, GLint level, GLint internalformat,
+                                               GLsizei width, GLsizei height, GLsizei depth, GLint border,
+                                               GLenum format, GLenum type, const void* pixels);
+    typedef void (GL_APIENTRYP TexSubImage3DProc)(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+                                                  GLint zoffset, GLsizei width, GLsizei height, GLsizei depth,
+                                                  GLenum format, GLenum type, const void* pixels);
+
+    GLuint              m_texture;
+    GLint               m_layers;
+    GLint               m_width;
+    GLint               m_height;
+
+    TexImage3DProc      m_texImage3D;
+    TexSubImage3DProc   m_texSubImage3D;
+};
+
+#endif // __TEXARRAY_H__
@@ -0,0 +1,254 @@
+#ifndef __TEXSTREAM_H__
+#define __TEXSTREAM_H__
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "bmp.h"
+#include "nativefile.h"
+#include "nativethread.h"
+#include "renderpass.h"
+
+#include <cstring>
+
+// core in OpenGL ES 3.0, which gl2.h does not cover
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+
+// Uploads a 24 bit BMP into a texture a few tiles per frame, so a large
+// texture never stalls a frame for the whole transfer.
+//
+// The file is mapped rather than read, and every frame Update() uploads tiles
+// until the frame's byte budget is spent. How a tile gets to the texture
+// depends on what the context offers:
+//
+// - OpenGL ES 3.0: the tile's rows are copied from the mapping into a pixel
+//   unpack buffer, orphaned for every tile, and glTexSubImage2D sources the
+//   buffer, so the driver can transfer it without stalling on earlier tiles.
+// - GL_EXT_unpack_subimage: glTexSubImage2D reads the tile straight from the
+//   mapping, with GL_UNPACK_ROW_LENGTH_EXT skipping the rest of each row.
+// - Otherwise tiles are strips of whole rows, which are contiguous in the
+//   file and need no row length.
+//
+// The texture is allocated up front and fills in while it is being drawn.
+// When contexts sharing it draw it too, every Update() waits with glFinish
+// until its tiles are in the texture, as those contexts only see completed
+// changes, and only once they bind the texture again.
+class TextureStreamer
+{
+public:
+    enum { TILE_SIZE = 256 };
+
+    TextureStreamer() :
+        m_file(NULL), m_pixels(NULL), m_width(0), m_height(0), m_stride(0),
+        m_texture(0), m_budget(0),
+        m_tileWidth(0), m_tileHeight(0), m_tilesX(0), m_numTiles(0), m_nextTile(0),
+        m_complete(1), m_shared(false), m_rowLength(false), m_pbo(0),
+        m_mapBufferRange(NULL), m_unmapBuffer(NULL)
+    {}
+
+    // Map the file and allocate the texture's storage. 'budget' is the
+    // number of bytes uploaded per frame; 'shared' tells whether other
+    // contexts draw the texture meanwhile. Needs a current context.
+    bool Begin(const char* filename, GLuint texture, GLsizeiptr budget, bool shared)
+    {
+        const void* data = NULL;
+        size_t size = 0;
+        if(!MapNativeFile(filename, &m_file, &data, &size))
+        {
+            return false;
+        }
+        const unsigned char* bytes = (const unsigned char*) data;
+        BMPHeader header;
+        BMPInfoHeader info;
+        if(size < sizeof(header) + sizeof(info))
+        {
+            End();
+            return false;
+        }
+        memcpy(&header, bytes, sizeof(header));
+        memcpy(&info, bytes + sizeof(header), sizeof(info));
+        m_width = info.width;
+        m_height = info.height;
+        m_stride = GetBMPRowSize(m_width);
+        if(info.bits != 24 || info.compression != 0 || m_width <= 0 || m_height <= 0 ||
+           header.offset + (size_t) m_stride * m_height > size)
+        {
+            printf("%s is not an uncompressed 24 bit BMP.\n", filename);
+            End();
+            return false;
+        }
+        m_pixels = (const GLbyte*) (bytes + header.offset);
+
+        const char* version = (const char*) glGetString(GL_VERSION);
+        bool es3 = version != NULL && strncmp(version, "OpenGL ES 3", 11) == 0;
+        if(es3)
+        {
+            m_mapBufferRange = (PFNGLMAPBUFFERRANGEEXTPROC) eglGetProcAddress("glMapBufferRange");
+            m_unmapBuffer = (PFNGLUNMAPBUFFEROESPROC) eglGetProcAddress("glUnmapBuffer");
+        }
+        if(m_mapBufferRange != NULL && m_unmapBuffer != NULL)
+        {
+            glGenBuffers(1, &m_pbo);
+        }
+        m_rowLength = m_pbo == 0 && (es3 || HasGLExtension("GL_EXT_unpack_subimage"));
+
+        // without a row length a tile has to span whole rows
+        if(m_pbo != 0 || m_rowLength)
+        {
+            m_tileWidth = TILE_SIZE;
+            m_tileHeight = TILE_SIZE;
+        }
+        else
+        {
+            m_tileWidth = m_width;
+            m_tileHeight = (TILE_SIZE * TILE_SIZE + m_width - 1) / m_width;
+        }
+        m_tilesX = (m_width + m_tileWidth - 1) / m_tileWidth;
+        m_numTiles = m_tilesX * ((m_height + m_tileHeight - 1) / m_tileHeight);
+        m_nextTile = 0;
+        m_budget = budget;
+        m_shared = shared;
+
+        m_texture = texture;
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        if(glGetError() != GL_NO_ERROR)
+        {
+            End();
+            AtomicStoreRelease(&m_complete, 1);
+            return false;
+        }
+        AtomicStoreRelease(&m_complete, 0);
+        return true;
+    }
+
+    // Upload the next tiles within the budget, at least one. Leaves the
+    // texture bound to GL_TEXTURE_2D. Once the last tile is uploaded the
+    // file and the buffer are released.
+    void Update()
+    {
+        if(IsComplete())
+        {
+            return;
+        }
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        if(m_rowLength)
+        {
+            glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, m_width);
+        }
+        GLsizeiptr uploaded = 0;
+        while(m_nextTile < m_numTiles && (uploaded == 0 || uploaded < m_budget))
+        {
+            GLint x = (m_nextTile % m_tilesX) * m_tileWidth;
+            GLint y = (m_nextTile / m_tilesX) * m_tileHeight;
+            GLint w = (x + m_tileWidth < m_width) ? m_tileWidth : m_width - x;
+            GLint h = (y + m_tileHeight < m_height) ? m_tileHeight : m_height - y;
+            const GLbyte* src = m_pixels + y * m_stride + x * 3;
+            if(m_pbo != 0)
+            {
+                UploadFromBuffer(src, x, y, w, h);
+            }
+            else
+            {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGB, GL_UNSIGNED_BYTE, src);
+            }
+            uploaded += w * h * 3;
+            m_nextTile++;
+        }
+        if(m_rowLength)
+        {
+            glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+        }
+        if(m_shared)
+        {
+            glFinish();
+        }
+        if(m_nextTile == m_numTiles)
+        {
+            if(m_pbo != 0)
+            {
+                glDeleteBuffers(1, &m_pbo);
+                m_pbo = 0;
+            }
+            End();
+            AtomicStoreRelease(&m_complete, 1);
+        }
+    }
+
+    // Safe to call from any thread.
+    bool IsComplete() const
+    {
+        return AtomicLoadAcquire(&m_complete) != 0;
+    }
+
+    // Release the file. A texture that is not complete stays partly empty.
+    void End()
+    {
+        if(m_file != NULL)
+        {
+            UnmapNativeFile(m_file);
+        }
+        m_file = NULL;
+        m_pixels = NULL;
+    }
+
+private:
+    // Copy the tile's rows tightly packed into the orphaned buffer and
+    // source the upload from it.
+    void UploadFromBuffer(const GLbyte* src, GLint x, GLint y, GLint w, GLint h)
+    {
+        GLsizeiptr rowSize = GetBMPRowSize(w);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, rowSize * h, NULL, GL_STREAM_DRAW);
+        GLbyte* dst = (GLbyte*) m_mapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, rowSize * h,
+                                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if(dst != NULL)
+        {
+            for(GLint row = 0; row < h; row++)
+            {
+                memcpy(dst + row * rowSize, src + row * m_stride, w * 3);
+            }
+            m_unmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    NativeFile          m_file;
+    const GLbyte*       m_pixels;
+    GLint               m_width;
+    GLint               m_height;
+    GLint               m_stride;
+
+    GLuint              m_texture;
+    GLsizeiptr          m_budget;
+
+    GLint               m_tileWidth;
+    GLint               m_tileHeight;
+    GLint               m_tilesX;
+    GLint               m_numTiles;
+    GLint               m_nextTile;
+    volatile unsigned int m_complete;
+    bool                m_shared;
+
+    bool                m_rowLength;
+    GLuint              m_pbo;
+    PFNGLMAPBUFFERRANGEEXTPROC  m_mapBufferRange;
+    PFNGLUNMAPBUFFEROESPROC     m_unmapBuffer;
+};
+
+#endif // __TEXSTREAM_H__
@@ -133,6 +133,11 @@ struct mat4
             0.0f);
     }
 
+    inline static mat4 translate(float tx, float ty, float tz)
+    {
+        return mat4(1.0f,0.0f,0.0f,0.0f, 0.0f,1.0f,0.0f,0.0f, 0.0f,0.0f,1.0f,0.0f, tx,ty,tz,1.0f);
+    }
+
     inline static mat4 rotate(float deg, const vec4& axis)
     {
         float rad = deg/180.0f * 3.141593f;